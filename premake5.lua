@@ -37,6 +37,8 @@ project "ggpo"
 
    filter { "not options:steam" }
       removefiles { "src/lib/ggpo/network/connection_steam.c" }
+   filter "system:linux"
+      links { "pthread" }
    filter { "options:steam", "system:Windows" }
       libdirs { "thirdparty/bin/win64" }
       links { "steam_api64" }
@@ -73,3 +75,80 @@ project "vectorwar"
    filter { "options:steam", "system:linux" }
       libdirs { "thirdparty/bin/linux64" }
       links { "steam_api64" }
+
+-- The benchmarks talk to themselves over loopback UDP, which the steam transport can't do.
+if not _OPTIONS["steam"] then
+   project "ggpo_bench"
+      kind "ConsoleApp"
+      language "C"
+      cdialect "c11"
+      warnings "High"
+      -- fatalwarnings "All"
+      -- targetdir "bin/%{cfg.buildcfg}"
+
+      files { "src/apps/bench/**.c", "src/apps/vectorwar/gamestate.h", "src/apps/vectorwar/gamestate.c" }
+      includedirs { "src/apps/vectorwar", "src/include" }
+
+      links { "ggpo" }
+
+      filter "configurations:Debug"
+         defines { "DEBUG" }
+         symbols "On"
+
+      filter "configurations:Release"
+         defines { "NDEBUG" }
+         optimize "On"
+
+      filter "system:linux"
+         links { "m", "pthread" }
+
+   -- Reaches into the library internals, so it uses the library's include paths.
+   project "ggpo_microbench"
+      kind "ConsoleApp"
+      language "C"
+      cdialect "c11"
+      warnings "High"
+      -- fatalwarnings "All"
+      -- targetdir "bin/%{cfg.buildcfg}"
+
+      files { "src/apps/microbench/**.c" }
+      includedirs { "src/lib/ggpo", "src/include", "thirdparty/include" }
+
+      links { "ggpo" }
+
+      filter "configurations:Debug"
+         defines { "DEBUG" }
+         symbols "On"
+
+      filter "configurations:Release"
+         defines { "NDEBUG" }
+         optimize "On"
+
+      filter "system:linux"
+         links { "m", "pthread" }
+end
+
+-- The relay is built on epoll and recvmmsg/sendmmsg, so it only builds on Linux.
+if os.istarget("linux") then
+   -- Uses the library's headers for the packet layout.
+   project "ggpo_relay"
+      kind "ConsoleApp"
+      language "C"
+      cdialect "c11"
+      warnings "High"
+      -- fatalwarnings "All"
+      -- targetdir "bin/%{cfg.buildcfg}"
+
+      files { "src/apps/relay/**.h", "src/apps/relay/**.c" }
+      includedirs { "src/lib/ggpo", "src/include", "thirdparty/include" }
+
+      links { "ggpo", "pthread" }
+
+      filter "configurations:Debug"
+         defines { "DEBUG" }
+         symbols "On"
+
+      filter "configurations:Release"
+         defines { "NDEBUG" }
+         optimize "On"
+end
@@ -0,0 +1,1019 @@
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#define _POSIX_C_SOURCE 199309L // We need this POSIX standard for clock_gettime
+#include <time.h>
+#include <pthread.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include "ggponet.h"
+#include "gamestate.h"
+
+/*
+ * bench.c --
+ *
+ * Headless benchmark for the GGPO library.  Runs the VectorWar simulation
+ * without a window through synctest, peer to peer, spectator and star
+ * sessions.
+ * All the sessions of a scenario live in this process and talk to each
+ * other over loopback UDP.  The sessions are not paced to 60 fps; every
+ * iteration of the main loop runs each session as fast as the library
+ * allows, so the numbers reflect the cost of the library and the game
+ * simulation rather than the frame rate.
+ *
+ * With -t, each scenario is also run as 1, 2, 4... up to the given number
+ * of matches at once, each match on its own thread, to measure how the
+ * library scales when a process hosts many sessions.
+ *
+ * With -s, all the sessions of a match share a single socket on the base
+ * port instead of binding one port each.  With -r, they also send all
+ * their packets through a ggpo_relay on the given port, which must have
+ * the session ids of the matches registered (1-16 for one match, 1-16 *
+ * the number of threads with -t).
+ *
+ * With -l, the sessions are paced to 60 frames/sec like a game instead.
+ * The library's timers (quality reports, keep alives, resends) then fire
+ * as often as they would in a match, so the packet counts are realistic.
+ *
+ * The star scenarios run the players of a star session and their input
+ * server; compare their bytes/frame with the peer to peer scenarios of the
+ * same size.  They need a port for each session, so they can't run with
+ * -s or -r.
+ */
+
+#define ARRAY_SIZE(n)            (sizeof(n) / sizeof(n[0]))
+#define MAX_BENCH_SESSIONS       16
+#define MAX_BENCH_HANDLES        16
+#define DEFAULT_FRAMES           3000
+#define DEFAULT_BASE_PORT        7100
+#define DEFAULT_FRAME_DELAY      2
+#define SYNCTEST_CHECK_DISTANCE  1
+#define STALL_TIMEOUT_US         10000000.0
+#define BENCH_UDP_HEADER_SIZE    28       /* counted in the bytes sent of the network stats */
+#define BENCH_FRAME_US           (1000000.0 / 60)
+#define MAX_BENCH_THREADS        64
+
+#if defined(_MSC_VER)
+#define BENCH_THREAD_LOCAL       __declspec(thread)
+#else
+#define BENCH_THREAD_LOCAL       _Thread_local
+#endif
+
+typedef enum BenchApi {
+   BENCH_API_IDLE,
+   BENCH_API_ADD_LOCAL_INPUT,
+   BENCH_API_SYNCHRONIZE_INPUT,
+   BENCH_API_ADVANCE_FRAME,
+   BENCH_API_COUNT
+} BenchApi;
+
+static const char *bench_api_names[BENCH_API_COUNT] = {
+   "idle",
+   "add_local_input",
+   "synchronize_input",
+   "advance_frame",
+};
+
+typedef struct BenchApiTiming {
+   double      total_us;
+   double      max_us;
+   int         calls;
+} BenchApiTiming;
+
+typedef struct BenchMatch BenchMatch;
+
+typedef struct BenchSession {
+   BenchMatch        *match;
+   GGPOSession       *ggpo;
+   GameState         gs;
+   bool              running;
+   int               num_local_players;
+   GGPOPlayerHandle  local_players[MAX_SHIPS];
+   int               num_remote_handles;
+   GGPOPlayerHandle  remote_handles[MAX_BENCH_HANDLES];
+   bool              input_server;     /* runs no game, only polled */
+   bool              shared_link;      /* all the remote handles are one connection */
+} BenchSession;
+
+typedef struct BenchScenario {
+   const char  *name;
+   int         num_players;
+   int         num_spectators;
+   bool        synctest;
+   bool        star;
+} BenchScenario;
+
+typedef struct BenchResult {
+   double         elapsed_us;
+   int            frames;
+   int            rollbacks;
+   int            rollback_frames;
+   int            max_rollback_depth;
+   int            resimulated_frames;
+   int            bytes_sent;
+   int            packets_sent;
+   int            predicted_frames;
+   int            mispredicted_frames;
+   BenchApiTiming api[BENCH_API_COUNT];
+} BenchResult;
+
+/*
+ * The sessions of one run of a scenario.  Matches running on different
+ * threads share nothing.
+ */
+struct BenchMatch {
+   const BenchScenario  *scenario;
+   int                  frames;
+   unsigned short       base_port;
+   int                  frame_delay;
+   GGPOInputPredictor   predictor;
+   BenchSession         sessions[MAX_BENCH_SESSIONS];
+   GGPOSocket           *socket;
+   unsigned short       first_session_id;
+   int                  num_sessions;
+   int                  num_players;
+   BenchResult          totals;
+   double               pace_start;       /* when frame 0 was due, with -l */
+   bool                 ok;
+};
+
+typedef struct BenchPredictor {
+   const char           *name;
+   GGPOInputPredictor   predictor;
+} BenchPredictor;
+
+static const BenchPredictor predictors[] = {
+   { "repeat",  GGPO_PREDICTOR_REPEAT_LAST },
+   { "release", GGPO_PREDICTOR_RELEASE_BUTTONS },
+   { "markov",  GGPO_PREDICTOR_MARKOV },
+};
+
+/*
+ * The buttons GGPO_PREDICTOR_RELEASE_BUTTONS expects to be released.
+ */
+static const int release_mask = INPUT_FIRE | INPUT_BOMB;
+
+static const BenchScenario scenarios[] = {
+   { "synctest",  2, 0, true,  false },
+   { "p2p2",      2, 0, false, false },
+   { "p2p3",      3, 0, false, false },
+   { "p2p4",      4, 0, false, false },
+   { "p2p8",      8, 0, false, false },
+   { "spectator", 2, 2, false, false },
+   { "star2",     2, 0, false, true },
+   { "star4",     4, 0, false, true },
+   { "star8",     8, 0, false, true },
+};
+
+/*
+ * The GGPO callbacks have no context, so they find their session here.
+ * Each thread runs its own match, so this is per thread.
+ */
+static BENCH_THREAD_LOCAL BenchSession *current;
+static bool threaded;
+static bool shared_socket;
+static unsigned short relay_port;
+static bool paced;
+
+/*
+ * gamestate.c logs through this session.  It is shared, so it is left
+ * alone when matches run on several threads.
+ */
+GGPOSession *ggpo = NULL;
+
+/*
+ * bench_now --
+ *
+ * High resolution monotonic clock, in microseconds.
+ */
+static double
+bench_now(void)
+{
+#if defined(_WIN32)
+   static LARGE_INTEGER frequency;
+   LARGE_INTEGER counter;
+
+   if (!frequency.QuadPart) {
+      QueryPerformanceFrequency(&frequency);
+   }
+   QueryPerformanceCounter(&counter);
+   return (double)counter.QuadPart * 1000000.0 / (double)frequency.QuadPart;
+#else
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec * 1000000.0 + (double)ts.tv_nsec / 1000.0;
+#endif
+}
+
+static void
+bench_record_call(BenchApi api, double start)
+{
+   double elapsed = bench_now() - start;
+   BenchApiTiming *timing = current->match->totals.api + api;
+
+   timing->total_us += elapsed;
+   timing->calls++;
+   if (elapsed > timing->max_us) {
+      timing->max_us = elapsed;
+   }
+}
+
+/*
+ * bench_input --
+ *
+ * Deterministic input for a player on a given frame.  Inputs are held for
+ * a few frames at a time like a real player would, so predictions are
+ * sometimes right and sometimes wrong.
+ */
+static int
+bench_input(int player, int frame)
+{
+   unsigned int hash = (unsigned int)(frame / (6 + player * 3) + player * 7919);
+
+   hash *= 2654435761u;
+   return (int)((hash >> 16) & (INPUT_THRUST | INPUT_BREAK | INPUT_ROTATE_LEFT | INPUT_ROTATE_RIGHT | INPUT_FIRE));
+}
+
+/*
+ * Simple checksum function stolen from wikipedia:
+ *
+ *   http://en.wikipedia.org/wiki/Fletcher%27s_checksum
+ */
+
+static int
+fletcher32_checksum(short *data, size_t len)
+{
+   int sum1 = 0xffff, sum2 = 0xffff;
+
+   while (len) {
+      size_t tlen = len > 360 ? 360 : len;
+      len -= tlen;
+      do {
+         sum1 += *data++;
+         sum2 += sum1;
+      } while (--tlen);
+      sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+      sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+   }
+
+   /* Second reduction step to reduce sums to 16 bits */
+   sum1 = (sum1 & 0xffff) + (sum1 >> 16);
+   sum2 = (sum2 & 0xffff) + (sum2 >> 16);
+   return (int)((unsigned int)sum2 << 16 | (unsigned int)sum1);
+}
+
+static bool
+bench_begin_game_callback(const char *game)
+{
+   (void)game;
+   return true;
+}
+
+static bool
+bench_on_event_callback(GGPOEvent *info)
+{
+   if (info->code == GGPO_EVENTCODE_RUNNING) {
+      current->running = true;
+   }
+   return true;
+}
+
+/*
+ * bench_advance_frame_callback --
+ *
+ * Called by GGPO to resimulate a frame during a rollback.
+ */
+static bool
+bench_advance_frame_callback(int flags)
+{
+   int inputs[MAX_SHIPS] = { 0 };
+   int disconnect_flags;
+
+   (void)flags;
+   ggpo_synchronize_input(current->ggpo, (void *)inputs, sizeof(int) * current->match->num_players, &disconnect_flags);
+   GameState_Update(&current->gs, inputs, disconnect_flags);
+   ggpo_advance_frame(current->ggpo);
+   current->match->totals.resimulated_frames++;
+   return true;
+}
+
+/*
+ * bench_load_game_state_callback --
+ *
+ * Every load of a running session is a rollback.  Its depth is the number
+ * of frames between the current frame and the frame being restored.
+ */
+static bool
+bench_load_game_state_callback(unsigned char *buffer, int len)
+{
+   GameState *saved = (GameState *)buffer;
+   BenchResult *totals = &current->match->totals;
+   int depth = current->gs._framenumber - saved->_framenumber;
+
+   if (current->running) {
+      totals->rollbacks++;
+      totals->rollback_frames += depth;
+      if (depth > totals->max_rollback_depth) {
+         totals->max_rollback_depth = depth;
+      }
+   }
+   memcpy(&current->gs, buffer, len);
+   return true;
+}
+
+static bool
+bench_save_game_state_callback(unsigned char **buffer, int *len, int *checksum, int frame)
+{
+   (void)frame;
+   *len = sizeof(current->gs);
+   *buffer = (unsigned char *)malloc(*len);
+   if (!*buffer) {
+      return false;
+   }
+   memcpy(*buffer, &current->gs, *len);
+   *checksum = fletcher32_checksum((short *)*buffer, *len / 2);
+   return true;
+}
+
+static bool
+bench_log_game_state(char *filename, unsigned char *buffer, int len)
+{
+   (void)filename;
+   (void)buffer;
+   (void)len;
+   return true;
+}
+
+static void
+bench_free_buffer(void *buffer)
+{
+   free(buffer);
+}
+
+static void
+bench_set_current(BenchSession *session)
+{
+   current = session;
+   if (!threaded) {
+      ggpo = session->ggpo;
+   }
+}
+
+/*
+ * bench_start_star_sessions --
+ *
+ * Player i listens on base_port + i and the input server on base_port +
+ * num_players, after the players.
+ */
+static bool
+bench_start_star_sessions(BenchMatch *match, GGPOSessionCallbacks *cb)
+{
+   BenchSession *sessions = match->sessions;
+   BenchSession *server = sessions + match->num_players;
+   unsigned short base_port = match->base_port;
+   unsigned short server_port = (unsigned short)(base_port + match->num_players);
+   int num_players = match->num_players;
+   GGPOErrorCode result;
+   GGPOPlayerHandle handle;
+   int i, j;
+
+   match->num_sessions = num_players + 1;
+   bench_set_current(server);
+   server->input_server = true;
+   result = ggpo_start_input_server(&server->ggpo, cb, "vectorwar", num_players, sizeof(int), server_port);
+   if (!GGPO_SUCCEEDED(result)) {
+      return false;
+   }
+   for (i = 0; i < num_players; i++) {
+      GGPOPlayer player = { 0 };
+
+      player.size = sizeof(player);
+      player.type = GGPO_PLAYERTYPE_REMOTE;
+      player.player_num = i + 1;
+      strcpy(player.u.remote.ip_address, "127.0.0.1");
+      player.u.remote.port = base_port + i;
+      result = ggpo_add_player(server->ggpo, &player, &handle);
+      if (!GGPO_SUCCEEDED(result)) {
+         return false;
+      }
+      server->remote_handles[server->num_remote_handles++] = handle;
+   }
+
+   for (i = 0; i < num_players; i++) {
+      BenchSession *session = sessions + i;
+
+      bench_set_current(session);
+      GameState_Init(&session->gs, 640, 480, num_players);
+      session->shared_link = true;
+      result = ggpo_start_star_session(&session->ggpo, cb, "vectorwar", num_players, sizeof(int), base_port + i, "127.0.0.1", server_port);
+      if (!GGPO_SUCCEEDED(result)) {
+         return false;
+      }
+      for (j = 0; j < num_players; j++) {
+         GGPOPlayer player = { 0 };
+
+         player.size = sizeof(player);
+         player.player_num = j + 1;
+         player.type = j == i ? GGPO_PLAYERTYPE_LOCAL : GGPO_PLAYERTYPE_REMOTE;
+         result = ggpo_add_player(session->ggpo, &player, &handle);
+         if (!GGPO_SUCCEEDED(result)) {
+            return false;
+         }
+         if (j == i) {
+            session->local_players[session->num_local_players++] = handle;
+            ggpo_set_frame_delay(session->ggpo, handle, match->frame_delay);
+         } else {
+            session->remote_handles[session->num_remote_handles++] = handle;
+            ggpo_set_input_predictor(session->ggpo, handle, match->predictor, &release_mask, sizeof(release_mask));
+         }
+      }
+   }
+   return true;
+}
+
+/*
+ * bench_start_sessions --
+ *
+ * Create every session of the scenario.  Player i listens on base_port + i
+ * and spectator j on base_port + num_players + j.  All the spectators
+ * connect to player 1.
+ *
+ * With a shared socket every session listens on base_port instead, and
+ * the ports above become the session ids on it, counted from
+ * first_session_id.  The peers are then reached at base_port, or at
+ * relay_port when going through a relay.
+ */
+static bool
+bench_start_sessions(BenchMatch *match)
+{
+   const BenchScenario *scenario = match->scenario;
+   BenchSession *sessions = match->sessions;
+   unsigned short base_port = match->base_port;
+   unsigned short peer_port = relay_port ? relay_port : base_port;
+   unsigned short first_id = match->first_session_id;
+   int num_players = scenario->num_players;
+   GGPOSessionCallbacks cb;
+   GGPOErrorCode result;
+   GGPOPlayerHandle handle;
+   int i, j;
+
+   memset(&cb, 0, sizeof(cb));
+   cb.begin_game      = bench_begin_game_callback;
+   cb.advance_frame   = bench_advance_frame_callback;
+   cb.load_game_state = bench_load_game_state_callback;
+   cb.save_game_state = bench_save_game_state_callback;
+   cb.free_buffer     = bench_free_buffer;
+   cb.on_event        = bench_on_event_callback;
+   cb.log_game_state  = bench_log_game_state;
+
+   memset(match->sessions, 0, sizeof(match->sessions));
+   for (i = 0; i < MAX_BENCH_SESSIONS; i++) {
+      sessions[i].match = match;
+   }
+   match->num_players = num_players;
+
+   if (scenario->synctest) {
+      match->num_sessions = 1;
+      bench_set_current(sessions);
+      GameState_Init(&sessions[0].gs, 640, 480, num_players);
+      result = ggpo_start_synctest(&sessions[0].ggpo, &cb, "vectorwar", num_players, sizeof(int), SYNCTEST_CHECK_DISTANCE);
+      if (!GGPO_SUCCEEDED(result)) {
+         return false;
+      }
+      for (i = 0; i < num_players; i++) {
+         GGPOPlayer player = { 0 };
+
+         player.size = sizeof(player);
+         player.type = GGPO_PLAYERTYPE_LOCAL;
+         player.player_num = i + 1;
+         ggpo_add_player(sessions[0].ggpo, &player, &sessions[0].local_players[i]);
+      }
+      sessions[0].num_local_players = num_players;
+      return true;
+   }
+
+   if (scenario->star) {
+      return !shared_socket && bench_start_star_sessions(match, &cb);
+   }
+
+   if (shared_socket) {
+      result = ggpo_open_socket(&match->socket, base_port);
+      if (!GGPO_SUCCEEDED(result)) {
+         return false;
+      }
+   }
+
+   match->num_sessions = scenario->num_players + scenario->num_spectators;
+   for (i = 0; i < scenario->num_players; i++) {
+      BenchSession *session = sessions + i;
+
+      bench_set_current(session);
+      GameState_Init(&session->gs, 640, 480, num_players);
+      if (match->socket) {
+         result = ggpo_start_session_on_socket(&session->ggpo, &cb, "vectorwar", num_players, sizeof(int), match->socket, (unsigned short)(first_id + i));
+      } else {
+         result = ggpo_start_session(&session->ggpo, &cb, "vectorwar", num_players, sizeof(int), base_port + i);
+      }
+      if (!GGPO_SUCCEEDED(result)) {
+         return false;
+      }
+      for (j = 0; j < scenario->num_players; j++) {
+         GGPOPlayer player = { 0 };
+
+         player.size = sizeof(player);
+         player.player_num = j + 1;
+         if (j == i) {
+            player.type = GGPO_PLAYERTYPE_LOCAL;
+         } else {
+            player.type = GGPO_PLAYERTYPE_REMOTE;
+            strcpy(player.u.remote.ip_address, "127.0.0.1");
+            if (match->socket) {
+               player.u.remote.port = peer_port;
+               player.u.remote.session_id = (unsigned short)(first_id + j);
+            } else {
+               player.u.remote.port = base_port + j;
+            }
+         }
+         result = ggpo_add_player(session->ggpo, &player, &handle);
+         if (!GGPO_SUCCEEDED(result)) {
+            return false;
+         }
+         if (j == i) {
+            session->local_players[session->num_local_players++] = handle;
+            ggpo_set_frame_delay(session->ggpo, handle, match->frame_delay);
+         } else {
+            session->remote_handles[session->num_remote_handles++] = handle;
+            ggpo_set_input_predictor(session->ggpo, handle, match->predictor, &release_mask, sizeof(release_mask));
+         }
+      }
+   }
+
+   for (i = 0; i < scenario->num_spectators; i++) {
+      BenchSession *session = sessions + scenario->num_players + i;
+      unsigned short port = (unsigned short)(base_port + scenario->num_players + i);
+      GGPOPlayer player = { 0 };
+
+      player.size = sizeof(player);
+      player.type = GGPO_PLAYERTYPE_SPECTATOR;
+      strcpy(player.u.remote.ip_address, "127.0.0.1");
+      if (match->socket) {
+         player.u.remote.port = peer_port;
+         player.u.remote.session_id = (unsigned short)(first_id + port - base_port);
+      } else {
+         player.u.remote.port = port;
+      }
+      result = ggpo_add_player(sessions[0].ggpo, &player, &handle);
+      if (!GGPO_SUCCEEDED(result)) {
+         return false;
+      }
+      sessions[0].remote_handles[sessions[0].num_remote_handles++] = handle;
+
+      bench_set_current(session);
+      GameState_Init(&session->gs, 640, 480, num_players);
+      if (match->socket) {
+         result = ggpo_start_spectating_on_socket(&session->ggpo, &cb, "vectorwar", num_players, sizeof(int), match->socket,
+                                                  (unsigned short)(first_id + port - base_port), "127.0.0.1", peer_port, first_id);
+      } else {
+         result = ggpo_start_spectating(&session->ggpo, &cb, "vectorwar", num_players, sizeof(int), port, "127.0.0.1", base_port);
+      }
+      if (!GGPO_SUCCEEDED(result)) {
+         return false;
+      }
+      session->remote_handles[session->num_remote_handles++] = GGPO_INVALID_HANDLE;
+   }
+   return true;
+}
+
+/*
+ * bench_run_frame --
+ *
+ * Give a session some time and advance it by one frame if it can.
+ * Returns true if the session advanced.
+ */
+static bool
+bench_run_frame(BenchSession *session)
+{
+   BenchMatch *match = session->match;
+   int inputs[MAX_SHIPS] = { 0 };
+   GGPOErrorCode result = GGPO_OK;
+   int disconnect_flags;
+   int frame, i;
+   double start;
+
+   bench_set_current(session);
+
+   start = bench_now();
+   ggpo_idle(session->ggpo, 0);
+   bench_record_call(BENCH_API_IDLE, start);
+
+   if (session->input_server || !session->running || session->gs._framenumber >= match->frames) {
+      return false;
+   }
+
+   frame = session->gs._framenumber;
+   if (paced && frame > (bench_now() - match->pace_start) / BENCH_FRAME_US) {
+      return false;
+   }
+   for (i = 0; i < session->num_local_players && GGPO_SUCCEEDED(result); i++) {
+      int player = session->num_local_players > 1 ? i : (int)(session - match->sessions);
+      int input = bench_input(player, frame);
+
+      start = bench_now();
+      result = ggpo_add_local_input(session->ggpo, session->local_players[i], &input, sizeof(input));
+      bench_record_call(BENCH_API_ADD_LOCAL_INPUT, start);
+   }
+   if (!GGPO_SUCCEEDED(result)) {
+      return false;
+   }
+
+   start = bench_now();
+   result = ggpo_synchronize_input(session->ggpo, (void *)inputs, sizeof(int) * match->num_players, &disconnect_flags);
+   bench_record_call(BENCH_API_SYNCHRONIZE_INPUT, start);
+   if (!GGPO_SUCCEEDED(result)) {
+      return false;
+   }
+
+   GameState_Update(&session->gs, inputs, disconnect_flags);
+
+   start = bench_now();
+   ggpo_advance_frame(session->ggpo);
+   bench_record_call(BENCH_API_ADVANCE_FRAME, start);
+   match->totals.frames++;
+   return true;
+}
+
+/*
+ * bench_collect_network_stats --
+ *
+ * Add up the traffic every session sent to its peers.
+ */
+static void
+bench_collect_network_stats(BenchMatch *match)
+{
+   BenchSession *sessions = match->sessions;
+   GGPONetworkStats stats;
+   int i, j;
+
+   for (i = 0; i < match->num_sessions; i++) {
+      for (j = 0; j < sessions[i].num_remote_handles; j++) {
+         if (GGPO_SUCCEEDED(ggpo_get_network_stats(sessions[i].ggpo, sessions[i].remote_handles[j], &stats))) {
+            if (j == 0 || !sessions[i].shared_link) {
+               match->totals.bytes_sent += stats.network.bytes_sent;
+               match->totals.packets_sent += stats.network.packets_sent;
+            }
+            match->totals.predicted_frames += stats.prediction.predicted_frames;
+            match->totals.mispredicted_frames += stats.prediction.mispredicted_frames;
+         }
+      }
+   }
+}
+
+static void
+bench_close_sessions(BenchMatch *match)
+{
+   int i;
+
+   for (i = 0; i < match->num_sessions; i++) {
+      if (match->sessions[i].ggpo) {
+         bench_set_current(match->sessions + i);
+         ggpo_close_session(match->sessions[i].ggpo);
+         match->sessions[i].ggpo = NULL;
+      }
+   }
+   if (match->socket) {
+      ggpo_close_socket(match->socket);
+      match->socket = NULL;
+   }
+   if (!threaded) {
+      ggpo = NULL;
+   }
+   current = NULL;
+}
+
+static void
+bench_report(BenchMatch *match)
+{
+   BenchResult *totals = &match->totals;
+   double seconds = totals->elapsed_us / 1000000.0;
+   int frames = match->frames;
+   int i;
+
+   printf("%s: %d sessions, %d frames in %.3f s\n", match->scenario->name, match->num_sessions, frames, seconds);
+   printf("  frames/sec           %12.1f\n", totals->frames / seconds);
+   printf("  rollbacks/sec        %12.1f\n", totals->rollbacks / seconds);
+   printf("  rollback depth       %12.2f mean %d max\n",
+          totals->rollbacks ? (double)totals->rollback_frames / totals->rollbacks : 0.0,
+          totals->max_rollback_depth);
+   printf("  resimulated frames   %12d\n", totals->resimulated_frames);
+   printf("  mispredicted frames  %12d of %d predicted\n", totals->mispredicted_frames, totals->predicted_frames);
+   printf("  bytes/frame          %12.1f (%d packets)\n", (double)totals->bytes_sent / frames, totals->packets_sent);
+   printf("  bytes/sec/session    %12.1f at 60 frames/sec\n", (double)totals->bytes_sent / frames / match->num_sessions * 60);
+   printf("  packets/sec/session  %12.1f at 60 frames/sec, %.1f%% IP/UDP headers\n",
+          (double)totals->packets_sent / frames / match->num_sessions * 60,
+          totals->bytes_sent ? 100.0 * BENCH_UDP_HEADER_SIZE * totals->packets_sent / totals->bytes_sent : 0.0);
+   for (i = 0; i < BENCH_API_COUNT; i++) {
+      BenchApiTiming *timing = totals->api + i;
+      printf("  %-20s %12.3f us mean %10.3f us max %10d calls\n",
+             bench_api_names[i],
+             timing->calls ? timing->total_us / timing->calls : 0.0,
+             timing->max_us,
+             timing->calls);
+   }
+}
+
+/*
+ * bench_run_match --
+ *
+ * Run every session of the match until all of them have simulated the
+ * requested number of frames.  Timing starts once every session is
+ * running, so the synchronization handshake is not counted.
+ */
+static bool
+bench_run_match(BenchMatch *match)
+{
+   const char *name = match->scenario->name;
+   double start, last_progress;
+   bool done = false;
+   int i;
+
+   memset(&match->totals, 0, sizeof(match->totals));
+   if (!bench_start_sessions(match)) {
+      fprintf(stderr, "%s: failed to start sessions.\n", name);
+      bench_close_sessions(match);
+      return false;
+   }
+
+   start = bench_now();
+   last_progress = start;
+   match->pace_start = start;
+   while (!done) {
+      bool progress = false;
+      bool all_running = true;
+
+      done = true;
+      for (i = 0; i < match->num_sessions; i++) {
+         if (bench_run_frame(match->sessions + i)) {
+            progress = true;
+         }
+         all_running = all_running && match->sessions[i].running;
+         done = done && (match->sessions[i].input_server || match->sessions[i].gs._framenumber >= match->frames);
+      }
+
+      if (!all_running || match->totals.frames == 0) {
+         /* Still synchronizing.  Don't count the handshake. */
+         memset(&match->totals, 0, sizeof(match->totals));
+         start = bench_now();
+         if (!all_running) {
+            match->pace_start = start;
+         }
+      }
+      if (progress) {
+         last_progress = bench_now();
+      } else if (bench_now() - last_progress > STALL_TIMEOUT_US) {
+         fprintf(stderr, "%s: sessions stopped making progress.\n", name);
+         bench_close_sessions(match);
+         return false;
+      }
+   }
+   match->totals.elapsed_us = bench_now() - start;
+
+   bench_collect_network_stats(match);
+   bench_close_sessions(match);
+   return true;
+}
+
+static void
+bench_init_match(BenchMatch *match, const BenchScenario *scenario, int frames, unsigned short base_port, int frame_delay, GGPOInputPredictor predictor)
+{
+   memset(match, 0, sizeof(*match));
+   match->scenario = scenario;
+   match->frames = frames;
+   match->base_port = base_port;
+   match->frame_delay = frame_delay;
+   match->predictor = predictor;
+   match->first_session_id = 1;
+}
+
+static bool
+bench_run_scenario(const BenchScenario *scenario, int frames, unsigned short base_port, int frame_delay, GGPOInputPredictor predictor)
+{
+   static BenchMatch match;
+
+   bench_init_match(&match, scenario, frames, base_port, frame_delay, predictor);
+   if (!bench_run_match(&match)) {
+      return false;
+   }
+   bench_report(&match);
+   return true;
+}
+
+#if defined(_WIN32)
+typedef HANDLE BenchThread;
+
+static DWORD WINAPI
+bench_thread_main(LPVOID param)
+{
+   BenchMatch *match = (BenchMatch *)param;
+
+   match->ok = bench_run_match(match);
+   return 0;
+}
+
+static bool
+bench_start_thread(BenchThread *thread, BenchMatch *match)
+{
+   *thread = CreateThread(NULL, 0, bench_thread_main, match, 0, NULL);
+   return *thread != NULL;
+}
+
+static void
+bench_join_thread(BenchThread *thread)
+{
+   WaitForSingleObject(*thread, INFINITE);
+   CloseHandle(*thread);
+}
+#else
+typedef pthread_t BenchThread;
+
+static void *
+bench_thread_main(void *param)
+{
+   BenchMatch *match = (BenchMatch *)param;
+
+   match->ok = bench_run_match(match);
+   return NULL;
+}
+
+static bool
+bench_start_thread(BenchThread *thread, BenchMatch *match)
+{
+   return pthread_create(thread, NULL, bench_thread_main, match) == 0;
+}
+
+static void
+bench_join_thread(BenchThread *thread)
+{
+   pthread_join(*thread, NULL);
+}
+#endif
+
+/*
+ * bench_run_threads --
+ *
+ * Run num_threads matches of the scenario at once, one per thread, each
+ * on its own range of ports.  Returns the combined frames per second of
+ * all of them, or 0 if any failed.
+ */
+static double
+bench_run_threads(const BenchScenario *scenario, int num_threads, int frames, unsigned short base_port, int frame_delay, GGPOInputPredictor predictor)
+{
+   BenchMatch *matches = calloc(num_threads, sizeof(BenchMatch));
+   BenchThread threads[MAX_BENCH_THREADS];
+   double frames_per_sec = 0.0;
+   bool ok = matches != NULL;
+   int started = 0;
+   int i;
+
+   for (i = 0; ok && i < num_threads; i++) {
+      bench_init_match(matches + i, scenario, frames, (unsigned short)(base_port + i * MAX_BENCH_SESSIONS), frame_delay, predictor);
+      matches[i].first_session_id = (unsigned short)(1 + i * MAX_BENCH_SESSIONS);
+      ok = bench_start_thread(threads + i, matches + i);
+      started += ok;
+   }
+   for (i = 0; i < started; i++) {
+      bench_join_thread(threads + i);
+      ok = ok && matches[i].ok;
+      frames_per_sec += matches[i].totals.frames / (matches[i].totals.elapsed_us / 1000000.0);
+   }
+   free(matches);
+   return ok ? frames_per_sec : 0.0;
+}
+
+/*
+ * bench_run_scaling --
+ *
+ * Run the scenario on 1, 2, 4... up to max_threads threads and report how
+ * the combined frame rate grows.  Ideally it doubles with the threads for
+ * as long as there are free cores.
+ */
+static bool
+bench_run_scaling(const BenchScenario *scenario, int max_threads, int frames, unsigned short base_port, int frame_delay, GGPOInputPredictor predictor)
+{
+   double single = 0.0;
+   int num_threads = 1;
+
+   threaded = true;
+   printf("%s: scaling up to %d threads, %d frames per match\n", scenario->name, max_threads, frames);
+   while (num_threads <= max_threads) {
+      double frames_per_sec = bench_run_threads(scenario, num_threads, frames, base_port, frame_delay, predictor);
+
+      if (frames_per_sec <= 0.0) {
+         fprintf(stderr, "%s: failed on %d threads.\n", scenario->name, num_threads);
+         threaded = false;
+         return false;
+      }
+      if (num_threads == 1) {
+         single = frames_per_sec;
+      }
+      printf("  %3d threads %14.1f frames/sec %12.1f per thread %8.1f%% efficiency\n",
+             num_threads, frames_per_sec, frames_per_sec / num_threads,
+             100.0 * frames_per_sec / (single * num_threads));
+      if (num_threads == max_threads) {
+         break;
+      }
+      num_threads = num_threads * 2 > max_threads ? max_threads : num_threads * 2;
+   }
+   threaded = false;
+   return true;
+}
+
+static void
+Syntax(void)
+{
+   fprintf(stderr,
+           "Syntax: ggpo_bench [-f frames] [-p base port] [-d frame delay] [-m predictor] [-t threads] [-s] [-r relay port] [-l] [scenario ...]\n"
+           "Scenarios: synctest p2p2 p2p3 p2p4 p2p8 spectator star2 star4 star8 (default: all)\n"
+           "Predictors: repeat release markov (default: repeat)\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+   const BenchScenario *selected[ARRAY_SIZE(scenarios)];
+   int num_selected = 0;
+   int frames = DEFAULT_FRAMES;
+   int base_port = DEFAULT_BASE_PORT;
+   int frame_delay = DEFAULT_FRAME_DELAY;
+   GGPOInputPredictor predictor = GGPO_PREDICTOR_REPEAT_LAST;
+   int max_threads = 0;
+   bool ok = true;
+   int i, j;
+
+   for (i = 1; i < argc; i++) {
+      if (!strcmp(argv[i], "-f") && i + 1 < argc) {
+         frames = atoi(argv[++i]);
+      } else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+         base_port = atoi(argv[++i]);
+      } else if (!strcmp(argv[i], "-d") && i + 1 < argc) {
+         frame_delay = atoi(argv[++i]);
+      } else if (!strcmp(argv[i], "-t") && i + 1 < argc) {
+         max_threads = atoi(argv[++i]);
+      } else if (!strcmp(argv[i], "-s")) {
+         shared_socket = true;
+      } else if (!strcmp(argv[i], "-l")) {
+         paced = true;
+      } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+         relay_port = (unsigned short)atoi(argv[++i]);
+         shared_socket = true;
+      } else if (!strcmp(argv[i], "-m") && i + 1 < argc) {
+         i++;
+         for (j = 0; j < (int)ARRAY_SIZE(predictors); j++) {
+            if (!strcmp(argv[i], predictors[j].name)) {
+               break;
+            }
+         }
+         if (j == ARRAY_SIZE(predictors)) {
+            Syntax();
+            return 1;
+         }
+         predictor = predictors[j].predictor;
+      } else {
+         for (j = 0; j < (int)ARRAY_SIZE(scenarios); j++) {
+            if (!strcmp(argv[i], scenarios[j].name)) {
+               break;
+            }
+         }
+         if (j == ARRAY_SIZE(scenarios) || num_selected == ARRAY_SIZE(selected)) {
+            Syntax();
+            return 1;
+         }
+         selected[num_selected++] = scenarios + j;
+      }
+   }
+   if (frames <= 0 || base_port <= 0 || frame_delay < 0 || max_threads < 0 || max_threads > MAX_BENCH_THREADS ||
+       base_port > 65535 - MAX_BENCH_SESSIONS * (max_threads ? max_threads : 1)) {
+      Syntax();
+      return 1;
+   }
+   if (!num_selected) {
+      for (i = 0; i < (int)ARRAY_SIZE(scenarios); i++) {
+         if (shared_socket && scenarios[i].star) {
+            continue;
+         }
+         selected[num_selected++] = scenarios + i;
+      }
+   }
+
+   for (i = 0; i < num_selected; i++) {
+      if (max_threads) {
+         ok = bench_run_scaling(selected[i], max_threads, frames, (unsigned short)base_port, frame_delay, predictor) && ok;
+      } else {
+         ok = bench_run_scenario(selected[i], frames, (unsigned short)base_port, frame_delay, predictor) && ok;
+      }
+   }
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,578 @@
+#include "types.h"
+#include "input_queue.h"
+#include "ring_buffer.h"
+#include "sync.h"
+#include "network/udp_proto.h"
+#include "network/connection.h"
+
+/*
+ * microbench.c --
+ *
+ * Microbenchmarks for the inner loops of the GGPO library, run in
+ * isolation from the rest of a session.  Every benchmark runs a fixed
+ * number of iterations so consecutive runs do the same work, and the
+ * results are written to stdout as JSON with a fixed layout, so the output
+ * of two library versions can be diffed directly.
+ */
+
+#define INPUT_SIZE               4
+#define DEFAULT_REPETITIONS      5
+#define DEFAULT_PORT             7200
+#define MAX_REPETITIONS          101
+
+typedef struct Microbench {
+   const char  *name;
+   int         param;
+   int         iterations;
+   void        (*setup)(int param);
+   void        (*run)(int param, int iterations);
+   void        (*teardown)(void);
+} Microbench;
+
+static InputQueue queue;
+static int queue_frame;
+
+static Sync saved_states;
+static byte *state;
+static int state_size;
+
+static Udp udp;
+static unsigned short udp_port = DEFAULT_PORT;
+static UdpProtocol sender;
+static UdpProtocol receiver;
+static UdpMsg *input_msg;
+static int input_msg_len;
+static UdpMsg_connect_status connect_status[UDP_MSG_MAX_PLAYERS];
+
+static RingBuffer ring;
+static int ring_values[64];
+
+static conn_Address peers[32];
+static conn_Address senders[32];
+
+/*
+ * Written by the benchmarks so the compiler can't drop the work.
+ */
+static volatile unsigned sink;
+
+/*
+ * microbench_now --
+ *
+ * High resolution monotonic clock, in nanoseconds.
+ */
+static double
+microbench_now(void)
+{
+#if defined(_WINDOWS)
+   static LARGE_INTEGER frequency;
+   LARGE_INTEGER counter;
+
+   if (!frequency.QuadPart) {
+      QueryPerformanceFrequency(&frequency);
+   }
+   QueryPerformanceCounter(&counter);
+   return (double)counter.QuadPart * 1000000000.0 / (double)frequency.QuadPart;
+#else
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec * 1000000000.0 + (double)ts.tv_nsec;
+#endif
+}
+
+/*
+ * microbench_input --
+ *
+ * Input for a frame.  The buttons change every few frames like a real
+ * player's would.  When alternate is set, consecutive frames always differ
+ * so every prediction is wrong.
+ */
+static void
+microbench_input(GameInput *input, int frame, bool alternate)
+{
+   int value = alternate ? (frame & 1) + 1 : (int)((unsigned)(frame / 7) * 0x9e3779b1u);
+
+   gameinput_init(input, frame, (char *)&value, INPUT_SIZE);
+}
+
+static void
+microbench_noop_teardown(void)
+{
+}
+
+/*
+ * Input queue benchmarks.  Each iteration adds the input for one frame and
+ * reads it back the way the sync layer does.
+ */
+
+static void
+input_queue_setup(int param)
+{
+   (void)param;
+   input_queue_Init(&queue, 0, INPUT_SIZE);
+   queue_frame = 0;
+}
+
+static void
+input_queue_discard(void)
+{
+   if (queue_frame > 0 && queue_frame % 32 == 0) {
+      input_queue_DiscardConfirmedFrames(&queue, queue_frame - 1);
+   }
+}
+
+static void
+input_queue_run_confirmed(int param, int iterations)
+{
+   GameInput input, output;
+
+   (void)param;
+   for (int i = 0; i < iterations; i++, queue_frame++) {
+      microbench_input(&input, queue_frame, false);
+      input_queue_AddInput(&queue, &input);
+      sink += input_queue_GetInput(&queue, queue_frame, &output);
+      input_queue_discard();
+   }
+}
+
+static void
+input_queue_run_predicted(int param, int iterations)
+{
+   GameInput input, output;
+
+   (void)param;
+   for (int i = 0; i < iterations; i++, queue_frame++) {
+      sink += input_queue_GetInput(&queue, queue_frame, &output);
+      microbench_input(&input, queue_frame, false);
+      input_queue_AddInput(&queue, &input);
+      if (input_queue_GetFirstIncorrectFrame(&queue) != GAMEINPUT_NULL_FRAME) {
+         input_queue_ResetPrediction(&queue, queue_frame);
+      }
+      input_queue_discard();
+   }
+}
+
+static void
+input_queue_run_mispredicted(int param, int iterations)
+{
+   GameInput input, output;
+
+   (void)param;
+   for (int i = 0; i < iterations; i++, queue_frame++) {
+      sink += input_queue_GetInput(&queue, queue_frame, &output);
+      microbench_input(&input, queue_frame, true);
+      input_queue_AddInput(&queue, &input);
+      input_queue_ResetPrediction(&queue, input_queue_GetFirstIncorrectFrame(&queue));
+      sink += input_queue_GetInput(&queue, queue_frame, &output);
+      input_queue_discard();
+   }
+}
+
+/*
+ * Sync benchmarks.  The save callback copies a state of param bytes, like
+ * a game which memcpys its state would.
+ */
+
+static bool
+sync_save_game_state(unsigned char **buffer, int *len, int *checksum, int frame)
+{
+   (void)frame;
+   *buffer = (unsigned char *)malloc(state_size);
+   memcpy(*buffer, state, state_size);
+   *len = state_size;
+   *checksum = 0;
+   return true;
+}
+
+static bool
+sync_load_game_state(unsigned char *buffer, int len)
+{
+   memcpy(state, buffer, len);
+   return true;
+}
+
+static void
+sync_free_buffer(void *buffer)
+{
+   free(buffer);
+}
+
+static void
+sync_setup(int param)
+{
+   sync_Config config = { 0 };
+
+   state_size = param;
+   state = (byte *)malloc(state_size);
+   memset(state, 0x5a, state_size);
+
+   config.callbacks.save_game_state = sync_save_game_state;
+   config.callbacks.load_game_state = sync_load_game_state;
+   config.callbacks.free_buffer = sync_free_buffer;
+   config.num_prediction_frames = MAX_PREDICTION_FRAMES;
+   config.num_players = 2;
+   config.input_size = INPUT_SIZE;
+
+   sync_ctor(&saved_states, NULL);
+   sync_Init(&saved_states, &config);
+
+   /*
+    * Fill every slot of the saved state ring.
+    */
+   sync_SaveCurrentFrame(&saved_states);
+   for (int i = 0; i < MAX_PREDICTION_FRAMES + 2; i++) {
+      sync_IncrementFrame(&saved_states);
+   }
+}
+
+static void
+sync_teardown(void)
+{
+   sync_dtor(&saved_states);
+   free(state);
+   state = NULL;
+}
+
+static void
+sync_run_save(int param, int iterations)
+{
+   (void)param;
+   for (int i = 0; i < iterations; i++) {
+      sync_IncrementFrame(&saved_states);
+   }
+}
+
+/*
+ * Alternates between two saved frames at the edge of the prediction
+ * window, so every iteration is a real load.
+ */
+static void
+sync_run_load(int param, int iterations)
+{
+   int newest = sync_GetFrameCount(&saved_states);
+
+   (void)param;
+   for (int i = 0; i < iterations; i++) {
+      sync_LoadFrame(&saved_states, newest - MAX_PREDICTION_FRAMES + (i & 1));
+   }
+   sink += state[0];
+}
+
+/*
+ * UdpProtocol benchmarks.  The sender keeps param unacked frames pending,
+ * so every call encodes all of them.  Packets go to our own socket and are
+ * dropped once its buffer is full.
+ */
+
+static void
+microbench_on_msg(conn_Address from, UdpMsg *msg, int len, void *user_data)
+{
+   (void)from;
+   (void)msg;
+   (void)len;
+   (void)user_data;
+}
+
+static void
+udp_proto_fill_pending(UdpProtocol *protocol, int count)
+{
+   for (int i = 0; i < count; i++) {
+      GameInput input;
+      microbench_input(&input, i, false);
+      if (!protocol->_pending_bits) {
+         protocol->_input_size = input.size;
+         protocol->_pending_bits = malloc(ARRAY_SIZE(protocol->_pending_frames) * input.size);
+      }
+      int j = ring_push(&protocol->_pending_output_ring);
+      protocol->_pending_frames[j] = input.frame;
+      memcpy(protocol->_pending_bits + j * input.size, input.bits, input.size);
+   }
+}
+
+static void
+udp_proto_send_setup(int param)
+{
+   conn_Address peer;
+
+   udp_ctor(&udp);
+   udp_Init(&udp, udp_port, microbench_on_msg, NULL);
+   peer = conn_address_from_ip_port(udp._socket, "127.0.0.1", udp_port);
+
+   UdpProtocol_ctor(&sender);
+   UdpProtocol_Init(&sender, &udp, 0, peer, connect_status, INPUT_SIZE);
+   sender._current_state = UdpProtocol_Running;
+   udp_proto_fill_pending(&sender, param);
+}
+
+static void
+udp_proto_send_teardown(void)
+{
+   UdpProtocol_dtor(&sender);
+   udp_dtor(&udp);
+}
+
+static void
+udp_proto_run_send(int param, int iterations)
+{
+   (void)param;
+   for (int i = 0; i < iterations; i++) {
+      UdpProtocol_SendPendingOutput(&sender);
+      UdpProtocol_Flush(&sender);
+   }
+}
+
+static void
+udp_proto_receive_setup(int param)
+{
+   GameInput last;
+
+   UdpProtocol_ctor(&sender);
+   udp_proto_fill_pending(&sender, param);
+
+   input_msg = calloc(1, sizeof(UdpMsg));
+   udp_msg_ctor(input_msg, UdpMsg_Input);
+   input_msg->hdr.magic = 1;
+   input_msg->u.input.ack_frame = GAMEINPUT_NULL_FRAME;
+   input_msg->u.input.current_frame = -1;
+   last = sender._last_acked_input;
+   UdpProtocol_EncodePendingOutput(&sender, 0, &last, UDP_MSG_MAX_INPUT_BITS, input_msg);
+   input_msg_len = udp_msg_PackInput(input_msg);
+
+   UdpProtocol_ctor(&receiver);
+   receiver._queue = 1;
+   receiver._remote_magic_number = 1;
+   receiver._remote_input_size = INPUT_SIZE;
+}
+
+static void
+udp_proto_receive_teardown(void)
+{
+   UdpProtocol_dtor(&receiver);
+   UdpProtocol_dtor(&sender);
+   free(input_msg);
+   input_msg = NULL;
+}
+
+/*
+ * Every iteration decodes the same packet from scratch, as if it were the
+ * first one to bring these frames.
+ */
+static void
+udp_proto_run_receive(int param, int iterations)
+{
+   (void)param;
+   for (int i = 0; i < iterations; i++) {
+      receiver._last_received_input.frame = GAMEINPUT_NULL_FRAME;
+      ring_ctor(&receiver._event_queue_ring, ARRAY_SIZE(receiver._event_queue));
+      UdpProtocol_OnMsg(&receiver, input_msg, input_msg_len);
+   }
+   sink += receiver._last_received_input.frame;
+}
+
+/*
+ * RingBuffer benchmarks.
+ */
+
+static void
+ring_buffer_setup(int param)
+{
+   ring_ctor(&ring, ARRAY_SIZE(ring_values));
+   for (int i = 0; i < param; i++) {
+      ring_values[ring_push(&ring)] = i;
+   }
+}
+
+static void
+ring_buffer_run_push_pop(int param, int iterations)
+{
+   (void)param;
+   for (int i = 0; i < iterations; i++) {
+      ring_values[ring_push(&ring)] = i;
+      sink += ring_values[ring_front(&ring)];
+      ring_pop(&ring);
+   }
+}
+
+static void
+ring_buffer_run_item(int param, int iterations)
+{
+   unsigned sum = 0;
+
+   for (int i = 0; i < iterations; i++) {
+      sum += ring_values[ring_item(&ring, i % param)];
+   }
+   sink += sum;
+}
+
+/*
+ * Sender lookup benchmark.  A received packet's address points into its
+ * socket, so finding who sent it means comparing it with the address of
+ * each of param peers in turn, the way the backends pick the endpoint
+ * which handles a message.  This is what conn_fill_out_address's pool
+ * lookup used to cost on every receive.
+ */
+
+static void
+conn_address_setup(int param)
+{
+   udp_ctor(&udp);
+   udp_Init(&udp, udp_port, microbench_on_msg, NULL);
+   for (int i = 0; i < param; i++) {
+      peers[i] = conn_address_from_ip_port(udp._socket, "127.0.0.1", (uint16)(10000 + i));
+      senders[i] = conn_address_from_ip_port(udp._socket, "127.0.0.1", (uint16)(10000 + i));
+   }
+}
+
+static void
+conn_address_teardown(void)
+{
+   for (int i = 0; i < (int)ARRAY_SIZE(peers); i++) {
+      if (peers[i]) {
+         conn_release_address(peers[i]);
+         conn_release_address(senders[i]);
+         peers[i] = senders[i] = NULL;
+      }
+   }
+   udp_dtor(&udp);
+}
+
+static void
+conn_address_run_lookup(int param, int iterations)
+{
+   for (int i = 0; i < iterations; i++) {
+      conn_Address from = senders[i % param];
+      int j = 0;
+      while (j < param && !conn_addr_is_equal(peers[j], from)) {
+         j++;
+      }
+      sink += j;
+   }
+}
+
+static const Microbench benchmarks[] = {
+   { "conn_addr_is_equal",             1,      1000000, conn_address_setup, conn_address_run_lookup, conn_address_teardown },
+   { "conn_addr_is_equal",             2,      1000000, conn_address_setup, conn_address_run_lookup, conn_address_teardown },
+   { "conn_addr_is_equal",             4,      1000000, conn_address_setup, conn_address_run_lookup, conn_address_teardown },
+   { "conn_addr_is_equal",             8,      1000000, conn_address_setup, conn_address_run_lookup, conn_address_teardown },
+   { "conn_addr_is_equal",             16,     1000000, conn_address_setup, conn_address_run_lookup, conn_address_teardown },
+   { "conn_addr_is_equal",             31,     1000000, conn_address_setup, conn_address_run_lookup, conn_address_teardown },
+   { "ring_buffer/push_pop",           0,      1000000, ring_buffer_setup, ring_buffer_run_push_pop, microbench_noop_teardown },
+   { "ring_buffer/item",               32,     1000000, ring_buffer_setup, ring_buffer_run_item, microbench_noop_teardown },
+   { "input_queue/confirmed",          0,      200000, input_queue_setup, input_queue_run_confirmed, microbench_noop_teardown },
+   { "input_queue/predicted",          0,      200000, input_queue_setup, input_queue_run_predicted, microbench_noop_teardown },
+   { "input_queue/mispredicted",       0,      200000, input_queue_setup, input_queue_run_mispredicted, microbench_noop_teardown },
+   { "sync/save",                      64,     100000, sync_setup, sync_run_save, sync_teardown },
+   { "sync/save",                      4096,   100000, sync_setup, sync_run_save, sync_teardown },
+   { "sync/save",                      65536,  10000, sync_setup, sync_run_save, sync_teardown },
+   { "sync/save",                      1048576, 1000, sync_setup, sync_run_save, sync_teardown },
+   { "sync/load",                      64,     100000, sync_setup, sync_run_load, sync_teardown },
+   { "sync/load",                      4096,   100000, sync_setup, sync_run_load, sync_teardown },
+   { "sync/load",                      65536,  10000, sync_setup, sync_run_load, sync_teardown },
+   { "sync/load",                      1048576, 1000, sync_setup, sync_run_load, sync_teardown },
+   { "udp_proto/send_pending_output",  1,      20000, udp_proto_send_setup, udp_proto_run_send, udp_proto_send_teardown },
+   { "udp_proto/send_pending_output",  2,      20000, udp_proto_send_setup, udp_proto_run_send, udp_proto_send_teardown },
+   { "udp_proto/send_pending_output",  4,      20000, udp_proto_send_setup, udp_proto_run_send, udp_proto_send_teardown },
+   { "udp_proto/send_pending_output",  8,      20000, udp_proto_send_setup, udp_proto_run_send, udp_proto_send_teardown },
+   { "udp_proto/send_pending_output",  16,     20000, udp_proto_send_setup, udp_proto_run_send, udp_proto_send_teardown },
+   { "udp_proto/send_pending_output",  32,     20000, udp_proto_send_setup, udp_proto_run_send, udp_proto_send_teardown },
+   { "udp_proto/send_pending_output",  63,     20000, udp_proto_send_setup, udp_proto_run_send, udp_proto_send_teardown },
+   { "udp_proto/on_input",             1,      5000,  udp_proto_receive_setup, udp_proto_run_receive, udp_proto_receive_teardown },
+   { "udp_proto/on_input",             2,      5000,  udp_proto_receive_setup, udp_proto_run_receive, udp_proto_receive_teardown },
+   { "udp_proto/on_input",             4,      5000,  udp_proto_receive_setup, udp_proto_run_receive, udp_proto_receive_teardown },
+   { "udp_proto/on_input",             8,      5000,  udp_proto_receive_setup, udp_proto_run_receive, udp_proto_receive_teardown },
+   { "udp_proto/on_input",             16,      5000, udp_proto_receive_setup, udp_proto_run_receive, udp_proto_receive_teardown },
+   { "udp_proto/on_input",             32,      5000, udp_proto_receive_setup, udp_proto_run_receive, udp_proto_receive_teardown },
+   { "udp_proto/on_input",             56,      5000, udp_proto_receive_setup, udp_proto_run_receive, udp_proto_receive_teardown },
+};
+
+static int
+compare_double(const void *a, const void *b)
+{
+   double lhs = *(const double *)a, rhs = *(const double *)b;
+   return (lhs > rhs) - (lhs < rhs);
+}
+
+/*
+ * microbench_run --
+ *
+ * Run a benchmark repetitions times from a fresh setup and write its
+ * result.  The median is the number to compare; the minimum shows how
+ * noisy the machine was.
+ */
+static void
+microbench_run(const Microbench *bench, int repetitions, bool last)
+{
+   double ns_per_op[MAX_REPETITIONS];
+
+   for (int i = 0; i < repetitions; i++) {
+      double start;
+
+      bench->setup(bench->param);
+      start = microbench_now();
+      bench->run(bench->param, bench->iterations);
+      ns_per_op[i] = (microbench_now() - start) / bench->iterations;
+      bench->teardown();
+   }
+   qsort(ns_per_op, repetitions, sizeof(ns_per_op[0]), compare_double);
+
+   printf("    { \"name\": \"%s\", \"param\": %d, \"iterations\": %d, \"median_ns\": %.2f, \"min_ns\": %.2f }%s\n",
+          bench->name, bench->param, bench->iterations,
+          ns_per_op[repetitions / 2], ns_per_op[0],
+          last ? "" : ",");
+}
+
+static void
+Syntax(void)
+{
+   fprintf(stderr,
+           "Syntax: ggpo_microbench [-r repetitions] [-p port] [name prefix ...]\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+   const char *filters[ARRAY_SIZE(benchmarks)];
+   const Microbench *selected[ARRAY_SIZE(benchmarks)];
+   int num_filters = 0, num_selected = 0;
+   int repetitions = DEFAULT_REPETITIONS;
+   int port = DEFAULT_PORT;
+
+   for (int i = 1; i < argc; i++) {
+      if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+         repetitions = atoi(argv[++i]);
+      } else if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+         port = atoi(argv[++i]);
+      } else if (argv[i][0] != '-' && num_filters < (int)ARRAY_SIZE(filters)) {
+         filters[num_filters++] = argv[i];
+      } else {
+         Syntax();
+         return 1;
+      }
+   }
+   if (repetitions < 1 || repetitions > MAX_REPETITIONS || port <= 0 || port > 65535) {
+      Syntax();
+      return 1;
+   }
+   udp_port = (unsigned short)port;
+
+   for (int i = 0; i < (int)ARRAY_SIZE(benchmarks); i++) {
+      bool match = num_filters == 0;
+      for (int j = 0; j < num_filters && !match; j++) {
+         match = !strncmp(benchmarks[i].name, filters[j], strlen(filters[j]));
+      }
+      if (match) {
+         selected[num_selected++] = benchmarks + i;
+      }
+   }
+
+   printf("{\n");
+   printf("  \"repetitions\": %d,\n", repetitions);
+   printf("  \"input_size\": %d,\n", INPUT_SIZE);
+   printf("  \"benchmarks\": [\n");
+   for (int i = 0; i < num_selected; i++) {
+      microbench_run(selected[i], repetitions, i == num_selected - 1);
+   }
+   printf("  ]\n");
+   printf("}\n");
+   return 0;
+}
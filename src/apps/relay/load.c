@@ -0,0 +1,222 @@
+#define _GNU_SOURCE // for recvmmsg and sendmmsg
+#include "types.h"
+#include "network/udp_msg.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include "relay.h"
+
+/*
+ * load.c --
+ *
+ * Load test for the relay.  The relay runs on its own thread on a
+ * loopback port and this thread plays both sides of many matches of two
+ * sessions, sending input packets as fast as the relay takes them and
+ * reading back what it forwards.  The relay measures the CPU time it
+ * spends, so the result is in packets per second per core whatever else
+ * runs on the machine.
+ */
+
+#define LOAD_MAX_PAIRS     512
+#define LOAD_BURST         16
+
+typedef struct LoadClient {
+   int         fd;
+   uint8_t     packet[RELAY_MAX_PACKET_SIZE];
+} LoadClient;
+
+static double
+load_now(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+static void *
+load_relay_main(void *param)
+{
+   relay_Run((Relay *)param);
+   return NULL;
+}
+
+/*
+ * load_init_client --
+ *
+ * Open a socket for session src and build the input packet it keeps
+ * sending to session dst.
+ */
+static bool
+load_init_client(LoadClient *client, uint16_t src, uint16_t dst, int packet_size)
+{
+   struct sockaddr_in addr;
+   UdpMsg *msg = (UdpMsg *)client->packet;
+   int size = 1024 * 1024;
+
+   client->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+   if (client->fd < 0) {
+      return false;
+   }
+   setsockopt(client->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   if (bind(client->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      return false;
+   }
+
+   memset(client->packet, 0, sizeof(client->packet));
+   msg->hdr.magic = src;
+   msg->hdr.type = UdpMsg_Input;
+   msg->hdr.dst_session = dst;
+   msg->hdr.src_session = src;
+   memset(client->packet + sizeof(msg->hdr), 0x5a, packet_size - sizeof(msg->hdr));
+   return true;
+}
+
+/*
+ * load_send --
+ *
+ * Send a burst of packets from the client to the relay.  Returns how many
+ * the kernel took.
+ */
+static int
+load_send(LoadClient *client, struct sockaddr_in *relay_addr, int packet_size)
+{
+   struct mmsghdr msgs[LOAD_BURST];
+   struct iovec iov;
+   int i, result;
+
+   iov.iov_base = client->packet;
+   iov.iov_len = packet_size;
+   memset(msgs, 0, sizeof(msgs));
+   for (i = 0; i < LOAD_BURST; i++) {
+      msgs[i].msg_hdr.msg_name = relay_addr;
+      msgs[i].msg_hdr.msg_namelen = sizeof(*relay_addr);
+      msgs[i].msg_hdr.msg_iov = &iov;
+      msgs[i].msg_hdr.msg_iovlen = 1;
+   }
+   result = sendmmsg(client->fd, msgs, LOAD_BURST, MSG_DONTWAIT);
+   return result > 0 ? result : 0;
+}
+
+/*
+ * load_receive --
+ *
+ * Drain the packets the relay forwarded to the client.
+ */
+static int
+load_receive(LoadClient *client)
+{
+   static uint8_t bufs[LOAD_BURST][RELAY_MAX_PACKET_SIZE];
+   struct mmsghdr msgs[LOAD_BURST];
+   struct iovec iov[LOAD_BURST];
+   int total = 0;
+   int i, result;
+
+   do {
+      memset(msgs, 0, sizeof(msgs));
+      for (i = 0; i < LOAD_BURST; i++) {
+         iov[i].iov_base = bufs[i];
+         iov[i].iov_len = sizeof(bufs[i]);
+         msgs[i].msg_hdr.msg_iov = iov + i;
+         msgs[i].msg_hdr.msg_iovlen = 1;
+      }
+      result = recvmmsg(client->fd, msgs, LOAD_BURST, MSG_DONTWAIT, NULL);
+      if (result > 0) {
+         total += result;
+      }
+   } while (result == LOAD_BURST);
+   return total;
+}
+
+/*
+ * relay_LoadTest --
+ *
+ * Run pairs matches of two sessions through a relay for the given number
+ * of seconds and report how fast it forwarded their packets.
+ */
+bool
+relay_LoadTest(int pairs, double seconds, int packet_size)
+{
+   static Relay relay;
+   static LoadClient clients[LOAD_MAX_PAIRS * 2];
+   struct sockaddr_in relay_addr;
+   uint64_t sent = 0, delivered = 0;
+   pthread_t thread;
+   double start, elapsed;
+   int num_clients = pairs * 2;
+   bool ok = true;
+   int i;
+
+   if (pairs <= 0 || pairs > LOAD_MAX_PAIRS || seconds <= 0.0 ||
+       packet_size < (int)sizeof(((UdpMsg *)0)->hdr) || packet_size > RELAY_MAX_PACKET_SIZE) {
+      return false;
+   }
+   if (!relay_Open(&relay, 0)) {
+      fprintf(stderr, "ggpo_relay: could not open the relay socket.\n");
+      return false;
+   }
+   memset(&relay_addr, 0, sizeof(relay_addr));
+   relay_addr.sin_family = AF_INET;
+   relay_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+   relay_addr.sin_port = htons(relay_Port(&relay));
+
+   for (i = 0; i < num_clients; i++) {
+      clients[i].fd = -1;
+   }
+   for (i = 0; ok && i < pairs; i++) {
+      uint16_t ids[2] = { (uint16_t)(i * 2 + 1), (uint16_t)(i * 2 + 2) };
+
+      ok = relay_AddMatch(&relay, ids, 2) != 0 &&
+           load_init_client(clients + i * 2, ids[0], ids[1], packet_size) &&
+           load_init_client(clients + i * 2 + 1, ids[1], ids[0], packet_size);
+   }
+   if (!ok || pthread_create(&thread, NULL, load_relay_main, &relay) != 0) {
+      fprintf(stderr, "ggpo_relay: could not set up the load test.\n");
+      for (i = 0; i < num_clients; i++) {
+         if (clients[i].fd >= 0) {
+            close(clients[i].fd);
+         }
+      }
+      relay_Close(&relay);
+      return false;
+   }
+
+   printf("relay load test: %d matches, %d byte packets, %.1f s\n", pairs, packet_size, seconds);
+   start = load_now();
+   while ((elapsed = load_now() - start) < seconds) {
+      for (i = 0; i < num_clients; i++) {
+         sent += load_send(clients + i, &relay_addr, packet_size);
+      }
+      for (i = 0; i < num_clients; i++) {
+         delivered += load_receive(clients + i);
+      }
+   }
+
+   relay_Stop(&relay);
+   pthread_join(thread, NULL);
+   for (i = 0; i < num_clients; i++) {
+      delivered += load_receive(clients + i);
+      close(clients[i].fd);
+   }
+
+   printf("  sent                 %12llu\n", (unsigned long long)sent);
+   printf("  forwarded            %12llu (%llu dropped)\n", (unsigned long long)relay.stats.forwarded, (unsigned long long)relay.stats.dropped);
+   printf("  delivered            %12llu\n", (unsigned long long)delivered);
+   printf("  packets per batch    %12.1f\n", relay.stats.batches ? (double)relay.stats.received / relay.stats.batches : 0.0);
+   printf("  forwarded/sec        %12.0f\n", relay.stats.forwarded / elapsed);
+   printf("  relay cpu            %12.3f s\n", relay.stats.cpu_seconds);
+   printf("  forwarded/sec/core   %12.0f\n", relay.stats.cpu_seconds > 0.0 ? relay.stats.forwarded / relay.stats.cpu_seconds : 0.0);
+
+   ok = relay.stats.forwarded > 0 && delivered > 0;
+   relay_Close(&relay);
+   return ok;
+}
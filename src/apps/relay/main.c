@@ -0,0 +1,124 @@
+#define _POSIX_C_SOURCE 200112L // for sigaction
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "relay.h"
+
+/*
+ * main.c --
+ *
+ * ggpo_relay forwards GGPO packets between sessions which can't reach each
+ * other directly (see relay.h).  The matches to relay are given on the
+ * command line or written to its standard input, one per line, so a
+ * matchmaker can drive it through a pipe.
+ */
+
+#define DEFAULT_PORT             7300
+#define DEFAULT_LOAD_PAIRS       64
+#define DEFAULT_LOAD_SECONDS     5.0
+#define DEFAULT_LOAD_PACKET_SIZE 64
+
+static Relay relay;
+
+static void
+on_signal(int sig)
+{
+   (void)sig;
+   relay_Stop(&relay);
+}
+
+static void
+Syntax(void)
+{
+   fprintf(stderr,
+           "Syntax: ggpo_relay [-p port] [-r report seconds] [-c] [match ...]\n"
+           "        ggpo_relay -l [-n matches] [-s seconds] [-b packet bytes]\n"
+           "A match is the session ids of its sessions, like 1,2 or 1-4.\n"
+           "With -c, a match read from stdin is registered and -id removes the match of session id.\n"
+           "-l runs a load test on loopback instead of relaying.\n");
+}
+
+int
+main(int argc, char *argv[])
+{
+   struct sigaction action;
+   int port = DEFAULT_PORT;
+   int report = 0;
+   bool control = false;
+   bool load = false;
+   int pairs = DEFAULT_LOAD_PAIRS;
+   double seconds = DEFAULT_LOAD_SECONDS;
+   int packet_size = DEFAULT_LOAD_PACKET_SIZE;
+   int first_match = argc;
+   int i;
+
+   for (i = 1; i < argc && first_match == argc; i++) {
+      if (!strcmp(argv[i], "-p") && i + 1 < argc) {
+         port = atoi(argv[++i]);
+      } else if (!strcmp(argv[i], "-r") && i + 1 < argc) {
+         report = atoi(argv[++i]);
+      } else if (!strcmp(argv[i], "-c")) {
+         control = true;
+      } else if (!strcmp(argv[i], "-l")) {
+         load = true;
+      } else if (!strcmp(argv[i], "-n") && i + 1 < argc) {
+         pairs = atoi(argv[++i]);
+      } else if (!strcmp(argv[i], "-s") && i + 1 < argc) {
+         seconds = atof(argv[++i]);
+      } else if (!strcmp(argv[i], "-b") && i + 1 < argc) {
+         packet_size = atoi(argv[++i]);
+      } else if (argv[i][0] != '-') {
+         first_match = i;
+      } else {
+         Syntax();
+         return 1;
+      }
+   }
+   if (port < 0 || port > 65535 || report < 0) {
+      Syntax();
+      return 1;
+   }
+
+   if (load) {
+      if (first_match != argc) {
+         Syntax();
+         return 1;
+      }
+      return relay_LoadTest(pairs, seconds, packet_size) ? 0 : 1;
+   }
+
+   if (!relay_Open(&relay, (uint16_t)port)) {
+      fprintf(stderr, "ggpo_relay: could not bind port %d.\n", port);
+      return 1;
+   }
+   for (i = first_match; i < argc; i++) {
+      if (!relay_ParseCommand(&relay, argv[i])) {
+         fprintf(stderr, "ggpo_relay: bad match '%s'.\n", argv[i]);
+         relay_Close(&relay);
+         return 1;
+      }
+   }
+   if ((control && !relay_SetControl(&relay, STDIN_FILENO)) ||
+       (report && !relay_SetReportInterval(&relay, report))) {
+      fprintf(stderr, "ggpo_relay: could not set up the event loop.\n");
+      relay_Close(&relay);
+      return 1;
+   }
+
+   memset(&action, 0, sizeof(action));
+   action.sa_handler = on_signal;
+   sigaction(SIGINT, &action, NULL);
+   sigaction(SIGTERM, &action, NULL);
+
+   printf("ggpo_relay: listening on port %d.\n", relay_Port(&relay));
+   fflush(stdout);
+   if (!relay_Run(&relay)) {
+      perror("ggpo_relay");
+      relay_Close(&relay);
+      return 1;
+   }
+   relay_Close(&relay);
+   return 0;
+}
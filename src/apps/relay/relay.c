@@ -0,0 +1,525 @@
+#define _GNU_SOURCE // for recvmmsg and sendmmsg
+#include "types.h"
+#include "network/udp_msg.h"
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include "relay.h"
+
+/*
+ * relay.c --
+ *
+ * The forwarding loop of ggpo_relay.  One thread waits on the socket with
+ * epoll, drains it with recvmmsg and sends every packet it can forward
+ * back out with sendmmsg.  The packets are sent from the buffers they were
+ * received into: only the destination address of each message changes.
+ *
+ * Session ids are 16 bits, so the session table is indexed by them
+ * directly and a lookup is a single load.
+ */
+
+#define RELAY_SOCKET_BUFFER_SIZE    (4 * 1024 * 1024)
+
+#define RELAY_EVENT_SOCKET          0
+#define RELAY_EVENT_WAKEUP          1
+#define RELAY_EVENT_TIMER           2
+#define RELAY_EVENT_CONTROL         3
+
+struct RelayBatch {
+   uint8_t              bufs[RELAY_BATCH][RELAY_MAX_PACKET_SIZE];
+   struct sockaddr_in   from[RELAY_BATCH];
+   struct iovec         recv_iov[RELAY_BATCH];
+   struct mmsghdr       recv_msgs[RELAY_BATCH];
+   struct iovec         send_iov[RELAY_BATCH];
+   struct mmsghdr       send_msgs[RELAY_BATCH];
+};
+
+static bool
+relay_Watch(Relay *relay, int fd, uint64_t event)
+{
+   struct epoll_event ev;
+
+   memset(&ev, 0, sizeof(ev));
+   ev.events = EPOLLIN;
+   ev.data.u64 = event;
+   return epoll_ctl(relay->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == 0;
+}
+
+bool
+relay_Open(Relay *relay, uint16_t port)
+{
+   struct sockaddr_in addr;
+   int size = RELAY_SOCKET_BUFFER_SIZE;
+   int i;
+
+   memset(relay, 0, sizeof(*relay));
+   relay->fd = relay->epoll_fd = relay->wakeup_fd = relay->timer_fd = relay->control_fd = -1;
+
+   relay->sessions = calloc(RELAY_MAX_SESSIONS, sizeof(RelaySession));
+   relay->batch = calloc(1, sizeof(RelayBatch));
+   if (!relay->sessions || !relay->batch) {
+      relay_Close(relay);
+      return false;
+   }
+   for (i = 0; i < RELAY_BATCH; i++) {
+      relay->batch->recv_iov[i].iov_base = relay->batch->bufs[i];
+      relay->batch->recv_iov[i].iov_len = RELAY_MAX_PACKET_SIZE;
+      relay->batch->recv_msgs[i].msg_hdr.msg_name = relay->batch->from + i;
+      relay->batch->recv_msgs[i].msg_hdr.msg_iov = relay->batch->recv_iov + i;
+      relay->batch->recv_msgs[i].msg_hdr.msg_iovlen = 1;
+      relay->batch->send_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+      relay->batch->send_msgs[i].msg_hdr.msg_iov = relay->batch->send_iov + i;
+      relay->batch->send_msgs[i].msg_hdr.msg_iovlen = 1;
+   }
+
+   relay->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+   if (relay->fd < 0) {
+      relay_Close(relay);
+      return false;
+   }
+   /*
+    * A burst from many matches shouldn't overflow the socket while the
+    * relay is busy forwarding the previous one.
+    */
+   setsockopt(relay->fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+   setsockopt(relay->fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+
+   memset(&addr, 0, sizeof(addr));
+   addr.sin_family = AF_INET;
+   addr.sin_addr.s_addr = htonl(INADDR_ANY);
+   addr.sin_port = htons(port);
+   if (bind(relay->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+      relay_Close(relay);
+      return false;
+   }
+
+   relay->epoll_fd = epoll_create1(0);
+   relay->wakeup_fd = eventfd(0, EFD_NONBLOCK);
+   if (relay->epoll_fd < 0 || relay->wakeup_fd < 0 ||
+       !relay_Watch(relay, relay->fd, RELAY_EVENT_SOCKET) ||
+       !relay_Watch(relay, relay->wakeup_fd, RELAY_EVENT_WAKEUP)) {
+      relay_Close(relay);
+      return false;
+   }
+   relay->next_match = 1;
+   return true;
+}
+
+void
+relay_Close(Relay *relay)
+{
+   if (relay->fd >= 0) {
+      close(relay->fd);
+   }
+   if (relay->epoll_fd >= 0) {
+      close(relay->epoll_fd);
+   }
+   if (relay->wakeup_fd >= 0) {
+      close(relay->wakeup_fd);
+   }
+   if (relay->timer_fd >= 0) {
+      close(relay->timer_fd);
+   }
+   free(relay->sessions);
+   free(relay->batch);
+   memset(relay, 0, sizeof(*relay));
+   relay->fd = relay->epoll_fd = relay->wakeup_fd = relay->timer_fd = relay->control_fd = -1;
+}
+
+uint16_t
+relay_Port(Relay *relay)
+{
+   struct sockaddr_in addr;
+   socklen_t len = sizeof(addr);
+
+   if (getsockname(relay->fd, (struct sockaddr *)&addr, &len) < 0) {
+      return 0;
+   }
+   return ntohs(addr.sin_port);
+}
+
+/*
+ * relay_AddMatch --
+ *
+ * Let the sessions with the given ids talk to each other.  Returns the
+ * number of the match, or 0 if an id is 0 or already in a match.
+ */
+uint32_t
+relay_AddMatch(Relay *relay, const uint16_t *ids, int count)
+{
+   uint32_t match = relay->next_match;
+   int i;
+
+   if (count < 2) {
+      return 0;
+   }
+   for (i = 0; i < count; i++) {
+      if (!ids[i] || relay->sessions[ids[i]].match) {
+         return 0;
+      }
+   }
+   for (i = 0; i < count; i++) {
+      RelaySession *session = relay->sessions + ids[i];
+
+      memset(session, 0, sizeof(*session));
+      session->match = match;
+   }
+   relay->next_match = match == UINT32_MAX ? 1 : match + 1;
+   return match;
+}
+
+/*
+ * relay_RemoveMatch --
+ *
+ * Forget the match the session id is in, and every session of it.
+ */
+bool
+relay_RemoveMatch(Relay *relay, uint16_t id)
+{
+   uint32_t match = relay->sessions[id].match;
+   int i;
+
+   if (!id || !match) {
+      return false;
+   }
+   for (i = 1; i < RELAY_MAX_SESSIONS; i++) {
+      if (relay->sessions[i].match == match) {
+         memset(relay->sessions + i, 0, sizeof(RelaySession));
+      }
+   }
+   return true;
+}
+
+static bool
+relay_ParseId(const char **p, uint16_t *id)
+{
+   char *end;
+   long value = strtol(*p, &end, 10);
+
+   if (end == *p || value <= 0 || value >= RELAY_MAX_SESSIONS) {
+      return false;
+   }
+   *id = (uint16_t)value;
+   *p = end;
+   return true;
+}
+
+/*
+ * relay_ParseCommand --
+ *
+ * Run a command from the command line or the control file descriptor.
+ * "1,2" or "1-4" registers a match of those session ids, "-3" removes the
+ * match of session 3.
+ */
+bool
+relay_ParseCommand(Relay *relay, const char *command)
+{
+   uint16_t ids[RELAY_MAX_MATCH_SIZE];
+   const char *p = command;
+   int count = 0;
+   uint16_t first, last;
+
+   while (*p == ' ' || *p == '\t') {
+      p++;
+   }
+   if (*p == '-') {
+      p++;
+      return relay_ParseId(&p, &first) && relay_RemoveMatch(relay, first);
+   }
+   for (;;) {
+      if (!relay_ParseId(&p, &first)) {
+         return false;
+      }
+      last = first;
+      if (*p == '-') {
+         p++;
+         if (!relay_ParseId(&p, &last) || last < first) {
+            return false;
+         }
+      }
+      if (count + (last - first + 1) > RELAY_MAX_MATCH_SIZE) {
+         return false;
+      }
+      while (first <= last) {
+         ids[count++] = first++;
+         if (!first) {
+            break;
+         }
+      }
+      if (*p != ',') {
+         break;
+      }
+      p++;
+   }
+   while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+      p++;
+   }
+   return !*p && relay_AddMatch(relay, ids, count) != 0;
+}
+
+bool
+relay_SetControl(Relay *relay, int fd)
+{
+   if (!relay_Watch(relay, fd, RELAY_EVENT_CONTROL)) {
+      return false;
+   }
+   relay->control_fd = fd;
+   relay->control_len = 0;
+   return true;
+}
+
+bool
+relay_SetReportInterval(Relay *relay, int seconds)
+{
+   struct itimerspec spec;
+
+   memset(&spec, 0, sizeof(spec));
+   spec.it_value.tv_sec = seconds;
+   spec.it_interval.tv_sec = seconds;
+   relay->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+   return relay->timer_fd >= 0 &&
+          timerfd_settime(relay->timer_fd, 0, &spec, NULL) == 0 &&
+          relay_Watch(relay, relay->timer_fd, RELAY_EVENT_TIMER);
+}
+
+void
+relay_Stop(Relay *relay)
+{
+   uint64_t one = 1;
+
+   /* Only an eventfd write, so it can be called from a signal handler. */
+   if (write(relay->wakeup_fd, &one, sizeof(one)) < 0) {
+      return;
+   }
+}
+
+/*
+ * relay_Send --
+ *
+ * Send the first count messages of the batch.  A message which can't be
+ * sent is dropped, like the network would.
+ */
+static void
+relay_Send(Relay *relay, int count)
+{
+   struct mmsghdr *msgs = relay->batch->send_msgs;
+   int sent = 0;
+
+   while (sent < count) {
+      int result = sendmmsg(relay->fd, msgs + sent, count - sent, MSG_DONTWAIT);
+
+      if (result > 0) {
+         relay->stats.forwarded += result;
+         sent += result;
+      } else if (result < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+         relay->stats.dropped += count - sent;
+         return;
+      } else {
+         /* This one receiver is unreachable; carry on with the others. */
+         relay->stats.dropped++;
+         sent++;
+      }
+   }
+}
+
+static uint64_t
+relay_NowMs(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000 + (uint64_t)(ts.tv_nsec / 1000000);
+}
+
+/*
+ * relay_Forward --
+ *
+ * Drain the socket, forwarding every packet whose sender and receiver are
+ * in the same match.  The sender's address is set by its first packet and
+ * only moves once it has been quiet for RELAY_REBIND_TIMEOUT (see relay.h).
+ */
+static void
+relay_Forward(Relay *relay)
+{
+   RelayBatch *batch = relay->batch;
+   int count, i;
+
+   do {
+      uint64_t now;
+      int out = 0;
+
+      for (i = 0; i < RELAY_BATCH; i++) {
+         batch->recv_msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+      }
+      count = recvmmsg(relay->fd, batch->recv_msgs, RELAY_BATCH, MSG_DONTWAIT, NULL);
+      if (count <= 0) {
+         return;
+      }
+      relay->stats.batches++;
+      relay->stats.received += count;
+      now = relay_NowMs();
+
+      for (i = 0; i < count; i++) {
+         unsigned int len = batch->recv_msgs[i].msg_len;
+         const uint8_t *buf = batch->bufs[i];
+         struct sockaddr_in *from = batch->from + i;
+         RelaySession *sender, *receiver;
+         uint16_t dst, src;
+
+         if (len < sizeof(((UdpMsg *)0)->hdr) || batch->recv_msgs[i].msg_hdr.msg_namelen != sizeof(*from)) {
+            relay->stats.malformed++;
+            continue;
+         }
+         memcpy(&dst, buf + offsetof(UdpMsg, hdr.dst_session), sizeof(dst));
+         memcpy(&src, buf + offsetof(UdpMsg, hdr.src_session), sizeof(src));
+         sender = relay->sessions + src;
+         receiver = relay->sessions + dst;
+         if (!src || !sender->match || receiver->match != sender->match || src == dst) {
+            relay->stats.dropped++;
+            continue;
+         }
+         if (!sender->has_addr ||
+             sender->addr.sin_addr.s_addr != from->sin_addr.s_addr ||
+             sender->addr.sin_port != from->sin_port) {
+            if (sender->has_addr && now - sender->last_heard < RELAY_REBIND_TIMEOUT) {
+               relay->stats.rejected++;
+               continue;
+            }
+            sender->addr = *from;
+            sender->has_addr = true;
+         }
+         sender->last_heard = now;
+         if (!receiver->has_addr) {
+            relay->stats.dropped++;
+            continue;
+         }
+
+         batch->send_iov[out].iov_base = batch->bufs[i];
+         batch->send_iov[out].iov_len = len;
+         batch->send_msgs[out].msg_hdr.msg_name = &receiver->addr;
+         out++;
+      }
+      relay_Send(relay, out);
+   } while (count == RELAY_BATCH);
+}
+
+static void
+relay_Report(Relay *relay)
+{
+   uint64_t expirations;
+
+   if (read(relay->timer_fd, &expirations, sizeof(expirations)) < 0) {
+      return;
+   }
+   printf("received %llu forwarded %llu dropped %llu malformed %llu rejected %llu (%.1f packets per batch)\n",
+          (unsigned long long)relay->stats.received,
+          (unsigned long long)relay->stats.forwarded,
+          (unsigned long long)relay->stats.dropped,
+          (unsigned long long)relay->stats.malformed,
+          (unsigned long long)relay->stats.rejected,
+          relay->stats.batches ? (double)relay->stats.received / relay->stats.batches : 0.0);
+   fflush(stdout);
+}
+
+/*
+ * relay_ReadControl --
+ *
+ * Run every complete line available on the control file descriptor.  The
+ * relay keeps running without it once it reaches its end.
+ */
+static void
+relay_ReadControl(Relay *relay)
+{
+   char *line, *newline;
+   ssize_t len;
+
+   len = read(relay->control_fd, relay->control_line + relay->control_len, sizeof(relay->control_line) - 1 - relay->control_len);
+   if (len <= 0) {
+      if (len == 0 || (errno != EAGAIN && errno != EINTR)) {
+         epoll_ctl(relay->epoll_fd, EPOLL_CTL_DEL, relay->control_fd, NULL);
+         relay->control_fd = -1;
+      }
+      return;
+   }
+   relay->control_len += (int)len;
+   relay->control_line[relay->control_len] = '\0';
+
+   line = relay->control_line;
+   while ((newline = strchr(line, '\n')) != NULL) {
+      *newline = '\0';
+      if (*line && !relay_ParseCommand(relay, line)) {
+         fprintf(stderr, "ggpo_relay: bad command '%s'.\n", line);
+      }
+      line = newline + 1;
+   }
+   relay->control_len -= (int)(line - relay->control_line);
+   memmove(relay->control_line, line, relay->control_len);
+   if (relay->control_len == sizeof(relay->control_line) - 1) {
+      /* A line this long can't be a command. */
+      relay->control_len = 0;
+   }
+}
+
+static double
+relay_CpuSeconds(void)
+{
+   struct timespec ts;
+
+   clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+   return (double)ts.tv_sec + (double)ts.tv_nsec / 1000000000.0;
+}
+
+/*
+ * relay_Run --
+ *
+ * Forward packets until relay_Stop is called.
+ */
+bool
+relay_Run(Relay *relay)
+{
+   struct epoll_event events[8];
+   double start = relay_CpuSeconds();
+   bool running = true;
+   uint64_t value;
+   int count, i;
+
+   while (running) {
+      count = epoll_wait(relay->epoll_fd, events, sizeof(events) / sizeof(events[0]), -1);
+      if (count < 0) {
+         if (errno == EINTR) {
+            continue;
+         }
+         relay->stats.cpu_seconds += relay_CpuSeconds() - start;
+         return false;
+      }
+      for (i = 0; i < count; i++) {
+         switch (events[i].data.u64) {
+         case RELAY_EVENT_SOCKET:
+            relay_Forward(relay);
+            break;
+         case RELAY_EVENT_WAKEUP:
+            if (read(relay->wakeup_fd, &value, sizeof(value)) == sizeof(value)) {
+               running = false;
+            }
+            break;
+         case RELAY_EVENT_TIMER:
+            relay_Report(relay);
+            break;
+         case RELAY_EVENT_CONTROL:
+            relay_ReadControl(relay);
+            break;
+         }
+      }
+   }
+   relay->stats.cpu_seconds += relay_CpuSeconds() - start;
+   return true;
+}
@@ -0,0 +1,84 @@
+#ifndef _RELAY_H
+#define _RELAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+/*
+ * relay.h --
+ *
+ * A UDP relay for GGPO sessions which can't reach each other directly.
+ * The peers send their packets to the relay instead of to each other, and
+ * the relay forwards each one to the session named by the dst_session of
+ * its header.  Only sessions registered in the same match may talk to
+ * each other; the relay learns their addresses from the packets they send.
+ * A session's address is the one its first packet came from.  Packets
+ * claiming to be from it but coming from elsewhere are dropped, until it
+ * has been quiet for RELAY_REBIND_TIMEOUT and the new address takes over,
+ * which is how a peer whose NAT mapping changed gets back in.  So anyone
+ * who knows a session id can still take it before its peer starts, or
+ * after it goes quiet: keep the ids unpredictable, and register a match
+ * only when its peers are about to connect.
+ *
+ * A session reaching its peers through the relay must have a session id,
+ * so it has to be started with ggpo_start_session_on_socket.  Its remote
+ * players are all at the address of the relay, told apart by their ids.
+ */
+
+#define RELAY_MAX_SESSIONS       65536
+#define RELAY_BATCH              64
+#define RELAY_MAX_PACKET_SIZE    4096
+#define RELAY_MAX_MATCH_SIZE     64
+#define RELAY_MAX_CONTROL_LINE   1024
+#define RELAY_REBIND_TIMEOUT     2000     /* ms, below GGPO's default disconnect timeout */
+
+typedef struct RelaySession {
+   uint32_t             match;      /* 0 if the id isn't registered */
+   bool                 has_addr;
+   struct sockaddr_in   addr;
+   uint64_t             last_heard;  /* ms, from addr */
+} RelaySession;
+
+typedef struct RelayStats {
+   uint64_t    received;
+   uint64_t    forwarded;
+   uint64_t    dropped;             /* unregistered, or the receiver hasn't been heard from yet */
+   uint64_t    malformed;
+   uint64_t    rejected;            /* from an address other than the session's */
+   uint64_t    batches;
+   double      cpu_seconds;         /* spent in relay_Run */
+} RelayStats;
+
+typedef struct RelayBatch RelayBatch;
+
+typedef struct Relay {
+   int            fd;
+   int            epoll_fd;
+   int            wakeup_fd;        /* eventfd written by relay_Stop */
+   int            timer_fd;         /* -1 unless reporting */
+   int            control_fd;       /* -1 unless reading commands */
+   uint32_t       next_match;
+   RelaySession   *sessions;        /* indexed by session id */
+   RelayBatch     *batch;
+   RelayStats     stats;
+   char           control_line[RELAY_MAX_CONTROL_LINE];
+   int            control_len;
+} Relay;
+
+bool relay_Open(Relay *relay, uint16_t port);
+void relay_Close(Relay *relay);
+uint16_t relay_Port(Relay *relay);
+
+uint32_t relay_AddMatch(Relay *relay, const uint16_t *ids, int count);
+bool relay_RemoveMatch(Relay *relay, uint16_t id);
+bool relay_ParseCommand(Relay *relay, const char *command);
+
+bool relay_SetControl(Relay *relay, int fd);
+bool relay_SetReportInterval(Relay *relay, int seconds);
+bool relay_Run(Relay *relay);
+void relay_Stop(Relay *relay);
+
+bool relay_LoadTest(int pairs, double seconds, int packet_size);
+
+#endif
@@ -1,7 +1,6 @@
-#include <windows.h>
 #include <stdio.h>
 #include <math.h>
-#include "vectorwar.h"
+#include "ggponet.h"
 #include "gamestate.h"
 
 extern GGPOSession *ggpo;
@@ -20,19 +19,31 @@ distance(Position *lhs, Position *rhs)
    return sqrt(x*x + y*y);
 }
 
+static void
+inflate_bounds(Bounds *bounds, int d)
+{
+   bounds->left -= d;
+   bounds->top -= d;
+   bounds->right += d;
+   bounds->bottom += d;
+}
+
 /*
  * GameState_Init --
  *
- * Initialize our game state.
+ * Initialize our game state for a playing field of width x height.
  */
 
 void
-GameState_Init(GameState *gs, HWND hwnd, int num_players)
+GameState_Init(GameState *gs, int width, int height, int num_players)
 {
    int i, w, h, r;
 
-   GetClientRect(hwnd, &gs->_bounds);
-   InflateRect(&gs->_bounds, -8, -8);
+   gs->_bounds.left = 0;
+   gs->_bounds.top = 0;
+   gs->_bounds.right = width;
+   gs->_bounds.bottom = height;
+   inflate_bounds(&gs->_bounds, -8);
 
    w = gs->_bounds.right - gs->_bounds.left;
    h = gs->_bounds.bottom - gs->_bounds.top;
@@ -55,7 +66,7 @@ GameState_Init(GameState *gs, HWND hwnd, int num_players)
       gs->_ships[i].radius = SHIP_RADIUS;
    }
 
-   InflateRect(&gs->_bounds, -8, -8);
+   inflate_bounds(&gs->_bounds, -8);
 }
 
 void GameState_GetShipAI(GameState *gs, int i, double *heading, double *thrust, int *fire)
@@ -1,16 +1,24 @@
 #ifndef _GAMESTATE_H_
 #define _GAMESTATE_H_
 
-#include <windows.h>
-
 /*
  * gamestate.h --
  *
  * Encapsulates all the game state for the vector war application inside
  * a single structure.  This makes it trivial to implement our GGPO
  * save and load functions.
+ *
+ * The simulation does not depend on the windowing system, so it can be
+ * run headless (see the ggpo_bench app).
  */
 
+#define INPUT_THRUST            (1 << 0)
+#define INPUT_BREAK             (1 << 1)
+#define INPUT_ROTATE_LEFT       (1 << 2)
+#define INPUT_ROTATE_RIGHT      (1 << 3)
+#define INPUT_FIRE              (1 << 4)
+#define INPUT_BOMB              (1 << 5)
+
 #define PI                    ((double)3.1415926)
 #define STARTING_HEALTH       100
 #define ROTATE_INCREMENT        3
@@ -25,7 +33,7 @@
 #define BULLET_COOLDOWN         8
 #define BULLET_DAMAGE           10
 
-#define MAX_SHIPS               4
+#define MAX_SHIPS               8
 
 typedef struct Position {
    double x, y;
@@ -41,6 +49,10 @@ typedef struct Bullet {
    Velocity velocity;
 } Bullet;
 
+typedef struct Bounds {
+   int left, top, right, bottom;
+} Bounds;
+
 typedef struct Ship {
    Position position;
    Velocity velocity;
@@ -55,12 +67,12 @@ typedef struct Ship {
 
 typedef struct GameState {
    int         _framenumber;
-   RECT        _bounds;
+   Bounds      _bounds;
    int         _num_ships;
    Ship        _ships[MAX_SHIPS];
 } GameState;
 
-void GameState_Init(GameState *gs, HWND hwnd, int num_players);
+void GameState_Init(GameState *gs, int width, int height, int num_players);
 void GameState_GetShipAI(GameState *gs, int i, double *heading, double *thrust, int *fire);
 void GameState_ParseShipInputs(GameState *gs, int inputs, int i, double *heading, double *thrust, int *fire);
 void GameState_MoveShip(GameState *gs, int i, double heading, double thrust, int fire);
@@ -19,10 +19,11 @@ GDIRenderer_Draw(Renderer *self, GameState *gs, NonGameState *ngs)
 {
    GDIRenderer *r = (GDIRenderer *)self;
    HDC hdc = GetDC(r->_hwnd);
+   RECT bounds = { gs->_bounds.left, gs->_bounds.top, gs->_bounds.right, gs->_bounds.bottom };
    int i;
 
    FillRect(hdc, &r->_rc, (HBRUSH)GetStockObject(BLACK_BRUSH));
-   FrameRect(hdc, &gs->_bounds, (HBRUSH)GetStockObject(WHITE_BRUSH));
+   FrameRect(hdc, &bounds, (HBRUSH)GetStockObject(WHITE_BRUSH));
 
    SetBkMode(hdc, TRANSPARENT);
    SelectObject(hdc, r->_font);
@@ -215,7 +216,7 @@ GDIRenderer_Destroy(Renderer *self)
       DeleteObject(r->_font);
       {
          int i;
-         for (i = 0; i < 4; i++) {
+         for (i = 0; i < MAX_SHIPS; i++) {
             DeleteObject(r->_shipPens[i]);
          }
       }
@@ -250,8 +251,12 @@ GDIRenderer_Create(HWND hwnd)
    r->_shipColors[1] = RGB(0, 255, 0);
    r->_shipColors[2] = RGB(0, 0, 255);
    r->_shipColors[3] = RGB(128, 128, 128);
+   r->_shipColors[4] = RGB(255, 255, 0);
+   r->_shipColors[5] = RGB(0, 255, 255);
+   r->_shipColors[6] = RGB(255, 0, 255);
+   r->_shipColors[7] = RGB(255, 128, 0);
    
-   for (i = 0; i < 4; i++) {
+   for (i = 0; i < MAX_SHIPS; i++) {
       r->_shipPens[i] = CreatePen(PS_SOLID, 1, r->_shipColors[i]);
    }
    r->_redBrush = CreateSolidBrush(RGB(255, 0, 0));
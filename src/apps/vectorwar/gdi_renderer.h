@@ -17,8 +17,8 @@ typedef struct GDIRenderer {
    HWND         _hwnd;
    RECT         _rc;
    char         _status[1024];
-   COLORREF     _shipColors[4];
-   HPEN         _shipPens[4];
+   COLORREF     _shipColors[MAX_SHIPS];
+   HPEN         _shipPens[MAX_SHIPS];
    HBRUSH       _bulletBrush;
    HBRUSH       _redBrush;
 } GDIRenderer;
@@ -7,11 +7,12 @@
 
 #define MAX_GRAPH_SIZE      4096
 #define MAX_FAIRNESS          20
-#define MAX_PLAYERS_PM         4
+#define MAX_PLAYERS_PM         GGPO_MAX_PLAYERS
+#define NUM_FAIRNESS_PENS      4
 
 static HWND _hwnd = NULL;
 static HWND _dialog = NULL;
-static HPEN _green_pen, _red_pen, _blue_pen, _yellow_pen, _grey_pen, _pink_pen, _fairness_pens[MAX_PLAYERS_PM];
+static HPEN _green_pen, _red_pen, _blue_pen, _yellow_pen, _grey_pen, _pink_pen, _fairness_pens[NUM_FAIRNESS_PENS];
 static BOOL _shown = FALSE;
 static int _last_text_update_time = 0;
 
@@ -86,7 +87,7 @@ draw_fairness_graph_control(LPDRAWITEMSTRUCT di)
    LineTo(di->hDC, di->rcItem.right, midpoint);
 
    for (i = 0; i < _num_players; i++) {
-      draw_graph(di, _fairness_pens[i],    _remote_fairness_graph[i], _graph_size, -MAX_FAIRNESS, MAX_FAIRNESS);
+      draw_graph(di, _fairness_pens[i % NUM_FAIRNESS_PENS], _remote_fairness_graph[i], _graph_size, -MAX_FAIRNESS, MAX_FAIRNESS);
    }
    draw_graph(di, _yellow_pen, _fairness_graph,        _graph_size, -MAX_FAIRNESS, MAX_FAIRNESS);
 }
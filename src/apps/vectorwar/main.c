@@ -1,6 +1,7 @@
 #include <windows.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
 #include "vectorwar.h"
 #include "ggpo_perfmon.h"
 
@@ -26,7 +27,7 @@ typedef int32_t HSteamPipe;
 // A versioned accessor is exported by the library
 S_API ISteamUser* SteamAPI_SteamUser_v023();
 // Inline, unversioned accessor to get the current version.  Essentially the same as SteamUser(), but using this ensures that you are using a matching library.
-inline ISteamUser* SteamAPI_SteamUser() { return SteamAPI_SteamUser_v023(); }
+static inline ISteamUser* SteamAPI_SteamUser() { return SteamAPI_SteamUser_v023(); }
 S_API HSteamUser SteamAPI_ISteamUser_GetHSteamUser(ISteamUser* self);
 S_API bool SteamAPI_ISteamUser_BLoggedOn(ISteamUser* self);
 S_API uint64_steamid SteamAPI_ISteamUser_GetSteamID(ISteamUser* self);
@@ -70,7 +71,7 @@ S_API void S_CALLTYPE SteamAPI_ManualDispatch_FreeLastCallback(HSteamPipe hSteam
 typedef struct ISteamNetworkingUtils ISteamNetworkingUtils;
 S_API ISteamNetworkingUtils* SteamAPI_SteamNetworkingUtils_SteamAPI_v004();
 // Inline, unversioned accessor to get the current version.  Essentially the same as SteamNetworkingUtils_SteamAPI(), but using this ensures that you are using a matching library.
-inline ISteamNetworkingUtils* SteamAPI_SteamNetworkingUtils_SteamAPI() { return SteamAPI_SteamNetworkingUtils_SteamAPI_v004(); }
+static inline ISteamNetworkingUtils* SteamAPI_SteamNetworkingUtils_SteamAPI() { return SteamAPI_SteamNetworkingUtils_SteamAPI_v004(); }
 S_API void SteamAPI_ISteamNetworkingUtils_InitRelayNetworkAccess(ISteamNetworkingUtils* self);
 
 
@@ -97,6 +98,15 @@ MainWindowProc(HWND hwnd,
 		else if (wParam >= VK_F1 && wParam <= VK_F12) {
 			VectorWar_DisconnectPlayer((int)(wParam - VK_F1));
 		}
+		else if (wParam == VK_PRIOR) {
+			VectorWar_SeekReplay(-5 * 60);
+		}
+		else if (wParam == VK_NEXT) {
+			VectorWar_SeekReplay(5 * 60);
+		}
+		else if (wParam == VK_HOME) {
+			VectorWar_SeekReplay(-INT_MAX);
+		}
 		return 0;
 	case WM_PAINT:
 		VectorWar_DrawCurrentFrame();
@@ -141,11 +151,18 @@ static void
 RunMainLoop(HWND hwnd)
 {
 	MSG msg;
-	int start, next, now;
+	int start, now;
+	long long next;
 
 	memset(&msg, 0, sizeof(msg));
 
-	start = next = now = timeGetTime();
+	/*
+	 * next is kept in microseconds and advanced by exactly one frame at a
+	 * time, so frames can be stretched by less than the millisecond
+	 * timeGetTime resolves.
+	 */
+	start = now = timeGetTime();
+	next = (long long)now * 1000;
 	while (1) {
 		while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
 			TranslateMessage(&msg);
@@ -155,10 +172,13 @@ RunMainLoop(HWND hwnd)
 			}
 		}
 		now = timeGetTime();
-		VectorWar_Idle(max(0, next - now - 1));
-		if (now >= next) {
+		VectorWar_Idle(max(0, (int)(next / 1000 - now - 1)));
+		if ((long long)now * 1000 >= next) {
 			VectorWar_RunFrame(hwnd);
-			next = now + (1000 / 60);
+			next += VectorWar_FrameDuration();
+			if (next < (long long)now * 1000) {
+				next = (long long)now * 1000;
+			}
 		}
 
 #if defined(GGPO_STEAM)
@@ -196,7 +216,8 @@ static void
 Syntax(void)
 {
 	MessageBox(NULL,
-		L"Syntax: vectorwar.exe <local port> <num players> ('local' | <remote ip>:<remote port>)*\n",
+		L"Syntax: vectorwar.exe [record <file>] <local port> <num players> ('local' | <remote ip>:<remote port>)*\n"
+		L"        vectorwar.exe (replay | benchmark) <num players> <file>\n",
 		L"Could not start", MB_OK);
 }
 
@@ -228,6 +249,8 @@ int APIENTRY wWinMain(HINSTANCE hInstance,
 	unsigned int wide_ip_buffer_size = (unsigned int)ARRAYSIZE(wide_ip_buffer);
 	unsigned short local_port;
 	int num_players;
+	char filename[MAX_PATH];
+	const char *record_file = NULL;
 
 	POINT window_offsets[] = {
 	   { 64,  64 },   /* player 1 */
@@ -249,6 +272,34 @@ int APIENTRY wWinMain(HINSTANCE hInstance,
 		Syntax();
 		return 1;
 	}
+	if (!wcscmp(__wargv[1], L"replay") || !wcscmp(__wargv[1], L"benchmark")) {
+		if (__argc < 4) {
+			Syntax();
+			return 1;
+		}
+		num_players = _wtoi(__wargv[2]);
+		wcstombs_s(NULL, filename, ARRAYSIZE(filename), __wargv[3], _TRUNCATE);
+		if (!wcscmp(__wargv[1], L"benchmark")) {
+			VectorWar_BenchmarkReplay(hwnd, num_players, filename);
+		}
+		else {
+			VectorWar_InitReplay(hwnd, num_players, filename);
+			RunMainLoop(hwnd);
+		}
+		VectorWar_Exit();
+		WSACleanup();
+		DestroyWindow(hwnd);
+		return 0;
+	}
+	if (!wcscmp(__wargv[1], L"record")) {
+		if (__argc < 5) {
+			Syntax();
+			return 1;
+		}
+		wcstombs_s(NULL, filename, ARRAYSIZE(filename), __wargv[2], _TRUNCATE);
+		record_file = filename;
+		offset += 2;
+	}
 	local_port = (unsigned short)_wtoi(__wargv[offset++]);
 	num_players = _wtoi(__wargv[offset++]);
 	if (num_players < 0 || __argc < offset + num_players) {
@@ -270,6 +321,8 @@ int APIENTRY wWinMain(HINSTANCE hInstance,
 		int i;
 		int num_spectators = 0;
 
+		memset(players, 0, sizeof(players));
+
 		for (i = 0; i < num_players; i++) {
 			const wchar_t* arg = __wargv[offset++];
 
@@ -319,7 +372,7 @@ int APIENTRY wWinMain(HINSTANCE hInstance,
 			SetWindowPos(hwnd, NULL, window_offsets[local_player].x, window_offsets[local_player].y, 0, 0, SWP_NOSIZE | SWP_NOZORDER);
 		}
 
-		VectorWar_Init(hwnd, local_port, num_players, players, num_spectators);
+		VectorWar_Init(hwnd, local_port, num_players, players, num_spectators, record_file);
 	}
 	RunMainLoop(hwnd);
 	VectorWar_Exit();
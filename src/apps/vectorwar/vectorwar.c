@@ -13,6 +13,7 @@
 static GameState gs;
 static NonGameState ngs;
 static Renderer *renderer = NULL;
+static int frame_drift_usec = 0;
 GGPOSession *ggpo = NULL;
 
 /* 
@@ -92,8 +93,18 @@ vw_on_event_callback(GGPOEvent *info)
    case GGPO_EVENTCODE_DISCONNECTED_FROM_PEER:
       NonGameState_SetConnectStateByHandle(&ngs, info->u.disconnected.player, Disconnected);
       break;
-   case GGPO_EVENTCODE_TIMESYNC:
-      Sleep(1000 * info->u.timesync.frames_ahead / 60);
+   case GGPO_EVENTCODE_TIMESYNC_DRIFT:
+      /* Stretch the frames a little instead of pausing on
+       * GGPO_EVENTCODE_TIMESYNC.  See VectorWar_FrameDuration. */
+      frame_drift_usec = info->u.timesync_drift.usec_per_frame;
+      break;
+   case GGPO_EVENTCODE_FRAME_DELAY_CHANGED:
+      ggpo_log(ggpo, "frame delay is now %d (ping %d ms, jitter %d ms, %d frames late).\n",
+               info->u.frame_delay_changed.frame_delay, info->u.frame_delay_changed.ping,
+               info->u.frame_delay_changed.jitter, info->u.frame_delay_changed.rollback_frames);
+      break;
+   case GGPO_EVENTCODE_REPLAY_ENDED:
+      renderer->SetStatusText(renderer, "Replay ended.");
       break;
    }
    return true;
@@ -204,6 +215,21 @@ vw_free_buffer(void *buffer)
    free(buffer);
 }
 
+/*
+ * vw_init_game_state --
+ *
+ * Initialize the game state with a playing field which fills the client
+ * area of the window.
+ */
+static void
+vw_init_game_state(HWND hwnd, int num_players)
+{
+   RECT rc;
+
+   GetClientRect(hwnd, &rc);
+   GameState_Init(&gs, rc.right - rc.left, rc.bottom - rc.top, num_players);
+}
+
 
 /*
  * VectorWar_Init --
@@ -212,7 +238,7 @@ vw_free_buffer(void *buffer)
  * the video renderer and creates a new network session.
  */
 void
-VectorWar_Init(HWND hwnd, unsigned short localport, int num_players, GGPOPlayer *players, int num_spectators)
+VectorWar_Init(HWND hwnd, unsigned short localport, int num_players, GGPOPlayer *players, int num_spectators, const char *record_file)
 {
    GGPOErrorCode result;
    GDIRenderer *gdi_renderer = GDIRenderer_Create(hwnd);
@@ -224,7 +250,7 @@ VectorWar_Init(HWND hwnd, unsigned short localport, int num_players, GGPOPlayer
    /* Initialize the game state */
    memset(&gs, 0, sizeof(gs));
    memset(&ngs, 0, sizeof(ngs));
-   GameState_Init(&gs, hwnd, num_players);
+   vw_init_game_state(hwnd, num_players);
    ngs.num_players = num_players;
 
    /* Fill in a ggpo callbacks structure to pass to start_session. */
@@ -250,6 +276,7 @@ VectorWar_Init(HWND hwnd, unsigned short localport, int num_players, GGPOPlayer
     * a value of 0 for ggpo_set_disconnect_timeout. */
    ggpo_set_disconnect_timeout(ggpo, 3000);
    ggpo_set_disconnect_notify_start(ggpo, 1000);
+   ggpo_set_frame_duration(ggpo, FRAME_USEC);
 
    for (i = 0; i < num_players + num_spectators; i++) {
       GGPOPlayerHandle handle;
@@ -261,11 +288,16 @@ VectorWar_Init(HWND hwnd, unsigned short localport, int num_players, GGPOPlayer
          ngs.local_player_handle = handle;
          NonGameState_SetConnectStateByHandle(&ngs, handle, Connecting);
          ggpo_set_frame_delay(ggpo, handle, FRAME_DELAY);
+         ggpo_set_adaptive_frame_delay(ggpo, handle, MIN_FRAME_DELAY, MAX_FRAME_DELAY);
       } else {
          ngs.players[i].connect_progress = 0;
       }
    }
 
+   if (record_file) {
+      ggpo_start_recording(ggpo, record_file, KEYFRAME_INTERVAL);
+   }
+
    ggpoutil_perfmon_init(hwnd);
    renderer->SetStatusText(renderer, "Connecting to peers.");
 }
@@ -287,7 +319,7 @@ VectorWar_InitSpectator(HWND hwnd, unsigned short localport, int num_players, ch
    /* Initialize the game state */
    memset(&gs, 0, sizeof(gs));
    memset(&ngs, 0, sizeof(ngs));
-   GameState_Init(&gs, hwnd, num_players);
+   vw_init_game_state(hwnd, num_players);
    ngs.num_players = num_players;
 
    /* Fill in a ggpo callbacks structure to pass to start_session. */
@@ -305,12 +337,120 @@ VectorWar_InitSpectator(HWND hwnd, unsigned short localport, int num_players, ch
 #else
    result = ggpo_start_spectating(&ggpo, &cb, "vectorwar", num_players, sizeof(int), localport, host_ip, host_port);
 #endif
+   ggpo_set_frame_duration(ggpo, FRAME_USEC);
 
    ggpoutil_perfmon_init(hwnd);
 
    renderer->SetStatusText(renderer, "Starting new spectator session");
 }
 
+/*
+ * VectorWar_InitReplay --
+ *
+ * Create a new session playing back a replay file
+ */
+void
+VectorWar_InitReplay(HWND hwnd, int num_players, const char *filename)
+{
+   GGPOErrorCode result;
+   GDIRenderer *gdi_renderer = GDIRenderer_Create(hwnd);
+   GGPOSessionCallbacks cb;
+
+   renderer = (Renderer *)gdi_renderer;
+
+   /* Initialize the game state */
+   memset(&gs, 0, sizeof(gs));
+   memset(&ngs, 0, sizeof(ngs));
+   vw_init_game_state(hwnd, num_players);
+   ngs.num_players = num_players;
+   ngs.local_player_handle = GGPO_INVALID_HANDLE;
+
+   /* Fill in a ggpo callbacks structure to pass to start_replay. */
+   memset(&cb, 0, sizeof(cb));
+   cb.begin_game      = vw_begin_game_callback;
+   cb.advance_frame   = vw_advance_frame_callback;
+   cb.load_game_state = vw_load_game_state_callback;
+   cb.save_game_state = vw_save_game_state_callback;
+   cb.free_buffer     = vw_free_buffer;
+   cb.on_event        = vw_on_event_callback;
+   cb.log_game_state  = vw_log_game_state;
+
+   result = ggpo_start_replay(&ggpo, &cb, "vectorwar", filename, num_players, sizeof(int));
+   if (!GGPO_SUCCEEDED(result)) {
+      renderer->SetStatusText(renderer, "Could not open the replay file.");
+      return;
+   }
+
+   ggpoutil_perfmon_init(hwnd);
+   renderer->SetStatusText(renderer, "Page Up/Page Down: seek, Home: restart.");
+}
+
+/*
+ * VectorWar_SeekReplay --
+ *
+ * Move a replay forward or backward by the given number of frames.
+ */
+void
+VectorWar_SeekReplay(int frames)
+{
+   int first_frame, end_frame, current_frame;
+
+   if (ggpo && GGPO_SUCCEEDED(ggpo_replay_position(ggpo, &first_frame, &end_frame, &current_frame))) {
+      int frame = current_frame + frames;
+      frame = frame < first_frame ? first_frame : frame > end_frame ? end_frame : frame;
+      ggpo_replay_seek(ggpo, frame);
+      renderer->SetStatusText(renderer, "");
+   }
+}
+
+/*
+ * VectorWar_BenchmarkReplay --
+ *
+ * Play a replay file as fast as possible, and report how many frames
+ * per second the replay session runs and how long seeking takes.
+ */
+void
+VectorWar_BenchmarkReplay(HWND hwnd, int num_players, const char *filename)
+{
+   LARGE_INTEGER freq, start, end;
+   int first_frame, end_frame, frames = 0, seeks = 0;
+   double elapsed, seek_elapsed;
+   char report[256];
+
+   VectorWar_InitReplay(hwnd, num_players, filename);
+   if (!ggpo) {
+      return;
+   }
+   ggpo_idle(ggpo, 0);
+   ggpo_replay_position(ggpo, &first_frame, &end_frame, NULL);
+   QueryPerformanceFrequency(&freq);
+
+   /* Run the whole replay for at least a second. */
+   QueryPerformanceCounter(&start);
+   do {
+      ggpo_replay_seek(ggpo, first_frame);
+      ggpo_replay_fast_forward(ggpo, -1);
+      frames += end_frame - first_frame;
+      QueryPerformanceCounter(&end);
+      elapsed = (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+   } while (elapsed < 1.0 && end_frame > first_frame);
+
+   /* Then seek to random frames for another second. */
+   srand(1);
+   QueryPerformanceCounter(&start);
+   do {
+      ggpo_replay_seek(ggpo, first_frame + rand() % (end_frame - first_frame + 1));
+      seeks++;
+      QueryPerformanceCounter(&end);
+      seek_elapsed = (double)(end.QuadPart - start.QuadPart) / freq.QuadPart;
+   } while (seek_elapsed < 1.0);
+
+   sprintf_s(report, ARRAYSIZE(report), "%d frames (%d to %d)\n%.0f frames/sec\n%.3f ms per seek\n",
+             end_frame - first_frame, first_frame, end_frame, frames / elapsed, 1000.0 * seek_elapsed / seeks);
+   printf("%s", report);
+   MessageBoxA(hwnd, report, "Replay benchmark", MB_OK);
+}
+
 
 /*
  * VectorWar_DisconnectPlayer --
@@ -462,6 +602,18 @@ VectorWar_Idle(int time)
    ggpo_idle(ggpo, time);
 }
 
+/*
+ * VectorWar_FrameDuration --
+ *
+ * How long the next frame should last, in microseconds: FRAME_USEC, plus
+ * whatever GGPO asked for to let the other players catch up.
+ */
+int
+VectorWar_FrameDuration(void)
+{
+   return FRAME_USEC + frame_drift_usec;
+}
+
 void
 VectorWar_Exit(void)
 {
@@ -2,6 +2,7 @@
 #define _VECTORWAR_H
 
 #include "ggponet.h"
+#include "gamestate.h"
 
 /*
  * vectorwar.h --
@@ -10,19 +11,16 @@
  *
  */
 
-#define INPUT_THRUST            (1 << 0)
-#define INPUT_BREAK             (1 << 1)
-#define INPUT_ROTATE_LEFT       (1 << 2)
-#define INPUT_ROTATE_RIGHT      (1 << 3)
-#define INPUT_FIRE              (1 << 4)
-#define INPUT_BOMB              (1 << 5)
-
-void VectorWar_Init(HWND hwnd, unsigned short localport, int num_players, GGPOPlayer *players, int num_spectators);
+void VectorWar_Init(HWND hwnd, unsigned short localport, int num_players, GGPOPlayer *players, int num_spectators, const char *record_file);
 void VectorWar_InitSpectator(HWND hwnd, unsigned short localport, int num_players, char *host_ip, unsigned short host_port);
+void VectorWar_InitReplay(HWND hwnd, int num_players, const char *filename);
+void VectorWar_SeekReplay(int frames);
+void VectorWar_BenchmarkReplay(HWND hwnd, int num_players, const char *filename);
 void VectorWar_DrawCurrentFrame(void);
 void VectorWar_AdvanceFrame(int inputs[], int disconnect_flags);
 void VectorWar_RunFrame(HWND hwnd);
 void VectorWar_Idle(int time);
+int VectorWar_FrameDuration(void);
 void VectorWar_DisconnectPlayer(int player);
 void VectorWar_Exit(void);
 
@@ -32,5 +30,9 @@ void VectorWar_SteamCallback(int callback_type, void *callback_data, int callbac
 
 #define ARRAY_SIZE(n)      (sizeof(n) / sizeof(n[0]))
 #define FRAME_DELAY        2
+#define MIN_FRAME_DELAY    1
+#define MAX_FRAME_DELAY    6
+#define KEYFRAME_INTERVAL  120
+#define FRAME_USEC         (1000000 / 60)
 
 #endif
@@ -32,7 +32,8 @@ extern "C" {
 #  define GGPO_API
 #endif
 
-#define GGPO_MAX_PLAYERS                  4
+#define GGPO_MAX_PLAYERS                 16
+#define GGPO_MAX_INPUT_SIZE               9
 #define GGPO_MAX_PREDICTION_FRAMES        8
 #define GGPO_MAX_SPECTATORS              32
 
@@ -40,6 +41,8 @@ extern "C" {
 
 typedef struct GGPOSession GGPOSession;
 
+typedef struct GGPOSocket GGPOSocket;
+
 typedef int GGPOPlayerHandle;
 
 typedef enum {
@@ -70,6 +73,10 @@ typedef enum {
  *       All the local inputs for this session will be sent to this player at
  *       ip_address:port.
  *
+ * u.remote.session_id: The id of the session of this player on its socket
+ *       when it was started with ggpo_start_session_on_socket, 0 when it has
+ *       a socket of its own.
+ *
  */
 
 typedef struct GGPOPlayer {
@@ -88,6 +95,7 @@ typedef struct GGPOPlayer {
       struct {
          char           ip_address[32];
          unsigned short port;
+         unsigned short session_id;
       } remote;
 #endif
    } u;
@@ -151,6 +159,23 @@ typedef enum {
  * down to ensure fairness.  The u.timesync.frames_ahead parameter in
  * the GGPOEvent object indicates how many frames the client is.
  *
+ * GGPO_EVENTCODE_TIMESYNC_DRIFT - A finer grained alternative to
+ * GGPO_EVENTCODE_TIMESYNC.  u.timesync_drift.usec_per_frame is how many
+ * microseconds longer each frame should last, from now until the next
+ * GGPO_EVENTCODE_TIMESYNC_DRIFT event, so that this client sheds its lead
+ * gradually instead of pausing.  0 means run at the normal rate.  Games
+ * should act on either this event or GGPO_EVENTCODE_TIMESYNC, not both.
+ *
+ * GGPO_EVENTCODE_FRAME_DELAY_CHANGED - The adaptive frame delay of a local
+ * player (see ggpo_set_adaptive_frame_delay) changed.  u.frame_delay_changed
+ * holds the new delay along with what it was based on: the ping and jitter
+ * of the slowest peer, and by how many frames the inputs of our peers
+ * arrived late on average.
+ *
+ * GGPO_EVENTCODE_REPLAY_ENDED - A replay session has played its last
+ * recorded frame.  ggpo_synchronize_input fails from then on, unless you
+ * seek back with ggpo_replay_seek.
+ *
  */
 typedef enum {
    GGPO_EVENTCODE_CONNECTED_TO_PEER            = 1000,
@@ -161,6 +186,9 @@ typedef enum {
    GGPO_EVENTCODE_TIMESYNC                     = 1005,
    GGPO_EVENTCODE_CONNECTION_INTERRUPTED       = 1006,
    GGPO_EVENTCODE_CONNECTION_RESUMED           = 1007,
+   GGPO_EVENTCODE_REPLAY_ENDED                 = 1008,
+   GGPO_EVENTCODE_TIMESYNC_DRIFT               = 1009,
+   GGPO_EVENTCODE_FRAME_DELAY_CHANGED          = 1010,
 } GGPOEventCode;
 
 /*
@@ -188,6 +216,16 @@ typedef struct {
       struct {
          int               frames_ahead;
       } timesync;
+      struct {
+         int               usec_per_frame;
+      } timesync_drift;
+      struct {
+         GGPOPlayerHandle  player;
+         int               frame_delay;
+         int               ping;
+         int               jitter;
+         int               rollback_frames;
+      } frame_delay_changed;
       struct {
          GGPOPlayerHandle  player;
          int               disconnect_timeout;
@@ -223,7 +261,8 @@ typedef struct {
     * of a rollback.  The buffer and len parameters contain a previously
     * saved state returned from the save_game_state function.  The client
     * should make the current game state match the state contained in the
-    * buffer.
+    * buffer.  Spectators joining a session which is already running are
+    * also sent a recent state this way before the first frame they play.
     */
    bool (*load_game_state)(unsigned char *buffer, int len);
 
@@ -256,6 +295,16 @@ typedef struct {
     * structure above for more information.
     */
    bool (*on_event)(GGPOEvent *info);
+
+   /*
+    * predict_input - Optional.  Called for the players whose input predictor
+    * is GGPO_PREDICTOR_CALLBACK (see ggpo_set_input_predictor) when GGPO.net
+    * needs to guess their input before it arrives.  last_input holds the
+    * last input received from the player.  Write the input the player is
+    * expected to send next into prediction and return true, or return false
+    * to repeat last_input.  The guess is used until the next input arrives.
+    */
+   bool (*predict_input)(GGPOPlayerHandle player, const void *last_input, void *prediction, int size);
 } GGPOSessionCallbacks;
 
 /*
@@ -282,6 +331,16 @@ typedef struct {
  * network.kbps_sent - The estimated bandwidth used between the two
  * clients, in kilobits per second.
  *
+ * network.bytes_sent - The total number of bytes sent to the remote client
+ * since the session started, including the UDP header overhead.
+ *
+ * network.packets_sent - The total number of packets sent to the remote
+ * client since the session started.
+ *
+ * network.jitter - How much the round trip time varies from one packet to
+ * the next, in milliseconds.  ping is a smoothed average of recent round
+ * trips and jitter is their mean deviation from it.
+ *
  * timesync.local_frames_behind - The number of frames GGPO.net calculates
  * that the local client is behind the remote client at this instant in
  * time.  For example, if at this instant the current game client is running
@@ -291,6 +350,23 @@ typedef struct {
  * timesync.remote_frames_behind - The same as local_frames_behind, but
  * calculated from the perspective of the remote player.
  *
+ * prediction.predicted_frames - The number of inputs of the player which
+ * were predicted before they arrived (see ggpo_set_input_predictor).
+ *
+ * prediction.mispredicted_frames - How many of those turned out wrong.
+ *
+ * prediction.mispredictions - The number of rollbacks the wrong predictions
+ * caused.
+ *
+ * prediction.rollback_frames - The number of frames run again because of
+ * them.  When the inputs of several players are wrong on the same frame,
+ * each of them is charged with the whole rollback.
+ *
+ * prediction.rollbacks_avoided - The number of rollbacks skipped because
+ * the wrong predictions only differed in bits outside the relevance mask
+ * (see ggpo_set_input_relevance).  Those frames don't count as
+ * mispredicted.
+ *
  */
 typedef struct GGPONetworkStats {
    struct {
@@ -298,13 +374,140 @@ typedef struct GGPONetworkStats {
       int   recv_queue_len;
       int   ping;
       int   kbps_sent;
+      int   bytes_sent;
+      int   packets_sent;
+      int   jitter;
    } network;
    struct {
       int   local_frames_behind;
       int   remote_frames_behind;
    } timesync;
+   struct {
+      int   predicted_frames;
+      int   mispredicted_frames;
+      int   mispredictions;
+      int   rollback_frames;
+      int   rollbacks_avoided;
+   } prediction;
 } GGPONetworkStats;
 
+/*
+ * The GGPOSpectatorStats structure contains some statistics about a spectator
+ * session (see ggpo_get_spectator_stats).
+ *
+ * relay.num_spectators - The number of downstream spectators this session is
+ * relaying the inputs to.
+ *
+ * relay.upstream_ping - The round trip time to the session serving us the
+ * inputs, in milliseconds.
+ *
+ * relay.forward_delay - The average time between receiving an input from
+ * upstream and forwarding it to the downstream spectators, in milliseconds.
+ *
+ * relay.hop_delay - The estimated delay added by the hop from our upstream
+ * to this session: half the upstream ping plus the forward delay.  Summed
+ * along a relay chain, it gives how far behind the host a spectator is.
+ *
+ * playback.frames_available - The number of frames received from upstream
+ * which have not been played yet.
+ *
+ * playback.playout_delay - The number of frames the jitter buffer currently
+ * holds back before playing (see ggpo_set_spectator_playout_delay).
+ *
+ * playback.jitter - The measured jitter of the input arrival times, in
+ * milliseconds.
+ *
+ * playback.stalls - The number of times playback ran out of inputs.
+ *
+ * playback.pacing_adjustment - The recommended change to the playback speed,
+ * in percent.  Positive when the buffer holds more than the playout delay and
+ * the game should run slightly faster, negative when it should slow down.
+ */
+typedef struct GGPOSpectatorStats {
+   struct {
+      int   num_spectators;
+      int   upstream_ping;
+      int   forward_delay;
+      int   hop_delay;
+   } relay;
+   struct {
+      int   frames_available;
+      int   playout_delay;
+      int   jitter;
+      int   stalls;
+      int   pacing_adjustment;
+   } playback;
+} GGPOSpectatorStats;
+
+/*
+ * The GGPOSpectatorCatchupPolicy enumeration decides how many frames a
+ * spectator should simulate each tick (see ggpo_spectator_frames_to_run)
+ * when it has fallen behind the inputs received from the host.
+ *
+ * GGPO_SPECTATOR_CATCHUP_NONE - Always run a single frame.  A spectator
+ * which stalled stays behind.
+ *
+ * GGPO_SPECTATOR_CATCHUP_IMMEDIATE - Run every frame available, up to the
+ * per-tick maximum.
+ *
+ * GGPO_SPECTATOR_CATCHUP_GRADUAL - Run a fraction of the backlog on top of
+ * the regular frame, so a spectator which stalled for a second fast-forwards
+ * smoothly back to live.
+ */
+typedef enum {
+   GGPO_SPECTATOR_CATCHUP_NONE,
+   GGPO_SPECTATOR_CATCHUP_IMMEDIATE,
+   GGPO_SPECTATOR_CATCHUP_GRADUAL,
+} GGPOSpectatorCatchupPolicy;
+
+/*
+ * The GGPOInputPredictor enumeration decides how the input of a remote
+ * player is guessed while it's on its way (see ggpo_set_input_predictor).
+ *
+ * GGPO_PREDICTOR_REPEAT_LAST - The player keeps sending the last input
+ * received.  The default.
+ *
+ * GGPO_PREDICTOR_RELEASE_BUTTONS - Same as GGPO_PREDICTOR_REPEAT_LAST, but
+ * momentary buttons, like the attack buttons being mashed, are expected to
+ * be released.
+ *
+ * GGPO_PREDICTOR_MARKOV - Learns which input usually follows which from the
+ * inputs of the player received during the session, and predicts the most
+ * frequent one.
+ *
+ * GGPO_PREDICTOR_CALLBACK - The game predicts through the predict_input
+ * callback.
+ */
+typedef enum {
+   GGPO_PREDICTOR_REPEAT_LAST,
+   GGPO_PREDICTOR_RELEASE_BUTTONS,
+   GGPO_PREDICTOR_MARKOV,
+   GGPO_PREDICTOR_CALLBACK,
+} GGPOInputPredictor;
+
+/*
+ * The GGPOSpectatorLagPolicy enumeration decides what a session does with a
+ * spectator which falls too far behind in acknowledging the inputs it has
+ * been sent (see ggpo_set_spectator_lag_policy).
+ *
+ * GGPO_SPECTATOR_LAG_DISCONNECT - The spectator is disconnected.  You will
+ * be notified via a GGPO_EVENTCODE_DISCONNECTED_FROM_PEER event.
+ *
+ * GGPO_SPECTATOR_LAG_THROTTLE - The session stops confirming new frames
+ * until the spectator catches up, which eventually stalls the players at
+ * the prediction barrier.
+ *
+ * GGPO_SPECTATOR_LAG_SNAPSHOT - The spectator's input stream is dropped and
+ * it is sent a recent saved state instead, the way a spectator joining a
+ * running session is.  It skips the frames in between and carries on from
+ * that state.
+ */
+typedef enum {
+   GGPO_SPECTATOR_LAG_DISCONNECT,
+   GGPO_SPECTATOR_LAG_THROTTLE,
+   GGPO_SPECTATOR_LAG_SNAPSHOT,
+} GGPOSpectatorLagPolicy;
+
 /*
  * ggpo_start_session --
  *
@@ -322,9 +525,13 @@ typedef struct GGPONetworkStats {
  *
  * num_players - The number of players which will be in this game.  The number of players
  * per session is fixed.  If you need to change the number of players or any player
- * disconnects, you must start a new session.
+ * disconnects, you must start a new session.  At most GGPO_MAX_PLAYERS.
  *
- * input_size - The size of the game inputs which will be passsed to ggpo_add_local_input.
+ * input_size - The size of the game inputs which will be passsed to ggpo_add_local_input,
+ * at most GGPO_MAX_INPUT_SIZE bytes.  Inputs are queued and sent sized to input_size,
+ * so games with many players should keep it small.
+ *
+ * Returns GGPO_ERRORCODE_INVALID_REQUEST if num_players or input_size is out of range.
  *
  * When GGPO_STEAM is NOT defined:
  *   local_port - The port GGPO should bind to for UDP traffic.
@@ -360,6 +567,11 @@ GGPO_API GGPOErrorCode ggpo_start_session(GGPOSession **session,
  *
  * handle - An out parameter to a handle used to identify this player in the future.
  * (e.g. in the on_event callbacks).
+ *
+ * Spectators (GGPO_PLAYERTYPE_SPECTATOR) may also be added to a peer to peer
+ * session after the game has started.  They are sent a compressed copy of a
+ * recent confirmed state followed by the inputs from that frame onward, so
+ * joining takes about as long as transferring one state.
  */
 GGPO_API GGPOErrorCode ggpo_add_player(GGPOSession *session,
                                                GGPOPlayer *player,
@@ -445,6 +657,214 @@ GGPO_API GGPOErrorCode ggpo_start_spectating(GGPOSession **session,
                                                       unsigned short host_port);
 #endif
 
+#if !defined(GGPO_STEAM)
+/*
+ * ggpo_open_socket --
+ *
+ * Binds a UDP socket which many sessions can share, so a server running
+ * lots of matches needs a single port.  Each session on the socket is told
+ * apart by a session id carried in every packet.
+ *
+ * All the sessions on a socket must be driven from the same thread: the
+ * first one to poll receives the packets of all of them.
+ */
+GGPO_API GGPOErrorCode ggpo_open_socket(GGPOSocket **socket,
+                                                 unsigned short local_port);
+
+/*
+ * ggpo_close_socket --
+ *
+ * Closes a socket opened with ggpo_open_socket.  Every session started on
+ * it must have been closed first.
+ */
+GGPO_API GGPOErrorCode ggpo_close_socket(GGPOSocket *socket);
+
+/*
+ * ggpo_start_session_on_socket --
+ *
+ * Like ggpo_start_session, but the session sends and receives through
+ * socket instead of binding a port of its own.
+ *
+ * session_id - Between 1 and 65535, and not in use by another session on
+ * socket.  The remote players must be given it in u.remote.session_id.
+ */
+GGPO_API GGPOErrorCode ggpo_start_session_on_socket(GGPOSession **session,
+                                                             GGPOSessionCallbacks *cb,
+                                                             const char *game,
+                                                             int num_players,
+                                                             int input_size,
+                                                             GGPOSocket *socket,
+                                                             unsigned short session_id);
+
+/*
+ * ggpo_start_spectating_on_socket --
+ *
+ * Like ggpo_start_spectating, but through socket (see
+ * ggpo_start_session_on_socket).
+ *
+ * host_session_id - The session id of the host on its socket, 0 when it
+ * has a socket of its own.
+ */
+GGPO_API GGPOErrorCode ggpo_start_spectating_on_socket(GGPOSession **session,
+                                                                GGPOSessionCallbacks *cb,
+                                                                const char *game,
+                                                                int num_players,
+                                                                int input_size,
+                                                                GGPOSocket *socket,
+                                                                unsigned short session_id,
+                                                                char *host_ip,
+                                                                unsigned short host_port,
+                                                                unsigned short host_session_id);
+#endif
+
+/*
+ * ggpo_start_input_server --
+ *
+ * Start the server of a star session.  In a peer to peer session each
+ * player sends their input to every other player, which costs each of them
+ * a packet per peer per frame.  In a star session the players only talk to
+ * an input server, which merges the inputs of everyone and sends the whole
+ * frame back to each player in one packet.  The players still predict and
+ * roll back as usual: the merged input is what confirms a frame.
+ *
+ * The server runs no game and only calls cb->on_event.  Add every player
+ * with ggpo_add_player as a GGPO_PLAYERTYPE_REMOTE player at the address of
+ * their ggpo_start_star_session, and the spectators as
+ * GGPO_PLAYERTYPE_SPECTATOR before the game starts.  Spectators start
+ * their session with ggpo_start_spectating, using the server as their
+ * host.  Then call ggpo_idle regularly; the server never advances frames.
+ * ggpo_disconnect_player drops a player for everyone.
+ *
+ * The merged input, input_size * num_players bytes, must fit in a single
+ * game input.
+ *
+ * When GGPO_STEAM is NOT defined:
+ *   local_port - The port the players and the spectators send to.
+ *
+ * When GGPO_STEAM IS defined:
+ *   local_channel - The virtual channel number for Steam Networking Messages routing.
+ */
+#if defined(GGPO_STEAM)
+GGPO_API GGPOErrorCode ggpo_start_input_server(GGPOSession **session,
+                                                        GGPOSessionCallbacks *cb,
+                                                        const char *game,
+                                                        int num_players,
+                                                        int input_size,
+                                                        int local_channel);
+#else
+GGPO_API GGPOErrorCode ggpo_start_input_server(GGPOSession **session,
+                                                        GGPOSessionCallbacks *cb,
+                                                        const char *game,
+                                                        int num_players,
+                                                        int input_size,
+                                                        unsigned short local_port);
+#endif
+
+/*
+ * ggpo_start_star_session --
+ *
+ * Start a player session of a star session (see ggpo_start_input_server).
+ * It is used like a session started with ggpo_start_session, except:
+ *
+ * - Exactly one GGPO_PLAYERTYPE_LOCAL player is added.  Adding the remote
+ *   players only gets their handle; their address isn't used.  Connection
+ *   events about the server are reported for every remote player.
+ * - Only the server can disconnect another player.  Disconnecting the local
+ *   player leaves the game.
+ * - Spectators, recording and adaptive frame delay are not supported.
+ *
+ * When GGPO_STEAM is NOT defined:
+ *   local_port - The port GGPO should bind to for UDP traffic.
+ *   server_ip, server_port - The address of the input server.
+ *
+ * When GGPO_STEAM IS defined:
+ *   local_channel - The virtual channel number for Steam Networking Messages routing.
+ *   server_steam_id - The Steam ID of the input server.
+ */
+#if defined(GGPO_STEAM)
+GGPO_API GGPOErrorCode ggpo_start_star_session(GGPOSession **session,
+                                                        GGPOSessionCallbacks *cb,
+                                                        const char *game,
+                                                        int num_players,
+                                                        int input_size,
+                                                        int local_channel,
+                                                        uint64_t server_steam_id);
+#else
+GGPO_API GGPOErrorCode ggpo_start_star_session(GGPOSession **session,
+                                                        GGPOSessionCallbacks *cb,
+                                                        const char *game,
+                                                        int num_players,
+                                                        int input_size,
+                                                        unsigned short local_port,
+                                                        char *server_ip,
+                                                        unsigned short server_port);
+#endif
+
+#if !defined(GGPO_STEAM)
+/*
+ * ggpo_start_input_server_on_socket --
+ *
+ * Like ggpo_start_input_server, but through socket (see
+ * ggpo_start_session_on_socket), so the servers of many matches can share
+ * a port.  The players and spectators must be given the session ids of
+ * their sessions in u.remote.session_id.
+ */
+GGPO_API GGPOErrorCode ggpo_start_input_server_on_socket(GGPOSession **session,
+                                                                  GGPOSessionCallbacks *cb,
+                                                                  const char *game,
+                                                                  int num_players,
+                                                                  int input_size,
+                                                                  GGPOSocket *socket,
+                                                                  unsigned short session_id);
+
+/*
+ * ggpo_start_star_session_on_socket --
+ *
+ * Like ggpo_start_star_session, but through socket (see
+ * ggpo_start_session_on_socket).
+ *
+ * server_session_id - The session id of the input server on its socket, 0
+ * when it has a socket of its own.
+ */
+GGPO_API GGPOErrorCode ggpo_start_star_session_on_socket(GGPOSession **session,
+                                                                  GGPOSessionCallbacks *cb,
+                                                                  const char *game,
+                                                                  int num_players,
+                                                                  int input_size,
+                                                                  GGPOSocket *socket,
+                                                                  unsigned short session_id,
+                                                                  char *server_ip,
+                                                                  unsigned short server_port,
+                                                                  unsigned short server_session_id);
+#endif
+
+/*
+ * ggpo_start_replay --
+ *
+ * Start a session which plays back a replay file written with
+ * ggpo_start_recording.  Run it like any other session:
+ * ggpo_synchronize_input returns the recorded inputs of each frame.  The
+ * first call to ggpo_idle loads the state the replay starts from through
+ * the load_game_state callback.
+ *
+ * cb - A GGPOSessionCallbacks structure which contains the callbacks you implement
+ * to help GGPO.net synchronize the two games.  You must implement all functions in
+ * cb, even if they do nothing but 'return true';
+ *
+ * game - The name of the game.  This is used internally for GGPO for logging purposes only.
+ *
+ * filename - The path of the replay file.
+ *
+ * num_players, input_size - Must match the session the replay was recorded
+ * from, or GGPO_ERRORCODE_INVALID_REQUEST is returned.
+ */
+GGPO_API GGPOErrorCode ggpo_start_replay(GGPOSession **session,
+                                                 GGPOSessionCallbacks *cb,
+                                                 const char *game,
+                                                 const char *filename,
+                                                 int num_players,
+                                                 int input_size);
+
 /*
  * ggpo_close_session --
  * Used to close a session.  You must call ggpo_close_session to
@@ -547,7 +967,8 @@ GGPO_API GGPOErrorCode ggpo_advance_frame(GGPOSession *);
  * Used to fetch some statistics about the quality of the network connection.
  *
  * player - The player handle returned from the ggpo_add_player function you used
- * to add the remote player.
+ * to add the remote player or spectator.  Spectating sessions ignore the
+ * handle and return the statistics for the connection to the host.
  *
  * stats - Out parameter to the network statistics.
  */
@@ -582,6 +1003,270 @@ GGPO_API GGPOErrorCode ggpo_set_disconnect_timeout(GGPOSession *,
 GGPO_API GGPOErrorCode ggpo_set_disconnect_notify_start(GGPOSession *,
                                                                 int timeout);
 
+/*
+ * ggpo_set_spectator_lag_policy --
+ *
+ * Sets what happens to spectators which fall behind.  All the spectators of
+ * a session read the confirmed inputs from a single shared log, so one slow
+ * spectator holds frames for everyone.  The default is to disconnect
+ * spectators once the log is full.  A spectating session applies it to the
+ * spectators it relays the inputs to, throttling only them, and snapshots
+ * with a state of its own.
+ *
+ * policy - One of the GGPOSpectatorLagPolicy values.
+ *
+ * max_lag_frames - The number of unacknowledged frames at which the policy
+ * kicks in.  Must be between 1 and the size of the log (256 frames).
+ */
+GGPO_API GGPOErrorCode ggpo_set_spectator_lag_policy(GGPOSession *,
+                                                             GGPOSpectatorLagPolicy policy,
+                                                             int max_lag_frames);
+
+/*
+ * ggpo_set_spectator_fanout --
+ *
+ * Limits the number of spectators served directly by this session.  Spectator
+ * sessions can relay the inputs they receive to their own spectators (add
+ * them with ggpo_add_player and GGPO_PLAYERTYPE_SPECTATOR), so a broadcast can
+ * be organized as a tree where every node serves at most max_spectators
+ * others, keeping the upload of the host constant.
+ *
+ * max_spectators - Between the number of spectators already added and
+ * GGPO_MAX_SPECTATORS, which is the default.
+ */
+GGPO_API GGPOErrorCode ggpo_set_spectator_fanout(GGPOSession *,
+                                                         int max_spectators);
+
+/*
+ * ggpo_set_path_mtu --
+ *
+ * Sets the largest datagram, IP and UDP headers included, that the session
+ * sends to its peers.  Inputs which don't fit in one datagram, after a
+ * long stall or with large inputs, are split over several.  Lower it if
+ * the path to your players drops or fragments bigger packets.
+ *
+ * mtu - Between 576 and 4096 bytes.  The default is 1280.
+ */
+GGPO_API GGPOErrorCode ggpo_set_path_mtu(GGPOSession *,
+                                                 int mtu);
+
+/*
+ * ggpo_get_spectator_stats --
+ *
+ * Used to fetch some statistics about a spectator session.
+ *
+ * stats - Out parameter to the spectator statistics.
+ */
+GGPO_API GGPOErrorCode ggpo_get_spectator_stats(GGPOSession *,
+                                                        GGPOSpectatorStats *stats);
+
+/*
+ * ggpo_spectator_frames_available --
+ *
+ * Returns the number of frames a spectator has received but not played yet.
+ * ggpo_synchronize_input will succeed that many times in a row.
+ *
+ * frames - Out parameter to the number of frames.
+ */
+GGPO_API GGPOErrorCode ggpo_spectator_frames_available(GGPOSession *,
+                                                               int *frames);
+
+/*
+ * ggpo_set_spectator_catchup --
+ *
+ * Sets how a spectator which has fallen behind catches up with the host.
+ * The default is GGPO_SPECTATOR_CATCHUP_NONE.
+ *
+ * policy - One of the GGPOSpectatorCatchupPolicy values.
+ *
+ * max_frames_per_tick - The maximum number of frames to run in a single tick.
+ */
+GGPO_API GGPOErrorCode ggpo_set_spectator_catchup(GGPOSession *,
+                                                          GGPOSpectatorCatchupPolicy policy,
+                                                          int max_frames_per_tick);
+
+/*
+ * ggpo_spectator_frames_to_run --
+ *
+ * Returns how many frames a spectator should simulate this tick according to
+ * its catch-up policy.  Run all but the last one without rendering, calling
+ * ggpo_synchronize_input and ggpo_advance_frame for each of them.
+ *
+ * frames - Out parameter to the number of frames to run, 0 if the next input
+ * has not been received yet.
+ */
+GGPO_API GGPOErrorCode ggpo_spectator_frames_to_run(GGPOSession *,
+                                                            int *frames);
+
+/*
+ * ggpo_set_spectator_playout_delay --
+ *
+ * Enables the jitter buffer of a spectator session.  Instead of playing the
+ * inputs as soon as they arrive, the spectator holds back a playout delay
+ * estimated from the jitter of their arrival times, and waits for the buffer
+ * to fill up again after running out of inputs.  This trades a few frames of
+ * latency for steady playback.
+ *
+ * min_frames, max_frames - The bounds of the playout delay.  Set max_frames
+ * to 0 to disable the jitter buffer, which is the default.
+ */
+GGPO_API GGPOErrorCode ggpo_set_spectator_playout_delay(GGPOSession *,
+                                                                int min_frames,
+                                                                int max_frames);
+
+/*
+ * ggpo_start_recording --
+ *
+ * Starts writing the confirmed inputs of a peer to peer session to a replay
+ * file, along with a keyframe of the game state every keyframe_interval
+ * frames so the replay can be seeked.  The states are the ones saved by the
+ * save_game_state callback.  The file is written from a background thread,
+ * and isn't complete until ggpo_stop_recording is called or the session is
+ * closed.
+ *
+ * filename - The path of the replay file.  It is overwritten if it exists.
+ *
+ * keyframe_interval - The number of frames between two keyframes.
+ */
+GGPO_API GGPOErrorCode ggpo_start_recording(GGPOSession *,
+                                                    const char *filename,
+                                                    int keyframe_interval);
+
+/*
+ * ggpo_stop_recording --
+ *
+ * Writes the seek index of the replay file started by ggpo_start_recording
+ * and closes it.
+ */
+GGPO_API GGPOErrorCode ggpo_stop_recording(GGPOSession *);
+
+/*
+ * ggpo_replay_seek --
+ *
+ * Moves a replay session to the given frame.  The closest keyframe before
+ * it is loaded through the load_game_state callback, then the game is run
+ * up to the frame through the advance_frame callback, as in a rollback.
+ * Seeking forward less than a keyframe interval only runs the game.
+ *
+ * frame - A frame between the first and the end frame of the replay (see
+ * ggpo_replay_position).
+ */
+GGPO_API GGPOErrorCode ggpo_replay_seek(GGPOSession *,
+                                                int frame);
+
+/*
+ * ggpo_replay_fast_forward --
+ *
+ * Runs a replay session forward through the advance_frame callback as fast
+ * as the CPU allows, e.g. to verify a replay or to skip to a highlight.
+ *
+ * frames - The number of frames to run, or -1 to run to the end of the
+ * replay.
+ */
+GGPO_API GGPOErrorCode ggpo_replay_fast_forward(GGPOSession *,
+                                                        int frames);
+
+/*
+ * ggpo_replay_position --
+ *
+ * Returns the range of frames of a replay session and the frame it is
+ * about to play.  Any of the out parameters may be NULL.
+ *
+ * first_frame - The first frame of the replay.
+ *
+ * end_frame - One past the last frame of the replay.
+ *
+ * current_frame - The frame ggpo_synchronize_input returns the inputs of.
+ */
+GGPO_API GGPOErrorCode ggpo_replay_position(GGPOSession *,
+                                                    int *first_frame,
+                                                    int *end_frame,
+                                                    int *current_frame);
+
+/*
+ * ggpo_set_adaptive_frame_delay --
+ *
+ * Lets ggpo pick the frame delay of a local player from the network
+ * conditions, instead of a fixed one set with ggpo_set_frame_delay.  The
+ * delay grows when the inputs of the other players keep arriving too late
+ * and the round trip time says more delay would help, and shrinks when the
+ * connection improves.  It changes by one frame at a time, and only shrinks
+ * on a frame where the local input repeats the previous one, so no input
+ * is lost.  Every change is reported with GGPO_EVENTCODE_FRAME_DELAY_CHANGED.
+ * Calling ggpo_set_frame_delay turns it off again.
+ *
+ * player - The handle of a local player.
+ *
+ * min_delay, max_delay - The bounds of the frame delay.
+ */
+GGPO_API GGPOErrorCode ggpo_set_adaptive_frame_delay(GGPOSession *,
+                                                             GGPOPlayerHandle player,
+                                                             int min_delay,
+                                                             int max_delay);
+
+/*
+ * ggpo_set_frame_duration --
+ *
+ * Tells ggpo how long a frame of the game lasts, if the game doesn't run
+ * at 60 frames per second.  Should be called right after the session is
+ * started.  It's used to turn the round trip time into frames when
+ * estimating the frame advantage, to size the windows the timesync
+ * recommendations are averaged over, and to space out the
+ * GGPO_EVENTCODE_TIMESYNC, GGPO_EVENTCODE_TIMESYNC_DRIFT and
+ * GGPO_EVENTCODE_FRAME_DELAY_CHANGED events, so that those work the same
+ * at any tick rate.
+ *
+ * usec - The duration of a frame in microseconds, e.g. 1000000 / 120 for a
+ * game ticking at 120 Hz.
+ */
+GGPO_API GGPOErrorCode ggpo_set_frame_duration(GGPOSession *,
+                                                       int usec);
+
+/*
+ * ggpo_set_input_predictor --
+ *
+ * Changes how the input of a remote player is predicted until it arrives.
+ * Every wrong prediction causes a rollback, so a predictor which fits the
+ * game better means fewer frames to run again.  ggpo_get_network_stats
+ * reports how well the predictions of each player did.
+ *
+ * player - The handle of a remote player.
+ *
+ * predictor - See GGPOInputPredictor.  GGPO_PREDICTOR_CALLBACK requires the
+ * predict_input callback.
+ *
+ * release_mask, size - For GGPO_PREDICTOR_RELEASE_BUTTONS, the bits of the
+ * momentary buttons in the input of the player.  Ignored otherwise.
+ */
+GGPO_API GGPOErrorCode ggpo_set_input_predictor(GGPOSession *,
+                                                        GGPOPlayerHandle player,
+                                                        GGPOInputPredictor predictor,
+                                                        const void *release_mask,
+                                                        int size);
+
+/*
+ * ggpo_set_input_relevance --
+ *
+ * Tells ggpo which bits of the input of a player affect the simulation.
+ * A prediction which only gets the other bits wrong (e.g. a taunt or an
+ * emote button) doesn't cause a rollback.  The game still receives the
+ * whole input once it is confirmed, so it must not let the ignored bits
+ * change the game state.
+ *
+ * The mask applies to the frames predicted from the next call to
+ * ggpo_synchronize_input on, so it can be set once or changed every frame
+ * when what matters depends on the game state.
+ *
+ * player - The handle of a remote player.
+ *
+ * mask, size - The relevant bits.  Bytes past size are all relevant.  Pass
+ * NULL to compare every bit again.
+ */
+GGPO_API GGPOErrorCode ggpo_set_input_relevance(GGPOSession *,
+                                                        GGPOPlayerHandle player,
+                                                        const void *mask,
+                                                        int size);
+
 /*
  * ggpo_log --
  *
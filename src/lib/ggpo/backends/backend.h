@@ -31,6 +31,9 @@ enum GGPOSessionType {
 	SESSION_P2P,
 	SESSION_SPECTATOR,
 	SESSION_SYNCTEST,
+	SESSION_REPLAY,
+	SESSION_INPUT_SERVER,
+	SESSION_STAR,
 };
 typedef enum GGPOSessionType GGPOSessionType;
 
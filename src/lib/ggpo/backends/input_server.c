@@ -0,0 +1,588 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#include "input_server.h"
+
+static const int DEFAULT_DISCONNECT_TIMEOUT = 5000;
+static const int DEFAULT_DISCONNECT_NOTIFY_START = 750;
+
+static void server_OnMsg(conn_Address from, UdpMsg* msg, int len, void* user_data);
+
+/*
+ * server_Init --
+ *
+ * The part of the constructor shared with the Steam one.
+ */
+static void server_Init(InputServerBackend *server, GGPOSessionCallbacks *cb, int num_players, int input_size)
+{
+	server->_header._session_type = SESSION_INPUT_SERVER;
+	server->_header._callbacks = *cb;
+	server->_num_players = num_players;
+	server->_num_spectators = 0;
+	server->_max_spectators = GGPO_MAX_SPECTATORS;
+	server->_input_size = input_size;
+	server->_synchronizing = true;
+	server->_disconnect_timeout = DEFAULT_DISCONNECT_TIMEOUT;
+	server->_disconnect_notify_start = DEFAULT_DISCONNECT_NOTIFY_START;
+	server->_frame_usec = TIMESYNC_DEFAULT_FRAME_USEC;
+	server->_next_frame = 0;
+	server->_received = calloc(num_players * INPUT_SERVER_QUEUE_LENGTH, input_size);
+
+	/*
+	 * Everyone is sent the same merged stream, so they all read it from
+	 * one log and share its encoded packets.
+	 */
+	input_log_Init(&server->_log, 0);
+	udp_protocol_encode_cache_ctor(&server->_encode_cache);
+	for (int i = 0; i < (int)ARRAY_SIZE(server->_endpoints); i++) {
+		UdpProtocol_ctor(&server->_endpoints[i]);
+		UdpProtocol_SetEncodeCache(&server->_endpoints[i], &server->_encode_cache);
+		UdpProtocol_SetInputLog(&server->_endpoints[i], &server->_log);
+	}
+	for (int i = 0; i < (int)ARRAY_SIZE(server->_last_received); i++) {
+		server->_last_received[i] = GAMEINPUT_NULL_FRAME;
+	}
+	memset(server->_local_connect_status, 0, sizeof(server->_local_connect_status));
+	for (int i = 0; i < (int)ARRAY_SIZE(server->_local_connect_status); i++) {
+		server->_local_connect_status[i].last_frame = -1;
+	}
+}
+
+static void server_InitEndpoint(InputServerBackend *server, int index, int queue, conn_Address addr)
+{
+	UdpProtocol *endpoint = &server->_endpoints[index];
+
+	UdpProtocol_Init(endpoint, &server->_udp, queue, addr, server->_local_connect_status, server->_input_size * server->_num_players);
+	UdpProtocol_SetDisconnectTimeout(endpoint, server->_disconnect_timeout);
+	UdpProtocol_SetDisconnectNotifyStart(endpoint, server->_disconnect_notify_start);
+	UdpProtocol_SetFrameDuration(endpoint, server->_frame_usec);
+	UdpProtocol_Synchronize(endpoint);
+}
+
+#if defined(GGPO_STEAM)
+
+void server_ctor_steam(InputServerBackend *server, GGPOSessionCallbacks *cb, const char *gamename, int local_channel, int num_players, int input_size)
+{
+	(void)gamename;
+	server_Init(server, cb, num_players, input_size);
+	udp_ctor(&server->_udp);
+	udp_Init(&server->_udp, (uint16)local_channel, server_OnMsg, server);
+}
+
+void server_AddRemotePlayerSteam(InputServerBackend *server, uint64 steam_id, int queue)
+{
+	conn_add_known_peer(steam_id);
+	server_InitEndpoint(server, queue, queue, conn_address_from_steam_id(steam_id));
+}
+
+GGPOErrorCode server_AddSpectatorSteam(InputServerBackend *server, uint64 steam_id, GGPOPlayerHandle *handle)
+{
+	if (server->_num_spectators == server->_max_spectators) {
+		return GGPO_ERRORCODE_TOO_MANY_SPECTATORS;
+	}
+	int queue = server->_num_spectators++;
+
+	conn_add_known_peer(steam_id);
+	server_InitEndpoint(server, server->_num_players + queue, queue + 1000, conn_address_from_steam_id(steam_id));
+	*handle = server_QueueToSpectatorHandle(server, queue);
+	return GGPO_OK;
+}
+
+#else
+
+/*
+ * server_ctor --
+ *
+ * Binds localport, or attaches to shared under session_id when shared
+ * isn't NULL.  The server runs no game, so it never calls begin_game with
+ * gamename.
+ */
+void server_ctor(InputServerBackend *server, GGPOSessionCallbacks *cb, const char *gamename, uint16 localport, UdpSocket *shared, uint16 session_id, int num_players, int input_size)
+{
+	(void)gamename;
+	server_Init(server, cb, num_players, input_size);
+	udp_ctor(&server->_udp);
+	if (shared) {
+		udp_InitShared(&server->_udp, shared, session_id, server_OnMsg, server);
+	} else {
+		udp_Init(&server->_udp, localport, server_OnMsg, server);
+	}
+}
+
+void server_AddRemotePlayer(InputServerBackend *server, char *ip, uint16 port, uint16 session_id, int queue)
+{
+	ASSERT(conn_support_ip_port());
+	conn_Address peer_addr = conn_address_from_ip_port(server->_udp._socket, ip, port);
+
+	server_InitEndpoint(server, queue, queue, peer_addr);
+	UdpProtocol_SetRemoteSession(&server->_endpoints[queue], session_id);
+}
+
+GGPOErrorCode server_AddSpectator(InputServerBackend *server, char *ip, uint16 port, uint16 session_id, GGPOPlayerHandle *handle)
+{
+	if (server->_num_spectators == server->_max_spectators) {
+		return GGPO_ERRORCODE_TOO_MANY_SPECTATORS;
+	}
+	int queue = server->_num_spectators++;
+	int index = server->_num_players + queue;
+
+	ASSERT(conn_support_ip_port());
+	conn_Address peer_addr = conn_address_from_ip_port(server->_udp._socket, ip, port);
+
+	server_InitEndpoint(server, index, queue + 1000, peer_addr);
+	UdpProtocol_SetRemoteSession(&server->_endpoints[index], session_id);
+	*handle = server_QueueToSpectatorHandle(server, queue);
+	return GGPO_OK;
+}
+
+#endif /* GGPO_STEAM */
+
+void server_dtor(InputServerBackend *server)
+{
+	for (int i = 0; i < (int)ARRAY_SIZE(server->_endpoints); i++) {
+		UdpProtocol_dtor(&server->_endpoints[i]);
+	}
+	udp_dtor(&server->_udp);
+	input_log_dtor(&server->_log);
+	free(server->_received);
+}
+
+GGPOErrorCode
+server_AddPlayer(InputServerBackend *server, GGPOPlayer *player, GGPOPlayerHandle *handle)
+{
+	if (player->type == GGPO_PLAYERTYPE_SPECTATOR) {
+		/*
+		 * There is no game state to send a late spectator, so they have to
+		 * watch from the first frame.
+		 */
+		if (!server->_synchronizing) {
+			return GGPO_ERRORCODE_INVALID_REQUEST;
+		}
+#if defined(GGPO_STEAM)
+		return server_AddSpectatorSteam(server, player->u.steam_remote.steam_id, handle);
+#else
+		return server_AddSpectator(server, player->u.remote.ip_address, player->u.remote.port, player->u.remote.session_id, handle);
+#endif
+	}
+	if (player->type != GGPO_PLAYERTYPE_REMOTE) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+
+	int queue = player->player_num - 1;
+	if (player->player_num < 1 || player->player_num > server->_num_players) {
+		return GGPO_ERRORCODE_PLAYER_OUT_OF_RANGE;
+	}
+	if (UdpProtocol_IsInitialized(&server->_endpoints[queue])) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	*handle = server_QueueToPlayerHandle(server, queue);
+
+#if defined(GGPO_STEAM)
+	server_AddRemotePlayerSteam(server, player->u.steam_remote.steam_id, queue);
+#else
+	server_AddRemotePlayer(server, player->u.remote.ip_address, player->u.remote.port, player->u.remote.session_id, queue);
+#endif
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+server_DoPoll(InputServerBackend *server, int timeout)
+{
+	udp_OnLoopPoll(&server->_udp);
+	for (int i = 0; i < server->_num_players + server->_num_spectators; i++) {
+		UdpProtocol_OnLoopPoll(&server->_endpoints[i]);
+	}
+
+	server_PollUdpProtocolEvents(server);
+
+	if (!server->_synchronizing) {
+		server_MergeInputs(server);
+		server_UpdateTimesync(server);
+	}
+	for (int i = 0; i < server->_num_players + server->_num_spectators; i++) {
+		UdpProtocol_Flush(&server->_endpoints[i]);
+	}
+	return GGPO_OK;
+}
+
+/*
+ * server_OnInput --
+ *
+ * Queue the input of a player until everyone else's input for the same
+ * frame is in.  A player with some frame delay starts sending at a later
+ * frame than 0; the frames before are empty, as they are in the input
+ * queues of the players.
+ */
+void
+server_OnInput(InputServerBackend *server, int queue, GameInput *input)
+{
+	if (server->_local_connect_status[queue].disconnected) {
+		return;
+	}
+	int last_frame = server->_last_received[queue];
+	ASSERT(last_frame == GAMEINPUT_NULL_FRAME || input->frame == last_frame + 1);
+
+	if (input->size != server->_input_size) {
+		Log("input of size %d from queue %d, expected %d.  Disconnecting.\n", input->size, queue, server->_input_size);
+		server_DisconnectPlayerQueue(server, queue);
+		return;
+	}
+	if (input->frame - server->_next_frame >= INPUT_SERVER_QUEUE_LENGTH) {
+		Log("queue %d is %d frames ahead of the merged input.  Disconnecting.\n", queue, input->frame - server->_next_frame);
+		server_DisconnectPlayerQueue(server, queue);
+		return;
+	}
+	for (int frame = last_frame + 1; frame < input->frame; frame++) {
+		memset(server_GetReceived(server, queue, frame), 0, server->_input_size);
+	}
+	memcpy(server_GetReceived(server, queue, input->frame), input->bits, server->_input_size);
+	server->_last_received[queue] = input->frame;
+}
+
+/*
+ * server_MergeInputs --
+ *
+ * Merge every frame the connected players have all sent their input for
+ * into the log.  The inputs of a disconnected player are empty after the
+ * last frame they sent, which is what the players fill them with too.
+ * The new frames go out in one packet to each endpoint.
+ */
+void
+server_MergeInputs(InputServerBackend *server)
+{
+	int count = server->_num_players + server->_num_spectators;
+	GameInput input;
+	bool merged = false;
+
+	UdpProtocol_TrimInputLog(&server->_log, server->_endpoints, count);
+
+	while (!input_log_IsFull(&server->_log)) {
+		int frame = server->_next_frame;
+		bool ready = false;
+		for (int i = 0; i < server->_num_players; i++) {
+			if (server->_local_connect_status[i].disconnected) {
+				continue;
+			}
+			if (server->_last_received[i] < frame) {
+				ready = false;
+				break;
+			}
+			ready = true;
+		}
+		if (!ready) {
+			break;
+		}
+
+		gameinput_init(&input, frame, NULL, server->_input_size * server->_num_players);
+		for (int i = 0; i < server->_num_players; i++) {
+			if (frame <= server->_last_received[i]) {
+				memcpy(input.bits + i * server->_input_size, server_GetReceived(server, i, frame), server->_input_size);
+			}
+			if (!server->_local_connect_status[i].disconnected) {
+				server->_local_connect_status[i].last_frame = frame;
+			}
+		}
+		Log("merged frame %d.\n", frame);
+		input_log_Append(&server->_log, &input);
+		server->_next_frame++;
+		merged = true;
+	}
+
+	if (merged) {
+		for (int i = 0; i < count; i++) {
+			if (UdpProtocol_IsInitialized(&server->_endpoints[i]) && !UdpProtocol_IsDisconnected(&server->_endpoints[i])) {
+				UdpProtocol_SendInput(&server->_endpoints[i], &input);
+			}
+		}
+	}
+}
+
+/*
+ * server_UpdateTimesync --
+ *
+ * The server has no frame of its own.  It tells every player that it is on
+ * the frame the slowest player should be on by now, so the players ahead of
+ * them are asked to wait and the slowest one isn't.
+ */
+void
+server_UpdateTimesync(InputServerBackend *server)
+{
+	int slowest = INT_MAX;
+
+	for (int i = 0; i < server->_num_players; i++) {
+		if (UdpProtocol_IsRunning(&server->_endpoints[i]) && !server->_local_connect_status[i].disconnected) {
+			slowest = MIN(slowest, UdpProtocol_EstimateRemoteFrame(&server->_endpoints[i]));
+		}
+	}
+	if (slowest == INT_MAX) {
+		return;
+	}
+	for (int i = 0; i < server->_num_players; i++) {
+		if (UdpProtocol_IsRunning(&server->_endpoints[i])) {
+			UdpProtocol_SetLocalFrameNumber(&server->_endpoints[i], slowest);
+		}
+	}
+}
+
+void
+server_PollUdpProtocolEvents(InputServerBackend *server)
+{
+	udp_protocol_Event evt;
+	for (int i = 0; i < server->_num_players + server->_num_spectators; i++) {
+		while (UdpProtocol_GetEvent(&server->_endpoints[i], &evt)) {
+			server_OnUdpProtocolEvent(server, &evt, i);
+		}
+	}
+}
+
+void
+server_OnUdpProtocolEvent(InputServerBackend *server, udp_protocol_Event *evt, int index)
+{
+	bool spectator = index >= server->_num_players;
+	GGPOPlayerHandle handle = spectator ? server_QueueToSpectatorHandle(server, index - server->_num_players) : server_QueueToPlayerHandle(server, index);
+	GGPOEvent info;
+
+	switch (evt->type) {
+	case UdpProtocol_Event_Connected:
+		info.code = GGPO_EVENTCODE_CONNECTED_TO_PEER;
+		info.u.connected.player = handle;
+		server->_header._callbacks.on_event(&info);
+		break;
+	case UdpProtocol_Event_Synchronizing:
+		info.code = GGPO_EVENTCODE_SYNCHRONIZING_WITH_PEER;
+		info.u.synchronizing.player = handle;
+		info.u.synchronizing.count = evt->u.synchronizing.count;
+		info.u.synchronizing.total = evt->u.synchronizing.total;
+		server->_header._callbacks.on_event(&info);
+		break;
+	case UdpProtocol_Event_Synchronzied:
+		info.code = GGPO_EVENTCODE_SYNCHRONIZED_WITH_PEER;
+		info.u.synchronized.player = handle;
+		server->_header._callbacks.on_event(&info);
+
+		server_CheckInitialSync(server);
+		break;
+	case UdpProtocol_Event_NetworkInterrupted:
+		info.code = GGPO_EVENTCODE_CONNECTION_INTERRUPTED;
+		info.u.connection_interrupted.player = handle;
+		info.u.connection_interrupted.disconnect_timeout = evt->u.network_interrupted.disconnect_timeout;
+		server->_header._callbacks.on_event(&info);
+		break;
+	case UdpProtocol_Event_NetworkResumed:
+		info.code = GGPO_EVENTCODE_CONNECTION_RESUMED;
+		info.u.connection_resumed.player = handle;
+		server->_header._callbacks.on_event(&info);
+		break;
+	case UdpProtocol_Event_Input:
+		if (!spectator) {
+			server_OnInput(server, index, &evt->u.input.input);
+		}
+		break;
+	case UdpProtocol_Event_Disconnected:
+		if (spectator) {
+			server_DisconnectSpectator(server, index - server->_num_players);
+		} else if (!server->_local_connect_status[index].disconnected) {
+			server_DisconnectPlayerQueue(server, index);
+		}
+		break;
+	case UdpProtocol_Event_State:
+		// Nobody sends the server a state.
+		free(evt->u.state.buf);
+		break;
+	case UdpProtocol_Event_Unknown:
+		break;
+	}
+}
+
+/*
+ * server_DisconnectPlayerQueue --
+ *
+ * Drop a player from the game.  Their inputs already received are still
+ * merged; the players learn the last one from the connect status.
+ */
+void
+server_DisconnectPlayerQueue(InputServerBackend *server, int queue)
+{
+	GGPOEvent info;
+
+	UdpProtocol_Disconnect(&server->_endpoints[queue]);
+
+	Log("Disconnecting queue %d after frame %d (next merged frame: %d).\n", queue, server->_last_received[queue], server->_next_frame);
+	server->_local_connect_status[queue].disconnected = 1;
+	server->_local_connect_status[queue].last_frame = MAX(server->_last_received[queue], server->_next_frame - 1);
+	server->_last_received[queue] = server->_local_connect_status[queue].last_frame;
+
+	info.code = GGPO_EVENTCODE_DISCONNECTED_FROM_PEER;
+	info.u.disconnected.player = server_QueueToPlayerHandle(server, queue);
+	server->_header._callbacks.on_event(&info);
+
+	server_CheckInitialSync(server);
+}
+
+void
+server_DisconnectSpectator(InputServerBackend *server, int queue)
+{
+	GGPOEvent info;
+
+	UdpProtocol_Disconnect(&server->_endpoints[server->_num_players + queue]);
+
+	info.code = GGPO_EVENTCODE_DISCONNECTED_FROM_PEER;
+	info.u.disconnected.player = server_QueueToSpectatorHandle(server, queue);
+	server->_header._callbacks.on_event(&info);
+}
+
+GGPOErrorCode
+server_DisconnectPlayer(InputServerBackend *server, GGPOPlayerHandle player)
+{
+	int queue = (int)player - 1000;
+	if (queue >= 0 && queue < server->_num_spectators) {
+		if (UdpProtocol_IsDisconnected(&server->_endpoints[server->_num_players + queue])) {
+			return GGPO_ERRORCODE_PLAYER_DISCONNECTED;
+		}
+		server_DisconnectSpectator(server, queue);
+		return GGPO_OK;
+	}
+
+	queue = (int)player - 1;
+	if (queue < 0 || queue >= server->_num_players || !UdpProtocol_IsInitialized(&server->_endpoints[queue])) {
+		return GGPO_ERRORCODE_INVALID_PLAYER_HANDLE;
+	}
+	if (server->_local_connect_status[queue].disconnected) {
+		return GGPO_ERRORCODE_PLAYER_DISCONNECTED;
+	}
+	server_DisconnectPlayerQueue(server, queue);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+server_GetNetworkStats(InputServerBackend *server, GGPONetworkStats *stats, GGPOPlayerHandle player)
+{
+	int index = (int)player - 1000;
+	if (index >= 0 && index < server->_num_spectators) {
+		index += server->_num_players;
+	} else {
+		index = (int)player - 1;
+		if (index < 0 || index >= server->_num_players) {
+			return GGPO_ERRORCODE_INVALID_PLAYER_HANDLE;
+		}
+	}
+	memset(stats, 0, sizeof * stats);
+	UdpProtocol_GetNetworkStats(&server->_endpoints[index], stats);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+server_SetFrameDuration(InputServerBackend *server, int usec)
+{
+	if (usec <= 0) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	server->_frame_usec = usec;
+	for (int i = 0; i < server->_num_players + server->_num_spectators; i++) {
+		if (UdpProtocol_IsInitialized(&server->_endpoints[i])) {
+			UdpProtocol_SetFrameDuration(&server->_endpoints[i], server->_frame_usec);
+		}
+	}
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+server_SetDisconnectTimeout(InputServerBackend *server, int timeout)
+{
+	server->_disconnect_timeout = timeout;
+	for (int i = 0; i < server->_num_players + server->_num_spectators; i++) {
+		if (UdpProtocol_IsInitialized(&server->_endpoints[i])) {
+			UdpProtocol_SetDisconnectTimeout(&server->_endpoints[i], server->_disconnect_timeout);
+		}
+	}
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+server_SetDisconnectNotifyStart(InputServerBackend *server, int timeout)
+{
+	server->_disconnect_notify_start = timeout;
+	for (int i = 0; i < server->_num_players + server->_num_spectators; i++) {
+		if (UdpProtocol_IsInitialized(&server->_endpoints[i])) {
+			UdpProtocol_SetDisconnectNotifyStart(&server->_endpoints[i], server->_disconnect_notify_start);
+		}
+	}
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+server_SetSpectatorFanout(InputServerBackend *server, int max_spectators)
+{
+	if (max_spectators < server->_num_spectators || max_spectators > GGPO_MAX_SPECTATORS) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	server->_max_spectators = max_spectators;
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+server_SetPathMtu(InputServerBackend *server, int mtu)
+{
+	for (int i = 0; i < (int)ARRAY_SIZE(server->_endpoints); i++) {
+		UdpProtocol_SetPathMtu(&server->_endpoints[i], mtu);
+	}
+	return GGPO_OK;
+}
+
+static void server_OnMsg(conn_Address from, UdpMsg* msg, int len, void* user_data)
+{
+	InputServerBackend* server = (InputServerBackend*)user_data;
+	for (int i = 0; i < server->_num_players + server->_num_spectators; i++) {
+		if (UdpProtocol_HandlesMsg(&server->_endpoints[i], from, msg)) {
+			UdpProtocol_OnMsg(&server->_endpoints[i], msg, len);
+			return;
+		}
+	}
+}
+
+/*
+ * server_CheckInitialSync --
+ *
+ * The game starts once every player has been added and everyone is
+ * synchronized with the server.
+ */
+void
+server_CheckInitialSync(InputServerBackend *server)
+{
+	if (!server->_synchronizing) {
+		return;
+	}
+	for (int i = 0; i < server->_num_players; i++) {
+		if (!UdpProtocol_IsInitialized(&server->_endpoints[i])) {
+			return;
+		}
+		if (!UdpProtocol_IsSynchronized(&server->_endpoints[i]) && !server->_local_connect_status[i].disconnected) {
+			return;
+		}
+	}
+	for (int i = 0; i < server->_num_spectators; i++) {
+		UdpProtocol *spectator = &server->_endpoints[server->_num_players + i];
+		if (!UdpProtocol_IsSynchronized(spectator) && !UdpProtocol_IsDisconnected(spectator)) {
+			return;
+		}
+	}
+
+	GGPOEvent info;
+	info.code = GGPO_EVENTCODE_RUNNING;
+	server->_header._callbacks.on_event(&info);
+	server->_synchronizing = false;
+}
@@ -0,0 +1,104 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#ifndef _INPUT_SERVER_H
+#define _INPUT_SERVER_H
+
+#include "types.h"
+#include "backend.h"
+#include "input_log.h"
+#include "network/udp_proto.h"
+
+/*
+ * input_server.h --
+ *
+ * The server of a star session (see star.h).  Every player sends their
+ * input to the server only.  Once it has the input of all the connected
+ * players for a frame, the server merges them and sends the merged input
+ * back to everyone, so each player gets the input of the whole game in a
+ * single packet per frame instead of one from each of their peers.  The
+ * server runs no game: it never rolls back and only calls on_event.
+ *
+ * The merged input is laid out like the confirmed input sent to
+ * spectators, so spectator sessions can watch an input server too.
+ */
+
+#define INPUT_SERVER_QUEUE_LENGTH    128
+
+struct InputServerBackend {
+	GGPOSessionHeader _header;
+
+   Udp                   _udp;
+   UdpProtocol           _endpoints[GGPO_MAX_PLAYERS + GGPO_MAX_SPECTATORS];   /* players, then spectators */
+   int                   _num_players;
+   int                   _num_spectators;
+   int                   _max_spectators;
+   int                   _input_size;
+   bool                  _synchronizing;
+   int                   _disconnect_timeout;
+   int                   _disconnect_notify_start;
+   int                   _frame_usec;
+
+   /*
+    * Inputs received from each player and not merged yet, indexed by
+    * frame modulo INPUT_SERVER_QUEUE_LENGTH: INPUT_SERVER_QUEUE_LENGTH
+    * inputs of _input_size bytes per player.
+    */
+   char                  *_received;
+   int                   _last_received[GGPO_MAX_PLAYERS];
+   int                   _next_frame;
+
+   InputLog              _log;
+   udp_protocol_EncodeCache _encode_cache;
+   UdpMsg_connect_status _local_connect_status[UDP_MSG_MAX_PLAYERS];
+};
+typedef struct InputServerBackend InputServerBackend;
+
+#if defined(GGPO_STEAM)
+void server_ctor_steam(InputServerBackend *server, GGPOSessionCallbacks *cb, const char *gamename, int local_channel, int num_players, int input_size);
+void server_AddRemotePlayerSteam(InputServerBackend *server, uint64 steam_id, int queue);
+GGPOErrorCode server_AddSpectatorSteam(InputServerBackend *server, uint64 steam_id, GGPOPlayerHandle *handle);
+#else
+void server_ctor(InputServerBackend *server, GGPOSessionCallbacks *cb, const char *gamename, uint16 localport, UdpSocket *shared, uint16 session_id, int num_players, int input_size);
+void server_AddRemotePlayer(InputServerBackend *server, char *remoteip, uint16 reportport, uint16 session_id, int queue);
+GGPOErrorCode server_AddSpectator(InputServerBackend *server, char *remoteip, uint16 reportport, uint16 session_id, GGPOPlayerHandle *handle);
+#endif
+void server_dtor(InputServerBackend *server);
+
+GGPOErrorCode server_DoPoll(InputServerBackend *server, int timeout);
+GGPOErrorCode server_AddPlayer(InputServerBackend *server, GGPOPlayer *player, GGPOPlayerHandle *handle);
+GGPOErrorCode server_DisconnectPlayer(InputServerBackend *server, GGPOPlayerHandle handle);
+GGPOErrorCode server_GetNetworkStats(InputServerBackend *server, GGPONetworkStats *stats, GGPOPlayerHandle handle);
+GGPOErrorCode server_SetFrameDuration(InputServerBackend *server, int usec);
+GGPOErrorCode server_SetDisconnectTimeout(InputServerBackend *server, int timeout);
+GGPOErrorCode server_SetDisconnectNotifyStart(InputServerBackend *server, int timeout);
+GGPOErrorCode server_SetSpectatorFanout(InputServerBackend *server, int max_spectators);
+GGPOErrorCode server_SetPathMtu(InputServerBackend *server, int mtu);
+
+static inline GGPOPlayerHandle server_QueueToPlayerHandle(InputServerBackend *server, int queue) { return (GGPOPlayerHandle)(queue + 1); }
+static inline GGPOPlayerHandle server_QueueToSpectatorHandle(InputServerBackend *server, int queue) { return (GGPOPlayerHandle)(queue + 1000); }
+static inline char *server_GetReceived(InputServerBackend *server, int queue, int frame) { return server->_received + (queue * INPUT_SERVER_QUEUE_LENGTH + frame % INPUT_SERVER_QUEUE_LENGTH) * server->_input_size; }
+void server_OnInput(InputServerBackend *server, int queue, GameInput *input);
+void server_MergeInputs(InputServerBackend *server);
+void server_UpdateTimesync(InputServerBackend *server);
+void server_DisconnectPlayerQueue(InputServerBackend *server, int queue);
+void server_DisconnectSpectator(InputServerBackend *server, int queue);
+void server_PollUdpProtocolEvents(InputServerBackend *server);
+void server_OnUdpProtocolEvent(InputServerBackend *server, udp_protocol_Event *e, int index);
+void server_CheckInitialSync(InputServerBackend *server);
+
+#endif
@@ -23,7 +23,10 @@
 
 #include "p2p.h"
 
-static const int RECOMMENDATION_INTERVAL = 240;
+static const int RECOMMENDATION_INTERVAL_USEC = 4000000;
+static const int DRIFT_UPDATE_INTERVAL_USEC = 1000000 / 6;
+static const int ADAPTIVE_DELAY_INTERVAL_USEC = 1000000;
+static const float ADAPTIVE_DELAY_MIN_LATENESS = 0.5f;
 static const int DEFAULT_DISCONNECT_TIMEOUT = 5000;
 static const int DEFAULT_DISCONNECT_NOTIFY_START = 750;
 
@@ -33,13 +36,21 @@ static void p2p_OnMsg(conn_Address from, UdpMsg* msg, int len, void* user_data);
 
 #ifndef GGPO_STEAM
 
-void p2p_ctor(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char *gamename, uint16 localport, int num_players, int input_size)
+/*
+ * p2p_ctor --
+ *
+ * Binds localport, or attaches to shared under session_id when shared
+ * isn't NULL.
+ */
+void p2p_ctor(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char *gamename, uint16 localport, UdpSocket *shared, uint16 session_id, int num_players, int input_size)
 {
 	p2p->_num_players = num_players;
 	p2p->_input_size = input_size;
 	p2p->_disconnect_timeout = DEFAULT_DISCONNECT_TIMEOUT;
 	p2p->_disconnect_notify_start = DEFAULT_DISCONNECT_NOTIFY_START;
+	p2p->_frame_usec = TIMESYNC_DEFAULT_FRAME_USEC;
 	p2p->_num_spectators = 0;
+	p2p->_max_spectators = GGPO_MAX_SPECTATORS;
 	p2p->_next_spectator_frame = 0;
 
 
@@ -48,6 +59,11 @@ void p2p_ctor(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char *gamen
 	p2p->_header._callbacks = *cb;
 	p2p->_synchronizing = true;
 	p2p->_next_recommended_sleep = 0;
+	p2p->_next_drift_update = 0;
+	p2p->_drift_usec = 0;
+	memset(p2p->_adaptive_delay, 0, sizeof(p2p->_adaptive_delay));
+	memset(p2p->_remote_lateness, 0, sizeof(p2p->_remote_lateness));
+	p2p->_next_delay_update = 0;
 
 	/*
 	 * Initialize the synchronziation layer
@@ -63,14 +79,35 @@ void p2p_ctor(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char *gamen
 	 * Initialize the UDP port
 	 */
 	udp_ctor(&p2p->_udp);
-	udp_Init(&p2p->_udp, localport, p2p_OnMsg, p2p);
+	if (shared) {
+		udp_InitShared(&p2p->_udp, shared, session_id, p2p_OnMsg, p2p);
+	} else {
+		udp_Init(&p2p->_udp, localport, p2p_OnMsg, p2p);
+	}
+
+	/*
+	 * Peers all receive our local input and spectators all receive the
+	 * confirmed input, so each group shares its encoded packets.
+	 */
+	udp_protocol_encode_cache_ctor(&p2p->_endpoint_encode_cache);
+	udp_protocol_encode_cache_ctor(&p2p->_spectator_encode_cache);
 
 	p2p->_endpoints = calloc(p2p->_num_players, sizeof(UdpProtocol));
 	for (int i = 0; i < p2p->_num_players; ++i) {
 		UdpProtocol_ctor(&p2p->_endpoints[i]);
+		UdpProtocol_SetEncodeCache(&p2p->_endpoints[i], &p2p->_endpoint_encode_cache);
 	}
+	/*
+	 * Spectators read the confirmed inputs from a single log, each one
+	 * through its own ack cursor.
+	 */
+	input_log_Init(&p2p->_spectator_log, 0);
+	p2p->_spectator_lag_policy = GGPO_SPECTATOR_LAG_DISCONNECT;
+	p2p->_spectator_max_lag = INPUT_LOG_LENGTH;
 	for (int i = 0; i < ARRAY_SIZE(p2p->_spectators); i++) {
 		UdpProtocol_ctor(&p2p->_spectators[i]);
+		UdpProtocol_SetEncodeCache(&p2p->_spectators[i], &p2p->_spectator_encode_cache);
+		UdpProtocol_SetInputLog(&p2p->_spectators[i], &p2p->_spectator_log);
 	}
 	memset(p2p->_local_connect_status, 0, sizeof(p2p->_local_connect_status));
 	for (int i = 0; i < ARRAY_SIZE(p2p->_local_connect_status); i++) {
@@ -83,36 +120,40 @@ void p2p_ctor(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char *gamen
 	p2p->_header._callbacks.begin_game(gamename);
 }
 
-void p2p_AddRemotePlayer(Peer2PeerBackend *p2p, char* ip, uint16 port, int queue)
+void p2p_AddRemotePlayer(Peer2PeerBackend *p2p, char* ip, uint16 port, uint16 session_id, int queue)
 {
 	p2p->_synchronizing = true;
 
 	ASSERT(conn_support_ip_port());
-	conn_Address peer_addr = conn_address_from_ip_port(ip, port);
+	conn_Address peer_addr = conn_address_from_ip_port(p2p->_udp._socket, ip, port);
 
-	UdpProtocol_Init(&p2p->_endpoints[queue], &p2p->_udp, queue, peer_addr, p2p->_local_connect_status);
+	UdpProtocol_Init(&p2p->_endpoints[queue], &p2p->_udp, queue, peer_addr, p2p->_local_connect_status, p2p->_input_size);
+	UdpProtocol_SetRemoteSession(&p2p->_endpoints[queue], session_id);
 	UdpProtocol_SetDisconnectTimeout(&p2p->_endpoints[queue], p2p->_disconnect_timeout);
 	UdpProtocol_SetDisconnectNotifyStart(&p2p->_endpoints[queue], p2p->_disconnect_notify_start);
+	UdpProtocol_SetFrameDuration(&p2p->_endpoints[queue], p2p->_frame_usec);
 	UdpProtocol_Synchronize(&p2p->_endpoints[queue]);
 }
 
-GGPOErrorCode p2p_AddSpectator(Peer2PeerBackend *p2p, char* ip, uint16 port)
+GGPOErrorCode p2p_AddSpectator(Peer2PeerBackend *p2p, char* ip, uint16 port, uint16 session_id)
 {
-	if (p2p->_num_spectators == GGPO_MAX_SPECTATORS) {
+	if (p2p->_num_spectators == p2p->_max_spectators) {
 		return GGPO_ERRORCODE_TOO_MANY_SPECTATORS;
 	}
-	if (!p2p->_synchronizing) {
-		return GGPO_ERRORCODE_INVALID_REQUEST;
-	}
 	int queue = p2p->_num_spectators++;
 
 	ASSERT(conn_support_ip_port());
-	conn_Address peer_addr = conn_address_from_ip_port(ip, port);
+	conn_Address peer_addr = conn_address_from_ip_port(p2p->_udp._socket, ip, port);
 
-	UdpProtocol_Init(&p2p->_spectators[queue], &p2p->_udp, queue + 1000, peer_addr, p2p->_local_connect_status);
+	UdpProtocol_Init(&p2p->_spectators[queue], &p2p->_udp, queue + 1000, peer_addr, p2p->_local_connect_status, p2p->_input_size * p2p->_num_players);
+	UdpProtocol_SetRemoteSession(&p2p->_spectators[queue], session_id);
 	UdpProtocol_SetDisconnectTimeout(&p2p->_spectators[queue], p2p->_disconnect_timeout);
 	UdpProtocol_SetDisconnectNotifyStart(&p2p->_spectators[queue], p2p->_disconnect_notify_start);
+	UdpProtocol_SetFrameDuration(&p2p->_spectators[queue], p2p->_frame_usec);
 	UdpProtocol_Synchronize(&p2p->_spectators[queue]);
+	if (!p2p->_synchronizing) {
+		p2p_PrepareLateSpectator(p2p, queue);
+	}
 
 	return GGPO_OK;
 }
@@ -125,6 +166,13 @@ void p2p_dtor(Peer2PeerBackend *p2p)
 		UdpProtocol_dtor(&p2p->_endpoints[i]);
 	}
 	free(p2p->_endpoints);
+	for (int i = 0; i < p2p->_num_spectators; i++) {
+		UdpProtocol_dtor(&p2p->_spectators[i]);
+	}
+	input_log_dtor(&p2p->_spectator_log);
+	if (recorder_IsOpen(&p2p->_recorder)) {
+		recorder_Close(&p2p->_recorder);
+	}
 	sync_dtor(&p2p->_sync);
 	udp_dtor(&p2p->_udp);
 }
@@ -143,7 +191,9 @@ void p2p_ctor_steam(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char
 	p2p->_input_size = input_size;
 	p2p->_disconnect_timeout = DEFAULT_DISCONNECT_TIMEOUT;
 	p2p->_disconnect_notify_start = DEFAULT_DISCONNECT_NOTIFY_START;
+	p2p->_frame_usec = TIMESYNC_DEFAULT_FRAME_USEC;
 	p2p->_num_spectators = 0;
+	p2p->_max_spectators = GGPO_MAX_SPECTATORS;
 	p2p->_next_spectator_frame = 0;
 
 	sync_ctor(&p2p->_sync, p2p->_local_connect_status);
@@ -151,6 +201,11 @@ void p2p_ctor_steam(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char
 	p2p->_header._callbacks = *cb;
 	p2p->_synchronizing = true;
 	p2p->_next_recommended_sleep = 0;
+	p2p->_next_drift_update = 0;
+	p2p->_drift_usec = 0;
+	memset(p2p->_adaptive_delay, 0, sizeof(p2p->_adaptive_delay));
+	memset(p2p->_remote_lateness, 0, sizeof(p2p->_remote_lateness));
+	p2p->_next_delay_update = 0;
 
 	/*
 	 * Initialize the synchronization layer
@@ -169,12 +224,29 @@ void p2p_ctor_steam(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char
 	udp_ctor(&p2p->_udp);
 	udp_Init(&p2p->_udp, (uint16)local_channel, p2p_OnMsg, p2p);
 
+	/*
+	 * Peers all receive our local input and spectators all receive the
+	 * confirmed input, so each group shares its encoded packets.
+	 */
+	udp_protocol_encode_cache_ctor(&p2p->_endpoint_encode_cache);
+	udp_protocol_encode_cache_ctor(&p2p->_spectator_encode_cache);
+
 	p2p->_endpoints = calloc(p2p->_num_players, sizeof(UdpProtocol));
 	for (int i = 0; i < p2p->_num_players; ++i) {
 		UdpProtocol_ctor(&p2p->_endpoints[i]);
+		UdpProtocol_SetEncodeCache(&p2p->_endpoints[i], &p2p->_endpoint_encode_cache);
 	}
+	/*
+	 * Spectators read the confirmed inputs from a single log, each one
+	 * through its own ack cursor.
+	 */
+	input_log_Init(&p2p->_spectator_log, 0);
+	p2p->_spectator_lag_policy = GGPO_SPECTATOR_LAG_DISCONNECT;
+	p2p->_spectator_max_lag = INPUT_LOG_LENGTH;
 	for (int i = 0; i < ARRAY_SIZE(p2p->_spectators); i++) {
 		UdpProtocol_ctor(&p2p->_spectators[i]);
+		UdpProtocol_SetEncodeCache(&p2p->_spectators[i], &p2p->_spectator_encode_cache);
+		UdpProtocol_SetInputLog(&p2p->_spectators[i], &p2p->_spectator_log);
 	}
 	memset(p2p->_local_connect_status, 0, sizeof(p2p->_local_connect_status));
 	for (int i = 0; i < ARRAY_SIZE(p2p->_local_connect_status); i++) {
@@ -201,9 +273,10 @@ void p2p_AddRemotePlayerSteam(Peer2PeerBackend *p2p, uint64 steam_id, int queue)
 
 	conn_Address peer_addr = conn_address_from_steam_id(steam_id);
 
-	UdpProtocol_Init(&p2p->_endpoints[queue], &p2p->_udp, queue, peer_addr, p2p->_local_connect_status);
+	UdpProtocol_Init(&p2p->_endpoints[queue], &p2p->_udp, queue, peer_addr, p2p->_local_connect_status, p2p->_input_size);
 	UdpProtocol_SetDisconnectTimeout(&p2p->_endpoints[queue], p2p->_disconnect_timeout);
 	UdpProtocol_SetDisconnectNotifyStart(&p2p->_endpoints[queue], p2p->_disconnect_notify_start);
+	UdpProtocol_SetFrameDuration(&p2p->_endpoints[queue], p2p->_frame_usec);
 	UdpProtocol_Synchronize(&p2p->_endpoints[queue]);
 }
 
@@ -214,21 +287,22 @@ void p2p_AddRemotePlayerSteam(Peer2PeerBackend *p2p, uint64 steam_id, int queue)
  */
 GGPOErrorCode p2p_AddSpectatorSteam(Peer2PeerBackend *p2p, uint64 steam_id)
 {
-	if (p2p->_num_spectators == GGPO_MAX_SPECTATORS) {
+	if (p2p->_num_spectators == p2p->_max_spectators) {
 		return GGPO_ERRORCODE_TOO_MANY_SPECTATORS;
 	}
-	if (!p2p->_synchronizing) {
-		return GGPO_ERRORCODE_INVALID_REQUEST;
-	}
 	int queue = p2p->_num_spectators++;
 
 	conn_add_known_peer(steam_id);
 	conn_Address peer_addr = conn_address_from_steam_id(steam_id);
 
-	UdpProtocol_Init(&p2p->_spectators[queue], &p2p->_udp, queue + 1000, peer_addr, p2p->_local_connect_status);
+	UdpProtocol_Init(&p2p->_spectators[queue], &p2p->_udp, queue + 1000, peer_addr, p2p->_local_connect_status, p2p->_input_size * p2p->_num_players);
 	UdpProtocol_SetDisconnectTimeout(&p2p->_spectators[queue], p2p->_disconnect_timeout);
 	UdpProtocol_SetDisconnectNotifyStart(&p2p->_spectators[queue], p2p->_disconnect_notify_start);
+	UdpProtocol_SetFrameDuration(&p2p->_spectators[queue], p2p->_frame_usec);
 	UdpProtocol_Synchronize(&p2p->_spectators[queue]);
+	if (!p2p->_synchronizing) {
+		p2p_PrepareLateSpectator(p2p, queue);
+	}
 
 	return GGPO_OK;
 }
@@ -272,21 +346,14 @@ p2p_DoPoll(Peer2PeerBackend *p2p, int timeout)
 			if (total_min_confirmed >= 0) {
 				ASSERT(total_min_confirmed != INT_MAX);
 				if (p2p->_num_spectators > 0) {
-					while (p2p->_next_spectator_frame <= total_min_confirmed) {
-						Log("pushing frame %d to spectators.\n", p2p->_next_spectator_frame);
-
-						GameInput input;
-						input.frame = p2p->_next_spectator_frame;
-						input.size = p2p->_input_size * p2p->_num_players;
-						sync_GetConfirmedInputs(&p2p->_sync, input.bits, p2p->_input_size * p2p->_num_players, p2p->_next_spectator_frame);
-						for (int i = 0; i < p2p->_num_spectators; i++) {
-							UdpProtocol_SendInput(&p2p->_spectators[i], &input);
-						}
-						p2p->_next_spectator_frame++;
-					}
+					total_min_confirmed = p2p_PushSpectatorFrames(p2p, total_min_confirmed);
+				}
+				if (recorder_IsOpen(&p2p->_recorder)) {
+					p2p_RecordFrames(p2p, total_min_confirmed);
 				}
 				Log("setting confirmed frame in sync to %d.\n", total_min_confirmed);
 				sync_SetLastConfirmedFrame(&p2p->_sync, total_min_confirmed);
+				p2p_ServeSpectatorStates(p2p);
 			}
 
 			// send timesync notifications if now is the proper time
@@ -301,7 +368,29 @@ p2p_DoPoll(Peer2PeerBackend *p2p, int timeout)
 					info.code = GGPO_EVENTCODE_TIMESYNC;
 					info.u.timesync.frames_ahead = interval;
 					p2p->_header._callbacks.on_event(&info);
-					p2p->_next_recommended_sleep = current_frame + RECOMMENDATION_INTERVAL;
+					p2p->_next_recommended_sleep = current_frame + p2p_FramesIn(p2p, RECOMMENDATION_INTERVAL_USEC);
+				}
+			}
+
+			if (current_frame >= p2p->_next_delay_update) {
+				p2p_UpdateAdaptiveDelay(p2p);
+				p2p->_next_delay_update = current_frame + p2p_FramesIn(p2p, ADAPTIVE_DELAY_INTERVAL_USEC);
+			}
+
+			// the drift correction is continuous, so only report it when it changes
+			if (current_frame >= p2p->_next_drift_update) {
+				int drift = 0;
+				for (int i = 0; i < p2p->_num_players; i++) {
+					drift = MAX(drift, UdpProtocol_RecommendDrift(&p2p->_endpoints[i]));
+				}
+				p2p->_next_drift_update = current_frame + p2p_FramesIn(p2p, DRIFT_UPDATE_INTERVAL_USEC);
+
+				if (drift != p2p->_drift_usec) {
+					GGPOEvent info;
+					info.code = GGPO_EVENTCODE_TIMESYNC_DRIFT;
+					info.u.timesync_drift.usec_per_frame = drift;
+					p2p->_header._callbacks.on_event(&info);
+					p2p->_drift_usec = drift;
 				}
 			}
 			// XXX: this is obviously a farce...
@@ -310,10 +399,184 @@ p2p_DoPoll(Peer2PeerBackend *p2p, int timeout)
 				// Sleep(1);
 			}
 		}
+
+		// everything this poll had to say to a peer goes out in one datagram
+		for (int i = 0; i < p2p->_num_players; i++) {
+			UdpProtocol_Flush(&p2p->_endpoints[i]);
+		}
+		for (int i = 0; i < p2p->_num_spectators; i++) {
+			UdpProtocol_Flush(&p2p->_spectators[i]);
+		}
 	}
 	return GGPO_OK;
 }
 
+/*
+ * p2p_PushSpectatorFrames --
+ *
+ * Append the newly confirmed frames to the spectator log and send them out.
+ * Returns the frame the sync layer may consider confirmed: frames which have
+ * not made it into the log yet must stay in the input queues.
+ */
+int p2p_PushSpectatorFrames(Peer2PeerBackend *p2p, int total_min_confirmed)
+{
+	int backlog = p2p_GetSpectatorBacklog(p2p);
+
+	if (p2p->_spectator_lag_policy != GGPO_SPECTATOR_LAG_THROTTLE && backlog >= p2p->_spectator_max_lag) {
+		for (int i = 0; i < p2p->_num_spectators; i++) {
+			if (UdpProtocol_IsInitialized(&p2p->_spectators[i]) && !UdpProtocol_IsDisconnected(&p2p->_spectators[i]) &&
+				UdpProtocol_GetPendingOutputCount(&p2p->_spectators[i]) >= p2p->_spectator_max_lag) {
+				if (p2p->_spectator_lag_policy == GGPO_SPECTATOR_LAG_SNAPSHOT) {
+					/*
+					 * Drop its place in the log and send it a state, like
+					 * a spectator joining now (see p2p_ServeSpectatorStates).
+					 */
+					Log("spectator %d is %d frames behind.  Sending it a state.\n", i, UdpProtocol_GetPendingOutputCount(&p2p->_spectators[i]));
+					UdpProtocol_RequireState(&p2p->_spectators[i]);
+				}
+				else {
+					Log("spectator %d is %d frames behind.  Disconnecting.\n", i, UdpProtocol_GetPendingOutputCount(&p2p->_spectators[i]));
+					p2p_DisconnectSpectator(p2p, i);
+				}
+			}
+		}
+		backlog = p2p_GetSpectatorBacklog(p2p);
+	}
+
+	while (p2p->_next_spectator_frame <= total_min_confirmed && !input_log_IsFull(&p2p->_spectator_log)) {
+		if (p2p->_spectator_lag_policy == GGPO_SPECTATOR_LAG_THROTTLE && backlog >= p2p->_spectator_max_lag) {
+			Log("throttling: spectators are %d frames behind.\n", backlog);
+			break;
+		}
+		Log("pushing frame %d to spectators.\n", p2p->_next_spectator_frame);
+
+		GameInput input;
+		input.frame = p2p->_next_spectator_frame;
+		input.size = p2p->_input_size * p2p->_num_players;
+		sync_GetConfirmedInputs(&p2p->_sync, input.bits, p2p->_input_size * p2p->_num_players, p2p->_next_spectator_frame);
+		input_log_Append(&p2p->_spectator_log, &input);
+		for (int i = 0; i < p2p->_num_spectators; i++) {
+			UdpProtocol_SendInput(&p2p->_spectators[i], &input);
+		}
+		p2p->_next_spectator_frame++;
+		backlog++;
+	}
+	return MIN(total_min_confirmed, p2p->_next_spectator_frame);
+}
+
+/*
+ * p2p_PrepareLateSpectator --
+ *
+ * A spectator added once the game has started is sent a saved state instead
+ * of every input since frame 0.  Its input stream is held back until
+ * p2p_ServeSpectatorStates picks that state.
+ */
+void p2p_PrepareLateSpectator(Peer2PeerBackend *p2p, int queue)
+{
+	/*
+	 * If nobody was watching, the confirmed inputs were never logged.  Restart
+	 * the spectator stream from the last confirmed frame, which the input
+	 * queues still hold.
+	 */
+	if (input_log_GetLength(&p2p->_spectator_log) == 0 && p2p->_next_spectator_frame < p2p->_sync._last_confirmed_frame) {
+		p2p->_next_spectator_frame = p2p->_sync._last_confirmed_frame;
+		input_log_Init(&p2p->_spectator_log, p2p->_next_spectator_frame);
+	}
+	UdpProtocol_RequireState(&p2p->_spectators[queue]);
+}
+
+/*
+ * p2p_ServeSpectatorStates --
+ *
+ * Start the state transfer of the late spectators which are done
+ * synchronizing.  The state must only depend on inputs already pushed to the
+ * spectators, which are all confirmed, and the inputs from its frame onward
+ * must still be in the log.
+ */
+void p2p_ServeSpectatorStates(Peer2PeerBackend *p2p)
+{
+	for (int i = 0; i < p2p->_num_spectators; i++) {
+		UdpProtocol* spectator = &p2p->_spectators[i];
+		if (!UdpProtocol_NeedsState(spectator) || !UdpProtocol_IsRunning(spectator)) {
+			continue;
+		}
+		sync_SavedFrame* state = sync_FindSavedFrame(&p2p->_sync, p2p->_spectator_log._first_frame, p2p->_next_spectator_frame);
+		if (!state) {
+			Log("no saved state between frames %d and %d for spectator %d yet.\n", p2p->_spectator_log._first_frame, p2p->_next_spectator_frame, i);
+			continue;
+		}
+		UdpProtocol_SendState(spectator, state->frame, state->buf, state->cbuf);
+	}
+}
+
+/*
+ * p2p_RecordFrames --
+ *
+ * Hand the newly confirmed inputs to the recorder, along with the saved
+ * state of the frames which need a keyframe.  This runs before the sync
+ * layer discards them, like p2p_PushSpectatorFrames.
+ */
+void p2p_RecordFrames(Peer2PeerBackend *p2p, int total_min_confirmed)
+{
+	Recorder *rec = &p2p->_recorder;
+
+	while (recorder_GetNextFrame(rec) <= total_min_confirmed) {
+		int frame = recorder_GetNextFrame(rec);
+		if (recorder_NeedsKeyframe(rec, frame)) {
+			sync_SavedFrame *state = sync_FindSavedFrame(&p2p->_sync, frame, frame);
+			if (state) {
+				recorder_AddKeyframe(rec, frame, state->buf, state->cbuf, state->checksum);
+			} else if (!recorder_HasKeyframe(rec)) {
+				recorder_SkipFrame(rec);
+				continue;
+			}
+		}
+
+		GameInput input;
+		input.frame = frame;
+		input.size = p2p->_input_size * p2p->_num_players;
+		sync_GetConfirmedInputs(&p2p->_sync, input.bits, input.size, frame);
+		recorder_AddInput(rec, &input);
+	}
+}
+
+GGPOErrorCode p2p_StartRecording(Peer2PeerBackend *p2p, const char *filename, int keyframe_interval)
+{
+	if (keyframe_interval < 1 || recorder_IsOpen(&p2p->_recorder)) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	/*
+	 * Frames up to the last confirmed one may already be gone from the
+	 * input queues, so start right after it.
+	 */
+	int first_frame = p2p->_sync._last_confirmed_frame + 1;
+	return recorder_Open(&p2p->_recorder, filename, p2p->_num_players, p2p->_input_size, keyframe_interval, first_frame);
+}
+
+GGPOErrorCode p2p_StopRecording(Peer2PeerBackend *p2p)
+{
+	if (!recorder_IsOpen(&p2p->_recorder)) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	return recorder_Close(&p2p->_recorder);
+}
+
+int p2p_GetSpectatorBacklog(Peer2PeerBackend *p2p)
+{
+	return UdpProtocol_TrimInputLog(&p2p->_spectator_log, p2p->_spectators, p2p->_num_spectators);
+}
+
+void p2p_DisconnectSpectator(Peer2PeerBackend *p2p, int queue)
+{
+	GGPOEvent info;
+
+	UdpProtocol_Disconnect(&p2p->_spectators[queue]);
+
+	info.code = GGPO_EVENTCODE_DISCONNECTED_FROM_PEER;
+	info.u.disconnected.player = p2p_QueueToSpectatorHandle(p2p, queue);
+	p2p->_header._callbacks.on_event(&info);
+}
+
 int p2p_Poll2Players(Peer2PeerBackend *p2p, int current_frame)
 {
 	int i;
@@ -396,7 +659,7 @@ p2p_AddPlayer(Peer2PeerBackend *p2p, GGPOPlayer* player,
 #if defined(GGPO_STEAM)
 		return p2p_AddSpectatorSteam(p2p, player->u.steam_remote.steam_id);
 #else
-		return p2p_AddSpectator(p2p, player->u.remote.ip_address, player->u.remote.port);
+		return p2p_AddSpectator(p2p, player->u.remote.ip_address, player->u.remote.port, player->u.remote.session_id);
 #endif
 	}
 
@@ -410,7 +673,7 @@ p2p_AddPlayer(Peer2PeerBackend *p2p, GGPOPlayer* player,
 #if defined(GGPO_STEAM)
 		p2p_AddRemotePlayerSteam(p2p, player->u.steam_remote.steam_id, queue);
 #else
-		p2p_AddRemotePlayer(p2p, player->u.remote.ip_address, player->u.remote.port, queue);
+		p2p_AddRemotePlayer(p2p, player->u.remote.ip_address, player->u.remote.port, player->u.remote.session_id, queue);
 #endif
 	}
 	return GGPO_OK;
@@ -439,23 +702,51 @@ p2p_AddLocalInput(Peer2PeerBackend *p2p, GGPOPlayerHandle player,
 
 	gameinput_init(&input, -1, (char*)values, size);
 
+	// Lowering the frame delay drops this input, so only do it when the
+	// input repeats the last one and nothing is lost.
+	int delay = sync_GetFrameDelay(&p2p->_sync, queue);
+	bool shrink = p2p->_adaptive_delay[queue].enabled && p2p->_adaptive_delay[queue].target < delay &&
+		sync_IsRepeatedInput(&p2p->_sync, queue, &input);
+	if (shrink) {
+		sync_SetFrameDelay(&p2p->_sync, queue, delay - 1);
+	}
+
 	// Feed the input for the current frame into the synchronzation layer.
 	if (!sync_AddLocalInput(&p2p->_sync, queue, &input)) {
+		if (shrink) {
+			sync_SetFrameDelay(&p2p->_sync, queue, delay);
+		}
 		return GGPO_ERRORCODE_PREDICTION_THRESHOLD;
 	}
+	if (shrink) {
+		p2p_OnFrameDelayChanged(p2p, queue);
+	}
 
 	if (input.frame != GAMEINPUT_NULL_FRAME) { // xxx: <- comment why this is the case
 		// Update the local connect status state to indicate that we've got a
 		// confirmed local frame for this player.  this must come first so it
 		// gets incorporated into the next packet we send.
 
-		Log("setting local connect status for local queue %d to %d", queue, input.frame);
-		p2p->_local_connect_status[queue].last_frame = input.frame;
+		// Raising the frame delay mid game pads the queue with copies of
+		// the last input, which the remote players need as well.
+		int last_frame = p2p->_local_connect_status[queue].last_frame;
+		int frame = last_frame == GAMEINPUT_NULL_FRAME ? input.frame : last_frame + 1;
+		for (; frame <= input.frame; frame++) {
+			GameInput padding;
+			GameInput* next = &input;
+			if (frame < input.frame) {
+				sync_GetQueuedInput(&p2p->_sync, queue, frame, &padding);
+				next = &padding;
+			}
 
-		// Send the input to all the remote players.
-		for (int i = 0; i < p2p->_num_players; i++) {
-			if (UdpProtocol_IsInitialized(&p2p->_endpoints[i])) {
-				UdpProtocol_SendInput(&p2p->_endpoints[i], &input);
+			Log("setting local connect status for local queue %d to %d", queue, frame);
+			p2p->_local_connect_status[queue].last_frame = frame;
+
+			// Send the input to all the remote players.
+			for (int i = 0; i < p2p->_num_players; i++) {
+				if (UdpProtocol_IsInitialized(&p2p->_endpoints[i])) {
+					UdpProtocol_SendInput(&p2p->_endpoints[i], next);
+				}
 			}
 		}
 	}
@@ -531,6 +822,11 @@ p2p_OnUdpProtocolPeerEvent(Peer2PeerBackend *p2p, udp_protocol_Event* evt, int q
 			int new_remote_frame = evt->u.input.input.frame;
 			ASSERT(current_remote_frame == -1 || new_remote_frame == (current_remote_frame + 1));
 
+			// How many frames ago we would have needed this input.  That's
+			// how deep the rollback is when we predicted it wrong.
+			int lateness = MAX(sync_GetFrameCount(&p2p->_sync) - new_remote_frame, 0);
+			p2p->_remote_lateness[queue] += (lateness - p2p->_remote_lateness[queue]) / 16;
+
 			sync_AddRemoteInput(&p2p->_sync, queue, &evt->u.input.input);
 			// Notify the other endpoints which frame we received from a peer
 			Log("setting remote connect status for queue %d to %d\n", queue, evt->u.input.input.frame);
@@ -549,6 +845,7 @@ p2p_OnUdpProtocolPeerEvent(Peer2PeerBackend *p2p, udp_protocol_Event* evt, int q
 	case UdpProtocol_Event_Synchronzied:
 	case UdpProtocol_Event_NetworkInterrupted:
 	case UdpProtocol_Event_NetworkResumed:
+	case UdpProtocol_Event_State:
 		break;
 	}
 }
@@ -560,14 +857,8 @@ p2p_OnUdpProtocolSpectatorEvent(Peer2PeerBackend *p2p, udp_protocol_Event* evt,
 	GGPOPlayerHandle handle = p2p_QueueToSpectatorHandle(p2p, queue);
 	p2p_OnUdpProtocolEvent(p2p, evt, handle);
 
-	GGPOEvent info;
-
 	if (evt->type == UdpProtocol_Event_Disconnected) {
-		UdpProtocol_Disconnect(&p2p->_spectators[queue]);
-
-		info.code = GGPO_EVENTCODE_DISCONNECTED_FROM_PEER;
-		info.u.disconnected.player = handle;
-		p2p->_header._callbacks.on_event(&info);
+		p2p_DisconnectSpectator(p2p, queue);
 	}
 }
 
@@ -609,6 +900,10 @@ p2p_OnUdpProtocolEvent(Peer2PeerBackend *p2p, udp_protocol_Event* evt, GGPOPlaye
 		info.u.connection_resumed.player = handle;
 		p2p->_header._callbacks.on_event(&info);
 		break;
+	case UdpProtocol_Event_State:
+		// Only spectators are sent states.
+		free(evt->u.state.buf);
+		break;
 	case UdpProtocol_Event_Unknown:
 	case UdpProtocol_Event_Input:
 	case UdpProtocol_Event_Disconnected:
@@ -689,13 +984,21 @@ p2p_GetNetworkStats(Peer2PeerBackend *p2p, GGPONetworkStats* stats, GGPOPlayerHa
 	int queue;
 	GGPOErrorCode result;
 
+	memset(stats, 0, sizeof * stats);
+
+	queue = (int)player - 1000;
+	if (queue >= 0 && queue < p2p->_num_spectators) {
+		UdpProtocol_GetNetworkStats(&p2p->_spectators[queue], stats);
+		return GGPO_OK;
+	}
+
 	result = p2p_PlayerHandleToQueue(p2p, player, &queue);
 	if (!GGPO_SUCCEEDED(result)) {
 		return result;
 	}
 
-	memset(stats, 0, sizeof * stats);
 	UdpProtocol_GetNetworkStats(&p2p->_endpoints[queue], stats);
+	sync_GetPredictionStats(&p2p->_sync, queue, stats);
 
 	return GGPO_OK;
 }
@@ -711,6 +1014,186 @@ p2p_SetFrameDelay(Peer2PeerBackend *p2p, GGPOPlayerHandle player, int delay)
 		return result;
 	}
 	sync_SetFrameDelay(&p2p->_sync, queue, delay);
+	p2p->_adaptive_delay[queue].enabled = false;
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+p2p_SetInputPredictor(Peer2PeerBackend *p2p, GGPOPlayerHandle player, GGPOInputPredictor predictor, const void *release_mask, int size)
+{
+	int queue;
+	GGPOErrorCode result;
+
+	switch (predictor) {
+	case GGPO_PREDICTOR_REPEAT_LAST:
+	case GGPO_PREDICTOR_MARKOV:
+		break;
+	case GGPO_PREDICTOR_RELEASE_BUTTONS:
+		if (!release_mask || size <= 0 || size > p2p->_input_size) {
+			return GGPO_ERRORCODE_INVALID_REQUEST;
+		}
+		break;
+	case GGPO_PREDICTOR_CALLBACK:
+		if (!p2p->_header._callbacks.predict_input) {
+			return GGPO_ERRORCODE_INVALID_REQUEST;
+		}
+		break;
+	default:
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	result = p2p_PlayerHandleToQueue(p2p, player, &queue);
+	if (!GGPO_SUCCEEDED(result)) {
+		return result;
+	}
+	sync_SetInputPredictor(&p2p->_sync, queue, predictor, release_mask, size, player);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+p2p_SetInputRelevance(Peer2PeerBackend *p2p, GGPOPlayerHandle player, const void *mask, int size)
+{
+	int queue;
+	GGPOErrorCode result;
+
+	if (mask && (size <= 0 || size > p2p->_input_size)) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	result = p2p_PlayerHandleToQueue(p2p, player, &queue);
+	if (!GGPO_SUCCEEDED(result)) {
+		return result;
+	}
+	sync_SetInputRelevance(&p2p->_sync, queue, mask, size);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+p2p_SetAdaptiveFrameDelay(Peer2PeerBackend *p2p, GGPOPlayerHandle player, int min_delay, int max_delay)
+{
+	int queue;
+	GGPOErrorCode result;
+
+	if (min_delay < 0 || max_delay < min_delay) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	result = p2p_PlayerHandleToQueue(p2p, player, &queue);
+	if (!GGPO_SUCCEEDED(result)) {
+		return result;
+	}
+	if (UdpProtocol_IsInitialized(&p2p->_endpoints[queue])) {
+		// only the delay of local players can be changed
+		return GGPO_ERRORCODE_INVALID_PLAYER_HANDLE;
+	}
+
+	p2p_AdaptiveDelay *adaptive = &p2p->_adaptive_delay[queue];
+	int delay = sync_GetFrameDelay(&p2p->_sync, queue);
+	adaptive->enabled = true;
+	adaptive->min_delay = min_delay;
+	adaptive->max_delay = max_delay;
+	adaptive->target = MAX(min_delay, MIN(delay, max_delay));
+
+	// Before the first input nothing needs to be padded or dropped.
+	if (adaptive->target > delay || (adaptive->target < delay && sync_GetFrameCount(&p2p->_sync) == 0)) {
+		sync_SetFrameDelay(&p2p->_sync, queue, adaptive->target);
+		p2p_OnFrameDelayChanged(p2p, queue);
+	}
+	return GGPO_OK;
+}
+
+/*
+ * p2p_UpdateAdaptiveDelay --
+ *
+ * Pick a new frame delay for the local players which asked for one with
+ * ggpo_set_adaptive_frame_delay.  The delay should cover the one way trip
+ * to the slowest peer plus some margin for jitter, but it is only raised
+ * when the inputs of our peers actually arrive late enough to roll back.
+ * It moves one frame at a time.  Raising it repeats the last local input
+ * once, which happens right away.  Lowering it drops a local input, which
+ * waits for one that repeats the last (see p2p_AddLocalInput).
+ */
+void
+p2p_UpdateAdaptiveDelay(Peer2PeerBackend *p2p)
+{
+	float needed = 0, lateness = 0;
+	int ping = 0, jitter = 0;
+
+	for (int i = 0; i < p2p->_num_players; i++) {
+		UdpProtocol *endpoint = &p2p->_endpoints[i];
+		if (!UdpProtocol_IsInitialized(endpoint) || !UdpProtocol_IsRunning(endpoint) || p2p->_local_connect_status[i].disconnected) {
+			continue;
+		}
+		RttEstimator *rtt = UdpProtocol_GetRtt(endpoint);
+		float frames = (rtt_get_srtt(rtt) / 2 + 2 * rtt_get_rttvar(rtt)) / (float)p2p->_frame_usec;
+		if (frames > needed) {
+			needed = frames;
+			ping = rtt_get_srtt(rtt) / 1000;
+			jitter = rtt_get_rttvar(rtt) / 1000;
+		}
+		lateness = MAX(lateness, p2p->_remote_lateness[i]);
+	}
+
+	for (int i = 0; i < p2p->_num_players; i++) {
+		p2p_AdaptiveDelay *adaptive = &p2p->_adaptive_delay[i];
+		if (!adaptive->enabled) {
+			continue;
+		}
+		int delay = sync_GetFrameDelay(&p2p->_sync, i);
+		int target = delay;
+		if (needed > delay + 0.25f && lateness >= ADAPTIVE_DELAY_MIN_LATENESS) {
+			target = delay + 1;
+		}
+		else if (needed < delay - 0.75f) {
+			target = delay - 1;
+		}
+		adaptive->target = MAX(adaptive->min_delay, MIN(target, adaptive->max_delay));
+		adaptive->ping = ping;
+		adaptive->jitter = jitter;
+		adaptive->lateness = lateness;
+		Log("adaptive delay for queue %d: %d -> %d (needed %.2f frames, late by %.2f).\n", i, delay, adaptive->target, needed, lateness);
+
+		if (adaptive->target > delay) {
+			sync_SetFrameDelay(&p2p->_sync, i, adaptive->target);
+			p2p_OnFrameDelayChanged(p2p, i);
+		}
+	}
+}
+
+void
+p2p_OnFrameDelayChanged(Peer2PeerBackend *p2p, int queue)
+{
+	p2p_AdaptiveDelay *adaptive = &p2p->_adaptive_delay[queue];
+	GGPOEvent info;
+
+	info.code = GGPO_EVENTCODE_FRAME_DELAY_CHANGED;
+	info.u.frame_delay_changed.player = p2p_QueueToPlayerHandle(p2p, queue);
+	info.u.frame_delay_changed.frame_delay = sync_GetFrameDelay(&p2p->_sync, queue);
+	info.u.frame_delay_changed.ping = adaptive->ping;
+	info.u.frame_delay_changed.jitter = adaptive->jitter;
+	info.u.frame_delay_changed.rollback_frames = (int)(adaptive->lateness + 0.5f);
+	p2p->_header._callbacks.on_event(&info);
+}
+
+/*
+ * p2p_SetFrameDuration --
+ *
+ * The timesync windows, the frame advantage estimates and the intervals
+ * between the timesync and frame delay updates are all kept in frames,
+ * so they are derived from the frame duration.
+ */
+GGPOErrorCode
+p2p_SetFrameDuration(Peer2PeerBackend *p2p, int usec)
+{
+	if (usec <= 0) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	p2p->_frame_usec = usec;
+	for (int i = 0; i < p2p->_num_players; i++) {
+		if (UdpProtocol_IsInitialized(&p2p->_endpoints[i])) {
+			UdpProtocol_SetFrameDuration(&p2p->_endpoints[i], p2p->_frame_usec);
+		}
+	}
+	for (int i = 0; i < p2p->_num_spectators; i++) {
+		UdpProtocol_SetFrameDuration(&p2p->_spectators[i], p2p->_frame_usec);
+	}
 	return GGPO_OK;
 }
 
@@ -738,6 +1221,40 @@ p2p_SetDisconnectNotifyStart(Peer2PeerBackend *p2p, int timeout)
 	return GGPO_OK;
 }
 
+GGPOErrorCode
+p2p_SetSpectatorLagPolicy(Peer2PeerBackend *p2p, GGPOSpectatorLagPolicy policy, int max_lag_frames)
+{
+	if (policy < GGPO_SPECTATOR_LAG_DISCONNECT || policy > GGPO_SPECTATOR_LAG_SNAPSHOT ||
+		max_lag_frames <= 0 || max_lag_frames > INPUT_LOG_LENGTH) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	p2p->_spectator_lag_policy = policy;
+	p2p->_spectator_max_lag = max_lag_frames;
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+p2p_SetSpectatorFanout(Peer2PeerBackend *p2p, int max_spectators)
+{
+	if (max_spectators < p2p->_num_spectators || max_spectators > GGPO_MAX_SPECTATORS) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	p2p->_max_spectators = max_spectators;
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+p2p_SetPathMtu(Peer2PeerBackend *p2p, int mtu)
+{
+	for (int i = 0; i < p2p->_num_players; i++) {
+		UdpProtocol_SetPathMtu(&p2p->_endpoints[i], mtu);
+	}
+	for (int i = 0; i < ARRAY_SIZE(p2p->_spectators); i++) {
+		UdpProtocol_SetPathMtu(&p2p->_spectators[i], mtu);
+	}
+	return GGPO_OK;
+}
+
 GGPOErrorCode
 p2p_PlayerHandleToQueue(Peer2PeerBackend *p2p, GGPOPlayerHandle player, int* queue)
 {
@@ -28,10 +28,26 @@
 #include "sync.h"
 #include "backend.h"
 #include "timesync.h"
+#include "recorder.h"
 #include "network/udp_proto.h"
 
 struct UdpMsg;
 
+/*
+ * Automatic frame delay of a local player, see p2p_UpdateAdaptiveDelay.
+ * The measurements the last decision was made on are kept to report it.
+ */
+struct p2p_AdaptiveDelay {
+   bool                  enabled;
+   int                   min_delay;
+   int                   max_delay;
+   int                   target;
+   int                   ping;
+   int                   jitter;
+   float                 lateness;
+};
+typedef struct p2p_AdaptiveDelay p2p_AdaptiveDelay;
+
 struct Peer2PeerBackend {
 	GGPOSessionHeader _header;
 
@@ -40,15 +56,32 @@ struct Peer2PeerBackend {
    UdpProtocol           *_endpoints;
    UdpProtocol           _spectators[GGPO_MAX_SPECTATORS];
    int                   _num_spectators;
+   int                   _max_spectators;
    int                   _input_size;
 
+   udp_protocol_EncodeCache _endpoint_encode_cache;
+   udp_protocol_EncodeCache _spectator_encode_cache;
+
+   InputLog              _spectator_log;
+   GGPOSpectatorLagPolicy _spectator_lag_policy;
+   int                   _spectator_max_lag;
+
+   Recorder              _recorder;
+
    bool                  _synchronizing;
    int                   _num_players;
    int                   _next_recommended_sleep;
+   int                   _next_drift_update;
+   int                   _drift_usec;
+
+   p2p_AdaptiveDelay     _adaptive_delay[UDP_MSG_MAX_PLAYERS];
+   float                 _remote_lateness[UDP_MSG_MAX_PLAYERS];
+   int                   _next_delay_update;
 
    int                   _next_spectator_frame;
    int                   _disconnect_timeout;
    int                   _disconnect_notify_start;
+   int                   _frame_usec;
 
    UdpMsg_connect_status _local_connect_status[UDP_MSG_MAX_PLAYERS];
 };
@@ -60,9 +93,9 @@ void p2p_ctor_steam(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char
 void p2p_AddRemotePlayerSteam(Peer2PeerBackend *p2p, uint64 steam_id, int queue);
 GGPOErrorCode p2p_AddSpectatorSteam(Peer2PeerBackend *p2p, uint64 steam_id);
 #else
-void p2p_ctor(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char *gamename, uint16 localport, int num_players, int input_size);
-void p2p_AddRemotePlayer(Peer2PeerBackend *p2p, char *remoteip, uint16 reportport, int queue);
-GGPOErrorCode p2p_AddSpectator(Peer2PeerBackend *p2p, char *remoteip, uint16 reportport);
+void p2p_ctor(Peer2PeerBackend *p2p, GGPOSessionCallbacks *cb, const char *gamename, uint16 localport, UdpSocket *shared, uint16 session_id, int num_players, int input_size);
+void p2p_AddRemotePlayer(Peer2PeerBackend *p2p, char *remoteip, uint16 reportport, uint16 session_id, int queue);
+GGPOErrorCode p2p_AddSpectator(Peer2PeerBackend *p2p, char *remoteip, uint16 reportport, uint16 session_id);
 #endif
 
 void p2p_dtor(Peer2PeerBackend *p2p);
@@ -75,19 +108,37 @@ GGPOErrorCode p2p_IncrementFrame(Peer2PeerBackend *p2p);
 GGPOErrorCode p2p_DisconnectPlayer(Peer2PeerBackend *p2p, GGPOPlayerHandle handle);
 GGPOErrorCode p2p_GetNetworkStats(Peer2PeerBackend *p2p, GGPONetworkStats *stats, GGPOPlayerHandle handle);
 GGPOErrorCode p2p_SetFrameDelay(Peer2PeerBackend *p2p, GGPOPlayerHandle player, int delay);
+GGPOErrorCode p2p_SetAdaptiveFrameDelay(Peer2PeerBackend *p2p, GGPOPlayerHandle player, int min_delay, int max_delay);
+GGPOErrorCode p2p_SetFrameDuration(Peer2PeerBackend *p2p, int usec);
+GGPOErrorCode p2p_SetInputPredictor(Peer2PeerBackend *p2p, GGPOPlayerHandle player, GGPOInputPredictor predictor, const void *release_mask, int size);
+GGPOErrorCode p2p_SetInputRelevance(Peer2PeerBackend *p2p, GGPOPlayerHandle player, const void *mask, int size);
 GGPOErrorCode p2p_SetDisconnectTimeout(Peer2PeerBackend *p2p, int timeout);
 GGPOErrorCode p2p_SetDisconnectNotifyStart(Peer2PeerBackend *p2p, int timeout);
+GGPOErrorCode p2p_SetSpectatorLagPolicy(Peer2PeerBackend *p2p, GGPOSpectatorLagPolicy policy, int max_lag_frames);
+GGPOErrorCode p2p_SetSpectatorFanout(Peer2PeerBackend *p2p, int max_spectators);
+GGPOErrorCode p2p_SetPathMtu(Peer2PeerBackend *p2p, int mtu);
+GGPOErrorCode p2p_StartRecording(Peer2PeerBackend *p2p, const char *filename, int keyframe_interval);
+GGPOErrorCode p2p_StopRecording(Peer2PeerBackend *p2p);
 
 GGPOErrorCode p2p_PlayerHandleToQueue(Peer2PeerBackend *p2p, GGPOPlayerHandle player, int *queue);
-inline GGPOPlayerHandle p2p_QueueToPlayerHandle(Peer2PeerBackend *p2p, int queue) { return (GGPOPlayerHandle)(queue + 1); }
-inline GGPOPlayerHandle p2p_QueueToSpectatorHandle(Peer2PeerBackend *p2p, int queue) { return (GGPOPlayerHandle)(queue + 1000); }
+static inline GGPOPlayerHandle p2p_QueueToPlayerHandle(Peer2PeerBackend *p2p, int queue) { return (GGPOPlayerHandle)(queue + 1); }
+static inline GGPOPlayerHandle p2p_QueueToSpectatorHandle(Peer2PeerBackend *p2p, int queue) { return (GGPOPlayerHandle)(queue + 1000); }
 void p2p_DisconnectPlayerQueue(Peer2PeerBackend *p2p, int queue, int syncto);
 void p2p_PollSyncEvents(Peer2PeerBackend *p2p);
+int p2p_PushSpectatorFrames(Peer2PeerBackend *p2p, int total_min_confirmed);
+int p2p_GetSpectatorBacklog(Peer2PeerBackend *p2p);
+void p2p_RecordFrames(Peer2PeerBackend *p2p, int total_min_confirmed);
+void p2p_DisconnectSpectator(Peer2PeerBackend *p2p, int queue);
+void p2p_PrepareLateSpectator(Peer2PeerBackend *p2p, int queue);
+void p2p_ServeSpectatorStates(Peer2PeerBackend *p2p);
 void p2p_PollUdpProtocolEvents(Peer2PeerBackend *p2p);
 void p2p_CheckInitialSync(Peer2PeerBackend *p2p);
+void p2p_UpdateAdaptiveDelay(Peer2PeerBackend *p2p);
+void p2p_OnFrameDelayChanged(Peer2PeerBackend *p2p, int queue);
+static inline int p2p_FramesIn(Peer2PeerBackend *p2p, int usec) { return MAX(1, usec / p2p->_frame_usec); }
 int p2p_Poll2Players(Peer2PeerBackend *p2p, int current_frame);
 int p2p_PollNPlayers(Peer2PeerBackend *p2p, int current_frame);
-inline void p2p_OnSyncEvent(Peer2PeerBackend *p2p, sync_Event *e) { }
+static inline void p2p_OnSyncEvent(Peer2PeerBackend *p2p, sync_Event *e) { }
 void p2p_OnUdpProtocolEvent(Peer2PeerBackend *p2p, udp_protocol_Event *e, GGPOPlayerHandle handle);
 void p2p_OnUdpProtocolPeerEvent(Peer2PeerBackend *p2p, udp_protocol_Event *e, int queue);
 void p2p_OnUdpProtocolSpectatorEvent(Peer2PeerBackend *p2p, udp_protocol_Event *e, int queue);
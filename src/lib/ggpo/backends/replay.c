@@ -0,0 +1,332 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#include "replay.h"
+#include "compress.h"
+
+GGPOErrorCode replay_ctor(ReplayBackend *replay, GGPOSessionCallbacks *cb, const char *gamename, const char *filename, int num_players, int input_size)
+{
+	replay->_header._session_type = SESSION_REPLAY;
+   replay->_header._callbacks = *cb;
+   replay->_num_players = num_players;
+   replay->_input_size = input_size;
+   replay->_framecount = 0;
+   replay->_running = false;
+   replay->_ended = false;
+
+   replay->_data = Platform_MapFile(filename, &replay->_size);
+   if (!replay->_data) {
+      Log("failed to open replay file %s.\n", filename);
+      return GGPO_ERRORCODE_GENERAL_FAILURE;
+   }
+   if (!replay_Validate(replay)) {
+      Log("%s is not a valid replay file.\n", filename);
+      replay_dtor(replay);
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   if (replay->_file_header->num_players != (uint32)num_players || replay->_file_header->input_size != (uint32)input_size) {
+      Log("replay file %s has %d players with %d byte inputs (expected %d players with %d byte inputs).\n", filename,
+          replay->_file_header->num_players, replay->_file_header->input_size, num_players, input_size);
+      replay_dtor(replay);
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   Log("opened replay file %s (frames %d to %d, %d keyframes).\n", filename, replay->_trailer->first_frame, replay->_trailer->end_frame, replay->_index_size);
+
+   /*
+    * Preload the ROM
+    */
+   replay->_header._callbacks.begin_game(gamename);
+   return GGPO_OK;
+}
+
+void replay_dtor(ReplayBackend *replay)
+{
+   if (replay->_data) {
+      Platform_UnmapFile(replay->_data, replay->_size);
+      replay->_data = NULL;
+   }
+}
+
+/*
+ * replay_Validate --
+ *
+ * Check the header, the trailer and the index before trusting any offset
+ * read from the file.  Input chunks are checked as they are read.
+ */
+bool
+replay_Validate(ReplayBackend *replay)
+{
+   if (replay->_size < sizeof(ReplayFileHeader) + sizeof(ReplayFileTrailer) || replay->_size % REPLAY_FILE_ALIGNMENT) {
+      return false;
+   }
+   replay->_file_header = (ReplayFileHeader *)replay->_data;
+   replay->_trailer = (ReplayFileTrailer *)(replay->_data + replay->_size - sizeof(ReplayFileTrailer));
+
+   ReplayFileHeader *hdr = replay->_file_header;
+   if (memcmp(hdr->magic, REPLAY_FILE_MAGIC, sizeof(hdr->magic)) || hdr->version != REPLAY_FILE_VERSION ||
+       memcmp(replay->_trailer->magic, REPLAY_FILE_TRAILER_MAGIC, sizeof(replay->_trailer->magic))) {
+      return false;
+   }
+   if (hdr->num_players < 1 || hdr->input_size < 1 || hdr->num_players * hdr->input_size > GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS) {
+      return false;
+   }
+
+   ReplayChunkHeader *chunk = replay_GetChunk(replay, replay->_trailer->index_offset);
+   if (!chunk || chunk->type != ReplayChunk_Index || chunk->count < 1 || chunk->size != chunk->count * sizeof(ReplayIndexEntry)) {
+      return false;
+   }
+   replay->_index = (ReplayIndexEntry *)(chunk + 1);
+   replay->_index_size = chunk->count;
+
+   for (int i = 0; i < replay->_index_size; i++) {
+      ReplayIndexEntry *entry = &replay->_index[i];
+      ReplayChunkHeader *keyframe = replay_GetChunk(replay, entry->offset);
+      if (!keyframe || keyframe->type != ReplayChunk_Keyframe || keyframe->frame != entry->frame || keyframe->count > REPLAY_MAX_STATE_SIZE) {
+         return false;
+      }
+      if (i > 0 && entry->frame <= replay->_index[i - 1].frame) {
+         return false;
+      }
+   }
+   return replay->_index[0].frame == replay->_trailer->first_frame &&
+          replay->_index[replay->_index_size - 1].frame <= replay->_trailer->end_frame;
+}
+
+ReplayChunkHeader *
+replay_GetChunk(ReplayBackend *replay, uint64 offset)
+{
+   if (offset < sizeof(ReplayFileHeader) || offset % REPLAY_FILE_ALIGNMENT || offset + sizeof(ReplayChunkHeader) > replay->_size) {
+      return NULL;
+   }
+   ReplayChunkHeader *chunk = (ReplayChunkHeader *)(replay->_data + offset);
+   if (chunk->size > replay->_size - offset - sizeof(ReplayChunkHeader)) {
+      return NULL;
+   }
+   return chunk;
+}
+
+/*
+ * replay_ReadInput --
+ *
+ * Decode inputs up to the one of the given frame, moving on to the next
+ * input chunk as needed.  The cursor only moves forward: seeking backward
+ * goes through replay_LoadKeyframe.
+ */
+bool
+replay_ReadInput(ReplayBackend *replay, int frame)
+{
+   while (replay->_input.frame < frame) {
+      if (!replay->_chunk || replay->_input.frame + 1 >= replay->_chunk->frame + (int)replay->_chunk->count) {
+         ReplayChunkHeader *chunk;
+         do {
+            chunk = replay_GetChunk(replay, replay->_next_chunk);
+            if (!chunk || chunk->type == ReplayChunk_Index) {
+               return false;
+            }
+            replay->_next_chunk += sizeof(ReplayChunkHeader) + replay_file_Align(chunk->size);
+         } while (chunk->type != ReplayChunk_Inputs);
+
+         if (chunk->frame != replay->_input.frame + 1 || chunk->size > INT_MAX / 8) {
+            return false;
+         }
+         replay->_chunk = chunk;
+         replay->_chunk_offset = 0;
+         gameinput_init(&replay->_input, chunk->frame - 1, NULL, replay->_num_players * replay->_input_size);
+      }
+      if (!gameinput_decode_delta(&replay->_input, (uint8 *)(replay->_chunk + 1), replay->_chunk->size * 8, &replay->_chunk_offset)) {
+         return false;
+      }
+      replay->_input.frame++;
+   }
+   return replay->_input.frame == frame;
+}
+
+/*
+ * replay_LoadKeyframe --
+ *
+ * Load the state of a keyframe into the game and move the read cursor to
+ * the inputs which follow it.
+ */
+bool
+replay_LoadKeyframe(ReplayBackend *replay, ReplayIndexEntry *entry)
+{
+   ReplayChunkHeader *chunk = replay_GetChunk(replay, entry->offset);
+   byte *buf = malloc(chunk->count);
+   if (!buf) {
+      return false;
+   }
+   int len = compress_Decode((byte *)(chunk + 1), chunk->size, buf, chunk->count);
+   if (len < 0 || (uint32)len != chunk->count) {
+      Log("failed to decompress keyframe %d.\n", entry->frame);
+      free(buf);
+      return false;
+   }
+   Log("loading keyframe %d.\n", entry->frame);
+   replay->_header._callbacks.load_game_state(buf, len);
+   free(buf);
+
+   replay->_framecount = entry->frame;
+   replay->_next_chunk = entry->offset + sizeof(ReplayChunkHeader) + replay_file_Align(chunk->size);
+   replay->_chunk = NULL;
+   gameinput_init(&replay->_input, entry->frame - 1, NULL, replay->_num_players * replay->_input_size);
+   return true;
+}
+
+/*
+ * replay_Simulate --
+ *
+ * Run the game up to the given frame through the advance_frame callback,
+ * as in a rollback.
+ */
+GGPOErrorCode
+replay_Simulate(ReplayBackend *replay, int frame)
+{
+   while (replay->_framecount < frame) {
+      int framecount = replay->_framecount;
+      replay->_header._callbacks.advance_frame(0);
+      if (replay->_framecount == framecount) {
+         Log("advance_frame callback did not advance the replay at frame %d.\n", framecount);
+         return GGPO_ERRORCODE_GENERAL_FAILURE;
+      }
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+replay_DoPoll(ReplayBackend *replay, int timeout)
+{
+   GGPOEvent info;
+
+   if (!replay->_running) {
+      if (!replay_LoadKeyframe(replay, &replay->_index[0])) {
+         return GGPO_ERRORCODE_GENERAL_FAILURE;
+      }
+      info.code = GGPO_EVENTCODE_RUNNING;
+      replay->_header._callbacks.on_event(&info);
+      replay->_running = true;
+   }
+   if (replay->_framecount >= replay->_trailer->end_frame && !replay->_ended) {
+      info.code = GGPO_EVENTCODE_REPLAY_ENDED;
+      replay->_header._callbacks.on_event(&info);
+      replay->_ended = true;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+replay_AddPlayer(ReplayBackend *replay, GGPOPlayer *player, GGPOPlayerHandle *handle)
+{
+   if (player->player_num < 1 || player->player_num > replay->_num_players) {
+      return GGPO_ERRORCODE_PLAYER_OUT_OF_RANGE;
+   }
+   *handle = (GGPOPlayerHandle)(player->player_num - 1);
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+replay_SyncInput(ReplayBackend *replay, void *values, int size, int *disconnect_flags)
+{
+   if (!replay->_running) {
+      return GGPO_ERRORCODE_NOT_SYNCHRONIZED;
+   }
+   if (replay->_framecount >= replay->_trailer->end_frame) {
+      return GGPO_ERRORCODE_PREDICTION_THRESHOLD;
+   }
+   if (!replay_ReadInput(replay, replay->_framecount)) {
+      Log("replay file is corrupt at frame %d.\n", replay->_framecount);
+      return GGPO_ERRORCODE_GENERAL_FAILURE;
+   }
+   memset(values, 0, size);
+   memcpy(values, replay->_input.bits, MIN(size, replay->_input.size));
+   if (disconnect_flags) {
+      *disconnect_flags = 0;
+   }
+   return GGPO_OK;
+}
+
+GGPOErrorCode
+replay_IncrementFrame(ReplayBackend *replay)
+{
+   if (replay->_framecount < replay->_trailer->end_frame) {
+      replay->_framecount++;
+   }
+   return GGPO_OK;
+}
+
+/*
+ * replay_Seek --
+ *
+ * Move to any frame of the replay.  Seeking forward within the current
+ * keyframe interval simply runs the game up to the frame; otherwise the
+ * closest keyframe before it is loaded first.
+ */
+GGPOErrorCode
+replay_Seek(ReplayBackend *replay, int frame)
+{
+   if (!replay->_running) {
+      return GGPO_ERRORCODE_NOT_SYNCHRONIZED;
+   }
+   if (frame < replay->_trailer->first_frame || frame > replay->_trailer->end_frame) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+
+   int lo = 0, hi = replay->_index_size - 1;
+   while (lo < hi) {
+      int mid = (lo + hi + 1) / 2;
+      if (replay->_index[mid].frame <= frame) {
+         lo = mid;
+      } else {
+         hi = mid - 1;
+      }
+   }
+   ReplayIndexEntry *entry = &replay->_index[lo];
+   if (frame < replay->_framecount || entry->frame > replay->_framecount) {
+      if (!replay_LoadKeyframe(replay, entry)) {
+         return GGPO_ERRORCODE_GENERAL_FAILURE;
+      }
+   }
+   replay->_ended = false;
+   return replay_Simulate(replay, frame);
+}
+
+GGPOErrorCode
+replay_FastForward(ReplayBackend *replay, int frames)
+{
+   if (!replay->_running) {
+      return GGPO_ERRORCODE_NOT_SYNCHRONIZED;
+   }
+   int frame = replay->_trailer->end_frame;
+   if (frames >= 0) {
+      frame = MIN(frame, replay->_framecount + frames);
+   }
+   return replay_Simulate(replay, frame);
+}
+
+GGPOErrorCode
+replay_GetReplayPosition(ReplayBackend *replay, int *first_frame, int *end_frame, int *current_frame)
+{
+   if (first_frame) {
+      *first_frame = replay->_trailer->first_frame;
+   }
+   if (end_frame) {
+      *end_frame = replay->_trailer->end_frame;
+   }
+   if (current_frame) {
+      *current_frame = replay->_framecount;
+   }
+   return GGPO_OK;
+}
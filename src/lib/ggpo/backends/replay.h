@@ -0,0 +1,78 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+#include "types.h"
+#include "backend.h"
+#include "game_input.h"
+#include "replay_file.h"
+
+#define REPLAY_MAX_STATE_SIZE    (64 * 1024 * 1024)
+
+/*
+ * Plays back a file written by the recorder (see replay_file.h).  The file
+ * is mapped in memory and read in place.
+ */
+struct ReplayBackend {
+	GGPOSessionHeader _header;
+
+   byte                  *_data;
+   size_t                _size;
+   ReplayFileHeader      *_file_header;
+   ReplayFileTrailer     *_trailer;
+   ReplayIndexEntry      *_index;
+   int                   _index_size;
+
+   int                   _num_players;
+   int                   _input_size;
+   int                   _framecount;
+   bool                  _running;
+   bool                  _ended;
+
+   /*
+    * Read cursor.  _input holds the input of frame _input.frame, decoded
+    * from _chunk at bit _chunk_offset.
+    */
+   uint64                _next_chunk;
+   ReplayChunkHeader     *_chunk;
+   int                   _chunk_offset;
+   GameInput             _input;
+};
+
+typedef struct ReplayBackend ReplayBackend;
+
+   GGPOErrorCode replay_ctor(ReplayBackend *replay, GGPOSessionCallbacks *cb, const char *gamename, const char *filename, int num_players, int input_size);
+   void replay_dtor(ReplayBackend *replay);
+
+   GGPOErrorCode replay_DoPoll(ReplayBackend *replay, int timeout);
+   GGPOErrorCode replay_AddPlayer(ReplayBackend *replay, GGPOPlayer *player, GGPOPlayerHandle *handle);
+   static inline GGPOErrorCode replay_AddLocalInput(ReplayBackend *replay, GGPOPlayerHandle player, void *values, int size) { return GGPO_OK; }
+   GGPOErrorCode replay_SyncInput(ReplayBackend *replay, void *values, int size, int *disconnect_flags);
+   GGPOErrorCode replay_IncrementFrame(ReplayBackend *replay);
+   GGPOErrorCode replay_Seek(ReplayBackend *replay, int frame);
+   GGPOErrorCode replay_FastForward(ReplayBackend *replay, int frames);
+   GGPOErrorCode replay_GetReplayPosition(ReplayBackend *replay, int *first_frame, int *end_frame, int *current_frame);
+
+   bool replay_Validate(ReplayBackend *replay);
+   ReplayChunkHeader *replay_GetChunk(ReplayBackend *replay, uint64 offset);
+   bool replay_ReadInput(ReplayBackend *replay, int frame);
+   bool replay_LoadKeyframe(ReplayBackend *replay, ReplayIndexEntry *entry);
+   GGPOErrorCode replay_Simulate(ReplayBackend *replay, int frame);
+
+#endif
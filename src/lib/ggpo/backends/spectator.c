@@ -26,15 +26,45 @@
 
 static void SpectatorBackend_OnMsg(conn_Address from, UdpMsg* msg, int len, void* user_data);
 
+/*
+ * spec_InitRelay --
+ *
+ * Downstream spectators read the inputs we receive from a shared log, the
+ * same way the spectators of a p2p session do.
+ */
+static void spec_InitRelay(SpectatorBackend* spec)
+{
+	spec->_num_spectators = 0;
+	spec->_max_spectators = GGPO_MAX_SPECTATORS;
+	input_log_Init(&spec->_spectator_log, 0);
+	udp_protocol_encode_cache_ctor(&spec->_spectator_encode_cache);
+	spec->_spectator_lag_policy = GGPO_SPECTATOR_LAG_DISCONNECT;
+	spec->_spectator_max_lag = INPUT_LOG_LENGTH;
+	for (int i = 0; i < ARRAY_SIZE(spec->_spectators); i++) {
+		UdpProtocol_ctor(&spec->_spectators[i]);
+		UdpProtocol_SetEncodeCache(&spec->_spectators[i], &spec->_spectator_encode_cache);
+		UdpProtocol_SetInputLog(&spec->_spectators[i], &spec->_spectator_log);
+	}
+}
+
 #ifndef GGPO_STEAM
 
+/*
+ * spec_ctor --
+ *
+ * Binds localport, or attaches to shared under session_id when shared
+ * isn't NULL.  host_session is the session id of the host on its socket.
+ */
 void spec_ctor(SpectatorBackend* spec, GGPOSessionCallbacks* cb,
 	const char* gamename,
 	uint16 localport,
+	UdpSocket* shared,
+	uint16 session_id,
 	int num_players,
 	int input_size,
 	char* hostip,
-	uint16 hostport)
+	uint16 hostport,
+	uint16 host_session)
 {
 
 	spec->_num_players = num_players;
@@ -45,25 +75,47 @@ void spec_ctor(SpectatorBackend* spec, GGPOSessionCallbacks* cb,
 	spec->_header._callbacks = *cb;
 	spec->_synchronizing = true;
 
-	for (int i = 0; i < ARRAY_SIZE(spec->_inputs); i++) {
+	spec->_last_received_frame = -1;
+	spec->_loading_state = false;
+	spec->_inputs_size = SPECTATOR_FRAME_BUFFER_SIZE;
+	spec->_inputs = calloc(spec->_inputs_size, sizeof(GameInput));
+	spec->_input_times = calloc(spec->_inputs_size, sizeof(uint32));
+	for (int i = 0; i < spec->_inputs_size; i++) {
 		spec->_inputs[i].frame = -1;
 	}
+	spec->_catchup_policy = GGPO_SPECTATOR_CATCHUP_NONE;
+	spec->_catchup_max_frames = 1;
+	spec->_min_playout_delay = 0;
+	spec->_max_playout_delay = 0;
+	spec->_playout_delay = 0;
+	spec->_buffering = true;
+	spec->_stalls = 0;
+	spec->_jitter = 0.0f;
+	spec->_frame_duration_ms = TIMESYNC_DEFAULT_FRAME_USEC / 1000.0f;
+	spec->_last_arrival_frame = -1;
 
 	/*
 	 * Initialize the UDP port
 	 */
 	udp_ctor(&spec->_udp);
-	udp_Init(&spec->_udp, localport, SpectatorBackend_OnMsg, spec);
+	if (shared) {
+		udp_InitShared(&spec->_udp, shared, session_id, SpectatorBackend_OnMsg, spec);
+	} else {
+		udp_Init(&spec->_udp, localport, SpectatorBackend_OnMsg, spec);
+	}
 
 	/*
 	 * Init the host endpoint
 	 */
 	ASSERT(conn_support_ip_port());
-	conn_Address peer_addr =  conn_address_from_ip_port(hostip, hostport);
+	conn_Address peer_addr = conn_address_from_ip_port(spec->_udp._socket, hostip, hostport);
 
 	UdpProtocol_ctor(&spec->_host);
-	UdpProtocol_Init(&spec->_host, &spec->_udp, 0, peer_addr, NULL);
+	UdpProtocol_Init(&spec->_host, &spec->_udp, 0, peer_addr, NULL, 0);
+	UdpProtocol_AcceptState(&spec->_host);
+	UdpProtocol_SetRemoteSession(&spec->_host, host_session);
 	UdpProtocol_Synchronize(&spec->_host);
+	spec_InitRelay(spec);
 
 	/*
 	 * Preload the ROM
@@ -71,6 +123,28 @@ void spec_ctor(SpectatorBackend* spec, GGPOSessionCallbacks* cb,
 	spec->_header._callbacks.begin_game(gamename);
 }
 
+GGPOErrorCode spec_AddSpectator(SpectatorBackend* spec, char* ip, uint16 port, uint16 session_id, GGPOPlayerHandle* handle)
+{
+	if (spec->_num_spectators == spec->_max_spectators) {
+		return GGPO_ERRORCODE_TOO_MANY_SPECTATORS;
+	}
+	if (!spec->_synchronizing) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	int queue = spec->_num_spectators++;
+
+	ASSERT(conn_support_ip_port());
+	conn_Address peer_addr = conn_address_from_ip_port(spec->_udp._socket, ip, port);
+
+	UdpProtocol_Init(&spec->_spectators[queue], &spec->_udp, queue + 1000, peer_addr, NULL, spec->_input_size * spec->_num_players);
+	UdpProtocol_SetRemoteSession(&spec->_spectators[queue], session_id);
+	UdpProtocol_SetFrameDuration(&spec->_spectators[queue], (int)(spec->_frame_duration_ms * 1000.0f + 0.5f));
+	UdpProtocol_Synchronize(&spec->_spectators[queue]);
+	*handle = spec_QueueToSpectatorHandle(spec, queue);
+
+	return GGPO_OK;
+}
+
 #endif /* !GGPO_STEAM */
 
 #if defined(GGPO_STEAM)
@@ -96,9 +170,24 @@ void spec_ctor_steam(SpectatorBackend* spec, GGPOSessionCallbacks* cb,
 	spec->_header._callbacks = *cb;
 	spec->_synchronizing = true;
 
-	for (int i = 0; i < ARRAY_SIZE(spec->_inputs); i++) {
+	spec->_last_received_frame = -1;
+	spec->_loading_state = false;
+	spec->_inputs_size = SPECTATOR_FRAME_BUFFER_SIZE;
+	spec->_inputs = calloc(spec->_inputs_size, sizeof(GameInput));
+	spec->_input_times = calloc(spec->_inputs_size, sizeof(uint32));
+	for (int i = 0; i < spec->_inputs_size; i++) {
 		spec->_inputs[i].frame = -1;
 	}
+	spec->_catchup_policy = GGPO_SPECTATOR_CATCHUP_NONE;
+	spec->_catchup_max_frames = 1;
+	spec->_min_playout_delay = 0;
+	spec->_max_playout_delay = 0;
+	spec->_playout_delay = 0;
+	spec->_buffering = true;
+	spec->_stalls = 0;
+	spec->_jitter = 0.0f;
+	spec->_frame_duration_ms = TIMESYNC_DEFAULT_FRAME_USEC / 1000.0f;
+	spec->_last_arrival_frame = -1;
 
 	/*
 	 * Initialize the Steam Networking Messages layer
@@ -113,8 +202,10 @@ void spec_ctor_steam(SpectatorBackend* spec, GGPOSessionCallbacks* cb,
 	conn_Address peer_addr = conn_address_from_steam_id(host_steam_id);
 
 	UdpProtocol_ctor(&spec->_host);
-	UdpProtocol_Init(&spec->_host, &spec->_udp, 0, peer_addr, NULL);
+	UdpProtocol_Init(&spec->_host, &spec->_udp, 0, peer_addr, NULL, 0);
+	UdpProtocol_AcceptState(&spec->_host);
 	UdpProtocol_Synchronize(&spec->_host);
+	spec_InitRelay(spec);
 
 	/*
 	 * Preload the ROM
@@ -122,11 +213,57 @@ void spec_ctor_steam(SpectatorBackend* spec, GGPOSessionCallbacks* cb,
 	spec->_header._callbacks.begin_game(gamename);
 }
 
+/*
+ * spec_AddSpectatorSteam --
+ *
+ * Add a downstream spectator identified by their Steam ID.
+ */
+GGPOErrorCode spec_AddSpectatorSteam(SpectatorBackend* spec, uint64 steam_id, GGPOPlayerHandle* handle)
+{
+	if (spec->_num_spectators == spec->_max_spectators) {
+		return GGPO_ERRORCODE_TOO_MANY_SPECTATORS;
+	}
+	if (!spec->_synchronizing) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	int queue = spec->_num_spectators++;
+
+	conn_add_known_peer(steam_id);
+	conn_Address peer_addr = conn_address_from_steam_id(steam_id);
+
+	UdpProtocol_Init(&spec->_spectators[queue], &spec->_udp, queue + 1000, peer_addr, NULL, spec->_input_size * spec->_num_players);
+	UdpProtocol_SetFrameDuration(&spec->_spectators[queue], (int)(spec->_frame_duration_ms * 1000.0f + 0.5f));
+	UdpProtocol_Synchronize(&spec->_spectators[queue]);
+	*handle = spec_QueueToSpectatorHandle(spec, queue);
+
+	return GGPO_OK;
+}
+
 #endif /* GGPO_STEAM */
 
+GGPOErrorCode
+spec_AddPlayer(SpectatorBackend* spec, GGPOPlayer* player, GGPOPlayerHandle* handle)
+{
+	if (player->type != GGPO_PLAYERTYPE_SPECTATOR) {
+		return GGPO_ERRORCODE_UNSUPPORTED;
+	}
+#if defined(GGPO_STEAM)
+	return spec_AddSpectatorSteam(spec, player->u.steam_remote.steam_id, handle);
+#else
+	return spec_AddSpectator(spec, player->u.remote.ip_address, player->u.remote.port, player->u.remote.session_id, handle);
+#endif
+}
+
 void spec_dtor(SpectatorBackend* spec)
 {
+	UdpProtocol_dtor(&spec->_host);
+	for (int i = 0; i < spec->_num_spectators; i++) {
+		UdpProtocol_dtor(&spec->_spectators[i]);
+	}
 	udp_dtor(&spec->_udp);
+	input_log_dtor(&spec->_spectator_log);
+	free(spec->_inputs);
+	free(spec->_input_times);
 }
 
 GGPOErrorCode
@@ -134,9 +271,17 @@ spec_DoPoll(SpectatorBackend* spec, int timeout)
 {
 	udp_OnLoopPoll(&spec->_udp);
 	UdpProtocol_OnLoopPoll(&spec->_host);
-
+	for (int i = 0; i < spec->_num_spectators; i++) {
+		UdpProtocol_OnLoopPoll(&spec->_spectators[i]);
+	}
 
 	spec_PollUdpProtocolEvents(spec);
+	spec_ForwardInputs(spec);
+	spec_ServeSpectatorStates(spec);
+	UdpProtocol_Flush(&spec->_host);
+	for (int i = 0; i < spec->_num_spectators; i++) {
+		UdpProtocol_Flush(&spec->_spectators[i]);
+	}
 	return GGPO_OK;
 }
 
@@ -149,10 +294,26 @@ spec_SyncInput(SpectatorBackend* spec, void* values,
 	if (spec->_synchronizing) {
 		return GGPO_ERRORCODE_NOT_SYNCHRONIZED;
 	}
+	if (spec->_loading_state) {
+		return GGPO_ERRORCODE_PREDICTION_THRESHOLD;
+	}
+
+	// Let the jitter buffer fill up before resuming playback.
+	if (spec->_buffering) {
+		int available;
+		spec_GetFramesAvailable(spec, &available);
+		if (available < MAX(1, spec->_playout_delay)) {
+			return GGPO_ERRORCODE_PREDICTION_THRESHOLD;
+		}
+		spec->_buffering = false;
+	}
 
-	GameInput const input = spec->_inputs[spec->_next_input_to_send % SPECTATOR_FRAME_BUFFER_SIZE];
+	GameInput const input = spec->_inputs[spec->_next_input_to_send % spec->_inputs_size];
 	if (input.frame < spec->_next_input_to_send) {
 		// Haven't received the input from the host yet.  Wait
+		Log("spectator stalled at frame %d.\n", spec->_next_input_to_send);
+		spec->_stalls++;
+		spec->_buffering = true;
 		return GGPO_ERRORCODE_PREDICTION_THRESHOLD;
 	}
 	if (input.frame > spec->_next_input_to_send) {
@@ -188,6 +349,11 @@ spec_PollUdpProtocolEvents(SpectatorBackend* spec)
 	while (UdpProtocol_GetEvent(&spec->_host, &evt)) {
 		spec_OnUdpProtocolEvent(spec, &evt);
 	}
+	for (int i = 0; i < spec->_num_spectators; i++) {
+		while (UdpProtocol_GetEvent(&spec->_spectators[i], &evt)) {
+			spec_OnUdpProtocolSpectatorEvent(spec, &evt, i);
+		}
+	}
 }
 
 void
@@ -242,9 +408,18 @@ spec_OnUdpProtocolEvent(SpectatorBackend* spec, udp_protocol_Event* evt)
 	case UdpProtocol_Event_Input:
 		GameInput const input = evt->u.input.input;
 
+		if (spec->_last_received_frame < 0 && spec->_next_input_to_send == 0 && input.frame > 0) {
+			spec_JoinAt(spec, input.frame);
+		}
 		UdpProtocol_SetLocalFrameNumber(&spec->_host, input.frame);
 		UdpProtocol_SendInputAck(&spec->_host);
-		spec->_inputs[input.frame % SPECTATOR_FRAME_BUFFER_SIZE] = input;
+		spec_UpdateJitter(spec, input.frame, evt->u.input.recv_time);
+		spec_StoreInput(spec, &evt->u.input.input, evt->u.input.recv_time);
+		break;
+
+	case UdpProtocol_Event_State:
+		spec_LoadState(spec, evt->u.state.frame, evt->u.state.buf, evt->u.state.len);
+		free(evt->u.state.buf);
 		break;
 
 	case UdpProtocol_Event_Unknown:
@@ -252,10 +427,471 @@ spec_OnUdpProtocolEvent(SpectatorBackend* spec, udp_protocol_Event* evt)
 	}
 }
 
+void
+spec_OnUdpProtocolSpectatorEvent(SpectatorBackend* spec, udp_protocol_Event* evt, int queue)
+{
+	GGPOPlayerHandle handle = spec_QueueToSpectatorHandle(spec, queue);
+	GGPOEvent info;
+
+	switch (evt->type) {
+	case UdpProtocol_Event_Connected:
+		info.code = GGPO_EVENTCODE_CONNECTED_TO_PEER;
+		info.u.connected.player = handle;
+		spec->_header._callbacks.on_event(&info);
+		break;
+	case UdpProtocol_Event_Synchronzied:
+		info.code = GGPO_EVENTCODE_SYNCHRONIZED_WITH_PEER;
+		info.u.synchronized.player = handle;
+		spec->_header._callbacks.on_event(&info);
+		break;
+	case UdpProtocol_Event_Disconnected:
+		spec_DisconnectSpectator(spec, queue);
+		break;
+	default:
+		break;
+	}
+}
+
+/*
+ * spec_JoinAt --
+ *
+ * The host's input stream starts at frame instead of 0, so we joined a
+ * running session or fell too far behind it.  Wait for the state saved at
+ * that frame before playing.  Unless we already logged the inputs up to it,
+ * our own spectators have to wait for it too.
+ */
+void
+spec_JoinAt(SpectatorBackend* spec, int frame)
+{
+	Log("joining session at frame %d.\n", frame);
+	spec->_next_input_to_send = frame;
+	spec->_loading_state = true;
+	if (input_log_Has(&spec->_spectator_log, frame)) {
+		return;
+	}
+	input_log_Init(&spec->_spectator_log, frame);
+	for (int i = 0; i < spec->_num_spectators; i++) {
+		UdpProtocol_RequireState(&spec->_spectators[i]);
+	}
+}
+
+/*
+ * spec_LoadState --
+ *
+ * Load the state the host sent us and pass it on to our own spectators.
+ */
+void
+spec_LoadState(SpectatorBackend* spec, int frame, byte* buf, int len)
+{
+	if (!spec->_loading_state && spec->_next_input_to_send != frame) {
+		if (frame < spec->_next_input_to_send) {
+			// Already played past it.
+			return;
+		}
+		spec_JoinAt(spec, frame);
+	}
+	Log("loading state for frame %d.\n", frame);
+	spec->_header._callbacks.load_game_state(buf, len);
+	spec->_loading_state = false;
+
+	for (int i = 0; i < spec->_num_spectators; i++) {
+		if (UdpProtocol_NeedsState(&spec->_spectators[i])) {
+			UdpProtocol_SendState(&spec->_spectators[i], frame, buf, len);
+		}
+	}
+}
+
+/*
+ * spec_StoreInput --
+ *
+ * Buffer an input until the game plays it and it is forwarded to our own
+ * spectators, growing the buffer when the host gets further ahead than it
+ * can hold.
+ */
+void
+spec_StoreInput(SpectatorBackend* spec, GameInput* input, uint32 recv_time)
+{
+	int oldest = MIN(spec->_next_input_to_send, spec->_spectator_log._next_frame);
+
+	if (input->frame - oldest >= spec->_inputs_size && spec->_inputs_size < SPECTATOR_MAX_FRAME_BUFFER_SIZE) {
+		int size = spec->_inputs_size;
+		while (input->frame - oldest >= size && size < SPECTATOR_MAX_FRAME_BUFFER_SIZE) {
+			size *= 2;
+		}
+		GameInput* inputs = calloc(size, sizeof(GameInput));
+		uint32* input_times = calloc(size, sizeof(uint32));
+		for (int i = 0; i < size; i++) {
+			inputs[i].frame = -1;
+		}
+		for (int frame = oldest; frame <= spec->_last_received_frame; frame++) {
+			inputs[frame % size] = spec->_inputs[frame % spec->_inputs_size];
+			input_times[frame % size] = spec->_input_times[frame % spec->_inputs_size];
+		}
+		Log("growing spectator input buffer from %d to %d frames.\n", spec->_inputs_size, size);
+		free(spec->_inputs);
+		free(spec->_input_times);
+		spec->_inputs = inputs;
+		spec->_input_times = input_times;
+		spec->_inputs_size = size;
+	}
+	spec->_inputs[input->frame % spec->_inputs_size] = *input;
+	spec->_input_times[input->frame % spec->_inputs_size] = recv_time;
+	spec->_last_received_frame = MAX(spec->_last_received_frame, input->frame);
+}
+
+/*
+ * spec_UpdateJitter --
+ *
+ * Estimate the jitter of the input arrival times the same way RTP does
+ * (RFC 3550, 6.4.1): the deviation between the time elapsed between two
+ * arrivals and the time elapsed between the two frames, smoothed over 16
+ * samples.  The playout delay is derived from it.
+ */
+void
+spec_UpdateJitter(SpectatorBackend* spec, int frame, uint32 recv_time)
+{
+	if (spec->_last_arrival_frame >= 0 && frame > spec->_last_arrival_frame) {
+		float d = (float)(int)(recv_time - spec->_last_arrival_time) -
+			(frame - spec->_last_arrival_frame) * spec->_frame_duration_ms;
+		if (d < 0) {
+			d = -d;
+		}
+		spec->_jitter += (d - spec->_jitter) / 16.0f;
+	}
+	spec->_last_arrival_frame = frame;
+	spec->_last_arrival_time = recv_time;
+
+	if (spec->_max_playout_delay > 0) {
+		int delay = (int)(SPECTATOR_JITTER_MULTIPLIER * spec->_jitter / spec->_frame_duration_ms) + 1;
+		spec->_playout_delay = MAX(spec->_min_playout_delay, MIN(delay, spec->_max_playout_delay));
+	}
+}
+
+/*
+ * spec_GetPacingAdjustment --
+ *
+ * Recommend running slightly faster when the buffer holds more frames than
+ * the playout delay and slightly slower when it holds less, one percent per
+ * frame.  Nudging the frame rate keeps the buffer at its target without the
+ * visible skips of the catch-up policies.
+ */
+int
+spec_GetPacingAdjustment(SpectatorBackend* spec)
+{
+	int available;
+
+	if (spec->_max_playout_delay == 0 || spec->_buffering) {
+		return 0;
+	}
+	spec_GetFramesAvailable(spec, &available);
+	return MAX(-SPECTATOR_MAX_PACING_ADJUSTMENT, MIN(available - spec->_playout_delay, SPECTATOR_MAX_PACING_ADJUSTMENT));
+}
+
+/*
+ * spec_ForwardInputs --
+ *
+ * Relay the inputs received from upstream to our own spectators, applying
+ * the lag policy to the ones which fall behind like p2p_PushSpectatorFrames
+ * does.  Inputs held back stay in the input buffer until they go out.
+ */
+void
+spec_ForwardInputs(SpectatorBackend* spec)
+{
+	int backlog = spec_TrimSpectatorLog(spec);
+
+	if (spec->_spectator_lag_policy != GGPO_SPECTATOR_LAG_THROTTLE && backlog >= spec->_spectator_max_lag) {
+		for (int i = 0; i < spec->_num_spectators; i++) {
+			if (UdpProtocol_IsInitialized(&spec->_spectators[i]) && !UdpProtocol_IsDisconnected(&spec->_spectators[i]) &&
+				UdpProtocol_GetPendingOutputCount(&spec->_spectators[i]) >= spec->_spectator_max_lag) {
+				if (spec->_spectator_lag_policy == GGPO_SPECTATOR_LAG_SNAPSHOT) {
+					Log("downstream spectator %d is %d frames behind.  Sending it a state.\n", i, UdpProtocol_GetPendingOutputCount(&spec->_spectators[i]));
+					UdpProtocol_RequireState(&spec->_spectators[i]);
+				}
+				else {
+					Log("downstream spectator %d is %d frames behind.  Disconnecting.\n", i, UdpProtocol_GetPendingOutputCount(&spec->_spectators[i]));
+					spec_DisconnectSpectator(spec, i);
+				}
+			}
+		}
+		backlog = spec_TrimSpectatorLog(spec);
+	}
+
+	while (spec->_spectator_log._next_frame <= spec->_last_received_frame && !input_log_IsFull(&spec->_spectator_log)) {
+		int frame = spec->_spectator_log._next_frame;
+		int i = frame % spec->_inputs_size;
+
+		if (spec->_inputs[i].frame != frame) {
+			break;
+		}
+		if (spec->_spectator_lag_policy == GGPO_SPECTATOR_LAG_THROTTLE && backlog >= spec->_spectator_max_lag) {
+			Log("throttling: downstream spectators are %d frames behind.\n", backlog);
+			break;
+		}
+		input_log_Append(&spec->_spectator_log, &spec->_inputs[i]);
+		for (int j = 0; j < spec->_num_spectators; j++) {
+			UdpProtocol_SendInput(&spec->_spectators[j], &spec->_inputs[i]);
+		}
+		backlog = spec_TrimSpectatorLog(spec);
+
+		if (spec->_num_spectators > 0) {
+			spec->_frames_forwarded++;
+			spec->_forward_delay_total += Platform_GetCurrentTimeMS() - spec->_input_times[i];
+		}
+	}
+}
+
+/*
+ * spec_TrimSpectatorLog --
+ *
+ * UdpProtocol_TrimInputLog, except that while one of our spectators waits
+ * for a state, the frames from the one we are about to play on are kept:
+ * that is the only state we can save for it.
+ */
+int
+spec_TrimSpectatorLog(SpectatorBackend* spec)
+{
+	int first_frame = spec->_spectator_log._first_frame;
+	int backlog = UdpProtocol_TrimInputLog(&spec->_spectator_log, spec->_spectators, spec->_num_spectators);
+
+	for (int i = 0; i < spec->_num_spectators; i++) {
+		if (UdpProtocol_NeedsState(&spec->_spectators[i]) && !UdpProtocol_IsDisconnected(&spec->_spectators[i])) {
+			spec->_spectator_log._first_frame = MAX(first_frame, MIN(spec->_spectator_log._first_frame, spec->_next_input_to_send));
+			break;
+		}
+	}
+	return backlog;
+}
+
+/*
+ * spec_ServeSpectatorStates --
+ *
+ * Save our state and start sending it to the downstream spectators waiting
+ * for one, once the inputs from the frame we are about to play are in the
+ * log.
+ */
+void
+spec_ServeSpectatorStates(SpectatorBackend* spec)
+{
+	int frame = spec->_next_input_to_send;
+	unsigned char* buf = NULL;
+	int len, checksum;
+
+	if (spec->_synchronizing || spec->_loading_state ||
+		frame < spec->_spectator_log._first_frame || frame > spec->_spectator_log._next_frame) {
+		return;
+	}
+	for (int i = 0; i < spec->_num_spectators; i++) {
+		if (!UdpProtocol_NeedsState(&spec->_spectators[i]) || !UdpProtocol_IsRunning(&spec->_spectators[i])) {
+			continue;
+		}
+		if (!buf && !spec->_header._callbacks.save_game_state(&buf, &len, &checksum, frame)) {
+			Log("failed to save the state for frame %d.\n", frame);
+			return;
+		}
+		UdpProtocol_SendState(&spec->_spectators[i], frame, buf, len);
+	}
+	if (buf) {
+		spec->_header._callbacks.free_buffer(buf);
+	}
+}
+
+void
+spec_DisconnectSpectator(SpectatorBackend* spec, int queue)
+{
+	GGPOEvent info;
+
+	UdpProtocol_Disconnect(&spec->_spectators[queue]);
+
+	info.code = GGPO_EVENTCODE_DISCONNECTED_FROM_PEER;
+	info.u.disconnected.player = spec_QueueToSpectatorHandle(spec, queue);
+	spec->_header._callbacks.on_event(&info);
+}
+
+GGPOErrorCode
+spec_SetSpectatorLagPolicy(SpectatorBackend* spec, GGPOSpectatorLagPolicy policy, int max_lag_frames)
+{
+	if (policy < GGPO_SPECTATOR_LAG_DISCONNECT || policy > GGPO_SPECTATOR_LAG_SNAPSHOT ||
+		max_lag_frames <= 0 || max_lag_frames > INPUT_LOG_LENGTH) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	spec->_spectator_lag_policy = policy;
+	spec->_spectator_max_lag = max_lag_frames;
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+spec_SetSpectatorFanout(SpectatorBackend* spec, int max_spectators)
+{
+	if (max_spectators < spec->_num_spectators || max_spectators > GGPO_MAX_SPECTATORS) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	spec->_max_spectators = max_spectators;
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+spec_SetPathMtu(SpectatorBackend* spec, int mtu)
+{
+	UdpProtocol_SetPathMtu(&spec->_host, mtu);
+	for (int i = 0; i < ARRAY_SIZE(spec->_spectators); i++) {
+		UdpProtocol_SetPathMtu(&spec->_spectators[i], mtu);
+	}
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+spec_GetFramesAvailable(SpectatorBackend* spec, int* frames)
+{
+	*frames = MAX(0, spec->_last_received_frame - spec->_next_input_to_send + 1);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+spec_SetCatchupPolicy(SpectatorBackend* spec, GGPOSpectatorCatchupPolicy policy, int max_frames_per_tick)
+{
+	if (max_frames_per_tick < 1) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	spec->_catchup_policy = policy;
+	spec->_catchup_max_frames = max_frames_per_tick;
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+spec_GetFramesToRun(SpectatorBackend* spec, int* frames)
+{
+	int available;
+
+	spec_GetFramesAvailable(spec, &available);
+	if (spec->_synchronizing || spec->_loading_state) {
+		*frames = 0;
+		return GGPO_OK;
+	}
+	if (available == 0) {
+		if (!spec->_buffering) {
+			Log("spectator stalled at frame %d.\n", spec->_next_input_to_send);
+			spec->_stalls++;
+			spec->_buffering = true;
+		}
+		*frames = 0;
+		return GGPO_OK;
+	}
+	if (spec->_buffering && available < MAX(1, spec->_playout_delay)) {
+		*frames = 0;
+		return GGPO_OK;
+	}
+
+	/*
+	 * Frames held back by the jitter buffer are not a backlog.
+	 */
+	int backlog = available;
+	if (spec->_max_playout_delay > 0) {
+		backlog = MAX(1, available - spec->_playout_delay + 1);
+	}
+
+	switch (spec->_catchup_policy) {
+	case GGPO_SPECTATOR_CATCHUP_IMMEDIATE:
+		*frames = backlog;
+		break;
+	case GGPO_SPECTATOR_CATCHUP_GRADUAL:
+		/*
+		 * Run the regular frame plus a fraction of the backlog, which shrinks
+		 * it geometrically instead of jumping straight back to live.
+		 */
+		*frames = 1 + (backlog - 1) / SPECTATOR_CATCHUP_RATE;
+		break;
+	default:
+		*frames = 1;
+		break;
+	}
+	*frames = MIN(*frames, MIN(available, spec->_catchup_max_frames));
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+spec_SetPlayoutDelay(SpectatorBackend* spec, int min_frames, int max_frames)
+{
+	if (min_frames < 0 || max_frames < 0 || (max_frames > 0 && min_frames > max_frames)) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	if (max_frames >= SPECTATOR_MAX_FRAME_BUFFER_SIZE) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	spec->_min_playout_delay = min_frames;
+	spec->_max_playout_delay = max_frames;
+	spec->_playout_delay = max_frames > 0 ? MAX(min_frames, 1) : 0;
+	return GGPO_OK;
+}
+
+/*
+ * spec_SetFrameDuration --
+ *
+ * The jitter of the input arrivals is measured against the time the
+ * frames should take, and the playout delay derived from it is in frames.
+ */
+GGPOErrorCode
+spec_SetFrameDuration(SpectatorBackend* spec, int usec)
+{
+	if (usec <= 0) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	spec->_frame_duration_ms = usec / 1000.0f;
+	UdpProtocol_SetFrameDuration(&spec->_host, usec);
+	for (int i = 0; i < spec->_num_spectators; i++) {
+		UdpProtocol_SetFrameDuration(&spec->_spectators[i], usec);
+	}
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+spec_GetNetworkStats(SpectatorBackend* spec, GGPONetworkStats* stats, GGPOPlayerHandle handle)
+{
+	/*
+	 * A spectator only has a single peer, so the stats always describe
+	 * the connection to the host regardless of the handle.
+	 */
+	memset(stats, 0, sizeof * stats);
+	UdpProtocol_GetNetworkStats(&spec->_host, stats);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+spec_GetSpectatorStats(SpectatorBackend* spec, GGPOSpectatorStats* stats)
+{
+	GGPONetworkStats upstream = { 0 };
+
+	memset(stats, 0, sizeof * stats);
+	UdpProtocol_GetNetworkStats(&spec->_host, &upstream);
+
+	for (int i = 0; i < spec->_num_spectators; i++) {
+		if (!UdpProtocol_IsDisconnected(&spec->_spectators[i])) {
+			stats->relay.num_spectators++;
+		}
+	}
+	stats->relay.upstream_ping = upstream.network.ping;
+	if (spec->_frames_forwarded) {
+		stats->relay.forward_delay = spec->_forward_delay_total / spec->_frames_forwarded;
+	}
+	stats->relay.hop_delay = stats->relay.upstream_ping / 2 + stats->relay.forward_delay;
+	spec_GetFramesAvailable(spec, &stats->playback.frames_available);
+	stats->playback.playout_delay = spec->_playout_delay;
+	stats->playback.jitter = (int)(spec->_jitter + 0.5f);
+	stats->playback.stalls = spec->_stalls;
+	stats->playback.pacing_adjustment = spec_GetPacingAdjustment(spec);
+	return GGPO_OK;
+}
+
 static void SpectatorBackend_OnMsg(conn_Address from, UdpMsg* msg, int len, void* user_data)
 {
 	SpectatorBackend* backend = (SpectatorBackend*)user_data;
 	if (UdpProtocol_HandlesMsg(&backend->_host, from, msg)) {
 		UdpProtocol_OnMsg(&backend->_host, msg, len);
+		return;
+	}
+	for (int i = 0; i < backend->_num_spectators; i++) {
+		if (UdpProtocol_HandlesMsg(&backend->_spectators[i], from, msg)) {
+			UdpProtocol_OnMsg(&backend->_spectators[i], msg, len);
+			return;
+		}
 	}
 }
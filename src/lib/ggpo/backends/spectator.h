@@ -31,6 +31,10 @@
 #include "network/udp_proto.h"
 
 #define SPECTATOR_FRAME_BUFFER_SIZE    64
+#define SPECTATOR_MAX_FRAME_BUFFER_SIZE   (1 << 16)
+#define SPECTATOR_CATCHUP_RATE         8
+#define SPECTATOR_JITTER_MULTIPLIER    3
+#define SPECTATOR_MAX_PACING_ADJUSTMENT   5
 
 struct SpectatorBackend  {
 	GGPOSessionHeader _header;
@@ -41,7 +45,41 @@ struct SpectatorBackend  {
    int                   _input_size;
    int                   _num_players;
    int                   _next_input_to_send;
-   GameInput             _inputs[SPECTATOR_FRAME_BUFFER_SIZE];
+   int                   _last_received_frame;
+   bool                  _loading_state;
+   GameInput             *_inputs;
+   uint32                *_input_times;
+   int                   _inputs_size;
+
+   GGPOSpectatorCatchupPolicy _catchup_policy;
+   int                   _catchup_max_frames;
+
+   /*
+    * Jitter buffer.  Playback waits until _playout_delay frames are buffered,
+    * both at the start and after a stall.
+    */
+   int                   _min_playout_delay;
+   int                   _max_playout_delay;
+   int                   _playout_delay;
+   bool                  _buffering;
+   int                   _stalls;
+   float                 _jitter;
+   float                 _frame_duration_ms;
+   uint32                _last_arrival_time;
+   int                   _last_arrival_frame;
+
+   /*
+    * Downstream spectators we relay the inputs to.
+    */
+   UdpProtocol           _spectators[GGPO_MAX_SPECTATORS];
+   int                   _num_spectators;
+   int                   _max_spectators;
+   InputLog              _spectator_log;
+   udp_protocol_EncodeCache _spectator_encode_cache;
+   GGPOSpectatorLagPolicy _spectator_lag_policy;
+   int                   _spectator_max_lag;
+   int                   _frames_forwarded;
+   int                   _forward_delay_total;
 };
 
 typedef struct SpectatorBackend SpectatorBackend;
@@ -49,24 +87,45 @@ typedef struct SpectatorBackend SpectatorBackend;
 #if defined(GGPO_STEAM)
    void spec_ctor_steam(SpectatorBackend *spec, GGPOSessionCallbacks *cb, const char *gamename, int local_channel, int num_players, int input_size, uint64 host_steam_id);
 #else
-   void spec_ctor(SpectatorBackend *spec, GGPOSessionCallbacks *cb, const char *gamename, uint16 localport, int num_players, int input_size, char *hostip, uint16 hostport);
+   void spec_ctor(SpectatorBackend *spec, GGPOSessionCallbacks *cb, const char *gamename, uint16 localport, UdpSocket *shared, uint16 session_id, int num_players, int input_size, char *hostip, uint16 hostport, uint16 host_session);
 #endif
    void spec_dtor(SpectatorBackend *spec);
 
    GGPOErrorCode spec_DoPoll(SpectatorBackend *spec, int timeout);
-   inline GGPOErrorCode spec_AddPlayer(SpectatorBackend *spec, GGPOPlayer *player, GGPOPlayerHandle *handle) { return GGPO_ERRORCODE_UNSUPPORTED; }
-   inline GGPOErrorCode spec_AddLocalInput(SpectatorBackend *spec, GGPOPlayerHandle player, void *values, int size) { return GGPO_OK; }
+   GGPOErrorCode spec_AddPlayer(SpectatorBackend *spec, GGPOPlayer *player, GGPOPlayerHandle *handle);
+#if defined(GGPO_STEAM)
+   GGPOErrorCode spec_AddSpectatorSteam(SpectatorBackend *spec, uint64 steam_id, GGPOPlayerHandle *handle);
+#else
+   GGPOErrorCode spec_AddSpectator(SpectatorBackend *spec, char *remoteip, uint16 reportport, uint16 session_id, GGPOPlayerHandle *handle);
+#endif
+   static inline GGPOErrorCode spec_AddLocalInput(SpectatorBackend *spec, GGPOPlayerHandle player, void *values, int size) { return GGPO_OK; }
    GGPOErrorCode spec_SyncInput(SpectatorBackend *spec, void *values, int size, int *disconnect_flags);
    GGPOErrorCode spec_IncrementFrame(SpectatorBackend *spec);
-   inline GGPOErrorCode spec_DisconnectPlayer(SpectatorBackend *spec, GGPOPlayerHandle handle) { return GGPO_ERRORCODE_UNSUPPORTED; }
-   inline GGPOErrorCode spec_GetNetworkStats(SpectatorBackend *spec, GGPONetworkStats *stats, GGPOPlayerHandle handle) { return GGPO_ERRORCODE_UNSUPPORTED; }
-   inline GGPOErrorCode spec_SetFrameDelay(SpectatorBackend *spec, GGPOPlayerHandle player, int delay) { return GGPO_ERRORCODE_UNSUPPORTED; }
-   inline GGPOErrorCode spec_SetDisconnectTimeout(SpectatorBackend *spec, int timeout) { return GGPO_ERRORCODE_UNSUPPORTED; }
-   inline GGPOErrorCode spec_SetDisconnectNotifyStart(SpectatorBackend *spec, int timeout) { return GGPO_ERRORCODE_UNSUPPORTED; }
+   GGPOErrorCode spec_GetNetworkStats(SpectatorBackend *spec, GGPONetworkStats *stats, GGPOPlayerHandle handle);
+   GGPOErrorCode spec_SetSpectatorLagPolicy(SpectatorBackend *spec, GGPOSpectatorLagPolicy policy, int max_lag_frames);
+   GGPOErrorCode spec_SetSpectatorFanout(SpectatorBackend *spec, int max_spectators);
+   GGPOErrorCode spec_SetPathMtu(SpectatorBackend *spec, int mtu);
+   GGPOErrorCode spec_GetSpectatorStats(SpectatorBackend *spec, GGPOSpectatorStats *stats);
+   GGPOErrorCode spec_GetFramesAvailable(SpectatorBackend *spec, int *frames);
+   GGPOErrorCode spec_SetCatchupPolicy(SpectatorBackend *spec, GGPOSpectatorCatchupPolicy policy, int max_frames_per_tick);
+   GGPOErrorCode spec_GetFramesToRun(SpectatorBackend *spec, int *frames);
+   GGPOErrorCode spec_SetPlayoutDelay(SpectatorBackend *spec, int min_frames, int max_frames);
+   GGPOErrorCode spec_SetFrameDuration(SpectatorBackend *spec, int usec);
 
    void spec_PollUdpProtocolEvents(SpectatorBackend *spec);
    void spec_CheckInitialSync(SpectatorBackend *spec);
 
    void spec_OnUdpProtocolEvent(SpectatorBackend *spec, udp_protocol_Event *e);
+   void spec_OnUdpProtocolSpectatorEvent(SpectatorBackend *spec, udp_protocol_Event *e, int queue);
+   void spec_ForwardInputs(SpectatorBackend *spec);
+   int spec_TrimSpectatorLog(SpectatorBackend *spec);
+   void spec_ServeSpectatorStates(SpectatorBackend *spec);
+   void spec_StoreInput(SpectatorBackend *spec, GameInput *input, uint32 recv_time);
+   void spec_JoinAt(SpectatorBackend *spec, int frame);
+   void spec_LoadState(SpectatorBackend *spec, int frame, byte *buf, int len);
+   void spec_UpdateJitter(SpectatorBackend *spec, int frame, uint32 recv_time);
+   int spec_GetPacingAdjustment(SpectatorBackend *spec);
+   void spec_DisconnectSpectator(SpectatorBackend *spec, int queue);
+   static inline GGPOPlayerHandle spec_QueueToSpectatorHandle(SpectatorBackend *spec, int queue) { return (GGPOPlayerHandle)(queue + 1000); }
 
 #endif
@@ -0,0 +1,633 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#include "star.h"
+
+static const int RECOMMENDATION_INTERVAL_USEC = 4000000;
+static const int DRIFT_UPDATE_INTERVAL_USEC = 1000000 / 6;
+static const int DEFAULT_DISCONNECT_TIMEOUT = 5000;
+static const int DEFAULT_DISCONNECT_NOTIFY_START = 750;
+
+static void star_OnMsg(conn_Address from, UdpMsg* msg, int len, void* user_data);
+
+/*
+ * star_Init --
+ *
+ * The part of the constructor shared with the Steam one.
+ */
+static void star_Init(StarBackend *star, GGPOSessionCallbacks *cb, int num_players, int input_size)
+{
+	star->_header._session_type = SESSION_STAR;
+	star->_header._callbacks = *cb;
+	star->_num_players = num_players;
+	star->_input_size = input_size;
+	star->_local_queue = -1;
+	star->_last_merged_frame = GAMEINPUT_NULL_FRAME;
+	star->_synchronizing = true;
+	star->_next_recommended_sleep = 0;
+	star->_next_drift_update = 0;
+	star->_drift_usec = 0;
+	star->_frame_usec = TIMESYNC_DEFAULT_FRAME_USEC;
+
+	sync_ctor(&star->_sync, star->_local_connect_status);
+	sync_Config config = { 0 };
+	config.num_players = num_players;
+	config.input_size = input_size;
+	config.callbacks = star->_header._callbacks;
+	config.num_prediction_frames = MAX_PREDICTION_FRAMES;
+	sync_Init(&star->_sync, &config);
+
+	memset(star->_local_connect_status, 0, sizeof(star->_local_connect_status));
+	for (int i = 0; i < ARRAY_SIZE(star->_local_connect_status); i++) {
+		star->_local_connect_status[i].last_frame = -1;
+	}
+	UdpProtocol_ctor(&star->_server);
+}
+
+/*
+ * star_InitServer --
+ *
+ * The server doesn't need our view of the connect status, it has the
+ * only one which counts.
+ */
+static void star_InitServer(StarBackend *star, conn_Address addr)
+{
+	UdpProtocol_Init(&star->_server, &star->_udp, 0, addr, NULL, star->_input_size);
+	UdpProtocol_SetDisconnectTimeout(&star->_server, DEFAULT_DISCONNECT_TIMEOUT);
+	UdpProtocol_SetDisconnectNotifyStart(&star->_server, DEFAULT_DISCONNECT_NOTIFY_START);
+	UdpProtocol_SetFrameDuration(&star->_server, star->_frame_usec);
+}
+
+#if defined(GGPO_STEAM)
+
+void star_ctor_steam(StarBackend *star, GGPOSessionCallbacks *cb, const char *gamename, int local_channel, int num_players, int input_size, uint64 server_steam_id)
+{
+	star_Init(star, cb, num_players, input_size);
+	udp_ctor(&star->_udp);
+	udp_Init(&star->_udp, (uint16)local_channel, star_OnMsg, star);
+
+	conn_add_known_peer(server_steam_id);
+	star_InitServer(star, conn_address_from_steam_id(server_steam_id));
+
+	/*
+	 * Preload the ROM
+	 */
+	star->_header._callbacks.begin_game(gamename);
+}
+
+#else
+
+/*
+ * star_ctor --
+ *
+ * Binds localport, or attaches to shared under session_id when shared
+ * isn't NULL.
+ */
+void star_ctor(StarBackend *star, GGPOSessionCallbacks *cb, const char *gamename, uint16 localport, UdpSocket *shared, uint16 session_id, int num_players, int input_size, char *serverip, uint16 serverport, uint16 server_session)
+{
+	star_Init(star, cb, num_players, input_size);
+	udp_ctor(&star->_udp);
+	if (shared) {
+		udp_InitShared(&star->_udp, shared, session_id, star_OnMsg, star);
+	} else {
+		udp_Init(&star->_udp, localport, star_OnMsg, star);
+	}
+
+	ASSERT(conn_support_ip_port());
+	star_InitServer(star, conn_address_from_ip_port(star->_udp._socket, serverip, serverport));
+	UdpProtocol_SetRemoteSession(&star->_server, server_session);
+
+	/*
+	 * Preload the ROM
+	 */
+	star->_header._callbacks.begin_game(gamename);
+}
+
+#endif /* GGPO_STEAM */
+
+void star_dtor(StarBackend *star)
+{
+	UdpProtocol_dtor(&star->_server);
+	sync_dtor(&star->_sync);
+	udp_dtor(&star->_udp);
+}
+
+/*
+ * star_AddPlayer --
+ *
+ * Only the local player matters here: we connect to the server once we
+ * know which one it is.  The remote players are reached through the
+ * server, so adding them only hands out their handle.
+ */
+GGPOErrorCode
+star_AddPlayer(StarBackend *star, GGPOPlayer *player, GGPOPlayerHandle *handle)
+{
+	if (player->type == GGPO_PLAYERTYPE_SPECTATOR) {
+		return GGPO_ERRORCODE_UNSUPPORTED;
+	}
+
+	int queue = player->player_num - 1;
+	if (player->player_num < 1 || player->player_num > star->_num_players) {
+		return GGPO_ERRORCODE_PLAYER_OUT_OF_RANGE;
+	}
+	if (player->type == GGPO_PLAYERTYPE_LOCAL) {
+		if (star->_local_queue != -1) {
+			return GGPO_ERRORCODE_INVALID_REQUEST;
+		}
+		star->_local_queue = queue;
+		UdpProtocol_Synchronize(&star->_server);
+	}
+	*handle = star_QueueToPlayerHandle(star, queue);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_DoPoll(StarBackend *star, int timeout)
+{
+	if (sync_InRollback(&star->_sync)) {
+		return GGPO_OK;
+	}
+
+	udp_OnLoopPoll(&star->_udp);
+	UdpProtocol_OnLoopPoll(&star->_server);
+
+	star_PollUdpProtocolEvents(star);
+
+	// nothing below sends, so this is the poll's one datagram to the server
+	UdpProtocol_Flush(&star->_server);
+
+	if (star->_synchronizing) {
+		return GGPO_OK;
+	}
+	sync_CheckSimulation(&star->_sync, timeout);
+
+	int current_frame = sync_GetFrameCount(&star->_sync);
+	UdpProtocol_SetLocalFrameNumber(&star->_server, current_frame);
+
+	star_CheckDisconnects(star);
+
+	// every frame the server merged is confirmed
+	if (star->_last_merged_frame >= 0) {
+		Log("setting confirmed frame in sync to %d.\n", star->_last_merged_frame);
+		sync_SetLastConfirmedFrame(&star->_sync, star->_last_merged_frame);
+	}
+
+	// send timesync notifications if now is the proper time
+	if (current_frame > star->_next_recommended_sleep) {
+		int interval = UdpProtocol_RecommendFrameDelay(&star->_server);
+		if (interval > 0) {
+			GGPOEvent info;
+			info.code = GGPO_EVENTCODE_TIMESYNC;
+			info.u.timesync.frames_ahead = interval;
+			star->_header._callbacks.on_event(&info);
+			star->_next_recommended_sleep = current_frame + star_FramesIn(star, RECOMMENDATION_INTERVAL_USEC);
+		}
+	}
+
+	// the drift correction is continuous, so only report it when it changes
+	if (current_frame >= star->_next_drift_update) {
+		int drift = UdpProtocol_RecommendDrift(&star->_server);
+		star->_next_drift_update = current_frame + star_FramesIn(star, DRIFT_UPDATE_INTERVAL_USEC);
+		if (drift != star->_drift_usec) {
+			GGPOEvent info;
+			info.code = GGPO_EVENTCODE_TIMESYNC_DRIFT;
+			info.u.timesync_drift.usec_per_frame = drift;
+			star->_header._callbacks.on_event(&info);
+			star->_drift_usec = drift;
+		}
+	}
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_AddLocalInput(StarBackend *star, GGPOPlayerHandle player, void *values, int size)
+{
+	int queue;
+	GameInput input;
+	GGPOErrorCode result;
+
+	if (sync_InRollback(&star->_sync)) {
+		return GGPO_ERRORCODE_IN_ROLLBACK;
+	}
+	if (star->_synchronizing) {
+		return GGPO_ERRORCODE_NOT_SYNCHRONIZED;
+	}
+	result = star_PlayerHandleToQueue(star, player, &queue);
+	if (!GGPO_SUCCEEDED(result)) {
+		return result;
+	}
+	if (queue != star->_local_queue) {
+		return GGPO_ERRORCODE_INVALID_PLAYER_HANDLE;
+	}
+
+	gameinput_init(&input, -1, (char*)values, size);
+	if (!sync_AddLocalInput(&star->_sync, queue, &input)) {
+		return GGPO_ERRORCODE_PREDICTION_THRESHOLD;
+	}
+
+	if (input.frame != GAMEINPUT_NULL_FRAME) {
+		// Raising the frame delay mid game pads the queue with copies of
+		// the last input, which the server needs as well.
+		int last_frame = star->_local_connect_status[queue].last_frame;
+		int frame = last_frame == GAMEINPUT_NULL_FRAME ? input.frame : last_frame + 1;
+		for (; frame <= input.frame; frame++) {
+			GameInput padding;
+			GameInput* next = &input;
+			if (frame < input.frame) {
+				sync_GetQueuedInput(&star->_sync, queue, frame, &padding);
+				next = &padding;
+			}
+			star->_local_connect_status[queue].last_frame = frame;
+			UdpProtocol_SendInput(&star->_server, next);
+		}
+	}
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_SyncInput(StarBackend *star, void *values, int size, int *disconnect_flags)
+{
+	int flags;
+
+	// Wait until we've started to return inputs.
+	if (star->_synchronizing) {
+		return GGPO_ERRORCODE_NOT_SYNCHRONIZED;
+	}
+	flags = sync_SynchronizeInputs(&star->_sync, values, size);
+	if (disconnect_flags) {
+		*disconnect_flags = flags;
+	}
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_IncrementFrame(StarBackend *star)
+{
+	Log("End of frame (%d)...\n", sync_GetFrameCount(&star->_sync));
+	sync_IncrementFrame(&star->_sync);
+	star_DoPoll(star, 0);
+	star_PollSyncEvents(star);
+
+	return GGPO_OK;
+}
+
+void
+star_PollSyncEvents(StarBackend *star)
+{
+	sync_Event e;
+	while (sync_GetEvent(&star->_sync, &e)) {
+		// nothing to do with them, like in p2p_OnSyncEvent
+	}
+}
+
+void
+star_PollUdpProtocolEvents(StarBackend *star)
+{
+	udp_protocol_Event evt;
+	while (UdpProtocol_GetEvent(&star->_server, &evt)) {
+		star_OnUdpProtocolEvent(star, &evt);
+	}
+}
+
+/*
+ * star_OnMergedInput --
+ *
+ * Split the merged input of a frame into the input queues of the remote
+ * players.  Our own input in there is the one we sent.  The inputs of a
+ * player who disconnected keep coming until the frame they left at, and
+ * are empty after it, so they are added like any other.
+ */
+void
+star_OnMergedInput(StarBackend *star, GameInput *input)
+{
+	GameInput slice;
+
+	if (input->size != star->_input_size * star->_num_players) {
+		Log("merged input of size %d, expected %d.  Ignoring.\n", input->size, star->_input_size * star->_num_players);
+		return;
+	}
+	ASSERT(star->_last_merged_frame == GAMEINPUT_NULL_FRAME || input->frame == star->_last_merged_frame + 1);
+
+	for (int i = 0; i < star->_num_players; i++) {
+		if (i == star->_local_queue) {
+			continue;
+		}
+		gameinput_init(&slice, input->frame, input->bits + i * star->_input_size, star->_input_size);
+		sync_AddRemoteInput(&star->_sync, i, &slice);
+		if (!star->_local_connect_status[i].disconnected) {
+			star->_local_connect_status[i].last_frame = input->frame;
+		}
+	}
+	star->_last_merged_frame = input->frame;
+}
+
+/*
+ * star_CheckDisconnects --
+ *
+ * Disconnect the players the server says have left.
+ */
+void
+star_CheckDisconnects(StarBackend *star)
+{
+	int last_frame;
+
+	if (!UdpProtocol_IsRunning(&star->_server)) {
+		return;
+	}
+	for (int i = 0; i < star->_num_players; i++) {
+		if (i == star->_local_queue || star->_local_connect_status[i].disconnected) {
+			continue;
+		}
+		if (!UdpProtocol_GetPeerConnectStatus(&star->_server, i, &last_frame)) {
+			Log("disconnecting queue %d by server request.\n", i);
+			star_DisconnectPlayerQueue(star, i, last_frame);
+		}
+	}
+}
+
+void
+star_DisconnectPlayerQueue(StarBackend *star, int queue, int syncto)
+{
+	GGPOEvent info;
+	int framecount = sync_GetFrameCount(&star->_sync);
+
+	Log("Changing queue %d local connect status for last frame from %d to %d on disconnect request (current: %d).\n",
+		queue, star->_local_connect_status[queue].last_frame, syncto, framecount);
+
+	star->_local_connect_status[queue].disconnected = 1;
+	star->_local_connect_status[queue].last_frame = syncto;
+
+	if (syncto < framecount) {
+		Log("adjusting simulation to account for the fact that %d disconnected @ %d.\n", queue, syncto);
+		sync_AdjustSimulation(&star->_sync, syncto);
+		Log("finished adjusting simulation.\n");
+	}
+
+	info.code = GGPO_EVENTCODE_DISCONNECTED_FROM_PEER;
+	info.u.disconnected.player = star_QueueToPlayerHandle(star, queue);
+	star->_header._callbacks.on_event(&info);
+}
+
+/*
+ * star_DisconnectAll --
+ *
+ * We lost the server, and every remote player with it.
+ */
+void
+star_DisconnectAll(StarBackend *star, int syncto)
+{
+	UdpProtocol_Disconnect(&star->_server);
+	for (int i = 0; i < star->_num_players; i++) {
+		if (i != star->_local_queue && !star->_local_connect_status[i].disconnected) {
+			star_DisconnectPlayerQueue(star, i, syncto);
+		}
+	}
+	star_CheckInitialSync(star);
+}
+
+/*
+ * star_NotifyRemotePlayers --
+ *
+ * Everything happening to the link with the server happens to all the
+ * remote players at once, so report it for each of them.
+ */
+void
+star_NotifyRemotePlayers(StarBackend *star, GGPOEvent *info, GGPOPlayerHandle *player)
+{
+	for (int i = 0; i < star->_num_players; i++) {
+		if (i != star->_local_queue && !star->_local_connect_status[i].disconnected) {
+			*player = star_QueueToPlayerHandle(star, i);
+			star->_header._callbacks.on_event(info);
+		}
+	}
+}
+
+void
+star_OnUdpProtocolEvent(StarBackend *star, udp_protocol_Event *evt)
+{
+	GGPOEvent info;
+
+	switch (evt->type) {
+	case UdpProtocol_Event_Connected:
+		info.code = GGPO_EVENTCODE_CONNECTED_TO_PEER;
+		star_NotifyRemotePlayers(star, &info, &info.u.connected.player);
+		break;
+	case UdpProtocol_Event_Synchronizing:
+		info.code = GGPO_EVENTCODE_SYNCHRONIZING_WITH_PEER;
+		info.u.synchronizing.count = evt->u.synchronizing.count;
+		info.u.synchronizing.total = evt->u.synchronizing.total;
+		star_NotifyRemotePlayers(star, &info, &info.u.synchronizing.player);
+		break;
+	case UdpProtocol_Event_Synchronzied:
+		info.code = GGPO_EVENTCODE_SYNCHRONIZED_WITH_PEER;
+		star_NotifyRemotePlayers(star, &info, &info.u.synchronized.player);
+		star_CheckInitialSync(star);
+		break;
+	case UdpProtocol_Event_NetworkInterrupted:
+		info.code = GGPO_EVENTCODE_CONNECTION_INTERRUPTED;
+		info.u.connection_interrupted.disconnect_timeout = evt->u.network_interrupted.disconnect_timeout;
+		star_NotifyRemotePlayers(star, &info, &info.u.connection_interrupted.player);
+		break;
+	case UdpProtocol_Event_NetworkResumed:
+		info.code = GGPO_EVENTCODE_CONNECTION_RESUMED;
+		star_NotifyRemotePlayers(star, &info, &info.u.connection_resumed.player);
+		break;
+	case UdpProtocol_Event_Input:
+		star_OnMergedInput(star, &evt->u.input.input);
+		break;
+	case UdpProtocol_Event_Disconnected:
+		Log("lost the server at frame %d.\n", star->_last_merged_frame);
+		star_DisconnectAll(star, star->_last_merged_frame);
+		break;
+	case UdpProtocol_Event_State:
+		// Only spectators are sent states.
+		free(evt->u.state.buf);
+		break;
+	case UdpProtocol_Event_Unknown:
+		break;
+	}
+}
+
+/*
+ * star_DisconnectPlayer --
+ *
+ * Only the server can drop another player.  Disconnecting the local player
+ * leaves the game.
+ */
+GGPOErrorCode
+star_DisconnectPlayer(StarBackend *star, GGPOPlayerHandle player)
+{
+	int queue;
+	GGPOErrorCode result;
+
+	result = star_PlayerHandleToQueue(star, player, &queue);
+	if (!GGPO_SUCCEEDED(result)) {
+		return result;
+	}
+	if (queue != star->_local_queue) {
+		return GGPO_ERRORCODE_UNSUPPORTED;
+	}
+	if (UdpProtocol_IsDisconnected(&star->_server)) {
+		return GGPO_ERRORCODE_PLAYER_DISCONNECTED;
+	}
+	Log("Disconnecting local player %d at frame %d by user request.\n", queue, star->_local_connect_status[queue].last_frame);
+	star_DisconnectAll(star, sync_GetFrameCount(&star->_sync));
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_GetNetworkStats(StarBackend *star, GGPONetworkStats *stats, GGPOPlayerHandle player)
+{
+	int queue;
+	GGPOErrorCode result;
+
+	memset(stats, 0, sizeof * stats);
+
+	result = star_PlayerHandleToQueue(star, player, &queue);
+	if (!GGPO_SUCCEEDED(result)) {
+		return result;
+	}
+	UdpProtocol_GetNetworkStats(&star->_server, stats);
+	if (queue != star->_local_queue) {
+		sync_GetPredictionStats(&star->_sync, queue, stats);
+	}
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_SetFrameDelay(StarBackend *star, GGPOPlayerHandle player, int delay)
+{
+	int queue;
+	GGPOErrorCode result;
+
+	result = star_PlayerHandleToQueue(star, player, &queue);
+	if (!GGPO_SUCCEEDED(result)) {
+		return result;
+	}
+	sync_SetFrameDelay(&star->_sync, queue, delay);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_SetInputPredictor(StarBackend *star, GGPOPlayerHandle player, GGPOInputPredictor predictor, const void *release_mask, int size)
+{
+	int queue;
+	GGPOErrorCode result;
+
+	switch (predictor) {
+	case GGPO_PREDICTOR_REPEAT_LAST:
+	case GGPO_PREDICTOR_MARKOV:
+		break;
+	case GGPO_PREDICTOR_RELEASE_BUTTONS:
+		if (!release_mask || size <= 0 || size > star->_input_size) {
+			return GGPO_ERRORCODE_INVALID_REQUEST;
+		}
+		break;
+	case GGPO_PREDICTOR_CALLBACK:
+		if (!star->_header._callbacks.predict_input) {
+			return GGPO_ERRORCODE_INVALID_REQUEST;
+		}
+		break;
+	default:
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	result = star_PlayerHandleToQueue(star, player, &queue);
+	if (!GGPO_SUCCEEDED(result)) {
+		return result;
+	}
+	sync_SetInputPredictor(&star->_sync, queue, predictor, release_mask, size, player);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_SetInputRelevance(StarBackend *star, GGPOPlayerHandle player, const void *mask, int size)
+{
+	int queue;
+	GGPOErrorCode result;
+
+	if (mask && (size <= 0 || size > star->_input_size)) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	result = star_PlayerHandleToQueue(star, player, &queue);
+	if (!GGPO_SUCCEEDED(result)) {
+		return result;
+	}
+	sync_SetInputRelevance(&star->_sync, queue, mask, size);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_SetFrameDuration(StarBackend *star, int usec)
+{
+	if (usec <= 0) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	star->_frame_usec = usec;
+	UdpProtocol_SetFrameDuration(&star->_server, star->_frame_usec);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_SetDisconnectTimeout(StarBackend *star, int timeout)
+{
+	UdpProtocol_SetDisconnectTimeout(&star->_server, timeout);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_SetDisconnectNotifyStart(StarBackend *star, int timeout)
+{
+	UdpProtocol_SetDisconnectNotifyStart(&star->_server, timeout);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_SetPathMtu(StarBackend *star, int mtu)
+{
+	UdpProtocol_SetPathMtu(&star->_server, mtu);
+	return GGPO_OK;
+}
+
+GGPOErrorCode
+star_PlayerHandleToQueue(StarBackend *star, GGPOPlayerHandle player, int *queue)
+{
+	int offset = ((int)player - 1);
+	if (offset < 0 || offset >= star->_num_players) {
+		return GGPO_ERRORCODE_INVALID_PLAYER_HANDLE;
+	}
+	*queue = offset;
+	return GGPO_OK;
+}
+
+static void star_OnMsg(conn_Address from, UdpMsg* msg, int len, void* user_data)
+{
+	StarBackend* star = (StarBackend*)user_data;
+	if (UdpProtocol_HandlesMsg(&star->_server, from, msg)) {
+		UdpProtocol_OnMsg(&star->_server, msg, len);
+	}
+}
+
+void
+star_CheckInitialSync(StarBackend *star)
+{
+	if (star->_synchronizing) {
+		GGPOEvent info;
+		info.code = GGPO_EVENTCODE_RUNNING;
+		star->_header._callbacks.on_event(&info);
+		star->_synchronizing = false;
+	}
+}
@@ -0,0 +1,93 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#ifndef _STAR_H
+#define _STAR_H
+
+#include "types.h"
+#include "sync.h"
+#include "backend.h"
+#include "timesync.h"
+#include "network/udp_proto.h"
+
+/*
+ * star.h --
+ *
+ * A player of a star session.  Instead of sending their input to every
+ * other player, the player sends it to an input server (see
+ * input_server.h) and receives the merged input of everyone from it.
+ * Rollback works as in a peer to peer session: the inputs of the other
+ * players are predicted until the merged input for their frame comes in.
+ * The server decides when a player is disconnected.
+ */
+
+struct StarBackend {
+	GGPOSessionHeader _header;
+
+   Sync                  _sync;
+   Udp                   _udp;
+   UdpProtocol           _server;
+   bool                  _synchronizing;
+   int                   _num_players;
+   int                   _input_size;
+   int                   _local_queue;
+   int                   _last_merged_frame;
+   int                   _next_recommended_sleep;
+   int                   _next_drift_update;
+   int                   _drift_usec;
+   int                   _frame_usec;
+
+   UdpMsg_connect_status _local_connect_status[UDP_MSG_MAX_PLAYERS];
+};
+typedef struct StarBackend StarBackend;
+
+#if defined(GGPO_STEAM)
+void star_ctor_steam(StarBackend *star, GGPOSessionCallbacks *cb, const char *gamename, int local_channel, int num_players, int input_size, uint64 server_steam_id);
+#else
+void star_ctor(StarBackend *star, GGPOSessionCallbacks *cb, const char *gamename, uint16 localport, UdpSocket *shared, uint16 session_id, int num_players, int input_size, char *serverip, uint16 serverport, uint16 server_session);
+#endif
+void star_dtor(StarBackend *star);
+
+GGPOErrorCode star_DoPoll(StarBackend *star, int timeout);
+GGPOErrorCode star_AddPlayer(StarBackend *star, GGPOPlayer *player, GGPOPlayerHandle *handle);
+GGPOErrorCode star_AddLocalInput(StarBackend *star, GGPOPlayerHandle player, void *values, int size);
+GGPOErrorCode star_SyncInput(StarBackend *star, void *values, int size, int *disconnect_flags);
+GGPOErrorCode star_IncrementFrame(StarBackend *star);
+GGPOErrorCode star_DisconnectPlayer(StarBackend *star, GGPOPlayerHandle handle);
+GGPOErrorCode star_GetNetworkStats(StarBackend *star, GGPONetworkStats *stats, GGPOPlayerHandle handle);
+GGPOErrorCode star_SetFrameDelay(StarBackend *star, GGPOPlayerHandle player, int delay);
+GGPOErrorCode star_SetFrameDuration(StarBackend *star, int usec);
+GGPOErrorCode star_SetInputPredictor(StarBackend *star, GGPOPlayerHandle player, GGPOInputPredictor predictor, const void *release_mask, int size);
+GGPOErrorCode star_SetInputRelevance(StarBackend *star, GGPOPlayerHandle player, const void *mask, int size);
+GGPOErrorCode star_SetDisconnectTimeout(StarBackend *star, int timeout);
+GGPOErrorCode star_SetDisconnectNotifyStart(StarBackend *star, int timeout);
+GGPOErrorCode star_SetPathMtu(StarBackend *star, int mtu);
+
+GGPOErrorCode star_PlayerHandleToQueue(StarBackend *star, GGPOPlayerHandle player, int *queue);
+static inline GGPOPlayerHandle star_QueueToPlayerHandle(StarBackend *star, int queue) { return (GGPOPlayerHandle)(queue + 1); }
+static inline int star_FramesIn(StarBackend *star, int usec) { return MAX(1, usec / star->_frame_usec); }
+void star_OnMergedInput(StarBackend *star, GameInput *input);
+void star_CheckDisconnects(StarBackend *star);
+void star_DisconnectPlayerQueue(StarBackend *star, int queue, int syncto);
+void star_DisconnectAll(StarBackend *star, int syncto);
+void star_PollSyncEvents(StarBackend *star);
+void star_PollUdpProtocolEvents(StarBackend *star);
+void star_OnUdpProtocolEvent(StarBackend *star, udp_protocol_Event *e);
+void star_NotifyRemotePlayers(StarBackend *star, GGPOEvent *info, GGPOPlayerHandle *player);
+void star_CheckInitialSync(StarBackend *star);
+
+#endif
@@ -36,6 +36,7 @@ void synctest_ctor(SyncTestBackend *synctest, GGPOSessionCallbacks *cb, char *ga
    synctest->_rollingback = false;
    synctest->_running = false;
    synctest->_logfp = NULL;
+   synctest->_logging = Platform_GetConfigBool("ggpo.log");
    gameinput_erase(&synctest->_current_input);
    strcpy(synctest->_game, gamename);
    ring_ctor(&synctest->_saved_frames_ring, ARRAY_SIZE(synctest->_saved_frames));
@@ -57,7 +58,12 @@ void synctest_ctor(SyncTestBackend *synctest, GGPOSessionCallbacks *cb, char *ga
 
 void synctest_dtor(SyncTestBackend* synctest)
 {
-
+   synctest_EndLog(synctest);
+   while (!ring_empty(&synctest->_saved_frames_ring)) {
+      free(synctest->_saved_frames[ring_front(&synctest->_saved_frames_ring)].buf);
+      ring_pop(&synctest->_saved_frames_ring);
+   }
+   sync_dtor(&synctest->_sync);
 }
 
 GGPOErrorCode
@@ -166,7 +172,7 @@ synctest_IncrementFrame(SyncTestBackend *synctest)
             synctest_LogSaveStates(synctest, &info);
             synctest_RaiseSyncError(synctest, "Checksum for frame %d does not match saved (%d != %d)", frame, checksum, info.checksum);
          }
-         printf("Checksum %08d for frame %d matches.\n", checksum, info.frame);
+         Log("Checksum %08d for frame %d matches.\n", checksum, info.frame);
          free(info.buf);
       }
       synctest->_last_verified = frame;
@@ -207,13 +213,17 @@ synctest_BeginLog(SyncTestBackend *synctest, int saving)
 {
    synctest_EndLog(synctest);
 
+   /*
+    * Opening a log file every frame is far too slow to leave on all the
+    * time, so only do it when logging has been requested.
+    */
+   if (!synctest->_logging) {
+      return;
+   }
+
    char filename[MAX_PATH];
-#if defined(_WINDOWS)
-   CreateDirectoryA("synclogs", NULL);
-#else
-   ASSERT(false);
-#endif
-   snprintf(filename, ARRAY_SIZE(filename), "synclogs\\%s-%04d-%s.log",
+   Platform_CreateDirectory("synclogs");
+   snprintf(filename, ARRAY_SIZE(filename), "synclogs/%s-%04d-%s.log",
            saving ? "state" : "log",
            sync_GetFrameCount(&synctest->_sync),
            synctest->_rollingback ? "replay" : "original");
@@ -234,9 +244,9 @@ void
 synctest_LogSaveStates(SyncTestBackend *synctest, synctest_SavedInfo *info)
 {
    char filename[MAX_PATH];
-   snprintf(filename, ARRAY_SIZE(filename), "synclogs\\state-%04d-original.log", sync_GetFrameCount(&synctest->_sync));
+   snprintf(filename, ARRAY_SIZE(filename), "synclogs/state-%04d-original.log", sync_GetFrameCount(&synctest->_sync));
    synctest->_header._callbacks.log_game_state(filename, (unsigned char *)info->buf, info->cbuf);
 
-   snprintf(filename, ARRAY_SIZE(filename), "synclogs\\state-%04d-replay.log", sync_GetFrameCount(&synctest->_sync));
+   snprintf(filename, ARRAY_SIZE(filename), "synclogs/state-%04d-replay.log", sync_GetFrameCount(&synctest->_sync));
    synctest->_header._callbacks.log_game_state(filename, sync_GetLastSavedFrame(&synctest->_sync)->buf, sync_GetLastSavedFrame(&synctest->_sync)->cbuf);
 }
@@ -48,6 +48,7 @@ struct SyncTestBackend {
    int                    _last_verified;
    bool                   _rollingback;
    bool                   _running;
+   bool                   _logging;
    FILE                   *_logfp;
    char                   _game[128];
 
@@ -67,15 +68,12 @@ struct SyncTestBackend {
    GGPOErrorCode synctest_AddLocalInput(SyncTestBackend *synctest, GGPOPlayerHandle player, void *values, int size);
    GGPOErrorCode synctest_SyncInput(SyncTestBackend *synctest, void *values, int size, int *disconnect_flags);
    GGPOErrorCode synctest_IncrementFrame(SyncTestBackend *synctest);
-   inline GGPOErrorCode synctest_DisconnectPlayer(SyncTestBackend *synctest,GGPOPlayerHandle handle) { return GGPO_OK; }
-   inline GGPOErrorCode synctest_GetNetworkStats(SyncTestBackend *synctest,GGPONetworkStats* stats, GGPOPlayerHandle handle) { return GGPO_OK; }
+   static inline GGPOErrorCode synctest_DisconnectPlayer(SyncTestBackend *synctest,GGPOPlayerHandle handle) { return GGPO_OK; }
+   static inline GGPOErrorCode synctest_GetNetworkStats(SyncTestBackend *synctest,GGPONetworkStats* stats, GGPOPlayerHandle handle) { return GGPO_OK; }
    GGPOErrorCode synctest_Logv(SyncTestBackend *synctest, char const *fmt, va_list list);
 
 
 
-   	inline GGPOErrorCode synctest_SetFrameDelay(SyncTestBackend *synctest,GGPOPlayerHandle player, int delay) { return GGPO_ERRORCODE_UNSUPPORTED; }
-	inline GGPOErrorCode synctest_SetDisconnectTimeout(SyncTestBackend *synctest,int timeout) { return GGPO_ERRORCODE_UNSUPPORTED; }
-	inline GGPOErrorCode synctest_SetDisconnectNotifyStart(SyncTestBackend *synctest,int timeout) { return GGPO_ERRORCODE_UNSUPPORTED; }
    
    void synctest_RaiseSyncError(SyncTestBackend *synctest, const char *fmt, ...);
    void synctest_BeginLog(SyncTestBackend *synctest, int saving);
@@ -25,9 +25,20 @@ BitVector_ClearBit(uint8 *vector, int *offset)
 void
 BitVector_WriteNibblet(uint8 *vector, int nibble, int *offset)
 {
-   ASSERT(nibble < (1 << BITVECTOR_NIBBLE_SIZE));
-   for (int i = 0; i < BITVECTOR_NIBBLE_SIZE; i++) {
-      if (nibble & (1 << i)) {
+   BitVector_WriteBits(vector, nibble, BITVECTOR_NIBBLE_SIZE, offset);
+}
+
+/*
+ * BitVector_WriteBits --
+ *
+ * Write the low count bits of value, least significant first.
+ */
+void
+BitVector_WriteBits(uint8 *vector, int value, int count, int *offset)
+{
+   ASSERT(value < (1 << count));
+   for (int i = 0; i < count; i++) {
+      if (value & (1 << i)) {
          BitVector_SetBit(vector, offset);
       } else {
          BitVector_ClearBit(vector, offset);
@@ -46,10 +57,16 @@ BitVector_ReadBit(uint8 *vector, int *offset)
 int
 BitVector_ReadNibblet(uint8 *vector, int *offset)
 {
-   int nibblet = 0;
-   for (int i = 0; i < BITVECTOR_NIBBLE_SIZE; i++) {
-      nibblet |= (BitVector_ReadBit(vector, offset) << i);
+   return BitVector_ReadBits(vector, BITVECTOR_NIBBLE_SIZE, offset);
+}
+
+int
+BitVector_ReadBits(uint8 *vector, int count, int *offset)
+{
+   int value = 0;
+   for (int i = 0; i < count; i++) {
+      value |= (BitVector_ReadBit(vector, offset) << i);
    }
-   return nibblet;
+   return value;
 }
 
@@ -13,7 +13,9 @@
 void BitVector_SetBit(uint8 *vector, int *offset);
 void BitVector_ClearBit(uint8 *vector, int *offset);
 void BitVector_WriteNibblet(uint8 *vector, int nibble, int *offset);
+void BitVector_WriteBits(uint8 *vector, int value, int count, int *offset);
 int BitVector_ReadBit(uint8 *vector, int *offset);
 int BitVector_ReadNibblet(uint8 *vector, int *offset);
+int BitVector_ReadBits(uint8 *vector, int count, int *offset);
 
 #endif // _BITVECTOR_H
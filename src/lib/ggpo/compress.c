@@ -0,0 +1,182 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#include "compress.h"
+
+#define COMPRESS_HASH_BITS     12
+
+static uint32 compress_Read32(const byte* p)
+{
+	return (uint32)p[0] | ((uint32)p[1] << 8) | ((uint32)p[2] << 16) | ((uint32)p[3] << 24);
+}
+
+static int compress_Hash(const byte* p)
+{
+	return (int)((compress_Read32(p) * 2654435761u) >> (32 - COMPRESS_HASH_BITS));
+}
+
+static byte* compress_WriteLength(byte* out, int length)
+{
+	while (length >= 255) {
+		*out++ = 255;
+		length -= 255;
+	}
+	*out++ = (byte)length;
+	return out;
+}
+
+static byte* compress_WriteBlock(byte* out, const byte* literals, int num_literals, int offset, int match_length)
+{
+	byte* token = out++;
+	int match_code = match_length ? match_length - COMPRESS_MIN_MATCH : 0;
+
+	*token = (byte)((MIN(num_literals, 15) << 4) | MIN(match_code, 15));
+	if (num_literals >= 15) {
+		out = compress_WriteLength(out, num_literals - 15);
+	}
+	memcpy(out, literals, num_literals);
+	out += num_literals;
+	if (match_length) {
+		*out++ = (byte)(offset & 0xFF);
+		*out++ = (byte)(offset >> 8);
+		if (match_code >= 15) {
+			out = compress_WriteLength(out, match_code - 15);
+		}
+	}
+	return out;
+}
+
+/*
+ * compress_Encode --
+ *
+ * Compress size bytes of src into dst.  Returns the compressed size, or -1
+ * if dst is smaller than compress_Bound(size).
+ */
+int
+compress_Encode(const byte* src, int size, byte* dst, int capacity)
+{
+	int table[1 << COMPRESS_HASH_BITS];
+	const byte* literals = src;
+	byte* out = dst;
+	int i = 0;
+
+	if (capacity < compress_Bound(size)) {
+		return -1;
+	}
+	for (i = 0; i < (int)ARRAY_SIZE(table); i++) {
+		table[i] = -1;
+	}
+
+	i = 0;
+	while (i + COMPRESS_MIN_MATCH <= size) {
+		int h = compress_Hash(src + i);
+		int candidate = table[h];
+		table[h] = i;
+
+		if (candidate < 0 || i - candidate > COMPRESS_MAX_OFFSET ||
+			compress_Read32(src + candidate) != compress_Read32(src + i)) {
+			i++;
+			continue;
+		}
+
+		int length = COMPRESS_MIN_MATCH;
+		while (i + length < size && src[candidate + length] == src[i + length]) {
+			length++;
+		}
+		out = compress_WriteBlock(out, literals, (int)(src + i - literals), i - candidate, length);
+		i += length;
+		literals = src + i;
+	}
+	out = compress_WriteBlock(out, literals, (int)(src + size - literals), 0, 0);
+	return (int)(out - dst);
+}
+
+/*
+ * compress_ReadLength --
+ *
+ * Add the extra length bytes at *in to *length.  A run of 255s could push
+ * the length past any buffer, and eventually past INT_MAX, so the stream is
+ * rejected as soon as it would exceed limit.
+ */
+static bool compress_ReadLength(const byte** in, const byte* end, int limit, int* length)
+{
+	byte b;
+	do {
+		if (*in >= end) {
+			return false;
+		}
+		b = *(*in)++;
+		if (b > limit - *length) {
+			return false;
+		}
+		*length += b;
+	} while (b == 255);
+	return true;
+}
+
+/*
+ * compress_Decode --
+ *
+ * Decompress size bytes of src into dst.  Returns the decompressed size, or
+ * -1 if the stream is malformed or does not fit in dst.
+ */
+int
+compress_Decode(const byte* src, int size, byte* dst, int capacity)
+{
+	const byte* in = src;
+	const byte* end = src + size;
+	byte* out = dst;
+
+	while (in < end) {
+		byte token = *in++;
+		int num_literals = token >> 4;
+		int match_length = token & 15;
+
+		if (num_literals == 15 &&
+			!compress_ReadLength(&in, end, (int)MIN(end - in, capacity - (out - dst)), &num_literals)) {
+			return -1;
+		}
+		if (num_literals > end - in || num_literals > capacity - (out - dst)) {
+			return -1;
+		}
+		memcpy(out, in, num_literals);
+		in += num_literals;
+		out += num_literals;
+		if (in == end) {
+			break;
+		}
+
+		if (end - in < 2) {
+			return -1;
+		}
+		int offset = in[0] | (in[1] << 8);
+		in += 2;
+		if (match_length == 15 &&
+			!compress_ReadLength(&in, end, (int)(capacity - (out - dst)) - COMPRESS_MIN_MATCH, &match_length)) {
+			return -1;
+		}
+		match_length += COMPRESS_MIN_MATCH;
+		if (offset == 0 || offset > out - dst || match_length > capacity - (out - dst)) {
+			return -1;
+		}
+		/* Matches may overlap their own output, so copy byte by byte. */
+		for (int i = 0; i < match_length; i++, out++) {
+			*out = *(out - offset);
+		}
+	}
+	return (int)(out - dst);
+}
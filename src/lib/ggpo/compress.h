@@ -0,0 +1,37 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#ifndef _COMPRESS_H
+#define _COMPRESS_H
+
+#include "types.h"
+
+/*
+ * A small LZ77 codec used to shrink game states before sending them over the
+ * network.  The stream is a sequence of blocks, each made of a token byte
+ * (literal count in the high nibble, match length - COMPRESS_MIN_MATCH in the
+ * low nibble), the extra length bytes when a nibble is saturated, the literal
+ * bytes and a 16 bit match offset.  The last block only holds literals.
+ */
+#define COMPRESS_MIN_MATCH     4
+#define COMPRESS_MAX_OFFSET    0xFFFF
+
+static inline int compress_Bound(int size) { return size + size / 255 + 16; }
+int compress_Encode(const byte* src, int size, byte* dst, int capacity);
+int compress_Decode(const byte* src, int size, byte* dst, int capacity);
+
+#endif
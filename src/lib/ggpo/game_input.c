@@ -23,6 +23,7 @@
 
 #include "types.h"
 #include "game_input.h"
+#include "bitvector.h"
 #include "log.h"
 
 
@@ -41,23 +42,26 @@ void gameinput_init(GameInput* input, int iframe, char* ibits, int isize)
 void gameinput_desc(GameInput const* input, char* buf, size_t buf_size, bool show_frame)
 {
 	ASSERT(input->size);
-	size_t remaining = buf_size;
+	size_t len;
 	if (show_frame) {
-		remaining -= snprintf(buf, buf_size, "(frame:%d size:%d ", input->frame, input->size);
+		len = snprintf(buf, buf_size, "(frame:%d size:%d ", input->frame, input->size);
 	}
 	else {
-		remaining -= snprintf(buf, buf_size, "(size:%d ", input->size);
+		len = snprintf(buf, buf_size, "(size:%d ", input->size);
 	}
 
-	for (int i = 0; i < input->size * 8; i++) {
-		char buf2[16];
+	/*
+	 * Wide inputs can set more bits than fit in the buffer, so the list is
+	 * cut short rather than written past the end.
+	 */
+	for (int i = 0; i < input->size * 8 && len < buf_size; i++) {
 		if (gameinput_value(input, i)) {
-			int c = snprintf(buf2, ARRAY_SIZE(buf2), "%2d ", i);
-			strncat_s(buf, remaining, buf2, ARRAY_SIZE(buf2));
-			remaining -= c;
+			len += snprintf(buf + len, buf_size - len, "%2d ", i);
 		}
 	}
-	strncat_s(buf, remaining, ")", 1);
+	if (len < buf_size) {
+		snprintf(buf + len, buf_size - len, ")");
+	}
 }
 
 void gameinput_log(GameInput const* input, char* prefix, bool show_frame)
@@ -65,8 +69,8 @@ void gameinput_log(GameInput const* input, char* prefix, bool show_frame)
 	char buf[1024];
 	size_t c = strlen(prefix);
 	strncpy(buf, prefix, c);
-	gameinput_desc(input, buf + c, ARRAY_SIZE(buf) - c, show_frame);
-	strncat_s(buf, ARRAY_SIZE(buf) - strlen(buf), "\n", 1);
+	gameinput_desc(input, buf + c, ARRAY_SIZE(buf) - c - 1, show_frame);
+	strcat(buf, "\n");
 	Log(buf);
 }
 
@@ -86,3 +90,144 @@ bool gameinput_equal(GameInput const* input, GameInput const* other, bool bitson
 		input->size == other->size &&
 		memcmp(input->bits, other->bits, input->size) == 0;
 }
+
+/*
+ * gameinput_equal_masked --
+ *
+ * Whether the bits of input and other set in mask are the same.  mask
+ * holds input->size bytes.
+ */
+bool gameinput_equal_masked(GameInput const* input, GameInput const* other, char const* mask)
+{
+	ASSERT(input->size == other->size);
+	for (int i = 0; i < input->size; i++) {
+		if ((input->bits[i] ^ other->bits[i]) & mask[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+ * gameinput_index_bits --
+ *
+ * Number of bits used to send the index of a bit of an input of size
+ * bytes.  Inputs of up to 256 bits use a nibblet, so their encoding is the
+ * same as it always was; bigger ones get as many bits as they need.
+ */
+int gameinput_index_bits(int size)
+{
+	int count = BITVECTOR_NIBBLE_SIZE;
+	while ((1 << count) < size * 8) {
+		count++;
+	}
+	return count;
+}
+
+/*
+ * gameinput_encode_delta --
+ *
+ * Write the bits of current which differ from last, the way inputs are sent
+ * over the network: a set bit, the new value and the index of each bit which
+ * changed, then a cleared bit.
+ */
+void gameinput_encode_delta(GameInput const* current, GameInput const* last, uint8* bits, int* offset)
+{
+	if (memcmp(current->bits, last->bits, current->size) != 0) {
+		int index_bits = gameinput_index_bits(current->size);
+		for (int i = 0; i < current->size * 8; i++) {
+			if (gameinput_value(current, i) != gameinput_value(last, i)) {
+				BitVector_SetBit(bits, offset);
+				(gameinput_value(current, i) ? BitVector_SetBit : BitVector_ClearBit)(bits, offset);
+				BitVector_WriteBits(bits, i, index_bits, offset);
+			}
+		}
+	}
+	BitVector_ClearBit(bits, offset);
+}
+
+/*
+ * gameinput_delta_bits --
+ *
+ * Number of bits gameinput_encode_delta writes for current against last.
+ */
+int gameinput_delta_bits(GameInput const* current, GameInput const* last)
+{
+	int changed = 0;
+
+	if (memcmp(current->bits, last->bits, current->size) != 0) {
+		for (int i = 0; i < current->size * 8; i++) {
+			changed += gameinput_value(current, i) != gameinput_value(last, i);
+		}
+	}
+	return 1 + changed * (2 + gameinput_index_bits(current->size));
+}
+
+/*
+ * gameinput_encode_raw --
+ *
+ * Write every bit of input, for when the delta against the last input
+ * would take more room (see gameinput_delta_bits).
+ */
+void gameinput_encode_raw(GameInput const* input, uint8* bits, int* offset)
+{
+	for (int i = 0; i < input->size * 8; i++) {
+		(gameinput_value(input, i) ? BitVector_SetBit : BitVector_ClearBit)(bits, offset);
+	}
+}
+
+/*
+ * gameinput_decode_raw --
+ *
+ * Read the bits of input written by gameinput_encode_raw, reading no
+ * further than num_bits.  Returns false if they are cut short.
+ */
+bool gameinput_decode_raw(GameInput* input, uint8* bits, int num_bits, int* offset)
+{
+	if (*offset + input->size * 8 > num_bits) {
+		return false;
+	}
+	for (int i = 0; i < input->size * 8; i++) {
+		if (BitVector_ReadBit(bits, offset)) {
+			gameinput_set(input, i);
+		}
+		else {
+			gameinput_clear(input, i);
+		}
+	}
+	return true;
+}
+
+/*
+ * gameinput_decode_delta --
+ *
+ * Apply a delta written by gameinput_encode_delta to input, reading no
+ * further than num_bits.  Returns false if the delta is malformed.
+ */
+bool gameinput_decode_delta(GameInput* input, uint8* bits, int num_bits, int* offset)
+{
+	int index_bits = gameinput_index_bits(input->size);
+
+	for (;;) {
+		if (*offset >= num_bits) {
+			return false;
+		}
+		if (!BitVector_ReadBit(bits, offset)) {
+			return true;
+		}
+		if (*offset + 1 + index_bits > num_bits) {
+			return false;
+		}
+		int on = BitVector_ReadBit(bits, offset);
+		int button = BitVector_ReadBits(bits, index_bits, offset);
+		if (button >= input->size * 8) {
+			return false;
+		}
+		if (on) {
+			gameinput_set(input, button);
+		}
+		else {
+			gameinput_clear(input, button);
+		}
+	}
+}
@@ -26,12 +26,15 @@
 
 #include <stdio.h>
 #include <memory.h>
+#include "ggponet.h"
 
- // GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS * 8 must be less than
- // 2^BITVECTOR_NIBBLE_SIZE (see bitvector.h)
+ // GAMEINPUT_MAX_BYTES is the most a single player may send, and a GameInput
+ // holds the merged inputs of up to GAMEINPUT_MAX_PLAYERS of them.  Inputs
+ // are stored and sent sized to their input_size, so a GameInput is only
+ // ever used as a temporary.
 
-#define GAMEINPUT_MAX_BYTES      9
-#define GAMEINPUT_MAX_PLAYERS    2
+#define GAMEINPUT_MAX_BYTES      GGPO_MAX_INPUT_SIZE
+#define GAMEINPUT_MAX_PLAYERS    GGPO_MAX_PLAYERS
 #define GAMEINPUT_NULL_FRAME -1
 
 struct GameInput 
@@ -44,12 +47,19 @@ struct GameInput
 typedef struct GameInput GameInput;
 
 void gameinput_init(GameInput* input, int frame, char* bits, int size);
-inline bool gameinput_value(GameInput const* input, int i) { return (input->bits[i / 8] & (1 << (i % 8))) != 0; }
-inline void gameinput_set(GameInput* input, int i) { input->bits[i / 8] |= (1 << (i % 8)); }
-inline void gameinput_clear(GameInput* input, int i) { input->bits[i / 8] &= ~(1 << (i % 8)); }
-inline void gameinput_erase(GameInput* input) { memset(input->bits, 0, sizeof(input->bits)); }
+static inline bool gameinput_value(GameInput const* input, int i) { return (input->bits[i / 8] & (1 << (i % 8))) != 0; }
+static inline void gameinput_set(GameInput* input, int i) { input->bits[i / 8] |= (1 << (i % 8)); }
+static inline void gameinput_clear(GameInput* input, int i) { input->bits[i / 8] &= ~(1 << (i % 8)); }
+static inline void gameinput_erase(GameInput* input) { memset(input->bits, 0, sizeof(input->bits)); }
 void gameinput_desc(GameInput const* input, char* buf, size_t buf_size, bool show_frame/*= true*/);
 void gameinput_log(GameInput const* input, char* prefix, bool show_frame/* = true */);
 bool gameinput_equal(GameInput const* a, GameInput const* b, bool bitsonly/* = false*/);
+bool gameinput_equal_masked(GameInput const* a, GameInput const* b, char const* mask);
+int gameinput_index_bits(int size);
+void gameinput_encode_delta(GameInput const* current, GameInput const* last, uint8* bits, int* offset);
+bool gameinput_decode_delta(GameInput* input, uint8* bits, int num_bits, int* offset);
+int gameinput_delta_bits(GameInput const* current, GameInput const* last);
+void gameinput_encode_raw(GameInput const* input, uint8* bits, int* offset);
+bool gameinput_decode_raw(GameInput* input, uint8* bits, int num_bits, int* offset);
 
 #endif
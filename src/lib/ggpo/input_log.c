@@ -0,0 +1,74 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#include "input_log.h"
+
+void
+input_log_Init(InputLog* log, int first_frame)
+{
+	log->_first_frame = first_frame;
+	log->_next_frame = first_frame;
+}
+
+void
+input_log_dtor(InputLog* log)
+{
+	free(log->_bits);
+	log->_bits = NULL;
+	log->_input_size = 0;
+}
+
+void
+input_log_Append(InputLog* log, GameInput* input)
+{
+	ASSERT(input->frame == log->_next_frame);
+	ASSERT(!input_log_IsFull(log));
+
+	if (!log->_bits) {
+		log->_input_size = input->size;
+		log->_bits = malloc(INPUT_LOG_LENGTH * input->size);
+	}
+	ASSERT(input->size == log->_input_size);
+	memcpy(log->_bits + (log->_next_frame % INPUT_LOG_LENGTH) * log->_input_size, input->bits, log->_input_size);
+	log->_next_frame++;
+}
+
+/*
+ * input_log_Get --
+ *
+ * Copy frame into input.  Returns false if the log doesn't hold it.
+ */
+bool
+input_log_Get(InputLog* log, int frame, GameInput* input)
+{
+	if (!input_log_Has(log, frame)) {
+		return false;
+	}
+	gameinput_init(input, frame, log->_bits + (frame % INPUT_LOG_LENGTH) * log->_input_size, log->_input_size);
+	return true;
+}
+
+/*
+ * input_log_DiscardFrames --
+ *
+ * Drop every frame up to and including frame.
+ */
+void
+input_log_DiscardFrames(InputLog* log, int frame)
+{
+	log->_first_frame = MAX(log->_first_frame, MIN(frame + 1, log->_next_frame));
+}
@@ -0,0 +1,51 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#ifndef _INPUT_LOG_H
+#define _INPUT_LOG_H
+
+#include "types.h"
+#include "game_input.h"
+
+#define INPUT_LOG_LENGTH    256
+
+/*
+ * A window of confirmed inputs shared by every endpoint reading the same
+ * stream (e.g. the spectators of a session).  Readers keep their own cursor
+ * and the owner discards the frames every reader has acknowledged.  The
+ * inputs are stored sized to the stream, which the first append sets.
+ */
+struct InputLog
+{
+	int                  _first_frame;
+	int                  _next_frame;
+	int                  _input_size;
+	char                 *_bits;     /* INPUT_LOG_LENGTH inputs of _input_size bytes */
+};
+typedef struct InputLog InputLog;
+
+void input_log_Init(InputLog* log, int first_frame);
+void input_log_dtor(InputLog* log);
+void input_log_Append(InputLog* log, GameInput* input);
+bool input_log_Get(InputLog* log, int frame, GameInput* input);
+void input_log_DiscardFrames(InputLog* log, int frame);
+static inline bool input_log_Has(InputLog* log, int frame) { return frame >= log->_first_frame && frame < log->_next_frame; }
+static inline int input_log_GetLength(InputLog* log) { return log->_next_frame - log->_first_frame; }
+static inline bool input_log_IsFull(InputLog* log) { return input_log_GetLength(log) == INPUT_LOG_LENGTH; }
+static inline int input_log_GetLastFrame(InputLog* log) { return log->_next_frame - 1; }
+
+#endif
@@ -0,0 +1,162 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#include "input_predictor.h"
+
+static predictor_MarkovEntry* input_predictor_FindEntry(InputPredictor* predictor, char const* bits);
+
+void
+input_predictor_Init(InputPredictor* predictor, int size)
+{
+   ASSERT(size <= PREDICTOR_INPUT_BYTES);
+   memset(predictor, 0, sizeof(*predictor));
+   predictor->_strategy = GGPO_PREDICTOR_REPEAT_LAST;
+   predictor->_size = size;
+}
+
+/*
+ * input_predictor_SetStrategy --
+ *
+ * Switch to another way of predicting.  The Markov model starts learning
+ * from scratch, the statistics are kept so strategies can be compared.
+ */
+void
+input_predictor_SetStrategy(InputPredictor* predictor, GGPOInputPredictor strategy, const void* release_mask, int mask_size,
+                            predictor_PredictInputFunc predict_input, GGPOPlayerHandle player)
+{
+   predictor->_strategy = strategy;
+   predictor->_predict_input = predict_input;
+   predictor->_player = player;
+
+   memset(predictor->_release_mask, 0, sizeof(predictor->_release_mask));
+   if (release_mask) {
+      memcpy(predictor->_release_mask, release_mask, MIN(mask_size, predictor->_size));
+   }
+   memset(predictor->_markov, 0, sizeof(predictor->_markov));
+   predictor->_has_last = false;
+}
+
+/*
+ * input_predictor_Predict --
+ *
+ * Guess the input following last.  prediction comes in as a copy of last,
+ * which is what every strategy falls back to.  The guess is used for every
+ * frame until the next confirmed input arrives.
+ */
+void
+input_predictor_Predict(InputPredictor* predictor, GameInput const* last, GameInput* prediction)
+{
+   predictor_MarkovEntry* entry;
+   int i, best;
+
+   switch (predictor->_strategy) {
+   case GGPO_PREDICTOR_RELEASE_BUTTONS:
+      for (i = 0; i < predictor->_size; i++) {
+         prediction->bits[i] &= ~predictor->_release_mask[i];
+      }
+      break;
+
+   case GGPO_PREDICTOR_MARKOV:
+      entry = input_predictor_FindEntry(predictor, last->bits);
+      if (entry->used && !memcmp(entry->bits, last->bits, predictor->_size)) {
+         best = 0;
+         for (i = 1; i < PREDICTOR_MARKOV_CHOICES; i++) {
+            if (entry->counts[i] > entry->counts[best]) {
+               best = i;
+            }
+         }
+         if (entry->counts[best] > 0) {
+            memcpy(prediction->bits, entry->next[best], predictor->_size);
+         }
+      }
+      break;
+
+   case GGPO_PREDICTOR_CALLBACK:
+      if (!predictor->_predict_input(predictor->_player, last->bits, prediction->bits, predictor->_size)) {
+         memcpy(prediction->bits, last->bits, predictor->_size);
+      }
+      break;
+
+   default:
+      break;
+   }
+}
+
+/*
+ * input_predictor_Learn --
+ *
+ * Feed the confirmed inputs of the player, in order, to the Markov model.
+ */
+void
+input_predictor_Learn(InputPredictor* predictor, GameInput const* input)
+{
+   predictor_MarkovEntry* entry;
+   int i, slot;
+
+   if (predictor->_strategy != GGPO_PREDICTOR_MARKOV) {
+      return;
+   }
+   if (predictor->_has_last) {
+      entry = input_predictor_FindEntry(predictor, predictor->_last_bits);
+      if (!entry->used || memcmp(entry->bits, predictor->_last_bits, predictor->_size)) {
+         memset(entry, 0, sizeof(*entry));
+         entry->used = true;
+         memcpy(entry->bits, predictor->_last_bits, predictor->_size);
+      }
+
+      /*
+       * Count the transition, making room for it in place of the least
+       * frequent one if it's new.
+       */
+      slot = 0;
+      for (i = 0; i < PREDICTOR_MARKOV_CHOICES; i++) {
+         if (entry->counts[i] && !memcmp(entry->next[i], input->bits, predictor->_size)) {
+            slot = i;
+            break;
+         }
+         if (entry->counts[i] < entry->counts[slot]) {
+            slot = i;
+         }
+      }
+      if (i == PREDICTOR_MARKOV_CHOICES) {
+         memcpy(entry->next[slot], input->bits, predictor->_size);
+         entry->counts[slot] = 0;
+      }
+      if (++entry->counts[slot] >= PREDICTOR_MARKOV_MAX_COUNT) {
+         for (i = 0; i < PREDICTOR_MARKOV_CHOICES; i++) {
+            entry->counts[i] /= 2;
+         }
+      }
+   }
+   memcpy(predictor->_last_bits, input->bits, predictor->_size);
+   predictor->_has_last = true;
+}
+
+/*
+ * input_predictor_FindEntry --
+ *
+ * The slot of the Markov table bits hash to.  It may hold another input.
+ */
+static predictor_MarkovEntry*
+input_predictor_FindEntry(InputPredictor* predictor, char const* bits)
+{
+   uint32 hash = 2166136261u;
+   for (int i = 0; i < predictor->_size; i++) {
+      hash = (hash ^ (uint8)bits[i]) * 16777619u;
+   }
+   return &predictor->_markov[hash % PREDICTOR_MARKOV_SIZE];
+}
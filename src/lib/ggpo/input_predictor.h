@@ -0,0 +1,76 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#ifndef _INPUT_PREDICTOR_H
+#define _INPUT_PREDICTOR_H
+
+#include "types.h"
+#include "ggponet.h"
+#include "game_input.h"
+
+/*
+ * The Markov predictor remembers, for the last PREDICTOR_MARKOV_SIZE
+ * distinct inputs of a player, the PREDICTOR_MARKOV_CHOICES inputs which
+ * followed them most often.  The counts are halved whenever one of them
+ * reaches PREDICTOR_MARKOV_MAX_COUNT, so the model keeps up with a player
+ * changing habits.
+ */
+#define PREDICTOR_INPUT_BYTES        GAMEINPUT_MAX_BYTES
+#define PREDICTOR_MARKOV_SIZE        32
+#define PREDICTOR_MARKOV_CHOICES     4
+#define PREDICTOR_MARKOV_MAX_COUNT   64
+
+typedef bool (*predictor_PredictInputFunc)(GGPOPlayerHandle player, const void *last_input, void *prediction, int size);
+
+struct predictor_MarkovEntry
+{
+   bool                 used;
+   char                 bits[PREDICTOR_INPUT_BYTES];
+   char                 next[PREDICTOR_MARKOV_CHOICES][PREDICTOR_INPUT_BYTES];
+   int                  counts[PREDICTOR_MARKOV_CHOICES];
+};
+typedef struct predictor_MarkovEntry predictor_MarkovEntry;
+
+struct InputPredictor
+{
+   GGPOInputPredictor         _strategy;
+   int                        _size;
+   char                       _release_mask[PREDICTOR_INPUT_BYTES];
+   predictor_PredictInputFunc _predict_input;
+   GGPOPlayerHandle           _player;
+
+   predictor_MarkovEntry      _markov[PREDICTOR_MARKOV_SIZE];
+   char                       _last_bits[PREDICTOR_INPUT_BYTES];
+   bool                       _has_last;
+
+   /*
+    * How well the predictions did, see GGPONetworkStats.
+    */
+   int                        _predicted_frames;
+   int                        _mispredicted_frames;
+   int                        _mispredictions;
+   int                        _rollback_frames;
+   int                        _rollbacks_avoided;
+};
+typedef struct InputPredictor InputPredictor;
+
+void input_predictor_Init(InputPredictor* predictor, int size);
+void input_predictor_SetStrategy(InputPredictor* predictor, GGPOInputPredictor strategy, const void* release_mask, int mask_size, predictor_PredictInputFunc predict_input, GGPOPlayerHandle player);
+void input_predictor_Predict(InputPredictor* predictor, GameInput const* last, GameInput* prediction);
+void input_predictor_Learn(InputPredictor* predictor, GameInput const* input);
+
+#endif
@@ -26,6 +26,12 @@
 
 #define PREVIOUS_FRAME(offset)   (((offset) == 0) ? (INPUT_QUEUE_LENGTH - 1) : ((offset) - 1))
 
+static void
+input_queue_Load(InputQueue* queue, int offset, GameInput* input)
+{
+   gameinput_init(input, queue->_frames[offset], queue->_bits + offset * queue->_input_size, queue->_input_size);
+}
+
 void
 input_queue_Init(InputQueue* queue, int id, int input_size)
 {
@@ -41,15 +47,27 @@ input_queue_Init(InputQueue* queue, int id, int input_size)
    queue->_last_added_frame = GAMEINPUT_NULL_FRAME;
 
    gameinput_init(&queue->_prediction, GAMEINPUT_NULL_FRAME, NULL, input_size);
+   input_predictor_Init(&queue->_predictor, input_size);
+   queue->_has_relevance_mask = false;
+   queue->_masked_mismatch = false;
 
    /*
-    * This is safe because we know the GameInput is a proper structure (as in,
-    * no virtual methods, no contained classes, etc.).
+    * One block holds the inputs and the relevance masks of the predicted
+    * frames.
     */
-   memset(queue->_inputs, 0, sizeof(queue->_inputs));
-   for (int i = 0; i < ARRAY_SIZE(queue->_inputs); i++) {
-      queue->_inputs[i].size = input_size;
-   }
+   free(queue->_bits);
+   queue->_input_size = input_size;
+   queue->_bits = calloc(2 * INPUT_QUEUE_LENGTH, input_size);
+   queue->_predicted_relevance = queue->_bits + INPUT_QUEUE_LENGTH * input_size;
+   memset(queue->_frames, 0, sizeof(queue->_frames));
+}
+
+void
+input_queue_dtor(InputQueue* queue)
+{
+   free(queue->_bits);
+   queue->_bits = NULL;
+   queue->_predicted_relevance = NULL;
 }
 
 int
@@ -79,7 +97,7 @@ input_queue_DiscardConfirmedFrames(InputQueue* queue, int frame)
    if (frame >= queue->_last_added_frame) {
       queue->_tail = queue->_head;
    } else {
-      int offset = frame - queue->_inputs[queue->_tail].frame + 1;
+      int offset = frame - queue->_frames[queue->_tail] + 1;
 
       Log("difference of %d frames.\n", offset);
       ASSERT(offset >= 0);
@@ -88,7 +106,7 @@ input_queue_DiscardConfirmedFrames(InputQueue* queue, int frame)
       queue->_length -= offset;
    }
 
-   Log("after discarding, new tail is %d (frame:%d).\n", queue->_tail, queue->_inputs[queue->_tail].frame);
+   Log("after discarding, new tail is %d (frame:%d).\n", queue->_tail, queue->_frames[queue->_tail]);
    ASSERT(queue->_length >= 0);
 }
 
@@ -106,6 +124,7 @@ input_queue_ResetPrediction(InputQueue* queue, int frame)
    queue->_prediction.frame = GAMEINPUT_NULL_FRAME;
    queue->_first_incorrect_frame = GAMEINPUT_NULL_FRAME;
    queue->_last_frame_requested = GAMEINPUT_NULL_FRAME;
+   queue->_masked_mismatch = false;
 }
 
 bool
@@ -113,10 +132,10 @@ input_queue_GetConfirmedInput(InputQueue* queue, int requested_frame, GameInput
 {
    ASSERT(queue->_first_incorrect_frame == GAMEINPUT_NULL_FRAME || requested_frame < queue->_first_incorrect_frame);
    int offset = requested_frame % INPUT_QUEUE_LENGTH;
-   if (queue->_inputs[offset].frame != requested_frame) {
+   if (queue->_frames[offset] != requested_frame) {
       return false;
    }
-   *input = queue->_inputs[offset];
+   input_queue_Load(queue, offset, input);
    return true;
 }
 
@@ -138,27 +157,27 @@ input_queue_GetInput(InputQueue* queue, int requested_frame, GameInput *input)
     */
    queue->_last_frame_requested = requested_frame;
 
-   ASSERT(requested_frame >= queue->_inputs[queue->_tail].frame);
+   ASSERT(requested_frame >= queue->_frames[queue->_tail]);
 
    if (queue->_prediction.frame == GAMEINPUT_NULL_FRAME) {
       /*
        * If the frame requested is in our range, fetch it out of the queue and
        * return it.
        */
-      int offset = requested_frame - queue->_inputs[queue->_tail].frame;
+      int offset = requested_frame - queue->_frames[queue->_tail];
 
       if (offset < queue->_length) {
          offset = (offset + queue->_tail) % INPUT_QUEUE_LENGTH;
-         ASSERT(queue->_inputs[offset].frame == requested_frame);
-         *input = queue->_inputs[offset];
+         ASSERT(queue->_frames[offset] == requested_frame);
+         input_queue_Load(queue, offset, input);
          Log("returning confirmed frame number %d.\n", input->frame);
          return true;
       }
 
       /*
        * The requested frame isn't in the queue.  Bummer.  This means we need
-       * to return a prediction frame.  Predict that the user will do the
-       * same thing they did last time.
+       * to return a prediction frame.  Unless a smarter predictor was picked,
+       * predict that the user will do the same thing they did last time.
        */
       if (requested_frame == 0) {
          Log("basing new prediction frame from nothing, you're client wants frame 0.\n");
@@ -167,15 +186,23 @@ input_queue_GetInput(InputQueue* queue, int requested_frame, GameInput *input)
          Log("basing new prediction frame from nothing, since we have no frames yet.\n");
          gameinput_erase(&queue->_prediction);
       } else {
+         GameInput last;
+
          Log("basing new prediction frame from previously added frame (queue entry:%d, frame:%d).\n",
-              PREVIOUS_FRAME(queue->_head), queue->_inputs[PREVIOUS_FRAME(queue->_head)].frame);
-         queue->_prediction = queue->_inputs[PREVIOUS_FRAME(queue->_head)];
+              PREVIOUS_FRAME(queue->_head), queue->_frames[PREVIOUS_FRAME(queue->_head)]);
+         input_queue_Load(queue, PREVIOUS_FRAME(queue->_head), &last);
+         queue->_prediction = last;
+         input_predictor_Predict(&queue->_predictor, &last, &queue->_prediction);
       }
       queue->_prediction.frame++;
    }
 
    ASSERT(queue->_prediction.frame >= 0);
 
+   if (queue->_has_relevance_mask) {
+      memcpy(queue->_predicted_relevance + (requested_frame % INPUT_QUEUE_LENGTH) * queue->_input_size, queue->_relevance_mask, queue->_input_size);
+   }
+
    /*
     * If we've made it this far, we must be predicting.  Go ahead and
     * forward the prediction frame contents.  Be sure to return the
@@ -228,18 +255,19 @@ input_queue_AddDelayedInputToQueue(InputQueue* queue, GameInput *input, int fram
 
    ASSERT(queue->_last_added_frame == GAMEINPUT_NULL_FRAME || frame_number == queue->_last_added_frame + 1);
 
-   ASSERT(frame_number == 0 || queue->_inputs[PREVIOUS_FRAME(queue->_head)].frame == frame_number - 1);
+   ASSERT(frame_number == 0 || queue->_frames[PREVIOUS_FRAME(queue->_head)] == frame_number - 1);
 
    /*
     * Add the frame to the back of the queue
     */
-   queue->_inputs[queue->_head] = *input;
-   queue->_inputs[queue->_head].frame = frame_number;
+   queue->_frames[queue->_head] = frame_number;
+   memcpy(queue->_bits + queue->_head * queue->_input_size, input->bits, queue->_input_size);
    queue->_head = (queue->_head + 1) % INPUT_QUEUE_LENGTH;
    queue->_length++;
    queue->_first_frame = false;
 
    queue->_last_added_frame = frame_number;
+   input_predictor_Learn(&queue->_predictor, input);
 
    if (queue->_prediction.frame != GAMEINPUT_NULL_FRAME) {
       ASSERT(frame_number == queue->_prediction.frame);
@@ -250,7 +278,18 @@ input_queue_AddDelayedInputToQueue(InputQueue* queue, GameInput *input, int fram
        * remember the first input which was incorrect so we can report it
        * in GetFirstIncorrectFrame()
        */
-      if (queue->_first_incorrect_frame == GAMEINPUT_NULL_FRAME && !gameinput_equal(&queue->_prediction, input, true)) {
+      bool correct = gameinput_equal(&queue->_prediction, input, true);
+      if (!correct && queue->_has_relevance_mask &&
+          gameinput_equal_masked(&queue->_prediction, input, queue->_predicted_relevance + (frame_number % INPUT_QUEUE_LENGTH) * queue->_input_size)) {
+         Log("frame %d only differs from the prediction in irrelevant bits.\n", frame_number);
+         correct = true;
+         queue->_masked_mismatch = true;
+      }
+      queue->_predictor._predicted_frames++;
+      if (!correct) {
+         queue->_predictor._mispredicted_frames++;
+      }
+      if (queue->_first_incorrect_frame == GAMEINPUT_NULL_FRAME && !correct) {
          Log("frame %d does not match prediction.  marking error.\n", frame_number);
          queue->_first_incorrect_frame = frame_number;
       }
@@ -264,6 +303,10 @@ input_queue_AddDelayedInputToQueue(InputQueue* queue, GameInput *input, int fram
       if (queue->_prediction.frame == queue->_last_frame_requested && queue->_first_incorrect_frame == GAMEINPUT_NULL_FRAME) {
          Log("prediction is correct!  dumping out of prediction mode.\n");
          queue->_prediction.frame = GAMEINPUT_NULL_FRAME;
+         if (queue->_masked_mismatch) {
+            queue->_predictor._rollbacks_avoided++;
+            queue->_masked_mismatch = false;
+         }
       } else {
               queue->_prediction.frame++;
       }
@@ -276,7 +319,7 @@ input_queue_AdvanceQueueHead(InputQueue* queue, int frame)
 {
    Log("advancing queue head to frame %d.\n", frame);
 
-   int expected_frame = queue->_first_frame ? 0 : queue->_inputs[PREVIOUS_FRAME(queue->_head)].frame + 1;
+   int expected_frame = queue->_first_frame ? 0 : queue->_frames[PREVIOUS_FRAME(queue->_head)] + 1;
 
    frame += queue->_frame_delay;
 
@@ -300,15 +343,55 @@ input_queue_AdvanceQueueHead(InputQueue* queue, int frame)
        */
       Log("Adding padding frame %d to account for change in frame delay.\n",
           expected_frame);
-      GameInput *last_frame = &queue->_inputs[PREVIOUS_FRAME(queue->_head)];
-      input_queue_AddDelayedInputToQueue(queue, last_frame, expected_frame);
+      GameInput last_frame;
+      input_queue_Load(queue, PREVIOUS_FRAME(queue->_head), &last_frame);
+      input_queue_AddDelayedInputToQueue(queue, &last_frame, expected_frame);
       expected_frame++;
    }
 
-   ASSERT(frame == 0 || frame == queue->_inputs[PREVIOUS_FRAME(queue->_head)].frame + 1);
+   ASSERT(frame == 0 || frame == queue->_frames[PREVIOUS_FRAME(queue->_head)] + 1);
    return frame;
 }
 
+/*
+ * input_queue_SetRelevanceMask --
+ *
+ * Only compare the bits set in mask against the predictions from the next
+ * predicted frame on, or every bit again if mask is NULL.  Bytes past size
+ * are all relevant.  Frames predicted before the first mask was set keep
+ * comparing every bit.
+ */
+void
+input_queue_SetRelevanceMask(InputQueue* queue, const void* mask, int size)
+{
+   if (!mask) {
+      queue->_has_relevance_mask = false;
+      return;
+   }
+   if (!queue->_has_relevance_mask) {
+      memset(queue->_predicted_relevance, 0xff, INPUT_QUEUE_LENGTH * queue->_input_size);
+   }
+   memset(queue->_relevance_mask, 0xff, sizeof(queue->_relevance_mask));
+   memcpy(queue->_relevance_mask, mask, MIN(size, (int)sizeof(queue->_relevance_mask)));
+   queue->_has_relevance_mask = true;
+}
+
+/*
+ * input_queue_GetLastAddedInput --
+ *
+ * Copy the input at the back of the queue into input.  Returns false if
+ * nothing was added yet.
+ */
+bool
+input_queue_GetLastAddedInput(InputQueue* queue, GameInput* input)
+{
+   if (queue->_first_frame) {
+      return false;
+   }
+   input_queue_Load(queue, PREVIOUS_FRAME(queue->_head), input);
+   return true;
+}
+
 
 void
 input_queue_Log(InputQueue* queue, const char *fmt, ...)
@@ -25,6 +25,7 @@
 #define _INPUT_QUEUE_H
 
 #include "game_input.h"
+#include "input_predictor.h"
 
 #define INPUT_QUEUE_LENGTH    128
 #define DEFAULT_INPUT_SIZE      4
@@ -44,16 +45,39 @@ struct InputQueue
 
 	int                  _frame_delay;
 
-	GameInput            _inputs[INPUT_QUEUE_LENGTH];
+	/*
+	 * The inputs are kept sized to _input_size rather than in full
+	 * GameInputs: entry i is _frames[i] and the _input_size bytes at
+	 * _bits + i * _input_size.
+	 */
+	int                  _input_size;
+	int                  _frames[INPUT_QUEUE_LENGTH];
+	char                 *_bits;
 	GameInput            _prediction;
+	InputPredictor       _predictor;
+
+	/*
+	 * The bits which matter to the simulation, as the game last set them,
+	 * and as they were when each predicted frame was run.  Mispredicting
+	 * the other bits doesn't need a rollback.
+	 */
+	bool                 _has_relevance_mask;
+	char                 _relevance_mask[GAMEINPUT_MAX_BYTES];
+	char                 *_predicted_relevance;     /* laid out like _bits */
+	bool                 _masked_mismatch;
 };
 typedef struct InputQueue InputQueue;
 
 void input_queue_Init(InputQueue* queue, int id, int input_size);
+void input_queue_dtor(InputQueue* queue);
 int input_queue_GetLastConfirmedFrame(InputQueue* queue);
 int input_queue_GetFirstIncorrectFrame(InputQueue* queue);
-inline int input_queue_GetLength(InputQueue* queue) { return queue->_length; }
-inline void input_queue_SetFrameDelay(InputQueue* queue, int delay) { queue->_frame_delay = delay; }
+static inline int input_queue_GetLength(InputQueue* queue) { return queue->_length; }
+static inline void input_queue_SetFrameDelay(InputQueue* queue, int delay) { queue->_frame_delay = delay; }
+static inline int input_queue_GetFrameDelay(InputQueue* queue) { return queue->_frame_delay; }
+bool input_queue_GetLastAddedInput(InputQueue* queue, GameInput* input);
+static inline InputPredictor* input_queue_GetPredictor(InputQueue* queue) { return &queue->_predictor; }
+void input_queue_SetRelevanceMask(InputQueue* queue, const void* mask, int size);
 void input_queue_ResetPrediction(InputQueue* queue, int frame);
 void input_queue_DiscardConfirmedFrames(InputQueue* queue, int frame);
 bool input_queue_GetConfirmedInput(InputQueue* queue, int frame, GameInput* input);
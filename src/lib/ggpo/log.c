@@ -7,7 +7,27 @@
 
 #include "types.h"
 
+/*
+ * The log file is shared by every session in the process.  It is opened
+ * once, and each line is written under the lock of the file, so sessions
+ * running on several threads don't garble each other's lines.
+ */
 static FILE *logfile = NULL;
+static PlatformOnce logfile_once = PLATFORM_ONCE_INIT;
+static uint32 log_start_time;
+static PlatformOnce log_start_once = PLATFORM_ONCE_INIT;
+
+static void LogOpen()
+{
+   char filename[64];
+   snprintf(filename, ARRAY_SIZE(filename), "log-%llu.log", Platform_GetProcessID());
+   logfile = fopen(filename, "w");
+}
+
+static void LogStartClock()
+{
+   log_start_time = Platform_GetCurrentTimeMS();
+}
 
 void LogFlush()
 {
@@ -16,8 +36,6 @@ void LogFlush()
    }
 }
 
-static char logbuf[4 * 1024 * 1024];
-
 void Log(const char *fmt, ...)
 {
    va_list args;
@@ -28,35 +46,37 @@ void Log(const char *fmt, ...)
 
 void Logv(const char *fmt, va_list args)
 {
-    char logbuf2[256] = { 0 };
-    vsnprintf(logbuf2, 256, fmt, args);
-    OutputDebugStringA(logbuf2);
+#if defined(_WINDOWS)
+   char logbuf2[256] = { 0 };
+   va_list debug_args;
+   va_copy(debug_args, args);
+   vsnprintf(logbuf2, 256, fmt, debug_args);
+   va_end(debug_args);
+   OutputDebugStringA(logbuf2);
+#endif
 
    if (!Platform_GetConfigBool("ggpo.log") || Platform_GetConfigBool("ggpo.log.ignore")) {
       return;
    }
-   if (!logfile) {
-      snprintf(logbuf, ARRAY_SIZE(logbuf), "log-%llu.log", Platform_GetProcessID());
-      logfile = fopen(logbuf, "w");
+   Platform_CallOnce(&logfile_once, LogOpen);
+   if (logfile) {
+      LogvFile(logfile, fmt, args);
    }
-   LogvFile(logfile, fmt, args);
 }
 
 void LogvFile(FILE *fp, const char *fmt, va_list args)
 {
+   Platform_LockFile(fp);
    if (Platform_GetConfigBool("ggpo.log.timestamps")) {
-      static int start = 0;
-      int t = 0;
-      if (!start) {
-         start = Platform_GetCurrentTimeMS();
-      } else {
-         t = Platform_GetCurrentTimeMS() - start;
-      }
+      Platform_CallOnce(&log_start_once, LogStartClock);
+      int t = Platform_GetCurrentTimeMS() - log_start_time;
       fprintf(fp, "%d.%03d : ", t / 1000, t % 1000);
    }
 
-   vfprintf(fp, fmt, args);
+   va_list file_args;
+   va_copy(file_args, args);
+   vfprintf(fp, fmt, file_args);
+   va_end(file_args);
    fflush(fp);
-
-   vsnprintf(logbuf, ARRAY_SIZE(logbuf), fmt, args);
+   Platform_UnlockFile(fp);
 }
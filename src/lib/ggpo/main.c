@@ -25,13 +25,15 @@
 #include "backends/p2p.h"
 #include "backends/synctest.h"
 #include "backends/spectator.h"
+#include "backends/replay.h"
+#include "backends/input_server.h"
+#include "backends/star.h"
 #include "ggponet.h"
 
 #if defined(_WINDOWS)
 BOOL WINAPI
 DllMain(HINSTANCE hinstDLL, DWORD fdwReason, LPVOID lpvReserved)
 {
-   srand(Platform_GetCurrentTimeMS() + Platform_GetProcessID());
    return TRUE;
 }
 #endif
@@ -59,6 +61,18 @@ ggpo_logv(GGPOSession *ggpo, const char *fmt, va_list args)
    }
 }
 
+/*
+ * Each player sends at most GAMEINPUT_MAX_BYTES, and the merged input of
+ * all of them has to fit in one GameInput.
+ */
+static bool
+ggpo_check_input_size(int num_players, int input_size)
+{
+    return num_players >= 1 && num_players <= GGPO_MAX_PLAYERS &&
+           input_size > 0 && input_size <= GAMEINPUT_MAX_BYTES &&
+           input_size * num_players <= GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS;
+}
+
 #if defined(GGPO_STEAM)
 GGPOErrorCode
 ggpo_start_session(GGPOSession **session,
@@ -68,6 +82,9 @@ ggpo_start_session(GGPOSession **session,
                    int input_size,
                    int local_channel)
 {
+    if (!ggpo_check_input_size(num_players, input_size)) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
     void* p2p = calloc(sizeof(Peer2PeerBackend), 1);
     p2p_ctor_steam((Peer2PeerBackend*)p2p, cb,
         game,
@@ -86,10 +103,14 @@ ggpo_start_session(GGPOSession **session,
                    int input_size,
                    unsigned short localport)
 {
+    if (!ggpo_check_input_size(num_players, input_size)) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
     void* p2p = calloc(sizeof(Peer2PeerBackend), 1);
     p2p_ctor((Peer2PeerBackend*)p2p, cb,
         game,
         localport,
+        NULL, 0,
         num_players,
         input_size);
     *session = (GGPOSession*)p2p;
@@ -110,6 +131,9 @@ ggpo_add_player(GGPOSession *ggpo,
    case SESSION_P2P: return p2p_AddPlayer((Peer2PeerBackend*)ggpo, player, handle);
    case SESSION_SPECTATOR: return spec_AddPlayer((SpectatorBackend*)ggpo, player, handle);
    case SESSION_SYNCTEST: return synctest_AddPlayer((SyncTestBackend*)ggpo, player, handle);
+   case SESSION_REPLAY: return replay_AddPlayer((ReplayBackend*)ggpo, player, handle);
+   case SESSION_INPUT_SERVER: return server_AddPlayer((InputServerBackend*)ggpo, player, handle);
+   case SESSION_STAR: return star_AddPlayer((StarBackend*)ggpo, player, handle);
    }
 
    return GGPO_ERRORCODE_INVALID_SESSION;
@@ -131,6 +155,27 @@ ggpo_start_synctest(GGPOSession **ggpo,
 	return GGPO_OK;
 }
 
+GGPOErrorCode
+ggpo_start_replay(GGPOSession **ggpo,
+                  GGPOSessionCallbacks *cb,
+                  const char *game,
+                  const char *filename,
+                  int num_players,
+                  int input_size)
+{
+	if (!ggpo_check_input_size(num_players, input_size)) {
+		return GGPO_ERRORCODE_INVALID_REQUEST;
+	}
+	void* replay = calloc(sizeof(ReplayBackend), 1);
+	GGPOErrorCode result = replay_ctor((ReplayBackend*)replay, cb, game, filename, num_players, input_size);
+	if (!GGPO_SUCCEEDED(result)) {
+		free(replay);
+		return result;
+	}
+	*ggpo = (GGPOSession*)replay;
+	return GGPO_OK;
+}
+
 GGPOErrorCode
 ggpo_set_frame_delay(GGPOSession *ggpo,
                      GGPOPlayerHandle player,
@@ -142,8 +187,12 @@ ggpo_set_frame_delay(GGPOSession *ggpo,
    GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
    switch (header->_session_type) {
    case SESSION_P2P: return p2p_SetFrameDelay((Peer2PeerBackend*)ggpo, player, frame_delay);
-   case SESSION_SPECTATOR: return spec_SetFrameDelay((SpectatorBackend*)ggpo, player, frame_delay);
-   case SESSION_SYNCTEST: return synctest_SetFrameDelay((SyncTestBackend*)ggpo, player, frame_delay);
+   case SESSION_STAR: return star_SetFrameDelay((StarBackend*)ggpo, player, frame_delay);
+   case SESSION_SPECTATOR:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_INPUT_SERVER:
+      return GGPO_ERRORCODE_UNSUPPORTED;
    }
 
    return GGPO_ERRORCODE_INVALID_SESSION;
@@ -160,6 +209,9 @@ ggpo_idle(GGPOSession *ggpo, int timeout)
    case SESSION_P2P: return p2p_DoPoll((Peer2PeerBackend*)ggpo, timeout);
    case SESSION_SPECTATOR: return spec_DoPoll((SpectatorBackend*)ggpo, timeout);
    case SESSION_SYNCTEST: return synctest_DoPoll((SyncTestBackend*)ggpo, timeout);
+   case SESSION_REPLAY: return replay_DoPoll((ReplayBackend*)ggpo, timeout);
+   case SESSION_INPUT_SERVER: return server_DoPoll((InputServerBackend*)ggpo, timeout);
+   case SESSION_STAR: return star_DoPoll((StarBackend*)ggpo, timeout);
    }
 
    return GGPO_ERRORCODE_INVALID_SESSION;
@@ -179,6 +231,10 @@ ggpo_add_local_input(GGPOSession *ggpo,
    case SESSION_P2P: return p2p_AddLocalInput((Peer2PeerBackend*)ggpo, player, values, size);
    case SESSION_SPECTATOR: return spec_AddLocalInput((SpectatorBackend*)ggpo, player, values, size);
    case SESSION_SYNCTEST: return synctest_AddLocalInput((SyncTestBackend*)ggpo, player, values, size);
+   case SESSION_REPLAY: return replay_AddLocalInput((ReplayBackend*)ggpo, player, values, size);
+   case SESSION_STAR: return star_AddLocalInput((StarBackend*)ggpo, player, values, size);
+   case SESSION_INPUT_SERVER:
+      return GGPO_ERRORCODE_UNSUPPORTED;
    }
 
    return GGPO_ERRORCODE_INVALID_SESSION;
@@ -198,6 +254,10 @@ ggpo_synchronize_input(GGPOSession *ggpo,
    case SESSION_P2P: return p2p_SyncInput((Peer2PeerBackend*)ggpo, values, size, disconnect_flags);
    case SESSION_SPECTATOR: return spec_SyncInput((SpectatorBackend*)ggpo, values, size, disconnect_flags);
    case SESSION_SYNCTEST: return synctest_SyncInput((SyncTestBackend*)ggpo, values, size, disconnect_flags);
+   case SESSION_REPLAY: return replay_SyncInput((ReplayBackend*)ggpo, values, size, disconnect_flags);
+   case SESSION_STAR: return star_SyncInput((StarBackend*)ggpo, values, size, disconnect_flags);
+   case SESSION_INPUT_SERVER:
+      return GGPO_ERRORCODE_UNSUPPORTED;
    }
 
    return GGPO_ERRORCODE_INVALID_SESSION;
@@ -212,8 +272,12 @@ GGPOErrorCode ggpo_disconnect_player(GGPOSession *ggpo,
    GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
    switch (header->_session_type) {
    case SESSION_P2P: return p2p_DisconnectPlayer((Peer2PeerBackend*)ggpo, player);
-   case SESSION_SPECTATOR: return spec_DisconnectPlayer((SpectatorBackend*)ggpo, player);
    case SESSION_SYNCTEST: return synctest_DisconnectPlayer((SyncTestBackend*)ggpo, player);
+   case SESSION_INPUT_SERVER: return server_DisconnectPlayer((InputServerBackend*)ggpo, player);
+   case SESSION_STAR: return star_DisconnectPlayer((StarBackend*)ggpo, player);
+   case SESSION_SPECTATOR:
+   case SESSION_REPLAY:
+      return GGPO_ERRORCODE_UNSUPPORTED;
    }
 
    return GGPO_ERRORCODE_INVALID_SESSION;
@@ -230,6 +294,10 @@ ggpo_advance_frame(GGPOSession *ggpo)
    case SESSION_P2P: return p2p_IncrementFrame((Peer2PeerBackend*)ggpo);
    case SESSION_SPECTATOR: return spec_IncrementFrame((SpectatorBackend*)ggpo);
    case SESSION_SYNCTEST: return synctest_IncrementFrame((SyncTestBackend*)ggpo);
+   case SESSION_REPLAY: return replay_IncrementFrame((ReplayBackend*)ggpo);
+   case SESSION_STAR: return star_IncrementFrame((StarBackend*)ggpo);
+   case SESSION_INPUT_SERVER:
+      return GGPO_ERRORCODE_UNSUPPORTED;
    }
 
    return GGPO_ERRORCODE_INVALID_SESSION;
@@ -248,6 +316,10 @@ ggpo_get_network_stats(GGPOSession *ggpo,
    case SESSION_P2P: return p2p_GetNetworkStats((Peer2PeerBackend*)ggpo, stats, player);
    case SESSION_SPECTATOR: return spec_GetNetworkStats((SpectatorBackend*)ggpo, stats, player);
    case SESSION_SYNCTEST: return synctest_GetNetworkStats((SyncTestBackend*)ggpo, stats, player);
+   case SESSION_INPUT_SERVER: return server_GetNetworkStats((InputServerBackend*)ggpo, stats, player);
+   case SESSION_STAR: return star_GetNetworkStats((StarBackend*)ggpo, stats, player);
+   case SESSION_REPLAY:
+      return GGPO_ERRORCODE_UNSUPPORTED;
    }
 
    return GGPO_ERRORCODE_INVALID_SESSION;
@@ -265,6 +337,9 @@ ggpo_close_session(GGPOSession *ggpo)
    case SESSION_P2P: p2p_dtor((Peer2PeerBackend*)ggpo); break;
    case SESSION_SPECTATOR: spec_dtor((SpectatorBackend*)ggpo); break;
    case SESSION_SYNCTEST: synctest_dtor((SyncTestBackend*)ggpo); break;
+   case SESSION_REPLAY: replay_dtor((ReplayBackend*)ggpo); break;
+   case SESSION_INPUT_SERVER: server_dtor((InputServerBackend*)ggpo); break;
+   case SESSION_STAR: star_dtor((StarBackend*)ggpo); break;
    }
    free(ggpo);
    return GGPO_OK;
@@ -279,8 +354,12 @@ ggpo_set_disconnect_timeout(GGPOSession *ggpo, int timeout)
    GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
    switch (header->_session_type) {
    case SESSION_P2P: return p2p_SetDisconnectTimeout((Peer2PeerBackend*)ggpo, timeout);
-   case SESSION_SPECTATOR: return spec_SetDisconnectTimeout((SpectatorBackend*)ggpo, timeout);
-   case SESSION_SYNCTEST: return synctest_SetDisconnectTimeout((SyncTestBackend*)ggpo, timeout);
+   case SESSION_INPUT_SERVER: return server_SetDisconnectTimeout((InputServerBackend*)ggpo, timeout);
+   case SESSION_STAR: return star_SetDisconnectTimeout((StarBackend*)ggpo, timeout);
+   case SESSION_SPECTATOR:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+      return GGPO_ERRORCODE_UNSUPPORTED;
    }
 
    return GGPO_ERRORCODE_INVALID_SESSION;
@@ -295,8 +374,355 @@ ggpo_set_disconnect_notify_start(GGPOSession *ggpo, int timeout)
    GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
    switch (header->_session_type) {
    case SESSION_P2P: return p2p_SetDisconnectNotifyStart((Peer2PeerBackend*)ggpo, timeout);
-   case SESSION_SPECTATOR: return spec_SetDisconnectNotifyStart((SpectatorBackend*)ggpo, timeout);
-   case SESSION_SYNCTEST: return synctest_SetDisconnectNotifyStart((SyncTestBackend*)ggpo, timeout);
+   case SESSION_INPUT_SERVER: return server_SetDisconnectNotifyStart((InputServerBackend*)ggpo, timeout);
+   case SESSION_STAR: return star_SetDisconnectNotifyStart((StarBackend*)ggpo, timeout);
+   case SESSION_SPECTATOR:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_spectator_lag_policy(GGPOSession *ggpo, GGPOSpectatorLagPolicy policy, int max_lag_frames)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_SetSpectatorLagPolicy((Peer2PeerBackend*)ggpo, policy, max_lag_frames);
+   case SESSION_SPECTATOR: return spec_SetSpectatorLagPolicy((SpectatorBackend*)ggpo, policy, max_lag_frames);
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_INPUT_SERVER:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_spectator_fanout(GGPOSession *ggpo, int max_spectators)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_SetSpectatorFanout((Peer2PeerBackend*)ggpo, max_spectators);
+   case SESSION_SPECTATOR: return spec_SetSpectatorFanout((SpectatorBackend*)ggpo, max_spectators);
+   case SESSION_INPUT_SERVER: return server_SetSpectatorFanout((InputServerBackend*)ggpo, max_spectators);
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_path_mtu(GGPOSession *ggpo, int mtu)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   if (mtu < UDP_PROTOCOL_MIN_PATH_MTU || mtu > UDP_PROTOCOL_MAX_PATH_MTU) {
+      return GGPO_ERRORCODE_INVALID_REQUEST;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_SetPathMtu((Peer2PeerBackend*)ggpo, mtu);
+   case SESSION_SPECTATOR: return spec_SetPathMtu((SpectatorBackend*)ggpo, mtu);
+   case SESSION_INPUT_SERVER: return server_SetPathMtu((InputServerBackend*)ggpo, mtu);
+   case SESSION_STAR: return star_SetPathMtu((StarBackend*)ggpo, mtu);
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_get_spectator_stats(GGPOSession *ggpo, GGPOSpectatorStats *stats)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_SPECTATOR: return spec_GetSpectatorStats((SpectatorBackend*)ggpo, stats);
+   case SESSION_P2P:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_INPUT_SERVER:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_spectator_frames_available(GGPOSession *ggpo, int *frames)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_SPECTATOR: return spec_GetFramesAvailable((SpectatorBackend*)ggpo, frames);
+   case SESSION_P2P:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_INPUT_SERVER:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_spectator_catchup(GGPOSession *ggpo, GGPOSpectatorCatchupPolicy policy, int max_frames_per_tick)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_SPECTATOR: return spec_SetCatchupPolicy((SpectatorBackend*)ggpo, policy, max_frames_per_tick);
+   case SESSION_P2P:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_INPUT_SERVER:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_spectator_frames_to_run(GGPOSession *ggpo, int *frames)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_SPECTATOR: return spec_GetFramesToRun((SpectatorBackend*)ggpo, frames);
+   case SESSION_P2P:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_INPUT_SERVER:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_spectator_playout_delay(GGPOSession *ggpo, int min_frames, int max_frames)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_SPECTATOR: return spec_SetPlayoutDelay((SpectatorBackend*)ggpo, min_frames, max_frames);
+   case SESSION_P2P:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_INPUT_SERVER:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_start_recording(GGPOSession *ggpo, const char *filename, int keyframe_interval)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_StartRecording((Peer2PeerBackend*)ggpo, filename, keyframe_interval);
+   case SESSION_SPECTATOR:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_INPUT_SERVER:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_stop_recording(GGPOSession *ggpo)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_StopRecording((Peer2PeerBackend*)ggpo);
+   case SESSION_SPECTATOR:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_INPUT_SERVER:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_replay_seek(GGPOSession *ggpo, int frame)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_REPLAY: return replay_Seek((ReplayBackend*)ggpo, frame);
+   case SESSION_P2P:
+   case SESSION_SPECTATOR:
+   case SESSION_SYNCTEST:
+   case SESSION_INPUT_SERVER:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_replay_fast_forward(GGPOSession *ggpo, int frames)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_REPLAY: return replay_FastForward((ReplayBackend*)ggpo, frames);
+   case SESSION_P2P:
+   case SESSION_SPECTATOR:
+   case SESSION_SYNCTEST:
+   case SESSION_INPUT_SERVER:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_replay_position(GGPOSession *ggpo, int *first_frame, int *end_frame, int *current_frame)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_REPLAY: return replay_GetReplayPosition((ReplayBackend*)ggpo, first_frame, end_frame, current_frame);
+   case SESSION_P2P:
+   case SESSION_SPECTATOR:
+   case SESSION_SYNCTEST:
+   case SESSION_INPUT_SERVER:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_adaptive_frame_delay(GGPOSession *ggpo, GGPOPlayerHandle player, int min_delay, int max_delay)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_SetAdaptiveFrameDelay((Peer2PeerBackend*)ggpo, player, min_delay, max_delay);
+   case SESSION_SPECTATOR:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_INPUT_SERVER:
+   case SESSION_STAR:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_frame_duration(GGPOSession *ggpo, int usec)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_SetFrameDuration((Peer2PeerBackend*)ggpo, usec);
+   case SESSION_SPECTATOR: return spec_SetFrameDuration((SpectatorBackend*)ggpo, usec);
+   case SESSION_INPUT_SERVER: return server_SetFrameDuration((InputServerBackend*)ggpo, usec);
+   case SESSION_STAR: return star_SetFrameDuration((StarBackend*)ggpo, usec);
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_input_predictor(GGPOSession *ggpo, GGPOPlayerHandle player, GGPOInputPredictor predictor, const void *release_mask, int size)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_SetInputPredictor((Peer2PeerBackend*)ggpo, player, predictor, release_mask, size);
+   case SESSION_STAR: return star_SetInputPredictor((StarBackend*)ggpo, player, predictor, release_mask, size);
+   case SESSION_SPECTATOR:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_INPUT_SERVER:
+      return GGPO_ERRORCODE_UNSUPPORTED;
+   }
+
+   return GGPO_ERRORCODE_INVALID_SESSION;
+}
+
+GGPOErrorCode
+ggpo_set_input_relevance(GGPOSession *ggpo, GGPOPlayerHandle player, const void *mask, int size)
+{
+   if (!ggpo) {
+	   return GGPO_ERRORCODE_INVALID_SESSION;
+   }
+   GGPOSessionHeader* header = (GGPOSessionHeader*)ggpo;
+   switch (header->_session_type) {
+   case SESSION_P2P: return p2p_SetInputRelevance((Peer2PeerBackend*)ggpo, player, mask, size);
+   case SESSION_STAR: return star_SetInputRelevance((StarBackend*)ggpo, player, mask, size);
+   case SESSION_SPECTATOR:
+   case SESSION_SYNCTEST:
+   case SESSION_REPLAY:
+   case SESSION_INPUT_SERVER:
+      return GGPO_ERRORCODE_UNSUPPORTED;
    }
 
    return GGPO_ERRORCODE_INVALID_SESSION;
@@ -311,6 +737,9 @@ GGPOErrorCode ggpo_start_spectating(GGPOSession **session,
                                     int local_channel,
                                     uint64_t host_steam_id)
 {
+    if (!ggpo_check_input_size(num_players, input_size)) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
     void* spec = calloc(sizeof(SpectatorBackend), 1);
     spec_ctor_steam((SpectatorBackend*)spec, cb,
                     game,
@@ -331,15 +760,197 @@ GGPOErrorCode ggpo_start_spectating(GGPOSession **session,
                                     char *host_ip,
                                     unsigned short host_port)
 {
+    if (!ggpo_check_input_size(num_players, input_size)) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
     void* spec = calloc(sizeof(SpectatorBackend), 1);
     spec_ctor((SpectatorBackend*)spec, cb,
                                                   game,
                                                   local_port,
+                                                  NULL, 0,
                                                   num_players,
                                                   input_size,
                                                   host_ip,
-                                                  host_port);
+                                                  host_port,
+                                                  0);
     *session = (GGPOSession*)spec;
     return GGPO_OK;
 }
+
+GGPOErrorCode ggpo_open_socket(GGPOSocket **socket, unsigned short local_port)
+{
+    UdpSocket* shared = calloc(sizeof(UdpSocket), 1);
+    if (!udp_socket_Open(shared, local_port)) {
+        free(shared);
+        return GGPO_ERRORCODE_GENERAL_FAILURE;
+    }
+    *socket = shared;
+    return GGPO_OK;
+}
+
+GGPOErrorCode ggpo_close_socket(GGPOSocket *socket)
+{
+    if (!socket || socket->_num_sessions) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
+    udp_socket_Close(socket);
+    free(socket);
+    return GGPO_OK;
+}
+
+GGPOErrorCode ggpo_start_session_on_socket(GGPOSession **session,
+                                           GGPOSessionCallbacks *cb,
+                                           const char *game,
+                                           int num_players,
+                                           int input_size,
+                                           GGPOSocket *socket,
+                                           unsigned short session_id)
+{
+    if (!socket || !udp_socket_IsSessionFree(socket, session_id) || !ggpo_check_input_size(num_players, input_size)) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
+    void* p2p = calloc(sizeof(Peer2PeerBackend), 1);
+    p2p_ctor((Peer2PeerBackend*)p2p, cb,
+        game,
+        0,
+        socket, session_id,
+        num_players,
+        input_size);
+    *session = (GGPOSession*)p2p;
+    return GGPO_OK;
+}
+
+GGPOErrorCode ggpo_start_spectating_on_socket(GGPOSession **session,
+                                              GGPOSessionCallbacks *cb,
+                                              const char *game,
+                                              int num_players,
+                                              int input_size,
+                                              GGPOSocket *socket,
+                                              unsigned short session_id,
+                                              char *host_ip,
+                                              unsigned short host_port,
+                                              unsigned short host_session_id)
+{
+    if (!socket || !udp_socket_IsSessionFree(socket, session_id) || !ggpo_check_input_size(num_players, input_size)) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
+    void* spec = calloc(sizeof(SpectatorBackend), 1);
+    spec_ctor((SpectatorBackend*)spec, cb,
+                                                  game,
+                                                  0,
+                                                  socket, session_id,
+                                                  num_players,
+                                                  input_size,
+                                                  host_ip,
+                                                  host_port,
+                                                  host_session_id);
+    *session = (GGPOSession*)spec;
+    return GGPO_OK;
+}
+#endif
+
+#if defined(GGPO_STEAM)
+GGPOErrorCode ggpo_start_input_server(GGPOSession **session,
+                                      GGPOSessionCallbacks *cb,
+                                      const char *game,
+                                      int num_players,
+                                      int input_size,
+                                      int local_channel)
+{
+    if (!ggpo_check_input_size(num_players, input_size)) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
+    void* server = calloc(sizeof(InputServerBackend), 1);
+    server_ctor_steam((InputServerBackend*)server, cb, game, local_channel, num_players, input_size);
+    *session = (GGPOSession*)server;
+    return GGPO_OK;
+}
+
+GGPOErrorCode ggpo_start_star_session(GGPOSession **session,
+                                      GGPOSessionCallbacks *cb,
+                                      const char *game,
+                                      int num_players,
+                                      int input_size,
+                                      int local_channel,
+                                      uint64_t server_steam_id)
+{
+    if (!ggpo_check_input_size(num_players, input_size)) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
+    void* star = calloc(sizeof(StarBackend), 1);
+    star_ctor_steam((StarBackend*)star, cb, game, local_channel, num_players, input_size, server_steam_id);
+    *session = (GGPOSession*)star;
+    return GGPO_OK;
+}
+#else
+GGPOErrorCode ggpo_start_input_server(GGPOSession **session,
+                                      GGPOSessionCallbacks *cb,
+                                      const char *game,
+                                      int num_players,
+                                      int input_size,
+                                      unsigned short local_port)
+{
+    if (!ggpo_check_input_size(num_players, input_size)) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
+    void* server = calloc(sizeof(InputServerBackend), 1);
+    server_ctor((InputServerBackend*)server, cb, game, local_port, NULL, 0, num_players, input_size);
+    *session = (GGPOSession*)server;
+    return GGPO_OK;
+}
+
+GGPOErrorCode ggpo_start_star_session(GGPOSession **session,
+                                      GGPOSessionCallbacks *cb,
+                                      const char *game,
+                                      int num_players,
+                                      int input_size,
+                                      unsigned short local_port,
+                                      char *server_ip,
+                                      unsigned short server_port)
+{
+    if (!ggpo_check_input_size(num_players, input_size)) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
+    void* star = calloc(sizeof(StarBackend), 1);
+    star_ctor((StarBackend*)star, cb, game, local_port, NULL, 0, num_players, input_size, server_ip, server_port, 0);
+    *session = (GGPOSession*)star;
+    return GGPO_OK;
+}
+
+GGPOErrorCode ggpo_start_input_server_on_socket(GGPOSession **session,
+                                                GGPOSessionCallbacks *cb,
+                                                const char *game,
+                                                int num_players,
+                                                int input_size,
+                                                GGPOSocket *socket,
+                                                unsigned short session_id)
+{
+    if (!socket || !udp_socket_IsSessionFree(socket, session_id) || !ggpo_check_input_size(num_players, input_size)) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
+    void* server = calloc(sizeof(InputServerBackend), 1);
+    server_ctor((InputServerBackend*)server, cb, game, 0, socket, session_id, num_players, input_size);
+    *session = (GGPOSession*)server;
+    return GGPO_OK;
+}
+
+GGPOErrorCode ggpo_start_star_session_on_socket(GGPOSession **session,
+                                                GGPOSessionCallbacks *cb,
+                                                const char *game,
+                                                int num_players,
+                                                int input_size,
+                                                GGPOSocket *socket,
+                                                unsigned short session_id,
+                                                char *server_ip,
+                                                unsigned short server_port,
+                                                unsigned short server_session_id)
+{
+    if (!socket || !udp_socket_IsSessionFree(socket, session_id) || !ggpo_check_input_size(num_players, input_size)) {
+        return GGPO_ERRORCODE_INVALID_REQUEST;
+    }
+    void* star = calloc(sizeof(StarBackend), 1);
+    star_ctor((StarBackend*)star, cb, game, 0, socket, session_id, num_players, input_size, server_ip, server_port, server_session_id);
+    *session = (GGPOSession*)star;
+    return GGPO_OK;
+}
 #endif
@@ -0,0 +1,86 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#include "clock_offset.h"
+
+void
+clock_offset_init(ClockOffset* clock)
+{
+	memset(clock, 0, sizeof(*clock));
+}
+
+/*
+ * clock_offset_add_sample --
+ *
+ * Fold in a packet the peer sent at remote_time on its clock, which we
+ * received at now, delay microseconds after sending the packet it echoes.
+ * Assuming the trip took as long both ways, the peer's clock read
+ * remote_time + delay / 2 when ours read now.
+ */
+void
+clock_offset_add_sample(ClockOffset* clock, uint64 now, uint32 remote_time, int delay)
+{
+	clock_OffsetSample sample;
+	sample.time = now;
+	sample.offset = remote_time + (uint32)(MAX(delay, 0) / 2) - (uint32)now;
+	sample.delay = MAX(delay, 0);
+
+	clock->_samples[clock->_num_samples % CLOCK_FILTER_SIZE] = sample;
+	clock->_num_samples++;
+
+	clock_OffsetSample best = sample;
+	for (int i = 0; i < MIN(clock->_num_samples, CLOCK_FILTER_SIZE); i++) {
+		if (clock->_samples[i].delay < best.delay) {
+			best = clock->_samples[i];
+		}
+	}
+	if (best.time == clock->_best.time) {
+		return;
+	}
+	clock->_best = best;
+
+	/*
+	 * Samples close together mostly measure the jitter of the network, so
+	 * the skew is only measured over a long enough interval.
+	 */
+	if (clock->_skew_base.time == 0) {
+		clock->_skew_base = best;
+		return;
+	}
+	uint64 interval = best.time - clock->_skew_base.time;
+	if (best.time < clock->_skew_base.time || interval < CLOCK_SKEW_MIN_INTERVAL) {
+		return;
+	}
+	float skew = (int)(best.offset - clock->_skew_base.offset) * 1000000.0f / (float)interval;
+	skew = MAX(-CLOCK_MAX_SKEW_PPM, MIN(skew, CLOCK_MAX_SKEW_PPM));
+	clock->_skew_ppm = clock->_has_skew ? clock->_skew_ppm + (skew - clock->_skew_ppm) / 4 : skew;
+	clock->_has_skew = true;
+	clock->_skew_base = best;
+}
+
+/*
+ * clock_offset_to_remote --
+ *
+ * What the peer's clock reads when ours reads now.
+ */
+uint32
+clock_offset_to_remote(ClockOffset* clock, uint64 now)
+{
+	int64 elapsed = (int64)(now - clock->_best.time);
+	int drift = (int)(clock->_skew_ppm * elapsed / 1000000.0f);
+	return (uint32)now + clock->_best.offset + (uint32)drift;
+}
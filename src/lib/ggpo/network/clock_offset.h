@@ -0,0 +1,63 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#ifndef _CLOCK_OFFSET_H
+#define _CLOCK_OFFSET_H
+
+#include "types.h"
+
+/*
+ * Estimation of the offset between the clock of a peer and ours, after
+ * NTP (RFC 5905).  Each timestamped packet which also echoes one of ours
+ * gives a sample of the offset, measured over a round trip.  The longer
+ * the round trip, the less accurate the sample, so the offset follows the
+ * sample with the shortest round trip among the last CLOCK_FILTER_SIZE.
+ * The skew, how fast the offset drifts, is measured between chosen samples
+ * at least CLOCK_SKEW_MIN_INTERVAL apart and carries the offset forward
+ * in between.  Times are in microseconds, and the peer's are the low 32
+ * bits of its clock, like the timestamps of udp_proto.c.
+ */
+#define CLOCK_FILTER_SIZE          16
+#define CLOCK_SKEW_MIN_INTERVAL    16000000
+#define CLOCK_MAX_SKEW_PPM         500.0f
+
+struct clock_OffsetSample
+{
+	uint64               time;       /* our clock when the sample was taken */
+	uint32               offset;     /* peer clock minus ours */
+	int                  delay;      /* round trip the sample was measured over */
+};
+typedef struct clock_OffsetSample clock_OffsetSample;
+
+struct ClockOffset
+{
+	clock_OffsetSample   _samples[CLOCK_FILTER_SIZE];
+	int                  _num_samples;
+	clock_OffsetSample   _best;
+	clock_OffsetSample   _skew_base;
+	float                _skew_ppm;
+	bool                 _has_skew;
+};
+typedef struct ClockOffset ClockOffset;
+
+void clock_offset_init(ClockOffset* clock);
+void clock_offset_add_sample(ClockOffset* clock, uint64 now, uint32 remote_time, int delay);
+uint32 clock_offset_to_remote(ClockOffset* clock, uint64 now);
+static inline bool clock_offset_is_valid(ClockOffset* clock) { return clock->_num_samples > 0; }
+static inline float clock_offset_get_skew(ClockOffset* clock) { return clock->_skew_ppm; }
+
+#endif
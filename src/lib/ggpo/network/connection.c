@@ -14,6 +14,9 @@
  * License along with this program. If not, see
  * <https://www.gnu.org/licenses/>.
 **/
+#if !defined(_WINDOWS)
+#define _GNU_SOURCE // for recvmmsg
+#endif
 #include "connection.h"
 
 #if defined(_WINDOWS)
@@ -22,21 +25,26 @@
 #include "sys/socket.h"
 #include <fcntl.h> // to set nonblocking socket
 #include <arpa/inet.h> // htonl
-#endif
 
-struct _conn_Socket
-{
-	// empty, socket descriptor is stored directly in the pointer to this struct.
-	int unused;
-};
+typedef struct linger LINGER;
+#endif
 
 struct _conn_Address
 {
 	struct sockaddr_in sa;
 };
 
-struct _conn_Address g_adress_pool[32];
-size_t g_address_pool_size;
+struct _conn_Socket
+{
+#if defined(_WINDOWS)
+	SOCKET s;
+#else
+	int s;
+#endif
+	// Senders of the last batch received.  A packet's address points in
+	// here, so anyone can send from anywhere without using up memory.
+	struct _conn_Address received[CONN_MAX_BATCH];
+};
 
 conn_Socket conn_open(uint16 port)
 {
@@ -83,26 +91,30 @@ conn_Socket conn_open(uint16 port)
 	}
 
 	Log("Udp bound to port: %d.\n", port);
-	return (conn_Socket)(uptr)s;
+	conn_Socket socket = calloc(1, sizeof(struct _conn_Socket));
+	socket->s = s;
+	return socket;
 }
 
 void conn_close(conn_Socket socket)
 {
+	if (!socket) {
+		return;
+	}
 #if defined(_WINDOWS)
-	SOCKET s = (uptr)socket;
-	closesocket(s);
+	closesocket(socket->s);
 #else
-	int s = (int)(uptr)socket;
-	close(s);
+	close(socket->s);
 #endif
+	free(socket);
 }
 
 void conn_send(conn_Socket socket, conn_Address remote, void const* data, uint32 size, int flags)
 {
 #if defined(_WINDOWS)
-	SOCKET s = (uptr)socket;
+	SOCKET s = socket->s;
 #else
-	int s = (int)(uptr)socket;
+	int s = socket->s;
 #endif
 
 	// NOTE: sockaddr_in and sockaddr have the same length by design.
@@ -122,29 +134,12 @@ void conn_send(conn_Socket socket, conn_Address remote, void const* data, uint32
 		res);
 }
 
-static void conn_fill_out_address(struct sockaddr_in const* sender_addr, conn_Address* out_address)
-{
-	for (size_t i = 0; i < g_address_pool_size; ++i) {
-		if (memcmp(sender_addr, &g_adress_pool[i].sa, sizeof(struct sockaddr_in)) == 0) {
-			*out_address = &g_adress_pool[i];
-			return;
-		}
-	}
-
-
-	ASSERT(g_address_pool_size < ARRAY_SIZE(g_adress_pool));
-	size_t iaddress = g_address_pool_size++;
-	g_adress_pool[iaddress].sa = *sender_addr;
-	*out_address = &g_adress_pool[iaddress];
-	return;
-}
-
-int conn_receive(conn_Socket socket, uint8* buf, uint32 size, conn_Address* out_address)
+static int conn_receive_into(conn_Socket socket, uint8* buf, uint32 size, struct _conn_Address* received, conn_Address* out_address)
 {
 #if defined(_WINDOWS)
-	SOCKET s = (uptr)socket;
+	SOCKET s = socket->s;
 #else
-	int s = (int)(uptr)socket;
+	int s = socket->s;
 #endif
 
 	// TODO: handle len == 0... indicates a disconnect.
@@ -168,27 +163,82 @@ int conn_receive(conn_Socket socket, uint8* buf, uint32 size, conn_Address* out_
 			inet_ntop(AF_INET, (void*)&sender_addr.sin_addr, src_ip, ARRAY_SIZE(src_ip)),
 			ntohs(sender_addr.sin_port));
 
-		conn_fill_out_address(&sender_addr, out_address);
+		received->sa = sender_addr;
+		*out_address = received;
 	}
 
 	return len;
 }
 
+int conn_receive(conn_Socket socket, uint8* buf, uint32 size, conn_Address* out_address)
+{
+	return conn_receive_into(socket, buf, size, &socket->received[0], out_address);
+}
+
+/*
+ * conn_receive_many --
+ *
+ * Receive up to count datagrams without blocking, in a single system call
+ * where the platform has one.  Returns how many were received.
+ */
+int conn_receive_many(conn_Socket socket, conn_Packet* packets, int count)
+{
+	count = MIN(count, CONN_MAX_BATCH);
+#if defined(_WINDOWS)
+	int received = 0;
+	while (received < count) {
+		conn_Packet* packet = &packets[received];
+		packet->len = conn_receive_into(socket, packet->buf, packet->size, &socket->received[received], &packet->from);
+		if (packet->len <= 0) {
+			break;
+		}
+		received++;
+	}
+	return received;
+#else
+	struct mmsghdr msgs[CONN_MAX_BATCH];
+	struct iovec iovecs[CONN_MAX_BATCH];
+
+	memset(msgs, 0, sizeof(msgs[0]) * count);
+	for (int i = 0; i < count; i++) {
+		iovecs[i].iov_base = packets[i].buf;
+		iovecs[i].iov_len = packets[i].size;
+		msgs[i].msg_hdr.msg_iov = &iovecs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+		msgs[i].msg_hdr.msg_name = &socket->received[i].sa;
+		msgs[i].msg_hdr.msg_namelen = sizeof(socket->received[i].sa);
+	}
+
+	int received = recvmmsg(socket->s, msgs, count, MSG_DONTWAIT, NULL);
+	if (received <= 0) {
+		return 0;
+	}
+	for (int i = 0; i < received; i++) {
+		packets[i].len = (int)msgs[i].msg_len;
+		packets[i].from = &socket->received[i];
+	}
+	return received;
+#endif
+}
+
 bool conn_support_ip_port()
 {
 	return true;
 }
 
-conn_Address conn_address_from_ip_port(char* ip, uint16 port)
+conn_Address conn_address_from_ip_port(conn_Socket socket, char* ip, uint16 port)
 {
-	ASSERT(g_address_pool_size < ARRAY_SIZE(g_adress_pool));
+	conn_Address address = calloc(1, sizeof(struct _conn_Address));
 
-	size_t iaddress = g_address_pool_size++;
-	g_adress_pool[iaddress].sa.sin_family = AF_INET; // IPv4
-	g_adress_pool[iaddress].sa.sin_port = htons(port);
-	inet_pton(AF_INET, ip, &g_adress_pool[iaddress].sa.sin_addr.s_addr);
+	address->sa.sin_family = AF_INET; // IPv4
+	address->sa.sin_port = htons(port);
+	inet_pton(AF_INET, ip, &address->sa.sin_addr.s_addr);
+	return address;
+}
 
-	return &g_adress_pool[iaddress];
+void conn_release_address(conn_Address address)
+{
+	free(address);
 }
 
 bool conn_addr_is_equal(conn_Address a, conn_Address b)
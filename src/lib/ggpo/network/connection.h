@@ -20,18 +20,36 @@
 typedef struct _conn_Socket* conn_Socket;
 typedef struct _conn_Address* conn_Address;
 
+/*
+ * One datagram of a batch.  The caller provides buf and size,
+ * conn_receive_many fills in len and from.  from belongs to the socket and
+ * is only good until the next receive on it.
+ */
+struct conn_Packet
+{
+	uint8*         buf;
+	uint32         size;
+	int            len;
+	conn_Address   from;
+};
+typedef struct conn_Packet conn_Packet;
+
 conn_Socket conn_open(uint16 port);
 void conn_close(conn_Socket socket);
 
 void conn_send(conn_Socket socket, conn_Address remote, void const *data, uint32 size, int flags);
 int conn_receive(conn_Socket socket, uint8 *buf, uint32 size, conn_Address *out_address);
+int conn_receive_many(conn_Socket socket, conn_Packet *packets, int count);
+
+#define CONN_MAX_BATCH 32
 
 bool conn_support_ip_port();
 bool conn_addr_is_equal(conn_Address a, conn_Address b);
+void conn_release_address(conn_Address address);
 
 #if defined(GGPO_STEAM)
 conn_Address conn_address_from_steam_id(uint64 steam_id);
 void conn_add_known_peer(uint64 steam_id);
 #else
-conn_Address conn_address_from_ip_port(char *ip, uint16 port);
+conn_Address conn_address_from_ip_port(conn_Socket socket, char *ip, uint16 port);
 #endif
@@ -250,6 +250,20 @@ int conn_receive(conn_Socket socket, uint8* buf, uint32 size, conn_Address* out_
 	return len;
 }
 
+int conn_receive_many(conn_Socket socket, conn_Packet* packets, int count)
+{
+	int received = 0;
+	while (received < count) {
+		conn_Packet* packet = &packets[received];
+		packet->len = conn_receive(socket, packet->buf, packet->size, &packet->from);
+		if (packet->len <= 0) {
+			break;
+		}
+		received++;
+	}
+	return received;
+}
+
 bool conn_support_ip_port()
 {
 	return false;
@@ -272,6 +286,14 @@ conn_Address conn_address_from_steam_id(uint64 steam_id)
 	return conn_intern_identity(&identity);
 }
 
+/*
+ * Steam addresses point into the table of known identities, which goes away
+ * with the connection, so there is nothing to free.
+ */
+void conn_release_address(conn_Address address)
+{
+}
+
 bool conn_addr_is_equal(conn_Address a, conn_Address b)
 {
 	if (a == b) {
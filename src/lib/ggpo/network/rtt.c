@@ -0,0 +1,64 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#include "rtt.h"
+
+void
+rtt_init(RttEstimator* rtt)
+{
+	memset(rtt, 0, sizeof(*rtt));
+}
+
+/*
+ * rtt_add_sample --
+ *
+ * Fold in a new round trip measurement.  The first one seeds the
+ * estimates, the following ones are blended in with the RFC 6298 gains of
+ * 1/8 for the mean and 1/4 for the variation.
+ */
+void
+rtt_add_sample(RttEstimator* rtt, int sample)
+{
+	sample = MAX(sample, 0);
+	if (rtt->_num_samples == 0) {
+		rtt->_srtt = sample;
+		rtt->_rttvar = sample / 2;
+	}
+	else {
+		rtt->_rttvar += (abs(rtt->_srtt - sample) - rtt->_rttvar) / 4;
+		rtt->_srtt += (sample - rtt->_srtt) / 8;
+	}
+	rtt->_num_samples++;
+	rtt->_backoff = 0;
+}
+
+/*
+ * rtt_get_timeout --
+ *
+ * How long to wait for an answer before sending again.
+ */
+int
+rtt_get_timeout(RttEstimator* rtt)
+{
+	int timeout = RTT_INITIAL_TIMEOUT;
+
+	if (rtt->_num_samples) {
+		timeout = rtt->_srtt + MAX(RTT_GRANULARITY, 4 * rtt->_rttvar);
+		timeout = MAX(timeout, RTT_MIN_TIMEOUT);
+	}
+	return MIN(timeout << rtt->_backoff, RTT_MAX_TIMEOUT);
+}
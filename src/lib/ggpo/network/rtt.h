@@ -0,0 +1,50 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#ifndef _RTT_H
+#define _RTT_H
+
+#include "types.h"
+
+/*
+ * Round trip time estimation, after RFC 6298.  Times are in microseconds.
+ * The timeout starts at RTT_INITIAL_TIMEOUT until the first sample comes
+ * in, and doubles every time it expires without a new sample.
+ */
+#define RTT_INITIAL_TIMEOUT     200000
+#define RTT_MIN_TIMEOUT         20000
+#define RTT_MAX_TIMEOUT         1000000
+#define RTT_GRANULARITY         1000
+#define RTT_MAX_BACKOFF         5
+
+struct RttEstimator
+{
+	int                  _srtt;
+	int                  _rttvar;
+	int                  _backoff;
+	int                  _num_samples;
+};
+typedef struct RttEstimator RttEstimator;
+
+void rtt_init(RttEstimator* rtt);
+void rtt_add_sample(RttEstimator* rtt, int sample);
+int rtt_get_timeout(RttEstimator* rtt);
+static inline void rtt_on_timeout(RttEstimator* rtt) { rtt->_backoff = MIN(rtt->_backoff + 1, RTT_MAX_BACKOFF); }
+static inline int rtt_get_srtt(RttEstimator* rtt) { return rtt->_srtt; }
+static inline int rtt_get_rttvar(RttEstimator* rtt) { return rtt->_rttvar; }
+
+#endif
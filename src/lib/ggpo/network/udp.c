@@ -23,6 +23,7 @@
 
 #include "types.h"
 #include "udp.h"
+#include "udp_msg.h"
 
 #if 0
 static SOCKET CreateSocket(uint16 bind_port, int retries)
@@ -38,6 +39,12 @@ void udp_ctor(Udp* udp)
 
 void udp_dtor(Udp* udp)
 {
+	if (udp->_shared) {
+		udp->_shared->_sessions[udp->_session_id] = NULL;
+		udp->_shared->_num_sessions--;
+		udp->_shared = NULL;
+		return;
+	}
 	conn_close(udp->_socket);
 	// closesocket(udp->_socket);
 	// udp->_socket = INVALID_SOCKET;
@@ -53,6 +60,82 @@ void udp_Init(Udp* udp, uint16 port, UdpOnMsgFn on_msg_callback, void* user_data
 	udp->_socket = conn_open(port);
 }
 
+/*
+ * udp_InitShared --
+ *
+ * Attach to a shared socket instead of binding one.  session_id must be
+ * free on it (see udp_socket_IsSessionFree).
+ */
+void udp_InitShared(Udp* udp, UdpSocket* shared, uint16 session_id, UdpOnMsgFn on_msg_callback, void* user_data)
+{
+	ASSERT(udp_socket_IsSessionFree(shared, session_id));
+
+	udp->_user_data = user_data;
+	udp->_on_msg_callback = on_msg_callback;
+	udp->_socket = shared->_socket;
+	udp->_shared = shared;
+	udp->_session_id = session_id;
+
+	shared->_sessions[session_id] = udp;
+	shared->_num_sessions++;
+	udp_Log("attached session %d to a shared socket.\n", session_id);
+}
+
+bool udp_socket_Open(UdpSocket* shared, uint16 port)
+{
+	memset(shared, 0, sizeof(*shared));
+	udp_Log("binding shared udp socket to port %d.\n", port);
+	shared->_socket = conn_open(port);
+	if (!shared->_socket) {
+		return false;
+	}
+	shared->_sessions = calloc(UDP_MAX_SESSION_IDS, sizeof(Udp*));
+	return true;
+}
+
+void udp_socket_Close(UdpSocket* shared)
+{
+	ASSERT(shared->_num_sessions == 0);
+	conn_close(shared->_socket);
+	free(shared->_sessions);
+	memset(shared, 0, sizeof(*shared));
+}
+
+/*
+ * udp_socket_Poll --
+ *
+ * Drain the shared socket, handing each packet to the session it is
+ * addressed to.  Packets for sessions which aren't attached are dropped.
+ */
+void udp_socket_Poll(UdpSocket* shared)
+{
+	uint8          recv_bufs[UDP_RECV_BATCH][MAX_UDP_PACKET_SIZE];
+	conn_Packet    packets[UDP_RECV_BATCH];
+
+	for (int i = 0; i < UDP_RECV_BATCH; i++) {
+		packets[i].buf = recv_bufs[i];
+		packets[i].size = MAX_UDP_PACKET_SIZE;
+	}
+	for (;;) {
+		int count = conn_receive_many(shared->_socket, packets, UDP_RECV_BATCH);
+		for (int i = 0; i < count; i++) {
+			UdpMsg* msg = (UdpMsg*)packets[i].buf;
+			if (packets[i].len < (int)sizeof(msg->hdr)) {
+				continue;
+			}
+			Udp* udp = shared->_sessions[msg->hdr.dst_session];
+			if (!udp) {
+				udp_Log("dropping packet for unknown session %d.\n", msg->hdr.dst_session);
+				continue;
+			}
+			udp->_on_msg_callback(packets[i].from, msg, packets[i].len, udp->_user_data);
+		}
+		if (count < UDP_RECV_BATCH) {
+			break;
+		}
+	}
+}
+
 void udp_SendTo(Udp* udp, char* buffer, int len, int flags, conn_Address to)
 {
 	conn_send(udp->_socket, to, buffer, len, flags);
@@ -68,31 +151,30 @@ void udp_SendTo(Udp* udp, char* buffer, int len, int flags, conn_Address to)
 
 bool udp_OnLoopPoll(Udp *udp)
 {
-	uint8          recv_buf[MAX_UDP_PACKET_SIZE];
-	conn_Address    recv_addr;
-	// int            recv_addr_len;
+	if (udp->_shared) {
+		udp_socket_Poll(udp->_shared);
+		return true;
+	}
 
-	for (;;) {
-		// recv_addr_len = sizeof(recv_addr);
+	uint8          recv_bufs[UDP_RECV_BATCH][MAX_UDP_PACKET_SIZE];
+	conn_Packet    packets[UDP_RECV_BATCH];
 
-		int len = conn_receive(udp->_socket, recv_buf, MAX_UDP_PACKET_SIZE, &recv_addr);
+	for (int i = 0; i < UDP_RECV_BATCH; i++) {
+		packets[i].buf = recv_bufs[i];
+		packets[i].size = MAX_UDP_PACKET_SIZE;
+	}
+	for (;;) {
 		// TODO: handle len == 0... indicates a disconnect.
-		// if (len == -1) {
-		//	int error = WSAGetLastError();
-		//	if (error != WSAEWOULDBLOCK) {
-		//		Log("recvfrom WSAGetLastError returned %d (%x).\n", error, error);
-		//	}
-		//	break;
-		//} else if (len > 0) {
-		 if (len > 0) {
-			 // char src_ip[1024];
-			// Log("recvfrom returned (len:%d  from:%s:%d).\n", len, inet_ntop(AF_INET, (void*)&recv_addr.sin_addr, src_ip, ARRAY_SIZE(src_ip)), ntohs(recv_addr.sin_port));
-			UdpMsg* msg = (UdpMsg*)recv_buf;
-			udp->_on_msg_callback(recv_addr, msg, len, udp->_user_data);
-		 }
-		 else {
-			 break;
-		 }
+		int count = conn_receive_many(udp->_socket, packets, UDP_RECV_BATCH);
+		for (int i = 0; i < count; i++) {
+			if (packets[i].len > 0) {
+				UdpMsg* msg = (UdpMsg*)packets[i].buf;
+				udp->_on_msg_callback(packets[i].from, msg, packets[i].len, udp->_user_data);
+			}
+		}
+		if (count < UDP_RECV_BATCH) {
+			break;
+		}
 	}
 	return true;
 }
@@ -32,8 +32,20 @@
 
 #define MAX_UDP_PACKET_SIZE 4096
 
+/*
+ * Datagrams taken off the socket per system call.
+ */
+#define UDP_RECV_BATCH      8
+
+/*
+ * Sessions attached to a shared socket are told apart by a 16 bit id
+ * carried in every packet.  0 means the session has a socket of its own.
+ */
+#define UDP_MAX_SESSION_IDS 65536
+
 typedef struct UdpMsg UdpMsg;
 typedef void (*UdpOnMsgFn)(conn_Address from, UdpMsg *msg, int len, void* user_data);
+typedef struct Udp Udp;
 
 
 struct udp_Stats {
@@ -43,22 +55,43 @@ struct udp_Stats {
 };
 typedef struct udp_Stats udp_Stats;
 
+/*
+ * A socket many sessions attach to (GGPOSocket in ggponet.h).  Whichever
+ * session polls first receives the packets of all of them and hands each
+ * one to the session its id names.  The sessions must all be driven from
+ * the same thread.
+ */
+struct GGPOSocket
+{
+   conn_Socket         _socket;
+   Udp**               _sessions;     // indexed by session id
+   int                 _num_sessions;
+};
+typedef struct GGPOSocket UdpSocket;
+
 struct Udp
 {
    // Network transmission information
    conn_Socket         _socket;
+   UdpSocket*          _shared;
+   uint16              _session_id;
 
    // state management
    void* _user_data;
    UdpOnMsgFn      _on_msg_callback;
 };
-typedef struct Udp Udp;
 
 void udp_Log(const char *fmt, ...);
 
+bool udp_socket_Open(UdpSocket* shared, uint16 port);
+void udp_socket_Close(UdpSocket* shared);
+static inline bool udp_socket_IsSessionFree(UdpSocket* shared, uint16 session_id) { return session_id != 0 && !shared->_sessions[session_id]; }
+void udp_socket_Poll(UdpSocket* shared);
+
 void udp_ctor(Udp* udp);
 void udp_dtor(Udp* udp);
 void udp_Init(Udp* udp, uint16 port, UdpOnMsgFn on_msg_callback, void *user_data);
+void udp_InitShared(Udp* udp, UdpSocket* shared, uint16 session_id, UdpOnMsgFn on_msg_callback, void *user_data);
 void udp_SendTo(Udp* ud, char *buffer, int len, int flags, conn_Address to);
 bool udp_OnLoopPoll(Udp* udp);
 
@@ -0,0 +1,344 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#include "types.h"
+#include "udp_msg.h"
+
+/*
+ * udp_msg.c --
+ *
+ * The wire format of input messages and bundles (see udp_msg.h).
+ *
+ * Most of an input message is frame
+ * numbers which are close to one another, timestamps and flags, so after
+ * the header they go out as:
+ *
+ *    flags                         one byte of UDP_MSG_INPUT_* bits
+ *    ack_frame + 1                 varint
+ *    start_frame - ack_frame       zigzag varint      if HAS_BITS
+ *    num_bits                      varint             if HAS_BITS
+ *    bits                          (num_bits + 7) / 8 bytes; the first
+ *                                  frame is written whole if RAW_FIRST_FRAME,
+ *                                  and it follows the frames of the previous
+ *                                  message if CONTINUATION
+ *    current_frame - ack_frame     zigzag varint      if HAS_CURRENT_FRAME
+ *    timestamp                     4 bytes            if HAS_TIMESTAMP
+ *    echo_timestamp                4 bytes            if HAS_ECHO_TIMESTAMP
+ *    connect_status_mask           varint             if HAS_CONNECT_STATUS
+ *    connect statuses              one varint each, the zigzagged distance
+ *                                  of last_frame from ack_frame times two,
+ *                                  plus one if disconnected
+ *
+ * Varints hold 7 bits per byte, low bits first, with the top bit set on
+ * every byte but the last.
+ */
+
+#define UDP_MSG_INPUT_DISCONNECT_REQUESTED  (1 << 0)
+#define UDP_MSG_INPUT_HAS_BITS              (1 << 1)
+#define UDP_MSG_INPUT_HAS_CURRENT_FRAME     (1 << 2)
+#define UDP_MSG_INPUT_HAS_TIMESTAMP         (1 << 3)
+#define UDP_MSG_INPUT_HAS_ECHO_TIMESTAMP    (1 << 4)
+#define UDP_MSG_INPUT_HAS_CONNECT_STATUS    (1 << 5)
+#define UDP_MSG_INPUT_RAW_FIRST_FRAME       (1 << 6)
+#define UDP_MSG_INPUT_CONTINUATION          (1 << 7)
+
+#define UDP_MSG_MAX_FRAME                   0x3fffffff
+
+static uint8*
+udp_msg_PutVarint(uint8* p, uint64 value)
+{
+	while (value >= 0x80) {
+		*p++ = (uint8)(value | 0x80);
+		value >>= 7;
+	}
+	*p++ = (uint8)value;
+	return p;
+}
+
+static int
+udp_msg_VarintSize(uint64 value)
+{
+	int size = 1;
+
+	while (value >= 0x80) {
+		value >>= 7;
+		size++;
+	}
+	return size;
+}
+
+static const uint8*
+udp_msg_GetVarint(const uint8* p, const uint8* end, uint64* value)
+{
+	int shift;
+
+	*value = 0;
+	for (shift = 0; p < end && shift < 64; shift += 7) {
+		uint8 b = *p++;
+		*value |= (uint64)(b & 0x7f) << shift;
+		if (!(b & 0x80)) {
+			return p;
+		}
+	}
+	return NULL;
+}
+
+/*
+ * Frames are sent as their distance from a base frame, zigzagged so that
+ * small negative distances are small too.
+ */
+static uint64
+udp_msg_ZigzagFrame(int frame, int base)
+{
+	int64 delta = (int64)frame - base;
+	return ((uint64)delta << 1) ^ (uint64)(delta >> 63);
+}
+
+static bool
+udp_msg_UnzigzagFrame(uint64 value, int base, int* frame)
+{
+	int64 result = base + ((int64)(value >> 1) ^ -(int64)(value & 1));
+
+	if (result < -1 || result > UDP_MSG_MAX_FRAME) {
+		return false;
+	}
+	*frame = (int)result;
+	return true;
+}
+
+static const uint8*
+udp_msg_GetFrame(const uint8* p, const uint8* end, int base, int* frame)
+{
+	uint64 value;
+
+	p = p ? udp_msg_GetVarint(p, end, &value) : NULL;
+	return p && udp_msg_UnzigzagFrame(value, base, frame) ? p : NULL;
+}
+
+/*
+ * udp_msg_PackInput --
+ *
+ * Rewrite the input message msg in its wire format, in place.  Returns the
+ * number of bytes to send.  Only the header of msg can be read afterwards.
+ */
+int
+udp_msg_PackInput(UdpMsg* msg)
+{
+	uint8 packet[sizeof(UdpMsg)];
+	uint8* p = packet + sizeof(msg->hdr);
+	uint8 flags = 0;
+	int ack_frame = msg->u.input.ack_frame;
+	int num_bytes = (msg->u.input.num_bits + 7) / 8;
+
+	ASSERT(msg->hdr.type == UdpMsg_Input);
+	ASSERT(ack_frame >= -1);
+
+	flags |= msg->u.input.disconnect_requested ? UDP_MSG_INPUT_DISCONNECT_REQUESTED : 0;
+	flags |= msg->u.input.num_bits ? UDP_MSG_INPUT_HAS_BITS : 0;
+	flags |= msg->u.input.current_frame >= 0 ? UDP_MSG_INPUT_HAS_CURRENT_FRAME : 0;
+	flags |= msg->u.input.timestamp ? UDP_MSG_INPUT_HAS_TIMESTAMP : 0;
+	flags |= msg->u.input.echo_timestamp ? UDP_MSG_INPUT_HAS_ECHO_TIMESTAMP : 0;
+	flags |= msg->u.input.connect_status_mask ? UDP_MSG_INPUT_HAS_CONNECT_STATUS : 0;
+	flags |= msg->u.input.num_bits && msg->u.input.first_frame_raw ? UDP_MSG_INPUT_RAW_FIRST_FRAME : 0;
+	flags |= msg->u.input.num_bits && msg->u.input.continuation ? UDP_MSG_INPUT_CONTINUATION : 0;
+
+	memcpy(packet, &msg->hdr, sizeof(msg->hdr));
+	*p++ = flags;
+	p = udp_msg_PutVarint(p, (uint64)(ack_frame + 1));
+	if (flags & UDP_MSG_INPUT_HAS_BITS) {
+		p = udp_msg_PutVarint(p, udp_msg_ZigzagFrame(msg->u.input.start_frame, ack_frame));
+		p = udp_msg_PutVarint(p, msg->u.input.num_bits);
+		memcpy(p, msg->u.input.bits, num_bytes);
+		p += num_bytes;
+	}
+	if (flags & UDP_MSG_INPUT_HAS_CURRENT_FRAME) {
+		p = udp_msg_PutVarint(p, udp_msg_ZigzagFrame(msg->u.input.current_frame, ack_frame));
+	}
+	if (flags & UDP_MSG_INPUT_HAS_TIMESTAMP) {
+		memcpy(p, &msg->u.input.timestamp, sizeof(uint32));
+		p += sizeof(uint32);
+	}
+	if (flags & UDP_MSG_INPUT_HAS_ECHO_TIMESTAMP) {
+		memcpy(p, &msg->u.input.echo_timestamp, sizeof(uint32));
+		p += sizeof(uint32);
+	}
+	if (flags & UDP_MSG_INPUT_HAS_CONNECT_STATUS) {
+		UdpMsg_connect_status* status = udp_msg_ConnectStatus(msg);
+		int count = udp_msg_ConnectStatusCount(msg->u.input.connect_status_mask);
+
+		p = udp_msg_PutVarint(p, msg->u.input.connect_status_mask);
+		for (int i = 0; i < count; i++) {
+			p = udp_msg_PutVarint(p, (udp_msg_ZigzagFrame(status[i].last_frame, ack_frame) << 1) | status[i].disconnected);
+		}
+	}
+
+	ASSERT(p - packet <= (int)sizeof(packet));
+	memcpy(msg, packet, p - packet);
+	return (int)(p - packet);
+}
+
+/*
+ * udp_msg_UnpackInput --
+ *
+ * Decode the len bytes of the input message packet, as received, into msg.
+ * Returns false if they aren't a well formed input message.
+ */
+bool
+udp_msg_UnpackInput(const UdpMsg* packet, int len, UdpMsg* msg)
+{
+	const uint8* p = (const uint8*)packet + sizeof(packet->hdr);
+	const uint8* end = (const uint8*)packet + len;
+	uint64 value;
+	uint8 flags;
+
+	if (len < (int)sizeof(packet->hdr) + 1) {
+		return false;
+	}
+	memcpy(&msg->hdr, &packet->hdr, sizeof(msg->hdr));
+	memset(&msg->u.input, 0, (char*)&msg->u.input.bits - (char*)&msg->u.input);
+	flags = *p++;
+	msg->u.input.disconnect_requested = (flags & UDP_MSG_INPUT_DISCONNECT_REQUESTED) != 0;
+	msg->u.input.first_frame_raw = (flags & UDP_MSG_INPUT_RAW_FIRST_FRAME) != 0;
+	msg->u.input.continuation = (flags & UDP_MSG_INPUT_CONTINUATION) != 0;
+	msg->u.input.current_frame = -1;
+
+	p = udp_msg_GetVarint(p, end, &value);
+	if (!p || value > UDP_MSG_MAX_FRAME + 1) {
+		return false;
+	}
+	msg->u.input.ack_frame = (int)value - 1;
+
+	if (flags & UDP_MSG_INPUT_HAS_BITS) {
+		p = udp_msg_GetFrame(p, end, msg->u.input.ack_frame, &msg->u.input.start_frame);
+		p = p ? udp_msg_GetVarint(p, end, &value) : NULL;
+		if (!p || value == 0 || value > UDP_MSG_MAX_INPUT_BITS || end - p < (int64)(value + 7) / 8) {
+			return false;
+		}
+		msg->u.input.num_bits = (uint16)value;
+		memcpy(msg->u.input.bits, p, (value + 7) / 8);
+		p += (value + 7) / 8;
+	}
+	if (flags & UDP_MSG_INPUT_HAS_CURRENT_FRAME) {
+		p = udp_msg_GetFrame(p, end, msg->u.input.ack_frame, &msg->u.input.current_frame);
+		if (!p) {
+			return false;
+		}
+	}
+	if (flags & UDP_MSG_INPUT_HAS_TIMESTAMP) {
+		if (end - p < (int)sizeof(uint32)) {
+			return false;
+		}
+		memcpy(&msg->u.input.timestamp, p, sizeof(uint32));
+		p += sizeof(uint32);
+	}
+	if (flags & UDP_MSG_INPUT_HAS_ECHO_TIMESTAMP) {
+		if (end - p < (int)sizeof(uint32)) {
+			return false;
+		}
+		memcpy(&msg->u.input.echo_timestamp, p, sizeof(uint32));
+		p += sizeof(uint32);
+	}
+	if (flags & UDP_MSG_INPUT_HAS_CONNECT_STATUS) {
+		UdpMsg_connect_status* status = udp_msg_ConnectStatus(msg);
+		int count;
+
+		p = udp_msg_GetVarint(p, end, &value);
+		if (!p || value == 0 || value > 0xffff) {
+			return false;
+		}
+		msg->u.input.connect_status_mask = (uint16)value;
+		count = udp_msg_ConnectStatusCount(msg->u.input.connect_status_mask);
+		for (int i = 0; i < count; i++) {
+			int last_frame;
+
+			p = udp_msg_GetVarint(p, end, &value);
+			if (!p || !udp_msg_UnzigzagFrame(value >> 1, msg->u.input.ack_frame, &last_frame)) {
+				return false;
+			}
+			status[i].disconnected = value & 1;
+			status[i].last_frame = last_frame;
+		}
+	}
+	return p == end;
+}
+
+/*
+ * udp_msg_BundleEntrySize --
+ *
+ * How many bytes a message of len bytes, header included, takes in a
+ * bundle.
+ */
+int
+udp_msg_BundleEntrySize(int len)
+{
+	int payload = len - (int)sizeof(((UdpMsg*)0)->hdr);
+	return 1 + udp_msg_VarintSize(payload) + payload;
+}
+
+/*
+ * udp_msg_AddToBundle --
+ *
+ * Append msg, of len bytes as it would be sent on its own, to the
+ * bundle_len bytes of bundle.  Returns the new length of the bundle.
+ */
+int
+udp_msg_AddToBundle(UdpMsg* bundle, int bundle_len, const UdpMsg* msg, int len)
+{
+	uint8* p = (uint8*)bundle + bundle_len;
+	int payload = len - (int)sizeof(msg->hdr);
+
+	ASSERT(bundle->hdr.type == UdpMsg_Bundle && msg->hdr.type != UdpMsg_Bundle);
+	*p++ = msg->hdr.type;
+	p = udp_msg_PutVarint(p, payload);
+	memcpy(p, (const uint8*)msg + sizeof(msg->hdr), payload);
+	return (int)(p + payload - (uint8*)bundle);
+}
+
+/*
+ * udp_msg_NextInBundle --
+ *
+ * Copy the message at *offset in the bundle into msg, as it would have
+ * been received on its own, and move *offset past it.  Returns the length
+ * of the message, 0 at the end of the bundle or -1 if it is malformed.
+ */
+int
+udp_msg_NextInBundle(const UdpMsg* bundle, int bundle_len, int* offset, UdpMsg* msg)
+{
+	const uint8* p = (const uint8*)bundle + *offset;
+	const uint8* end = (const uint8*)bundle + bundle_len;
+	uint64 payload;
+	uint8 type;
+
+	if (*offset < (int)sizeof(bundle->hdr)) {
+		*offset = sizeof(bundle->hdr);
+		p = (const uint8*)bundle + *offset;
+	}
+	if (p >= end) {
+		return 0;
+	}
+	type = *p++;
+	p = udp_msg_GetVarint(p, end, &payload);
+	if (!p || type == UdpMsg_Bundle || payload > (uint64)(end - p) || payload > sizeof(msg->u)) {
+		return -1;
+	}
+	memcpy(&msg->hdr, &bundle->hdr, sizeof(msg->hdr));
+	msg->hdr.type = type;
+	memcpy(&msg->u, p, (size_t)payload);
+	memset((uint8*)&msg->u + payload, 0, sizeof(msg->u) - (size_t)payload);
+	*offset = (int)(p + payload - (const uint8*)bundle);
+	return (int)(sizeof(msg->hdr) + payload);
+}
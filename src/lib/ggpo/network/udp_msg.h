@@ -9,7 +9,8 @@
 #define _UDP_MSG_H
 
 #define MAX_COMPRESSED_BITS       4096
-#define UDP_MSG_MAX_PLAYERS          4
+#define UDP_MSG_MAX_PLAYERS         16
+#define UDP_MSG_MAX_STATE_CHUNK   1024
 
 #pragma pack(push, 1)
 
@@ -22,6 +23,9 @@ enum udp_msg_MsgType {
       UdpMsg_QualityReply  = 5,
       UdpMsg_KeepAlive     = 6,
       UdpMsg_InputAck      = 7,
+      UdpMsg_StateChunk    = 8,
+      UdpMsg_StateAck      = 9,
+      UdpMsg_Bundle        = 10,
 };
 typedef enum udp_msg_MsgType udp_msg_MsgType;
 
@@ -37,12 +41,15 @@ struct UdpMsg
       uint16         magic;
       uint16         sequence_number;
       uint8          type;            /* packet type */
+      uint16         dst_session;     /* session id of the receiver on a shared socket */
+      uint16         src_session;     /* session id of the sender, 0 if it has its own socket */
    } hdr;
    union {
       struct {
          uint32      random_request;  /* please reply back with this random data */
          uint16      remote_magic;
          uint8       remote_endpoint;
+         uint8       input_size;      /* size of the inputs the sender will send, 0 if none */
       } sync_request;
       
       struct {
@@ -51,37 +58,80 @@ struct UdpMsg
       
       struct {
          int8        frame_advantage; /* what's the other guy's frame advantage? */
-         uint32      ping;
+         uint32      ping;            /* sender clock in microseconds */
       } quality_report;
       
       struct {
          uint32      pong;
       } quality_reply;
 
+      /*
+       * Input messages don't go on the wire laid out like this: see
+       * udp_msg_PackInput.  The size of the inputs is not in them either,
+       * each side tells the other in its sync requests.
+       */
       struct {
-         UdpMsg_connect_status    peer_connect_status[UDP_MSG_MAX_PLAYERS];
-
-         uint32            start_frame;
-
-         int               disconnect_requested:1;
-         int               ack_frame:31;
+         /*
+          * The players whose connect status changed, one bit each.  Their
+          * statuses follow the input bits, see udp_msg_ConnectStatus.
+          */
+         uint16            connect_status_mask;
+
+         uint32            timestamp;       /* sender clock in microseconds, 0 if none */
+         uint32            echo_timestamp;  /* last timestamp received, plus how long we held it */
+         int               current_frame;   /* frame the sender was on, -1 if unknown */
+
+         int               start_frame;
+         int               ack_frame;
+         uint8             disconnect_requested;
+         uint8             first_frame_raw; /* bits start with all of start_frame instead of its delta */
+         uint8             continuation;    /* starts where the sender's previous message stopped, not at its ack */
 
          uint16            num_bits;
-         uint8             input_size; // XXX: shouldn't be in every single packet!
          uint8             bits[MAX_COMPRESSED_BITS]; /* must be last */
       } input;
 
       struct {
          int               ack_frame:31;
+         uint32            timestamp;
+         uint32            echo_timestamp;
       } input_ack;
+
+      struct {
+         int               frame;           /* frame the state was saved at */
+         uint32            raw_size;        /* size of the decompressed state */
+         uint32            total_size;      /* size of the compressed state */
+         uint32            offset;
+         uint16            size;
+         uint8             data[UDP_MSG_MAX_STATE_CHUNK]; /* must be last */
+      } state_chunk;
+
+      struct {
+         int               frame;
+         uint32            received;        /* bytes received in order so far */
+      } state_ack;
    } u;
 };
 typedef struct UdpMsg UdpMsg;
 
-inline void udp_msg_ctor(UdpMsg* msg, udp_msg_MsgType t) { memset(msg, 0, sizeof(UdpMsg)); msg->hdr.type = (uint8)t; }
+static inline void udp_msg_ctor(UdpMsg* msg, udp_msg_MsgType t) { memset(msg, 0, sizeof(UdpMsg)); msg->hdr.type = (uint8)t; }
+
+
+static inline int udp_msg_ConnectStatusCount(uint16 mask)
+{
+    int count = 0;
+    for (; mask; mask &= mask - 1) {
+        count++;
+    }
+    return count;
+}
 
+static inline UdpMsg_connect_status* udp_msg_ConnectStatus(UdpMsg* msg)
+{
+    return (UdpMsg_connect_status*)(msg->u.input.bits + (msg->u.input.num_bits + 7) / 8);
+}
 
-inline int udp_msg_PayloadSize(UdpMsg* msg)
+static inline int udp_msg_PayloadSize(UdpMsg* msg)
 {
     int size;
 
@@ -95,17 +145,51 @@ inline int udp_msg_PayloadSize(UdpMsg* msg)
     case UdpMsg_Input:
         size = (int)((char *)&msg->u.input.bits - (char *)&msg->u.input);
         size += (msg->u.input.num_bits + 7) / 8;
+        size += udp_msg_ConnectStatusCount(msg->u.input.connect_status_mask) * sizeof(UdpMsg_connect_status);
         return size;
+    case UdpMsg_StateChunk:
+        size = (int)((char *)&msg->u.state_chunk.data - (char *)&msg->u.state_chunk);
+        size += msg->u.state_chunk.size;
+        return size;
+    case UdpMsg_StateAck:      return sizeof(msg->u.state_ack);
     }
     ASSERT(false);
     return 0;
 }
 
-inline int udp_msg_PacketSize(UdpMsg* msg)
+static inline int udp_msg_PacketSize(UdpMsg* msg)
 {
     return sizeof(msg->hdr) + udp_msg_PayloadSize(msg);
 }
 
+/*
+ * The most input bits a message can carry, leaving room for the connect
+ * statuses stored after them.
+ */
+#define UDP_MSG_MAX_INPUT_BITS \
+   ((MAX_COMPRESSED_BITS - UDP_MSG_MAX_PLAYERS * (int)sizeof(UdpMsg_connect_status)) * 8)
+
+/*
+ * The most a packed input message can take besides its bits: the header,
+ * the flags, three frame numbers, the number of bits, two timestamps and
+ * every connect status, plus its type and size when it is in a bundle.
+ */
+#define UDP_MSG_MAX_INPUT_OVERHEAD \
+   ((int)sizeof(((UdpMsg*)0)->hdr) + 1 + 3 * 5 + 3 + 2 * 4 + 3 + UDP_MSG_MAX_PLAYERS * 5 + 1 + 2)
+
+int udp_msg_PackInput(UdpMsg* msg);
+bool udp_msg_UnpackInput(const UdpMsg* packet, int len, UdpMsg* msg);
+
+/*
+ * Several messages to the same peer can share a datagram.  A bundle is a
+ * header of type UdpMsg_Bundle followed by each message's type, the size
+ * of its payload as a varint and the payload.  Its messages take the
+ * magic and sequence number of its header.
+ */
+int udp_msg_BundleEntrySize(int len);
+int udp_msg_AddToBundle(UdpMsg* bundle, int bundle_len, const UdpMsg* msg, int len);
+int udp_msg_NextInBundle(const UdpMsg* bundle, int bundle_len, int* offset, UdpMsg* msg);
+
 #pragma pack(pop)
 
 #endif   
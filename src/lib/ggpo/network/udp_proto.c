@@ -25,17 +25,22 @@
 #include "udp_proto.h"
 #include "bitvector.h"
 #include "udp_msg.h"
+#include "compress.h"
 
 #define UDP_HEADER_SIZE 28     /* Size of IP + UDP headers */
 #define NUM_SYNC_PACKETS 5
 #define SYNC_RETRY_INTERVAL 2000
 #define SYNC_FIRST_RETRY_INTERVAL 500
-#define RUNNING_RETRY_INTERVAL 200
 #define KEEP_ALIVE_INTERVAL 200
 #define QUALITY_REPORT_INTERVAL 1000
 #define NETWORK_STATS_INTERVAL 1000
 #define UDP_SHUTDOWN_TIMER 5000
 #define MAX_SEQ_DISTANCE (1 << 15)
+#define UDP_PROTOCOL_EVENT_QUEUE_RESERVE 8
+#define STATE_WINDOW_CHUNKS 8
+#define STATE_RETRY_INTERVAL 200
+#define STATE_MAX_SIZE (64 * 1024 * 1024)
+#define MAX_REMOTE_FRAME_EXTRAPOLATION 2
 
 
 
@@ -46,12 +51,19 @@ static bool UdpProtocol_OnInput(UdpProtocol *protocol, UdpMsg* msg, int len);
 static bool UdpProtocol_OnInputAck(UdpProtocol *protocol, UdpMsg* msg, int len);
 static bool UdpProtocol_OnQualityReport(UdpProtocol *protocol, UdpMsg* msg, int len);
 static bool UdpProtocol_OnQualityReply(UdpProtocol *protocol, UdpMsg* msg, int len);
+static uint32 UdpProtocol_GetTimestamp(void);
+static uint32 UdpProtocol_GetEchoTimestamp(UdpProtocol *protocol);
+static void UdpProtocol_OnTimestamps(UdpProtocol *protocol, uint32 timestamp, uint32 echo_timestamp);
+static void UdpProtocol_AddRttSample(UdpProtocol *protocol, int sample);
 static bool UdpProtocol_OnKeepAlive(UdpProtocol *protocol, UdpMsg* msg, int len);
+static bool UdpProtocol_OnStateChunk(UdpProtocol *protocol, UdpMsg* msg, int len);
+static bool UdpProtocol_OnStateAck(UdpProtocol *protocol, UdpMsg* msg, int len);
 
 void UdpProtocol_ctor(UdpProtocol* protocol)
 {
 	memset(protocol, 0, sizeof(UdpProtocol));
 	protocol->_queue = -1;
+	protocol->_path_mtu = UDP_PROTOCOL_DEFAULT_PATH_MTU;
 
 	gameinput_init(&protocol->_last_sent_input, -1, NULL, 1);
 	gameinput_init(&protocol->_last_received_input, -1, NULL, 1);
@@ -61,6 +73,7 @@ void UdpProtocol_ctor(UdpProtocol* protocol)
 	memset(protocol->_peer_connect_status, 0, sizeof(protocol->_peer_connect_status));
 	for (int i = 0; i < ARRAY_SIZE(protocol->_peer_connect_status); i++) {
 		protocol->_peer_connect_status[i].last_frame = -1;
+		protocol->_sent_connect_status[i].last_frame = -1;
 	}
 	memset(&protocol->_peer_addr, 0, sizeof protocol->_peer_addr);
 	protocol->_oo_packet.msg = NULL;
@@ -69,26 +82,51 @@ void UdpProtocol_ctor(UdpProtocol* protocol)
 	protocol->_oop_percent = Platform_GetConfigInt("ggpo.oop.percent");
 
 	timesync_init(&protocol->_timesync);
+	rtt_init(&protocol->_rtt);
+	clock_offset_init(&protocol->_clock);
+	random_init_unique(&protocol->_random, protocol);
+	protocol->_local_frame = -1;
+	protocol->_remote_frame = -1;
 
 	ring_ctor(&protocol->_send_queue_ring, ARRAY_SIZE(protocol->_send_queue));
-	ring_ctor(&protocol->_pending_output_ring, ARRAY_SIZE(protocol->_pending_output));
+	ring_ctor(&protocol->_pending_output_ring, ARRAY_SIZE(protocol->_pending_frames));
 	ring_ctor(&protocol->_event_queue_ring, ARRAY_SIZE(protocol->_event_queue));
 }
 
 void UdpProtocol_dtor(UdpProtocol* protocol)
 {
+	for (int i = 0; i < protocol->_bundle.count; i++) {
+		free(protocol->_bundle.msgs[i]);
+	}
+	protocol->_bundle.count = 0;
+	for (int i = 0; i < protocol->_fragments.count; i++) {
+		free(protocol->_fragments.msgs[i]);
+	}
+	protocol->_fragments.count = 0;
 	UdpProtocol_ClearSendQueue(protocol);
+	free(protocol->_snapshot.data);
+	protocol->_snapshot.data = NULL;
+	free(protocol->_pending_bits);
+	protocol->_pending_bits = NULL;
+	free(protocol->_event_bits);
+	protocol->_event_bits = NULL;
+	if (protocol->_peer_addr) {
+		conn_release_address(protocol->_peer_addr);
+		protocol->_peer_addr = NULL;
+	}
 }
 
 void UdpProtocol_Init(UdpProtocol* protocol,
 	Udp* udp,
 	int queue,
 	conn_Address addr,
-	UdpMsg_connect_status* status)
+	UdpMsg_connect_status* status,
+	int input_size)
 {
 	protocol->_udp = udp;
 	protocol->_queue = queue;
 	protocol->_local_connect_status = status;
+	protocol->_input_size = input_size;
 
 	protocol->_peer_addr = addr;
 	// protocol->_peer_addr.sin_family = AF_INET;
@@ -96,7 +134,7 @@ void UdpProtocol_Init(UdpProtocol* protocol,
 	// inet_pton(AF_INET, ip, &protocol->_peer_addr.sin_addr.s_addr);
 
 	do {
-		protocol->_magic_number = (uint16)rand();
+		protocol->_magic_number = (uint16)random_next(&protocol->_random);
 	} while (protocol->_magic_number == 0);
 }
 
@@ -110,76 +148,284 @@ void UdpProtocol_SendInput(UdpProtocol* protocol, GameInput* input)
 			timesync_advance_frame(&protocol->_timesync, input, protocol->_local_frame_advantage, protocol->_remote_frame_advantage);
 
 			/*
-			 * Save this input packet
-			 *
-			 * XXX: This queue may fill up for spectators who do not ack input packets in a timely
-			 * manner.  When this happens, we can either resize the queue (ug) or disconnect them
-			 * (better, but still ug).  For the meantime, make this queue really big to decrease
-			 * the odds of this happening...
+			 * Save this input packet, unless it comes from a shared input log
+			 * which already holds it.
 			 */
-			protocol->_pending_output[ring_push(&protocol->_pending_output_ring)] = *input;
+			if (!protocol->_input_log) {
+				ASSERT(input->size == protocol->_input_size);
+				if (!protocol->_pending_bits) {
+					protocol->_pending_bits = malloc(ARRAY_SIZE(protocol->_pending_frames) * protocol->_input_size);
+				}
+				int i = ring_push(&protocol->_pending_output_ring);
+				protocol->_pending_frames[i] = input->frame;
+				memcpy(protocol->_pending_bits + i * protocol->_input_size, input->bits, protocol->_input_size);
+			}
 		}
+		/*
+		 * Inputs don't wait for the next poll: they go out right away,
+		 * along with whatever else is waiting.
+		 */
 		UdpProtocol_SendPendingOutput(protocol);
+		UdpProtocol_Flush(protocol);
 	}
 }
 
-void UdpProtocol_SendPendingOutput(UdpProtocol* protocol)
+void udp_protocol_encode_cache_ctor(udp_protocol_EncodeCache *cache)
 {
-	UdpMsg* msg = calloc(1, sizeof(UdpMsg));  udp_msg_ctor(msg, UdpMsg_Input);
-	int i, j, offset = 0;
-	uint8* bits;
-	GameInput last;
-
-	if (ring_size(&protocol->_pending_output_ring)) {
-		last = protocol->_last_acked_input;
-		bits = msg->u.input.bits;
-
-		msg->u.input.start_frame = protocol->_pending_output[ring_front(&protocol->_pending_output_ring)].frame;
-		msg->u.input.input_size = (uint8)protocol->_pending_output[ring_front(&protocol->_pending_output_ring)].size;
-
-		ASSERT(last.frame == -1 || last.frame + 1 == msg->u.input.start_frame);
-		for (j = 0; j < ring_size(&protocol->_pending_output_ring); j++) {
-			GameInput current = protocol->_pending_output[ring_item(&protocol->_pending_output_ring, j)];
-			if (memcmp(current.bits, last.bits, current.size) != 0) {
-				ASSERT((GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS * 8) < (1 << BITVECTOR_NIBBLE_SIZE));
-				for (i = 0; i < current.size * 8; i++) {
-					ASSERT(i < (1 << BITVECTOR_NIBBLE_SIZE));
-					if (gameinput_value(&current, i) != gameinput_value(&last, i)) {
-						BitVector_SetBit(msg->u.input.bits, &offset);
-						(gameinput_value(&current, i) ? BitVector_SetBit : BitVector_ClearBit)(bits, &offset);
-						BitVector_WriteNibblet(bits, i, &offset);
-					}
-				}
-			}
-			BitVector_ClearBit(msg->u.input.bits, &offset);
-			last = protocol->_last_sent_input = current;
+	memset(cache, 0, sizeof(*cache));
+}
+
+/*
+ * UdpProtocol_GetPendingOutputCount --
+ *
+ * Number of inputs sent to the endpoint which have not been acked yet.  When
+ * reading from a shared input log, these are all the frames after our cursor.
+ */
+int UdpProtocol_GetPendingOutputCount(UdpProtocol* protocol)
+{
+	if (protocol->_snapshot.pending) {
+		return 0;
+	}
+	if (protocol->_input_log) {
+		if (!input_log_Has(protocol->_input_log, protocol->_last_acked_input.frame + 1)) {
+			return 0;
 		}
+		return input_log_GetLastFrame(protocol->_input_log) - protocol->_last_acked_input.frame;
 	}
-	else {
-		msg->u.input.start_frame = 0;
-		msg->u.input.input_size = 0;
+	return ring_size(&protocol->_pending_output_ring);
+}
+
+/*
+ * UdpProtocol_GetPendingOutput --
+ *
+ * Copy the i-th input which has not been acked yet into input.
+ */
+void UdpProtocol_GetPendingOutput(UdpProtocol* protocol, int i, GameInput* input)
+{
+	if (protocol->_input_log) {
+		bool found = input_log_Get(protocol->_input_log, protocol->_last_acked_input.frame + 1 + i, input);
+		ASSERT(found);
+		return;
+	}
+	int j = ring_item(&protocol->_pending_output_ring, i);
+	gameinput_init(input, protocol->_pending_frames[j], protocol->_pending_bits + j * protocol->_input_size, protocol->_input_size);
+}
+
+/*
+ * UdpProtocol_MaxPayload --
+ *
+ * The most we can send in one datagram without going over the path MTU.
+ */
+static int UdpProtocol_MaxPayload(UdpProtocol* protocol)
+{
+	return protocol->_path_mtu - UDP_HEADER_SIZE;
+}
+
+/*
+ * UdpProtocol_RestartsStream --
+ *
+ * True if a message encoded from last starts the input stream over at the
+ * frame of the state we sent.  The peer may have older frames than last,
+ * or none at all, so the first frame has to go whole.
+ */
+static bool UdpProtocol_RestartsStream(UdpProtocol* protocol, GameInput* last)
+{
+	return (protocol->_snapshot.data || protocol->_snapshot.complete) && last->frame == protocol->_snapshot.frame - 1;
+}
+
+/*
+ * UdpProtocol_EncodePendingOutput --
+ *
+ * Bit-delta encode the pending frames from the first-th one into msg, each
+ * against the one before it starting from last, stopping before a frame
+ * could take the bits past max_bits.  The first frame always goes, whole if
+ * that is smaller than its delta or the stream restarts there, so it fits
+ * in any path MTU.  Returns the number of frames encoded and leaves the last
+ * of them in last.
+ */
+int UdpProtocol_EncodePendingOutput(UdpProtocol* protocol, int first, GameInput* last, int max_bits, UdpMsg* msg)
+{
+	int j, offset = 0;
+	int count = UdpProtocol_GetPendingOutputCount(protocol);
+	bool restart = UdpProtocol_RestartsStream(protocol, last);
+	GameInput current;
+
+	ASSERT(first < count);
+	for (j = first; j < count; j++) {
+		UdpProtocol_GetPendingOutput(protocol, j, &current);
+		int size = gameinput_delta_bits(&current, last);
+		if (j == first) {
+			msg->u.input.start_frame = current.frame;
+			msg->u.input.first_frame_raw = size > current.size * 8 || restart;
+		}
+		else if (offset + size > max_bits) {
+			break;
+		}
+		if (j == first && msg->u.input.first_frame_raw) {
+			gameinput_encode_raw(&current, msg->u.input.bits, &offset);
+		}
+		else {
+			gameinput_encode_delta(&current, last, msg->u.input.bits, &offset);
+		}
+		*last = current;
 	}
-	msg->u.input.ack_frame = protocol->_last_received_input.frame;
 	msg->u.input.num_bits = (uint16)offset;
+	return j - first;
+}
+
+/*
+ * UdpProtocol_EncodeFragment --
+ *
+ * UdpProtocol_EncodePendingOutput through the encode cache, when the
+ * endpoint shares one.
+ */
+static int UdpProtocol_EncodeFragment(UdpProtocol* protocol, int first, GameInput* last, int max_bits, UdpMsg* msg)
+{
+	udp_protocol_EncodeCache* cache = protocol->_encode_cache;
+	udp_protocol_EncodedChunk* chunk;
+	GameInput front, back;
+	int base_frame = last->frame;
+	bool restart = UdpProtocol_RestartsStream(protocol, last);
+	int encoded;
+
+	if (!cache) {
+		return UdpProtocol_EncodePendingOutput(protocol, first, last, max_bits, msg);
+	}
+	UdpProtocol_GetPendingOutput(protocol, first, &front);
+	UdpProtocol_GetPendingOutput(protocol, UdpProtocol_GetPendingOutputCount(protocol) - 1, &back);
 
-	msg->u.input.disconnect_requested = protocol->_current_state == UdpProtocol_Disconnected;
-	if (protocol->_local_connect_status) {
-		memcpy(msg->u.input.peer_connect_status, protocol->_local_connect_status, sizeof(UdpMsg_connect_status) * UDP_MSG_MAX_PLAYERS);
+	/*
+	 * Every endpoint sharing the cache is fed the same input stream, so the
+	 * (start, base, end) frame range and the room left for the bits fully
+	 * identify the payload, except that a restarted stream needs its first
+	 * frame whole.
+	 */
+	for (int i = 0; i < cache->_num_chunks; i++) {
+		chunk = &cache->_chunks[i];
+		if (chunk->start_frame == front.frame && chunk->end_frame == back.frame &&
+			chunk->base_frame == base_frame && chunk->input_size == front.size && chunk->max_bits == max_bits &&
+			(!restart || chunk->first_frame_raw)) {
+			cache->_hits++;
+			msg->u.input.start_frame = chunk->start_frame;
+			msg->u.input.first_frame_raw = chunk->first_frame_raw;
+			msg->u.input.num_bits = chunk->num_bits;
+			memcpy(msg->u.input.bits, chunk->bits, (chunk->num_bits + 7) / 8);
+			encoded = chunk->last_encoded_frame - front.frame + 1;
+			UdpProtocol_GetPendingOutput(protocol, first + encoded - 1, last);
+			return encoded;
+		}
 	}
-	else {
-		memset(msg->u.input.peer_connect_status, 0, sizeof(UdpMsg_connect_status) * UDP_MSG_MAX_PLAYERS);
+
+	cache->_misses++;
+	encoded = UdpProtocol_EncodePendingOutput(protocol, first, last, max_bits, msg);
+
+	chunk = &cache->_chunks[cache->_next_chunk];
+	cache->_next_chunk = (cache->_next_chunk + 1) % UDP_PROTOCOL_ENCODE_CACHE_SIZE;
+	cache->_num_chunks = MIN(cache->_num_chunks + 1, UDP_PROTOCOL_ENCODE_CACHE_SIZE);
+
+	chunk->start_frame = front.frame;
+	chunk->base_frame = base_frame;
+	chunk->end_frame = back.frame;
+	chunk->last_encoded_frame = last->frame;
+	chunk->max_bits = max_bits;
+	chunk->input_size = (uint8)front.size;
+	chunk->first_frame_raw = msg->u.input.first_frame_raw;
+	chunk->num_bits = msg->u.input.num_bits;
+	memcpy(chunk->bits, msg->u.input.bits, (chunk->num_bits + 7) / 8);
+	return encoded;
+}
+
+void UdpProtocol_SendPendingOutput(UdpProtocol* protocol)
+{
+	/*
+	 * The peer can't decode anything until it knows the frame its input
+	 * stream starts from, which is picked along with the state.
+	 */
+	if (protocol->_snapshot.pending) {
+		return;
 	}
 
-	ASSERT(offset < MAX_COMPRESSED_BITS);
+	int count = UdpProtocol_GetPendingOutputCount(protocol);
+	int max_bits = MIN(UDP_MSG_MAX_INPUT_BITS, (UdpProtocol_MaxPayload(protocol) - UDP_MSG_MAX_INPUT_OVERHEAD) * 8);
+	GameInput last = protocol->_last_acked_input;
+	int sent = 0;
+
+	/*
+	 * The pending frames go in as many messages as it takes to keep each
+	 * one within the path MTU, every message starting where the last one
+	 * stopped.  Past UDP_PROTOCOL_MAX_INPUT_FRAGMENTS, the rest wait for
+	 * the peer to ack these.  Only the first message carries the timestamps
+	 * and connect statuses.
+	 */
+	for (int i = 0; i == 0 || (sent < count && i < UDP_PROTOCOL_MAX_INPUT_FRAGMENTS); i++) {
+		UdpMsg msg;  udp_msg_ctor(&msg, UdpMsg_Input);
+
+		if (sent < count) {
+			sent += UdpProtocol_EncodeFragment(protocol, sent, &last, max_bits, &msg);
+			msg.u.input.continuation = i > 0;
+			ASSERT(i > 0 || protocol->_last_acked_input.frame == -1 || protocol->_last_acked_input.frame + 1 == msg.u.input.start_frame);
+		}
+		msg.u.input.ack_frame = protocol->_last_received_input.frame;
+		msg.u.input.current_frame = -1;
+		msg.u.input.disconnect_requested = protocol->_current_state == UdpProtocol_Disconnected;
+		if (i == 0) {
+			msg.u.input.timestamp = UdpProtocol_GetTimestamp();
+			msg.u.input.echo_timestamp = UdpProtocol_GetEchoTimestamp(protocol);
+			msg.u.input.current_frame = protocol->_local_frame;
+			if (protocol->_local_connect_status) {
+				UdpProtocol_EncodeConnectStatus(protocol, &msg);
+			}
+		}
+		UdpProtocol_SendMsg(protocol, &msg);
+	}
+	if (sent) {
+		protocol->_last_sent_input = last;
+	}
+}
 
-	UdpProtocol_SendMsg(protocol, msg);
+/*
+ * UdpProtocol_EncodeConnectStatus --
+ *
+ * Append to msg the connect statuses which changed since we last sent them,
+ * and one of the others in turn.  Statuses still at their initial value are
+ * left out of the turns: the peer starts from the same one.
+ */
+void UdpProtocol_EncodeConnectStatus(UdpProtocol* protocol, UdpMsg* msg)
+{
+	UdpMsg_connect_status* local = protocol->_local_connect_status;
+	UdpMsg_connect_status* sent = protocol->_sent_connect_status;
+	UdpMsg_connect_status* out = udp_msg_ConnectStatus(msg);
+	uint16 mask = 0;
+
+	for (int i = 0; i < UDP_MSG_MAX_PLAYERS; i++) {
+		if (local[i].disconnected != sent[i].disconnected || local[i].last_frame != sent[i].last_frame) {
+			mask |= 1 << i;
+		}
+	}
+	for (int i = 0; i < UDP_MSG_MAX_PLAYERS; i++) {
+		int j = (protocol->_next_connect_status_refresh + i) % UDP_MSG_MAX_PLAYERS;
+		if (!(mask & (1 << j)) && (local[j].disconnected || local[j].last_frame != -1)) {
+			mask |= 1 << j;
+			protocol->_next_connect_status_refresh = j + 1;
+			break;
+		}
+	}
+	for (int i = 0; i < UDP_MSG_MAX_PLAYERS; i++) {
+		if (mask & (1 << i)) {
+			*out++ = local[i];
+			sent[i] = local[i];
+		}
+	}
+	msg->u.input.connect_status_mask = mask;
 }
 
 void UdpProtocol_SendInputAck(UdpProtocol* protocol)
 {
-	UdpMsg* msg = calloc(1, sizeof(UdpMsg));  udp_msg_ctor(msg, UdpMsg_InputAck);
-	msg->u.input_ack.ack_frame = protocol->_last_received_input.frame;
-	UdpProtocol_SendMsg(protocol, msg);
+	UdpMsg msg;  udp_msg_ctor(&msg, UdpMsg_InputAck);
+	msg.u.input_ack.ack_frame = protocol->_last_received_input.frame;
+	msg.u.input_ack.timestamp = UdpProtocol_GetTimestamp();
+	msg.u.input_ack.echo_timestamp = UdpProtocol_GetEchoTimestamp(protocol);
+	UdpProtocol_SendMsg(protocol, &msg);
 }
 
 bool UdpProtocol_GetEvent(UdpProtocol* protocol, udp_protocol_Event* e)
@@ -187,7 +433,30 @@ bool UdpProtocol_GetEvent(UdpProtocol* protocol, udp_protocol_Event* e)
 	if (ring_size(&protocol->_event_queue_ring) == 0) {
 		return false;
 	}
-	*e = protocol->_event_queue[ring_front(&protocol->_event_queue_ring)];
+	int i = ring_front(&protocol->_event_queue_ring);
+	udp_protocol_QueuedEvent* q = &protocol->_event_queue[i];
+
+	e->type = q->type;
+	switch (q->type) {
+	case UdpProtocol_Event_Input:
+		gameinput_init(&e->u.input.input, q->u.input.frame, protocol->_event_bits + i * protocol->_remote_input_size, protocol->_remote_input_size);
+		e->u.input.recv_time = q->u.input.recv_time;
+		break;
+	case UdpProtocol_Event_Synchronizing:
+		e->u.synchronizing.total = q->u.synchronizing.total;
+		e->u.synchronizing.count = q->u.synchronizing.count;
+		break;
+	case UdpProtocol_Event_NetworkInterrupted:
+		e->u.network_interrupted.disconnect_timeout = q->u.network_interrupted.disconnect_timeout;
+		break;
+	case UdpProtocol_Event_State:
+		e->u.state.frame = q->u.state.frame;
+		e->u.state.buf = q->u.state.buf;
+		e->u.state.len = q->u.state.len;
+		break;
+	default:
+		break;
+	}
 	ring_pop(&protocol->_event_queue_ring);
 	return true;
 }
@@ -214,17 +483,28 @@ bool UdpProtocol_OnLoopPoll(UdpProtocol* protocol)
 
 	case UdpProtocol_Running:
 		// xxx: rig all this up with a timer wrapper
-		if (!protocol->_state.running.last_input_packet_recv_time || protocol->_state.running.last_input_packet_recv_time + RUNNING_RETRY_INTERVAL < now) {
+		/*
+		 * The retry timer runs from the last time the peer acked some of our
+		 * output, or from when the oldest unacked input was sent, so only
+		 * output which is really overdue gets resent.
+		 */
+		if (!UdpProtocol_GetPendingOutputCount(protocol)) {
+			protocol->_state.running.last_ack_progress_time = now;
+		}
+		else if (protocol->_state.running.last_ack_progress_time + UdpProtocol_GetRetryInterval(protocol) < now) {
 			Log("Haven't exchanged packets in a while (last received:%d  last sent:%d).  Resending.\n", protocol->_last_received_input.frame, protocol->_last_sent_input.frame);
 			UdpProtocol_SendPendingOutput(protocol);
-			protocol->_state.running.last_input_packet_recv_time = now;
+			protocol->_state.running.last_ack_progress_time = now;
+			rtt_on_timeout(&protocol->_rtt);
 		}
 
+		UdpProtocol_SendStateChunks(protocol);
+
 		if (!protocol->_state.running.last_quality_report_time || protocol->_state.running.last_quality_report_time + QUALITY_REPORT_INTERVAL < now) {
-			UdpMsg* msg = calloc(1, sizeof(UdpMsg));   udp_msg_ctor(msg, UdpMsg_QualityReport);
-			msg->u.quality_report.ping = Platform_GetCurrentTimeMS();
-			msg->u.quality_report.frame_advantage = (uint8)protocol->_local_frame_advantage;
-			UdpProtocol_SendMsg(protocol, msg);
+			UdpMsg msg;  udp_msg_ctor(&msg, UdpMsg_QualityReport);
+			msg.u.quality_report.ping = UdpProtocol_GetTimestamp();
+			msg.u.quality_report.frame_advantage = (uint8)protocol->_local_frame_advantage;
+			UdpProtocol_SendMsg(protocol, &msg);
 			protocol->_state.running.last_quality_report_time = now;
 		}
 
@@ -235,8 +515,8 @@ bool UdpProtocol_OnLoopPoll(UdpProtocol* protocol)
 
 		if (protocol->_last_send_time && protocol->_last_send_time + KEEP_ALIVE_INTERVAL < now) {
 			Log("Sending keep alive packet\n");
-			UdpMsg* msg = calloc(1, sizeof(UdpMsg));   udp_msg_ctor(msg, UdpMsg_KeepAlive);
-			UdpProtocol_SendMsg(protocol, msg);
+			UdpMsg msg;  udp_msg_ctor(&msg, UdpMsg_KeepAlive);
+			UdpProtocol_SendMsg(protocol, &msg);
 		}
 
 		if (protocol->_disconnect_timeout && protocol->_disconnect_notify_start &&
@@ -260,6 +540,7 @@ bool UdpProtocol_OnLoopPoll(UdpProtocol* protocol)
 	case UdpProtocol_Disconnected:
 		if (protocol->_shutdown_timeout < now) {
 			Log("Shutting down udp connection.\n");
+			UdpProtocol_Flush(protocol);
 			protocol->_udp = NULL;
 			protocol->_shutdown_timeout = 0;
 		}
@@ -281,24 +562,81 @@ void UdpProtocol_Disconnect(UdpProtocol* protocol)
 
 void UdpProtocol_SendSyncRequest(UdpProtocol* protocol)
 {
-	protocol->_state.sync.random = rand() & 0xFFFF;
-	UdpMsg* msg = calloc(1, sizeof(UdpMsg));   udp_msg_ctor(msg, UdpMsg_SyncRequest);
-	msg->u.sync_request.random_request = protocol->_state.sync.random;
-	UdpProtocol_SendMsg(protocol, msg);
+	protocol->_state.sync.random = random_next(&protocol->_random) & 0xFFFF;
+	UdpMsg msg;  udp_msg_ctor(&msg, UdpMsg_SyncRequest);
+	msg.u.sync_request.random_request = protocol->_state.sync.random;
+	msg.u.sync_request.input_size = (uint8)protocol->_input_size;
+	UdpProtocol_SendMsg(protocol, &msg);
 }
 
+/*
+ * UdpProtocol_SendMsg --
+ *
+ * Hold msg until the next UdpProtocol_Flush.  It is packed in place and
+ * copied into a block of just the bytes that go out, so the caller keeps
+ * it and can build it on the stack.
+ */
 void UdpProtocol_SendMsg(UdpProtocol* protocol, UdpMsg* msg)
 {
 	UdpProtocol_LogMsg(protocol, "send", msg);
 
+	msg->hdr.magic = protocol->_magic_number;
+	msg->hdr.dst_session = protocol->_remote_session;
+	msg->hdr.src_session = protocol->_udp->_session_id;
+	int len = msg->hdr.type == UdpMsg_Input ? udp_msg_PackInput(msg) : udp_msg_PacketSize(msg);
+	int size = udp_msg_BundleEntrySize(len);
+
+	if (protocol->_bundle.count == UDP_PROTOCOL_MAX_BUNDLE ||
+		(protocol->_bundle.count && protocol->_bundle.size + size > UdpProtocol_MaxPayload(protocol))) {
+		UdpProtocol_Flush(protocol);
+	}
+	if (!protocol->_bundle.count) {
+		protocol->_bundle.size = sizeof(msg->hdr);
+	}
+	protocol->_bundle.msgs[protocol->_bundle.count] = malloc(len);
+	memcpy(protocol->_bundle.msgs[protocol->_bundle.count], msg, len);
+	protocol->_bundle.lens[protocol->_bundle.count] = len;
+	protocol->_bundle.count++;
+	protocol->_bundle.size += size;
+}
+
+/*
+ * UdpProtocol_Flush --
+ *
+ * Send the messages held by UdpProtocol_SendMsg, bundled in one datagram
+ * if there is more than one.
+ */
+void UdpProtocol_Flush(UdpProtocol* protocol)
+{
+	UdpMsg* datagram;
+	int len;
+
+	if (!protocol->_bundle.count || !protocol->_udp) {
+		return;
+	}
+	if (protocol->_bundle.count == 1) {
+		datagram = protocol->_bundle.msgs[0];
+		len = protocol->_bundle.lens[0];
+	}
+	else {
+		datagram = malloc(protocol->_bundle.size);
+		memcpy(&datagram->hdr, &protocol->_bundle.msgs[0]->hdr, sizeof(datagram->hdr));
+		datagram->hdr.type = UdpMsg_Bundle;
+		len = sizeof(datagram->hdr);
+		for (int i = 0; i < protocol->_bundle.count; i++) {
+			len = udp_msg_AddToBundle(datagram, len, protocol->_bundle.msgs[i], protocol->_bundle.lens[i]);
+			free(protocol->_bundle.msgs[i]);
+		}
+		ASSERT(len == protocol->_bundle.size);
+	}
+	protocol->_bundle.count = 0;
+	datagram->hdr.sequence_number = protocol->_next_send_seq++;
+
 	protocol->_packets_sent++;
 	protocol->_last_send_time = Platform_GetCurrentTimeMS();
-	protocol->_bytes_sent += udp_msg_PacketSize(msg);
-
-	msg->hdr.magic = protocol->_magic_number;
-	msg->hdr.sequence_number = protocol->_next_send_seq++;
+	protocol->_bytes_sent += len;
 
-	protocol->_send_queue[ring_push(&protocol->_send_queue_ring)] = (udp_protocol_QueueEntry){(int)Platform_GetCurrentTimeMS(), protocol->_peer_addr, msg};
+	protocol->_send_queue[ring_push(&protocol->_send_queue_ring)] = (udp_protocol_QueueEntry){(int)Platform_GetCurrentTimeMS(), protocol->_peer_addr, datagram, len};
 	UdpProtocol_PumpSendQueue(protocol);
 }
 
@@ -307,7 +645,11 @@ bool UdpProtocol_HandlesMsg(UdpProtocol* protocol, conn_Address from, UdpMsg* ms
 	if (!protocol->_udp) {
 		return false;
 	}
-	return conn_addr_is_equal(protocol->_peer_addr, from);
+	/*
+	 * Several sessions of a shared socket have the same address, so the
+	 * session id tells them apart.
+	 */
+	return conn_addr_is_equal(protocol->_peer_addr, from) && msg->hdr.src_session == protocol->_remote_session;
 	//	return protocol->_peer_addr.sin_addr.S_un.S_addr == from->sin_addr.S_un.S_addr &&
 	//		protocol->_peer_addr.sin_port == from->sin_port;
 }
@@ -323,11 +665,25 @@ static const DispatchFn table[] = {
 	   UdpProtocol_OnQualityReply,        /* QualityReply */
 	   UdpProtocol_OnKeepAlive,           /* KeepAlive */
 	   UdpProtocol_OnInputAck,            /* InputAck */
+	   UdpProtocol_OnStateChunk,          /* StateChunk */
+	   UdpProtocol_OnStateAck,            /* StateAck */
 };
 
 void UdpProtocol_OnMsg(UdpProtocol* protocol, UdpMsg* msg, int len)
 {
 	bool handled = false;
+	UdpMsg unpacked;
+
+	if (msg->hdr.type == UdpMsg_Bundle) {
+		int offset = 0, entry_len;
+		while ((entry_len = udp_msg_NextInBundle(msg, len, &offset, &unpacked)) > 0) {
+			UdpProtocol_OnMsg(protocol, &unpacked, entry_len);
+		}
+		if (entry_len < 0) {
+			Log("dropping the rest of a malformed bundle.\n");
+		}
+		return;
+	}
 
 	// filter out messages that don't match what we expect
 	uint16 seq = msg->hdr.sequence_number;
@@ -346,6 +702,14 @@ void UdpProtocol_OnMsg(UdpProtocol* protocol, UdpMsg* msg, int len)
 			return;
 		}
 	}
+	if (msg->hdr.type == UdpMsg_Input) {
+		if (!udp_msg_UnpackInput(msg, len, &unpacked)) {
+			Log("dropping malformed input packet (%d bytes).\n", len);
+			return;
+		}
+		msg = &unpacked;
+		len = udp_msg_PacketSize(msg);
+	}
 
 	protocol->_next_recv_seq = seq;
 	UdpProtocol_LogMsg(protocol, "recv", msg);
@@ -392,7 +756,35 @@ void UdpProtocol_UpdateNetworkStats(UdpProtocol *protocol)
 void UdpProtocol_QueueEvent(UdpProtocol *protocol, const udp_protocol_Event* evt)
 {
 	UdpProtocol_LogEvent(protocol, "Queuing event", evt);
-	protocol->_event_queue[ring_push(&protocol->_event_queue_ring)] = *evt;
+	int i = ring_push(&protocol->_event_queue_ring);
+	udp_protocol_QueuedEvent* q = &protocol->_event_queue[i];
+
+	q->type = evt->type;
+	switch (evt->type) {
+	case UdpProtocol_Event_Input:
+		ASSERT(evt->u.input.input.size == protocol->_remote_input_size);
+		if (!protocol->_event_bits) {
+			protocol->_event_bits = malloc(ARRAY_SIZE(protocol->_event_queue) * protocol->_remote_input_size);
+		}
+		memcpy(protocol->_event_bits + i * protocol->_remote_input_size, evt->u.input.input.bits, protocol->_remote_input_size);
+		q->u.input.frame = evt->u.input.input.frame;
+		q->u.input.recv_time = evt->u.input.recv_time;
+		break;
+	case UdpProtocol_Event_Synchronizing:
+		q->u.synchronizing.total = evt->u.synchronizing.total;
+		q->u.synchronizing.count = evt->u.synchronizing.count;
+		break;
+	case UdpProtocol_Event_NetworkInterrupted:
+		q->u.network_interrupted.disconnect_timeout = evt->u.network_interrupted.disconnect_timeout;
+		break;
+	case UdpProtocol_Event_State:
+		q->u.state.frame = evt->u.state.frame;
+		q->u.state.buf = evt->u.state.buf;
+		q->u.state.len = evt->u.state.len;
+		break;
+	default:
+		break;
+	}
 }
 
 void UdpProtocol_Synchronize(UdpProtocol *protocol)
@@ -451,6 +843,13 @@ void UdpProtocol_LogMsg(UdpProtocol *protocol, const char* prefix, UdpMsg* msg)
 	case UdpMsg_InputAck:
 		UdpProtocol_Log(protocol, "%s input ack.\n", prefix);
 		break;
+	case UdpMsg_StateChunk:
+		UdpProtocol_Log(protocol, "%s state chunk %d (%d/%d bytes).\n", prefix, msg->u.state_chunk.frame,
+			msg->u.state_chunk.offset + msg->u.state_chunk.size, msg->u.state_chunk.total_size);
+		break;
+	case UdpMsg_StateAck:
+		UdpProtocol_Log(protocol, "%s state ack (%d bytes).\n", prefix, msg->u.state_ack.received);
+		break;
 	default:
 		ASSERT(false && "Unknown UdpMsg type.");
 	}
@@ -476,9 +875,21 @@ bool UdpProtocol_OnSyncRequest(UdpProtocol *protocol, UdpMsg* msg, int len)
 			msg->hdr.magic, protocol->_remote_magic_number);
 		return false;
 	}
-	UdpMsg* reply = calloc(1, sizeof(UdpMsg));   udp_msg_ctor(reply, UdpMsg_SyncReply);
-	reply->u.sync_reply.random_reply = msg->u.sync_request.random_request;
-	UdpProtocol_SendMsg(protocol, reply);
+	/*
+	 * The size of the peer's inputs is only sent here, so it can't change
+	 * once we have queued some.
+	 */
+	int input_size = msg->u.sync_request.input_size;
+	if (input_size > GAMEINPUT_MAX_BYTES * GAMEINPUT_MAX_PLAYERS ||
+		(protocol->_event_bits && input_size != protocol->_remote_input_size)) {
+		Log("Ignoring sync request with input size %d.\n", input_size);
+		return false;
+	}
+	protocol->_remote_input_size = input_size;
+
+	UdpMsg reply;  udp_msg_ctor(&reply, UdpMsg_SyncReply);
+	reply.u.sync_reply.random_reply = msg->u.sync_request.random_request;
+	UdpProtocol_SendMsg(protocol, &reply);
 	return true;
 }
 
@@ -518,57 +929,59 @@ bool UdpProtocol_OnSyncReply(UdpProtocol *protocol, UdpMsg* msg, int len)
 	return true;
 }
 
-bool UdpProtocol_OnInput(UdpProtocol *protocol, UdpMsg* msg, int len)
+/*
+ * UdpProtocol_DecodeInput --
+ *
+ * Queue an input event for each frame of msg we haven't received yet.  msg
+ * must not start past the frame after the last one we have.
+ */
+static void UdpProtocol_DecodeInput(UdpProtocol *protocol, UdpMsg* msg)
 {
-	/*
-	 * If a disconnect is requested, go ahead and disconnect now.
-	 */
-	bool disconnect_requested = msg->u.input.disconnect_requested;
-	if (disconnect_requested) {
-		if (protocol->_current_state != UdpProtocol_Disconnected && !protocol->_disconnect_event_sent) {
-			Log("Disconnecting endpoint on remote request.\n");
-			UdpProtocol_QueueEvent(protocol, &(udp_protocol_Event) { UdpProtocol_Event_Disconnected });
-			protocol->_disconnect_event_sent = true;
-		}
+	int offset = 0;
+	uint8* bits = (uint8*)msg->u.input.bits;
+	int numBits = msg->u.input.num_bits;
+	int currentFrame = msg->u.input.start_frame;
+	int indexBits = gameinput_index_bits(protocol->_remote_input_size);
+	bool malformed = false;
+
+	protocol->_last_received_input.size = protocol->_remote_input_size;
+	if (protocol->_last_received_input.frame < 0) {
+		protocol->_last_received_input.frame = msg->u.input.start_frame - 1;
 	}
-	else {
+	while (offset < numBits) {
 		/*
-		 * Update the peer connection status if this peer is still considered to be part
-		 * of the network.
+		 * Keep walking through the frames (parsing bits) until we reach
+		 * the inputs for the frame right after the one we're on.
 		 */
-		UdpMsg_connect_status* remote_status = msg->u.input.peer_connect_status;
-		for (int i = 0; i < ARRAY_SIZE(protocol->_peer_connect_status); i++) {
-			ASSERT(remote_status[i].last_frame >= protocol->_peer_connect_status[i].last_frame);
-			protocol->_peer_connect_status[i].disconnected = protocol->_peer_connect_status[i].disconnected || remote_status[i].disconnected;
-			protocol->_peer_connect_status[i].last_frame = MAX(protocol->_peer_connect_status[i].last_frame, remote_status[i].last_frame);
-		}
-	}
-
-	/*
-	 * Decompress the input.
-	 */
-	int last_received_frame_number = protocol->_last_received_input.frame;
-	if (msg->u.input.num_bits) {
-		int offset = 0;
-		uint8* bits = (uint8*)msg->u.input.bits;
-		int numBits = msg->u.input.num_bits;
-		int currentFrame = msg->u.input.start_frame;
+		ASSERT(currentFrame <= (protocol->_last_received_input.frame + 1));
+		bool useInputs = currentFrame == protocol->_last_received_input.frame + 1;
 
-		protocol->_last_received_input.size = msg->u.input.input_size;
-		if (protocol->_last_received_input.frame < 0) {
-			protocol->_last_received_input.frame = msg->u.input.start_frame - 1;
+		/*
+		 * A peer catching up after a stall can send more frames than our
+		 * event queue holds.  Stop here; since we only ack what we have
+		 * decoded, the rest will be sent again.
+		 */
+		if (useInputs && ring_size(&protocol->_event_queue_ring) >= ARRAY_SIZE(protocol->_event_queue) - UDP_PROTOCOL_EVENT_QUEUE_RESERVE) {
+			Log("Event queue full.  Deferring frames from %d.\n", currentFrame);
+			break;
 		}
-		while (offset < numBits) {
-			/*
-			 * Keep walking through the frames (parsing bits) until we reach
-			 * the inputs for the frame right after the one we're on.
-			 */
-			ASSERT(currentFrame <= (protocol->_last_received_input.frame + 1));
-			bool useInputs = currentFrame == protocol->_last_received_input.frame + 1;
 
+		if (currentFrame == msg->u.input.start_frame && msg->u.input.first_frame_raw) {
+			GameInput skipped = protocol->_last_received_input;
+			if (!gameinput_decode_raw(useInputs ? &protocol->_last_received_input : &skipped, bits, numBits, &offset)) {
+				Log("input for frame %d cut short.  Dropping the packet.\n", currentFrame);
+				malformed = true;
+			}
+		}
+		else {
 			while (BitVector_ReadBit(bits, &offset)) {
 				int on = BitVector_ReadBit(bits, &offset);
-				int button = BitVector_ReadNibblet(bits, &offset);
+				int button = BitVector_ReadBits(bits, indexBits, &offset);
+				if (button >= protocol->_remote_input_size * 8) {
+					Log("input bit %d out of range.  Dropping the rest of the packet.\n", button);
+					malformed = true;
+					break;
+				}
 				if (useInputs) {
 					if (on) {
 						gameinput_set(&protocol->_last_received_input, button);
@@ -578,42 +991,187 @@ bool UdpProtocol_OnInput(UdpProtocol *protocol, UdpMsg* msg, int len)
 					}
 				}
 			}
-			ASSERT(offset <= numBits);
+		}
+		if (malformed) {
+			break;
+		}
+		ASSERT(offset <= numBits);
 
+		/*
+		 * Now if we want to use these inputs, go ahead and send them to
+		 * the emulator.
+		 */
+		if (useInputs) {
 			/*
-			 * Now if we want to use these inputs, go ahead and send them to
-			 * the emulator.
+			 * Move forward 1 frame in the stream.
 			 */
-			if (useInputs) {
-				/*
-				 * Move forward 1 frame in the stream.
-				 */
-				char desc[1024];
-				ASSERT(currentFrame == protocol->_last_received_input.frame + 1);
-				protocol->_last_received_input.frame = currentFrame;
+			char desc[1024];
+			ASSERT(currentFrame == protocol->_last_received_input.frame + 1);
+			protocol->_last_received_input.frame = currentFrame;
+
+			/*
+			 * Send the event to the emualtor
+			 */
+			udp_protocol_Event evt = { UdpProtocol_Event_Input };
+			evt.u.input.input = protocol->_last_received_input;
+			evt.u.input.recv_time = Platform_GetCurrentTimeMS();
+
+			gameinput_desc(&protocol->_last_received_input, desc, ARRAY_SIZE(desc), true);
 
-				/*
-				 * Send the event to the emualtor
-				 */
-				udp_protocol_Event evt = { UdpProtocol_Event_Input };
-				evt.u.input.input = protocol->_last_received_input;
+			Log("Sending frame %d to emu queue %d (%s).\n", protocol->_last_received_input.frame, protocol->_queue, desc);
+			UdpProtocol_QueueEvent(protocol, &evt);
 
-				gameinput_desc(&protocol->_last_received_input, desc, ARRAY_SIZE(desc), true);
+		}
+		else {
+			Log("Skipping past frame:(%d) current is %d.\n", currentFrame, protocol->_last_received_input.frame);
+		}
 
-				protocol->_state.running.last_input_packet_recv_time = Platform_GetCurrentTimeMS();
+		/*
+		 * Move forward 1 frame in the input stream.
+		 */
+		currentFrame++;
+	}
+}
 
-				Log("Sending frame %d to emu queue %d (%s).\n", protocol->_last_received_input.frame, protocol->_queue, desc);
-				UdpProtocol_QueueEvent(protocol, &evt);
+/*
+ * UdpProtocol_HoldFragment --
+ *
+ * Keep a copy of the input message msg, which starts past the frames we
+ * have, for UdpProtocol_DecodeHeldFragments.  The oldest goes when there
+ * are too many.
+ */
+static void UdpProtocol_HoldFragment(UdpProtocol *protocol, UdpMsg* msg)
+{
+	UdpMsg* held = malloc(sizeof(UdpMsg));
 
+	Log("Holding input from frame %d until frame %d arrives.\n", msg->u.input.start_frame, protocol->_last_received_input.frame + 1);
+	if (protocol->_fragments.count == UDP_PROTOCOL_MAX_INPUT_FRAGMENTS) {
+		free(protocol->_fragments.msgs[0]);
+		memmove(protocol->_fragments.msgs, protocol->_fragments.msgs + 1, (UDP_PROTOCOL_MAX_INPUT_FRAGMENTS - 1) * sizeof(UdpMsg*));
+		protocol->_fragments.count--;
+	}
+	memcpy(held, msg, udp_msg_PacketSize(msg));
+	protocol->_fragments.msgs[protocol->_fragments.count++] = held;
+}
+
+/*
+ * UdpProtocol_RestartInputStream --
+ *
+ * The state for frame arrived, and the peer's input stream starts over
+ * there.  Skip ahead to it if we are behind, dropping the held messages
+ * from before it.
+ */
+static void UdpProtocol_RestartInputStream(UdpProtocol *protocol, int frame)
+{
+	int i = 0;
+
+	if (protocol->_last_received_input.frame < frame - 1) {
+		protocol->_last_received_input.frame = frame - 1;
+	}
+	while (i < protocol->_fragments.count) {
+		if (protocol->_fragments.msgs[i]->u.input.start_frame >= frame) {
+			i++;
+			continue;
+		}
+		free(protocol->_fragments.msgs[i]);
+		protocol->_fragments.count--;
+		memmove(protocol->_fragments.msgs + i, protocol->_fragments.msgs + i + 1, (protocol->_fragments.count - i) * sizeof(UdpMsg*));
+	}
+}
+
+/*
+ * UdpProtocol_DecodeHeldFragments --
+ *
+ * Decode the held input messages which no longer start past the frames we
+ * have, until none are left that do.
+ */
+static void UdpProtocol_DecodeHeldFragments(UdpProtocol *protocol)
+{
+	int i = 0;
+
+	while (i < protocol->_fragments.count) {
+		UdpMsg* held = protocol->_fragments.msgs[i];
+
+		if (protocol->_last_received_input.frame < 0 || held->u.input.start_frame > protocol->_last_received_input.frame + 1) {
+			i++;
+			continue;
+		}
+		protocol->_fragments.count--;
+		memmove(protocol->_fragments.msgs + i, protocol->_fragments.msgs + i + 1, (protocol->_fragments.count - i) * sizeof(UdpMsg*));
+		UdpProtocol_DecodeInput(protocol, held);
+		free(held);
+		i = 0;
+	}
+}
+
+bool UdpProtocol_OnInput(UdpProtocol *protocol, UdpMsg* msg, int len)
+{
+	if (msg->u.input.num_bits && protocol->_remote_input_size == 0) {
+		Log("dropping input packet from a peer which sends no inputs.\n");
+		return false;
+	}
+	UdpProtocol_OnTimestamps(protocol, msg->u.input.timestamp, msg->u.input.echo_timestamp);
+
+	/*
+	 * Remember the latest frame the peer told us it was on.  Retries of
+	 * old inputs still carry the peer's current frame, so going by the
+	 * timestamp also notices when the peer stops advancing.
+	 */
+	if (msg->u.input.current_frame >= 0 && msg->u.input.timestamp &&
+		(protocol->_remote_frame < 0 || (int)(msg->u.input.timestamp - protocol->_remote_frame_timestamp) > 0)) {
+		protocol->_remote_frame = msg->u.input.current_frame;
+		protocol->_remote_frame_timestamp = msg->u.input.timestamp;
+		protocol->_remote_frame_recv_time = Platform_GetCurrentTimeUS();
+	}
+
+	/*
+	 * If a disconnect is requested, go ahead and disconnect now.
+	 */
+	bool disconnect_requested = msg->u.input.disconnect_requested;
+	if (disconnect_requested) {
+		if (protocol->_current_state != UdpProtocol_Disconnected && !protocol->_disconnect_event_sent) {
+			Log("Disconnecting endpoint on remote request.\n");
+			UdpProtocol_QueueEvent(protocol, &(udp_protocol_Event) { UdpProtocol_Event_Disconnected });
+			protocol->_disconnect_event_sent = true;
+		}
+	}
+	else {
+		/*
+		 * Update the peer connection status if this peer is still considered to be part
+		 * of the network.  Only the statuses which changed are sent.
+		 */
+		UdpMsg_connect_status* remote_status = udp_msg_ConnectStatus(msg);
+		for (int i = 0; i < ARRAY_SIZE(protocol->_peer_connect_status); i++) {
+			if (!(msg->u.input.connect_status_mask & (1 << i))) {
+				continue;
 			}
-			else {
-				Log("Skipping past frame:(%d) current is %d.\n", currentFrame, protocol->_last_received_input.frame);
-			}
+			ASSERT(remote_status->last_frame >= protocol->_peer_connect_status[i].last_frame);
+			protocol->_peer_connect_status[i].disconnected = protocol->_peer_connect_status[i].disconnected || remote_status->disconnected;
+			protocol->_peer_connect_status[i].last_frame = MAX(protocol->_peer_connect_status[i].last_frame, remote_status->last_frame);
+			remote_status++;
+		}
+	}
 
-			/*
-			 * Move forward 1 frame in the input stream.
-			 */
-			currentFrame++;
+	/*
+	 * Decompress the input, unless it starts past the frames we have: the
+	 * message before it was lost or is late, so keep it until that one
+	 * fills the gap.  Until we reach the frame of a state we skipped ahead
+	 * to, we don't know the inputs before it, so only the restarted stream
+	 * can be decoded.
+	 */
+	int last_received_frame_number = protocol->_last_received_input.frame;
+	if (msg->u.input.num_bits && protocol->_snapshot.complete && msg->u.input.start_frame < protocol->_snapshot.frame &&
+		protocol->_last_received_input.frame < protocol->_snapshot.frame) {
+		Log("dropping input from frame %d, before the state for frame %d.\n", msg->u.input.start_frame, protocol->_snapshot.frame);
+	}
+	else if (msg->u.input.num_bits) {
+		if ((protocol->_last_received_input.frame >= 0 || msg->u.input.continuation) &&
+			msg->u.input.start_frame > protocol->_last_received_input.frame + 1) {
+			UdpProtocol_HoldFragment(protocol, msg);
+		}
+		else {
+			UdpProtocol_DecodeInput(protocol, msg);
+			UdpProtocol_DecodeHeldFragments(protocol);
 		}
 	}
 	ASSERT(protocol->_last_received_input.frame >= last_received_frame_number);
@@ -621,11 +1179,7 @@ bool UdpProtocol_OnInput(UdpProtocol *protocol, UdpMsg* msg, int len)
 	/*
 	 * Get rid of our buffered input
 	 */
-	while (ring_size(&protocol->_pending_output_ring) && protocol->_pending_output[ring_front(&protocol->_pending_output_ring)].frame < msg->u.input.ack_frame) {
-		Log("Throwing away pending output frame %d\n", protocol->_pending_output[ring_front(&protocol->_pending_output_ring)].frame);
-		protocol->_last_acked_input = protocol->_pending_output[ring_front(&protocol->_pending_output_ring)];
-		ring_pop(&protocol->_pending_output_ring);
-	}
+	UdpProtocol_DiscardAckedOutput(protocol, msg->u.input.ack_frame);
 	return true;
 }
 
@@ -635,20 +1189,68 @@ bool UdpProtocol_OnInputAck(UdpProtocol *protocol, UdpMsg* msg, int len)
 	/*
 	 * Get rid of our buffered input
 	 */
-	while (ring_size(&protocol->_pending_output_ring) && protocol->_pending_output[ring_front(&protocol->_pending_output_ring)].frame < msg->u.input_ack.ack_frame) {
-		Log("Throwing away pending output frame %d\n", protocol->_pending_output[ring_front(&protocol->_pending_output_ring)].frame);
-		protocol->_last_acked_input = protocol->_pending_output[ring_front(&protocol->_pending_output_ring)];
-		ring_pop(&protocol->_pending_output_ring);
-	}
+	UdpProtocol_OnTimestamps(protocol, msg->u.input_ack.timestamp, msg->u.input_ack.echo_timestamp);
+	UdpProtocol_DiscardAckedOutput(protocol, msg->u.input_ack.ack_frame);
 	return true;
 }
 
+/*
+ * UdpProtocol_DiscardAckedOutput --
+ *
+ * Drop every pending frame before ack_frame, remembering the last one as
+ * the base of the next delta.  With a shared input log this only moves our
+ * cursor; the log owner discards frames once every reader has moved past.
+ * Any progress restarts the retry timer.
+ */
+void UdpProtocol_DiscardAckedOutput(UdpProtocol *protocol, int ack_frame)
+{
+	int last_acked_frame = protocol->_last_acked_input.frame;
+
+	if (protocol->_input_log) {
+		int frame = protocol->_last_acked_input.frame + 1;
+		while (frame < ack_frame && input_log_Get(protocol->_input_log, frame, &protocol->_last_acked_input)) {
+			frame++;
+		}
+	}
+	else {
+		while (ring_size(&protocol->_pending_output_ring) && protocol->_pending_frames[ring_front(&protocol->_pending_output_ring)] < ack_frame) {
+			Log("Throwing away pending output frame %d\n", protocol->_pending_frames[ring_front(&protocol->_pending_output_ring)]);
+			UdpProtocol_GetPendingOutput(protocol, 0, &protocol->_last_acked_input);
+			ring_pop(&protocol->_pending_output_ring);
+		}
+	}
+	if (protocol->_last_acked_input.frame != last_acked_frame) {
+		protocol->_state.running.last_ack_progress_time = Platform_GetCurrentTimeMS();
+	}
+}
+
+/*
+ * UdpProtocol_TrimInputLog --
+ *
+ * Discard the log frames every live endpoint reading from it has acked and
+ * return the number of frames the slowest one has yet to ack.
+ */
+int UdpProtocol_TrimInputLog(InputLog *log, UdpProtocol *endpoints, int count)
+{
+	int backlog = 0;
+	int min_acked = input_log_GetLastFrame(log);
+
+	for (int i = 0; i < count; i++) {
+		if (UdpProtocol_IsInitialized(&endpoints[i]) && !UdpProtocol_IsDisconnected(&endpoints[i]) && !UdpProtocol_NeedsState(&endpoints[i])) {
+			min_acked = MIN(min_acked, UdpProtocol_GetLastAckedFrame(&endpoints[i]));
+			backlog = MAX(backlog, UdpProtocol_GetPendingOutputCount(&endpoints[i]));
+		}
+	}
+	input_log_DiscardFrames(log, min_acked);
+	return backlog;
+}
+
 bool UdpProtocol_OnQualityReport(UdpProtocol *protocol, UdpMsg* msg, int len)
 {
 	// send a reply so the other side can compute the round trip transmit time.
-	UdpMsg* reply = calloc(1, sizeof(UdpMsg));   udp_msg_ctor(reply, UdpMsg_QualityReply);
-	reply->u.quality_reply.pong = msg->u.quality_report.ping;
-	UdpProtocol_SendMsg(protocol, reply);
+	UdpMsg reply;  udp_msg_ctor(&reply, UdpMsg_QualityReply);
+	reply.u.quality_reply.pong = msg->u.quality_report.ping;
+	UdpProtocol_SendMsg(protocol, &reply);
 
 	protocol->_remote_frame_advantage = msg->u.quality_report.frame_advantage;
 	return true;
@@ -656,32 +1258,307 @@ bool UdpProtocol_OnQualityReport(UdpProtocol *protocol, UdpMsg* msg, int len)
 
 bool UdpProtocol_OnQualityReply(UdpProtocol *protocol, UdpMsg* msg, int len)
 {
-	protocol->_round_trip_time = Platform_GetCurrentTimeMS() - msg->u.quality_reply.pong;
+	UdpProtocol_AddRttSample(protocol, (int)(UdpProtocol_GetTimestamp() - msg->u.quality_reply.pong));
 	return true;
 }
 
+/*
+ * UdpProtocol_GetTimestamp --
+ *
+ * The low 32 bits of our clock in microseconds, which wrap every 71
+ * minutes.  Only differences are ever used.  0 is skipped so it can mean
+ * "no timestamp".
+ */
+static uint32 UdpProtocol_GetTimestamp(void)
+{
+	uint32 timestamp = (uint32)Platform_GetCurrentTimeUS();
+	return timestamp ? timestamp : 1;
+}
+
+static uint32 UdpProtocol_GetEchoTimestamp(UdpProtocol *protocol)
+{
+	if (!protocol->_remote_timestamp) {
+		return 0;
+	}
+	uint32 held = (uint32)(Platform_GetCurrentTimeUS() - protocol->_remote_timestamp_recv_time);
+	uint32 echo = protocol->_remote_timestamp + held;
+	return echo ? echo : 1;
+}
+
+static void UdpProtocol_OnTimestamps(UdpProtocol *protocol, uint32 timestamp, uint32 echo_timestamp)
+{
+	if (timestamp) {
+		protocol->_remote_timestamp = timestamp;
+		protocol->_remote_timestamp_recv_time = Platform_GetCurrentTimeUS();
+	}
+	if (echo_timestamp && echo_timestamp != protocol->_last_echo_timestamp) {
+		int sample = (int)(UdpProtocol_GetTimestamp() - echo_timestamp);
+		protocol->_last_echo_timestamp = echo_timestamp;
+		UdpProtocol_AddRttSample(protocol, sample);
+		if (timestamp) {
+			clock_offset_add_sample(&protocol->_clock, Platform_GetCurrentTimeUS(), timestamp, sample);
+		}
+	}
+}
+
+static void UdpProtocol_AddRttSample(UdpProtocol *protocol, int sample)
+{
+	rtt_add_sample(&protocol->_rtt, sample);
+	protocol->_round_trip_time = (rtt_get_srtt(&protocol->_rtt) + 500) / 1000;
+}
+
+/*
+ * UdpProtocol_GetRetryInterval --
+ *
+ * How long to go without the peer acking any of our pending output before
+ * sending it again, in milliseconds.
+ */
+int UdpProtocol_GetRetryInterval(UdpProtocol *protocol)
+{
+	return rtt_get_timeout(&protocol->_rtt) / 1000;
+}
+
 bool UdpProtocol_OnKeepAlive(UdpProtocol *protocol, UdpMsg* msg, int len)
 {
 	return true;
 }
 
+/*
+ * UdpProtocol_RequireState --
+ *
+ * Hold back the input stream of an endpoint joining a running session until
+ * the backend hands us a state to send with UdpProtocol_SendState.  Until
+ * then the endpoint doesn't read from its input log, so it neither keeps
+ * frames in it nor counts as lagging behind.
+ */
+void UdpProtocol_RequireState(UdpProtocol *protocol)
+{
+	protocol->_snapshot.pending = true;
+}
+
+/*
+ * UdpProtocol_SendState --
+ *
+ * Start streaming the state saved at the beginning of frame to the peer.
+ * The input stream restarts at the same frame, its first frame sent whole.
+ */
+void UdpProtocol_SendState(UdpProtocol *protocol, int frame, byte* buf, int len)
+{
+	free(protocol->_snapshot.data);
+
+	protocol->_snapshot.data = malloc(compress_Bound(len));
+	protocol->_snapshot.size = compress_Encode(buf, len, protocol->_snapshot.data, compress_Bound(len));
+	protocol->_snapshot.raw_size = len;
+	protocol->_snapshot.frame = frame;
+	protocol->_snapshot.acked = 0;
+	protocol->_snapshot.next_offset = 0;
+	protocol->_snapshot.last_progress_time = Platform_GetCurrentTimeMS();
+	protocol->_snapshot.pending = false;
+	protocol->_snapshot.complete = false;
+	Log("sending state for frame %d (%d bytes, %d compressed).\n", frame, len, protocol->_snapshot.size);
+
+	gameinput_init(&protocol->_last_acked_input, frame - 1, NULL, 1);
+	UdpProtocol_SendStateChunks(protocol);
+	UdpProtocol_SendPendingOutput(protocol);
+}
+
+/*
+ * UdpProtocol_SendStateChunks --
+ *
+ * Keep a window of state chunks in flight, starting over from the last
+ * acked offset when the peer hasn't acked anything for a while.
+ */
+void UdpProtocol_SendStateChunks(UdpProtocol *protocol)
+{
+	uint32 now = Platform_GetCurrentTimeMS();
+
+	if (!protocol->_snapshot.data || protocol->_current_state != UdpProtocol_Running) {
+		return;
+	}
+	if (protocol->_snapshot.last_progress_time + STATE_RETRY_INTERVAL < now) {
+		Log("No state acked in %d ms.  Resending from offset %d.\n", STATE_RETRY_INTERVAL, protocol->_snapshot.acked);
+		protocol->_snapshot.next_offset = protocol->_snapshot.acked;
+		protocol->_snapshot.last_progress_time = now;
+	}
+
+	int window_end = MIN(protocol->_snapshot.size, protocol->_snapshot.acked + STATE_WINDOW_CHUNKS * UDP_MSG_MAX_STATE_CHUNK);
+	while (protocol->_snapshot.next_offset < window_end) {
+		UdpMsg msg;  udp_msg_ctor(&msg, UdpMsg_StateChunk);
+		/* what a chunk costs besides its data, bundled, at its biggest */
+		int overhead = udp_msg_BundleEntrySize(udp_msg_PacketSize(&msg) + UDP_MSG_MAX_STATE_CHUNK) - UDP_MSG_MAX_STATE_CHUNK;
+		int room = UdpProtocol_MaxPayload(protocol) - overhead;
+		int size = MIN(MIN(UDP_MSG_MAX_STATE_CHUNK, room), protocol->_snapshot.size - protocol->_snapshot.next_offset);
+		msg.u.state_chunk.frame = protocol->_snapshot.frame;
+		msg.u.state_chunk.raw_size = protocol->_snapshot.raw_size;
+		msg.u.state_chunk.total_size = protocol->_snapshot.size;
+		msg.u.state_chunk.offset = protocol->_snapshot.next_offset;
+		msg.u.state_chunk.size = (uint16)size;
+		memcpy(msg.u.state_chunk.data, protocol->_snapshot.data + protocol->_snapshot.next_offset, size);
+		UdpProtocol_SendMsg(protocol, &msg);
+		protocol->_snapshot.next_offset += size;
+	}
+}
+
+/*
+ * UdpProtocol_OnStateChunk --
+ *
+ * Only the endpoint a spectator receives its inputs through is ever sent a
+ * state.  Anyone else sending chunks could make us hold up to STATE_MAX_SIZE
+ * bytes for nothing, so they are dropped.
+ */
+bool UdpProtocol_OnStateChunk(UdpProtocol *protocol, UdpMsg* msg, int len)
+{
+	int frame = msg->u.state_chunk.frame;
+	int total_size = msg->u.state_chunk.total_size;
+	int raw_size = msg->u.state_chunk.raw_size;
+
+	if (!protocol->_snapshot.accept) {
+		Log("dropping state chunk from a peer which doesn't send states.\n");
+		return false;
+	}
+	if (len < udp_msg_PacketSize(msg)) {
+		Log("dropping state chunk of %d bytes in a %d byte message.\n", msg->u.state_chunk.size, len);
+		return false;
+	}
+
+	/*
+	 * The peer sends a newer state when we fall too far behind.
+	 */
+	if ((protocol->_snapshot.data || protocol->_snapshot.complete) && frame > protocol->_snapshot.frame) {
+		free(protocol->_snapshot.data);
+		protocol->_snapshot.data = NULL;
+		protocol->_snapshot.complete = false;
+	}
+	if (!protocol->_snapshot.data && !protocol->_snapshot.complete) {
+		if (total_size <= 0 || total_size > STATE_MAX_SIZE || raw_size < 0 || raw_size > STATE_MAX_SIZE) {
+			Log("rejecting state of %d bytes (%d compressed).\n", raw_size, total_size);
+			return false;
+		}
+		protocol->_snapshot.data = malloc(total_size);
+		if (!protocol->_snapshot.data) {
+			Log("out of memory for a state of %d bytes.\n", total_size);
+			return false;
+		}
+		protocol->_snapshot.size = total_size;
+		protocol->_snapshot.raw_size = raw_size;
+		protocol->_snapshot.frame = frame;
+		protocol->_snapshot.acked = 0;
+	}
+	if (frame != protocol->_snapshot.frame) {
+		return true;
+	}
+
+	if (!protocol->_snapshot.complete && (int)msg->u.state_chunk.offset == protocol->_snapshot.acked &&
+		msg->u.state_chunk.size <= UDP_MSG_MAX_STATE_CHUNK &&
+		msg->u.state_chunk.size <= protocol->_snapshot.size - protocol->_snapshot.acked) {
+		memcpy(protocol->_snapshot.data + protocol->_snapshot.acked, msg->u.state_chunk.data, msg->u.state_chunk.size);
+		protocol->_snapshot.acked += msg->u.state_chunk.size;
+	}
+
+	UdpMsg ack;  udp_msg_ctor(&ack, UdpMsg_StateAck);
+	ack.u.state_ack.frame = frame;
+	ack.u.state_ack.received = protocol->_snapshot.acked;
+	UdpProtocol_SendMsg(protocol, &ack);
+
+	if (!protocol->_snapshot.complete && protocol->_snapshot.acked == protocol->_snapshot.size) {
+		udp_protocol_Event evt = { UdpProtocol_Event_State };
+		byte* buf = malloc(MAX(protocol->_snapshot.raw_size, 1));
+		int decoded = buf ? compress_Decode(protocol->_snapshot.data, protocol->_snapshot.size, buf, protocol->_snapshot.raw_size) : -1;
+
+		free(protocol->_snapshot.data);
+		protocol->_snapshot.data = NULL;
+		protocol->_snapshot.complete = true;
+		if (decoded != protocol->_snapshot.raw_size) {
+			Log("failed to decode state for frame %d.  Disconnecting.\n", frame);
+			free(buf);
+			UdpProtocol_QueueEvent(protocol, &(udp_protocol_Event){ UdpProtocol_Event_Disconnected });
+			protocol->_disconnect_event_sent = true;
+			return true;
+		}
+		Log("received state for frame %d (%d bytes).\n", frame, decoded);
+		evt.u.state.frame = frame;
+		evt.u.state.buf = buf;
+		evt.u.state.len = decoded;
+		UdpProtocol_QueueEvent(protocol, &evt);
+		UdpProtocol_RestartInputStream(protocol, frame);
+		UdpProtocol_DecodeHeldFragments(protocol);
+	}
+	return true;
+}
+
+bool UdpProtocol_OnStateAck(UdpProtocol *protocol, UdpMsg* msg, int len)
+{
+	if (!protocol->_snapshot.data || msg->u.state_ack.frame != protocol->_snapshot.frame) {
+		return true;
+	}
+	if ((int)msg->u.state_ack.received > protocol->_snapshot.acked) {
+		protocol->_snapshot.acked = MIN((int)msg->u.state_ack.received, protocol->_snapshot.size);
+		protocol->_snapshot.next_offset = MAX(protocol->_snapshot.next_offset, protocol->_snapshot.acked);
+		protocol->_snapshot.last_progress_time = Platform_GetCurrentTimeMS();
+	}
+	if (protocol->_snapshot.acked == protocol->_snapshot.size) {
+		Log("state for frame %d delivered.\n", protocol->_snapshot.frame);
+		free(protocol->_snapshot.data);
+		protocol->_snapshot.data = NULL;
+		protocol->_snapshot.complete = true;
+		return true;
+	}
+	UdpProtocol_SendStateChunks(protocol);
+	return true;
+}
+
 void UdpProtocol_GetNetworkStats(UdpProtocol *protocol, struct GGPONetworkStats* s)
 {
 	s->network.ping = protocol->_round_trip_time;
-	s->network.send_queue_len = ring_size(&protocol->_pending_output_ring);
+	s->network.jitter = (rtt_get_rttvar(&protocol->_rtt) + 500) / 1000;
+	s->network.send_queue_len = UdpProtocol_GetPendingOutputCount(protocol);
 	s->network.kbps_sent = protocol->_kbps_sent;
+	s->network.bytes_sent = protocol->_bytes_sent + (UDP_HEADER_SIZE * protocol->_packets_sent);
+	s->network.packets_sent = protocol->_packets_sent;
 	s->timesync.remote_frames_behind = protocol->_remote_frame_advantage;
 	s->timesync.local_frames_behind = protocol->_local_frame_advantage;
 }
 
+/*
+ * UdpProtocol_EstimateRemoteFrame --
+ *
+ * The frame the other guy should be on right now.
+ */
+int UdpProtocol_EstimateRemoteFrame(UdpProtocol *protocol)
+{
+	int frame_usec = timesync_get_frame_duration(&protocol->_timesync);
+	int remoteFrame;
+
+	if (protocol->_remote_frame >= 0 && clock_offset_is_valid(&protocol->_clock)) {
+		/*
+		 * Move the frame the other guy was on when they last sent us
+		 * their inputs forward by the time elapsed since then on their
+		 * clock.  They send every frame while running, so don't count on
+		 * them having moved on for long after their packets stop.
+		 */
+		uint64 now = Platform_GetCurrentTimeUS();
+		uint32 sent = protocol->_remote_frame_timestamp;
+		int elapsed = (int)(clock_offset_to_remote(&protocol->_clock, now) - sent);
+		int transit = (int)(clock_offset_to_remote(&protocol->_clock, protocol->_remote_frame_recv_time) - sent);
+		elapsed = MIN(elapsed, transit + MAX_REMOTE_FRAME_EXTRAPOLATION * frame_usec);
+		remoteFrame = protocol->_remote_frame + MAX(elapsed, 0) / frame_usec;
+	}
+	else {
+		/*
+		 * Estimate which frame the other guy is one by looking at the
+		 * last frame they gave us plus some delta for the one-way packet
+		 * trip time.
+		 */
+		remoteFrame = protocol->_last_received_input.frame + rtt_get_srtt(&protocol->_rtt) / frame_usec;
+	}
+	return remoteFrame;
+}
+
 void UdpProtocol_SetLocalFrameNumber(UdpProtocol *protocol, int localFrame)
 {
-	/*
-	 * Estimate which frame the other guy is one by looking at the
-	 * last frame they gave us plus some delta for the one-way packet
-	 * trip time.
-	 */
-	int remoteFrame = protocol->_last_received_input.frame + (protocol->_round_trip_time * 60 / 1000);
+	int remoteFrame = UdpProtocol_EstimateRemoteFrame(protocol);
+
+	protocol->_local_frame = localFrame;
 
 	/*
 	 * Our frame advantage is how many frames *behind* the other guy
@@ -698,6 +1575,11 @@ int UdpProtocol_RecommendFrameDelay(UdpProtocol *protocol)
 	return timesync_recommend_frame_wait_duration(&protocol->_timesync, false);
 }
 
+int UdpProtocol_RecommendDrift(UdpProtocol *protocol)
+{
+	return timesync_recommend_drift(&protocol->_timesync);
+}
+
 
 void UdpProtocol_SetDisconnectTimeout(UdpProtocol *protocol, int timeout)
 {
@@ -709,6 +1591,17 @@ void UdpProtocol_SetDisconnectNotifyStart(UdpProtocol *protocol, int timeout)
 	protocol->_disconnect_notify_start = timeout;
 }
 
+void UdpProtocol_SetFrameDuration(UdpProtocol *protocol, int usec)
+{
+	timesync_set_frame_duration(&protocol->_timesync, usec);
+}
+
+void UdpProtocol_SetPathMtu(UdpProtocol *protocol, int mtu)
+{
+	ASSERT(mtu >= UDP_PROTOCOL_MIN_PATH_MTU && mtu <= UDP_PROTOCOL_MAX_PATH_MTU);
+	protocol->_path_mtu = mtu;
+}
+
 void UdpProtocol_PumpSendQueue(UdpProtocol *protocol)
 {
 	while (!ring_empty(&protocol->_send_queue_ring)) {
@@ -717,22 +1610,23 @@ void UdpProtocol_PumpSendQueue(UdpProtocol *protocol)
 		if (protocol->_send_latency) {
 			// should really come up with a gaussian distributation based on the configured
 			// value, but this will do for now.
-			int jitter = (protocol->_send_latency * 2 / 3) + ((rand() % protocol->_send_latency) / 3);
+			int jitter = (protocol->_send_latency * 2 / 3) + ((random_next(&protocol->_random) % protocol->_send_latency) / 3);
 			if (Platform_GetCurrentTimeMS() < protocol->_send_queue[ring_front(&protocol->_send_queue_ring)].queue_time + jitter) {
 				break;
 			}
 		}
-		if (protocol->_oop_percent && !protocol->_oo_packet.msg && ((rand() % 100) < protocol->_oop_percent)) {
-			int delay = rand() % (protocol->_send_latency * 10 + 1000);
+		if (protocol->_oop_percent && !protocol->_oo_packet.msg && ((random_next(&protocol->_random) % 100) < (uint32)protocol->_oop_percent)) {
+			int delay = random_next(&protocol->_random) % (protocol->_send_latency * 10 + 1000);
 			Log("creating rogue oop (seq: %d  delay: %d)\n", entry.msg->hdr.sequence_number, delay);
 			protocol->_oo_packet.send_time = Platform_GetCurrentTimeMS() + delay;
 			protocol->_oo_packet.msg = entry.msg;
 			protocol->_oo_packet.dest_addr = entry.dest_addr;
+			protocol->_oo_packet.len = entry.len;
 		}
 		else {
 			ASSERT(entry.dest_addr);
 
-			udp_SendTo(protocol->_udp, (char*)entry.msg, udp_msg_PacketSize(entry.msg), 0, entry.dest_addr);
+			udp_SendTo(protocol->_udp, (char*)entry.msg, entry.len, 0, entry.dest_addr);
 
 			free(entry.msg);
 		}
@@ -740,7 +1634,7 @@ void UdpProtocol_PumpSendQueue(UdpProtocol *protocol)
 	}
 	if (protocol->_oo_packet.msg && protocol->_oo_packet.send_time < Platform_GetCurrentTimeMS()) {
 		Log("sending rogue oop!");
-		udp_SendTo(protocol->_udp, (char*)protocol->_oo_packet.msg, udp_msg_PacketSize(protocol->_oo_packet.msg), 0,
+		udp_SendTo(protocol->_udp, (char*)protocol->_oo_packet.msg, protocol->_oo_packet.len, 0,
 			   protocol->_oo_packet.dest_addr);
 
 		free(protocol->_oo_packet.msg);
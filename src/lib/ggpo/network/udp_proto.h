@@ -27,9 +27,13 @@
 #include "udp.h"
 #include "game_input.h"
 #include "timesync.h"
+#include "rtt.h"
+#include "clock_offset.h"
+#include "random.h"
 #include "ggponet.h"
 #include "ring_buffer.h"
 #include "udp_msg.h"
+#include "input_log.h"
 
 
 struct udp_protocol_Stats {
@@ -50,6 +54,7 @@ enum udp_protocol_EventType {
 			UdpProtocol_Event_Disconnected,
 			UdpProtocol_Event_NetworkInterrupted,
 			UdpProtocol_Event_NetworkResumed,
+			UdpProtocol_Event_State,
 };
 typedef enum udp_protocol_EventType udp_protocol_EventType;
 
@@ -58,6 +63,7 @@ struct udp_protocol_Event {
 		union {
 			struct {
 				GameInput   input;
+				uint32      recv_time;
 			} input;
 			struct {
 				int         total;
@@ -66,10 +72,42 @@ struct udp_protocol_Event {
 			struct {
 				int         disconnect_timeout;
 			} network_interrupted;
+			struct {
+				int         frame;
+				byte*       buf;      /* owned by the receiver of the event */
+				int         len;
+			} state;
 		} u;
 };
 typedef struct udp_protocol_Event udp_protocol_Event;
 
+/*
+ * An event waiting in the queue.  The bits of an input event are kept in
+ * _event_bits, sized to the input stream, rather than in a GameInput.
+ */
+struct udp_protocol_QueuedEvent {
+		udp_protocol_EventType      type;
+		union {
+			struct {
+				int         frame;
+				uint32      recv_time;
+			} input;
+			struct {
+				int         total;
+				int         count;
+			} synchronizing;
+			struct {
+				int         disconnect_timeout;
+			} network_interrupted;
+			struct {
+				int         frame;
+				byte*       buf;
+				int         len;
+			} state;
+		} u;
+};
+typedef struct udp_protocol_QueuedEvent udp_protocol_QueuedEvent;
+
 enum udp_protocol_State
 {
 		UdpProtocol_Syncing,
@@ -79,14 +117,60 @@ enum udp_protocol_State
 };
 typedef enum udp_protocol_State udp_protocol_State;
 
+/*
+ * Most messages to a peer are held until the next UdpProtocol_Flush and
+ * sent in a single datagram, as long as it fits in the path MTU (IP and
+ * UDP headers included).  Pending inputs which don't fit in one datagram
+ * are split over up to UDP_PROTOCOL_MAX_INPUT_FRAGMENTS of them.
+ */
+#define UDP_PROTOCOL_MAX_BUNDLE           16
+#define UDP_PROTOCOL_DEFAULT_PATH_MTU     1280
+#define UDP_PROTOCOL_MIN_PATH_MTU         576
+#define UDP_PROTOCOL_MAX_PATH_MTU         4096
+#define UDP_PROTOCOL_MAX_INPUT_FRAGMENTS  8
+
 struct udp_protocol_QueueEntry
 {
 		int         queue_time;
 		conn_Address dest_addr;
 		UdpMsg* msg;
+		int         len;               /* bytes on the wire, see udp_msg_PackInput */
 };
 typedef struct udp_protocol_QueueEntry udp_protocol_QueueEntry;
 
+/*
+ * Encoded input chunks shared by every endpoint of a session which is fed the
+ * same input stream.  Endpoints in the same ack state produce the exact same
+ * bit-delta payload, so it only needs to be encoded once per frame.
+ */
+#define UDP_PROTOCOL_ENCODE_CACHE_SIZE 8
+
+struct udp_protocol_EncodedChunk
+{
+	int         start_frame;
+	int         base_frame;
+	int         end_frame;
+	int         last_encoded_frame;
+	int         max_bits;
+	uint8       input_size;
+	uint8       first_frame_raw;
+	uint16      num_bits;
+	uint8       bits[UDP_MSG_MAX_INPUT_BITS / 8];
+};
+typedef struct udp_protocol_EncodedChunk udp_protocol_EncodedChunk;
+
+struct udp_protocol_EncodeCache
+{
+	udp_protocol_EncodedChunk _chunks[UDP_PROTOCOL_ENCODE_CACHE_SIZE];
+	int         _num_chunks;
+	int         _next_chunk;
+	int         _hits;
+	int         _misses;
+};
+typedef struct udp_protocol_EncodeCache udp_protocol_EncodeCache;
+
+void udp_protocol_encode_cache_ctor(udp_protocol_EncodeCache *cache);
+
 struct UdpProtocol
 {
 	/*
@@ -97,21 +181,37 @@ struct UdpProtocol
 	uint16         _magic_number;
 	int            _queue;
 	uint16         _remote_magic_number;
+	uint16         _remote_session;
 	bool           _connected;
 	int            _send_latency;
 	int            _oop_percent;
+	Random         _random;
 	struct {
 		int         send_time;
 		conn_Address dest_addr;
 		UdpMsg* msg;
+		int         len;
 	}              _oo_packet;
 	RingBuffer _send_queue_ring;
 	udp_protocol_QueueEntry _send_queue[64];
+	int            _path_mtu;
+
+	/*
+	 * Packed copies of the messages waiting to go out together in one
+	 * datagram at the next UdpProtocol_Flush.
+	 */
+	struct {
+		UdpMsg*     msgs[UDP_PROTOCOL_MAX_BUNDLE];
+		int         lens[UDP_PROTOCOL_MAX_BUNDLE];
+		int         count;
+		int         size;          /* of the bundle holding them all */
+	}              _bundle;
 
 	/*
 	 * Stats
 	 */
 	int            _round_trip_time;
+	RttEstimator   _rtt;
 	int            _packets_sent;
 	int            _bytes_sent;
 	int            _kbps_sent;
@@ -123,6 +223,14 @@ struct UdpProtocol
 	UdpMsg_connect_status* _local_connect_status;
 	UdpMsg_connect_status _peer_connect_status[UDP_MSG_MAX_PLAYERS];
 
+	/*
+	 * Only the connect statuses which changed since we last sent them go
+	 * out, plus one of the others in turn, so that the peer catches up
+	 * on a change it lost within UDP_MSG_MAX_PLAYERS packets.
+	 */
+	UdpMsg_connect_status _sent_connect_status[UDP_MSG_MAX_PLAYERS];
+	int                   _next_connect_status_refresh;
+
 	udp_protocol_State          _current_state;
 	union {
 		struct {
@@ -132,7 +240,7 @@ struct UdpProtocol
 		struct {
 			uint32   last_quality_report_time;
 			uint32   last_network_stats_interval;
-			uint32   last_input_packet_recv_time;
+			uint32   last_ack_progress_time;    /* last ack of our output, or when it was empty */
 		} running;
 	} _state;
 
@@ -145,9 +253,23 @@ struct UdpProtocol
 	/*
 	 * Packet loss...
 	 */
-	RingBuffer  _pending_output_ring;
-	GameInput  _pending_output[64];
+	RingBuffer                 _pending_output_ring;
+	int                        _pending_frames[64];
+	char                       *_pending_bits;      /* _input_size bytes per pending frame */
+	int                        _input_size;         /* size of the inputs we send, 0 if none */
+	InputLog                   *_input_log;
+	udp_protocol_EncodeCache   *_encode_cache;
 	GameInput                  _last_received_input;
+
+	/*
+	 * Input messages which start past the frames we have, kept until the
+	 * ones before them fill the gap.
+	 */
+	struct {
+		UdpMsg*     msgs[UDP_PROTOCOL_MAX_INPUT_FRAGMENTS];
+		int         count;
+	}                          _fragments;
+
 	GameInput                  _last_sent_input;
 	GameInput                  _last_acked_input;
 	unsigned int               _last_send_time;
@@ -161,6 +283,45 @@ struct UdpProtocol
 	uint16                     _next_send_seq;
 	uint16                     _next_recv_seq;
 
+	/*
+	 * Round trip samples piggybacked on input traffic.  We echo the last
+	 * timestamp the peer sent us, advanced by how long we held on to it,
+	 * so the peer can measure its round trip from the echo alone.
+	 */
+	uint32                     _remote_timestamp;
+	uint64                     _remote_timestamp_recv_time;
+	uint32                     _last_echo_timestamp;
+
+	/*
+	 * Remote frame estimation.  The peer tells us which frame it was on
+	 * when it sent its inputs, and the offset of its clock lets us work
+	 * out how long ago that was.
+	 */
+	ClockOffset                _clock;
+	int                        _local_frame;
+	int                        _remote_frame;
+	uint32                     _remote_frame_timestamp;
+	uint64                     _remote_frame_recv_time;
+
+	/*
+	 * Game state transfer, used to let spectators join a running session.
+	 * The sender streams the compressed state in chunks and goes back to the
+	 * last acked offset when the receiver stops making progress.  Only an
+	 * endpoint set up with UdpProtocol_AcceptState takes chunks in.
+	 */
+	struct {
+		byte*       data;
+		int         size;
+		int         raw_size;
+		int         frame;
+		int         acked;
+		int         next_offset;
+		uint32      last_progress_time;
+		bool        pending;
+		bool        complete;
+		bool        accept;
+	}                          _snapshot;
+
 	/*
 	 * Rift synchronization.
 	 */
@@ -169,8 +330,10 @@ struct UdpProtocol
 	/*
 	 * Event queue
 	 */
-	RingBuffer  _event_queue_ring;
-	udp_protocol_Event  _event_queue[64];
+	RingBuffer                 _event_queue_ring;
+	udp_protocol_QueuedEvent   _event_queue[64];
+	char                       *_event_bits;        /* _remote_input_size bytes per queued event */
+	int                        _remote_input_size;  /* size of the inputs the peer sends, from its sync requests */
 };
 typedef struct UdpProtocol UdpProtocol;
 
@@ -181,15 +344,17 @@ typedef struct UdpProtocol UdpProtocol;
 	bool UdpProtocol_OnLoopPoll(UdpProtocol *protocol);
 
 
-	void UdpProtocol_Init(UdpProtocol *protocol, Udp* udp, int queue, conn_Address addr, UdpMsg_connect_status* status);
+	void UdpProtocol_Init(UdpProtocol *protocol, Udp* udp, int queue, conn_Address addr, UdpMsg_connect_status* status, int input_size);
 
 	void UdpProtocol_Synchronize(UdpProtocol *protocol);
 	bool UdpProtocol_GetPeerConnectStatus(UdpProtocol *protocol, int id, int* frame);
-	inline bool UdpProtocol_IsInitialized(UdpProtocol *protocol) { return protocol->_udp != NULL; }
-	inline bool UdpProtocol_IsSynchronized(UdpProtocol *protocol) { return protocol->_current_state == UdpProtocol_Running; }
-	inline bool UdpProtocol_IsRunning(UdpProtocol *protocol) { return protocol->_current_state == UdpProtocol_Running; }
+	static inline bool UdpProtocol_IsInitialized(UdpProtocol *protocol) { return protocol->_udp != NULL; }
+	static inline bool UdpProtocol_IsSynchronized(UdpProtocol *protocol) { return protocol->_current_state == UdpProtocol_Running; }
+	static inline bool UdpProtocol_IsRunning(UdpProtocol *protocol) { return protocol->_current_state == UdpProtocol_Running; }
+	static inline bool UdpProtocol_IsDisconnected(UdpProtocol *protocol) { return protocol->_current_state == UdpProtocol_Disconnected; }
 	void UdpProtocol_SendInput(UdpProtocol *protocol, GameInput* input);
 	void UdpProtocol_SendInputAck(UdpProtocol *protocol);
+	void UdpProtocol_Flush(UdpProtocol *protocol);
 	bool UdpProtocol_HandlesMsg(UdpProtocol *protocol, conn_Address from, UdpMsg* msg);
 	void UdpProtocol_OnMsg(UdpProtocol *protocol, UdpMsg* msg, int len);
 	void UdpProtocol_Disconnect(UdpProtocol *protocol);
@@ -198,10 +363,25 @@ typedef struct UdpProtocol UdpProtocol;
 	bool UdpProtocol_GetEvent(UdpProtocol *protocol, udp_protocol_Event* e);
 	void UdpProtocol_GGPONetworkStats(UdpProtocol *protocol, udp_protocol_Stats* stats);
 	void UdpProtocol_SetLocalFrameNumber(UdpProtocol *protocol, int num);
+	int UdpProtocol_EstimateRemoteFrame(UdpProtocol *protocol);
 	int UdpProtocol_RecommendFrameDelay(UdpProtocol *protocol);
+	int UdpProtocol_GetRetryInterval(UdpProtocol *protocol);
+	int UdpProtocol_RecommendDrift(UdpProtocol *protocol);
 
 	void UdpProtocol_SetDisconnectTimeout(UdpProtocol *protocol, int timeout);
 	void UdpProtocol_SetDisconnectNotifyStart(UdpProtocol *protocol, int timeout);
+	void UdpProtocol_SetFrameDuration(UdpProtocol *protocol, int usec);
+	void UdpProtocol_SetPathMtu(UdpProtocol *protocol, int mtu);
+	static inline void UdpProtocol_SetEncodeCache(UdpProtocol *protocol, udp_protocol_EncodeCache *cache) { protocol->_encode_cache = cache; }
+	static inline void UdpProtocol_SetInputLog(UdpProtocol *protocol, InputLog *log) { protocol->_input_log = log; }
+	static inline void UdpProtocol_SetRemoteSession(UdpProtocol *protocol, uint16 session_id) { protocol->_remote_session = session_id; }
+	static inline int UdpProtocol_GetLastAckedFrame(UdpProtocol *protocol) { return protocol->_last_acked_input.frame; }
+	static inline RttEstimator* UdpProtocol_GetRtt(UdpProtocol *protocol) { return &protocol->_rtt; }
+	int UdpProtocol_GetPendingOutputCount(UdpProtocol *protocol);
+	void UdpProtocol_RequireState(UdpProtocol *protocol);
+	void UdpProtocol_SendState(UdpProtocol *protocol, int frame, byte* buf, int len);
+	static inline bool UdpProtocol_NeedsState(UdpProtocol *protocol) { return protocol->_snapshot.pending; }
+	static inline void UdpProtocol_AcceptState(UdpProtocol *protocol) { protocol->_snapshot.accept = true; }
 
 	bool UdpProtocol_CreateSocket(UdpProtocol *protocol, int retries);
 	void UdpProtocol_UpdateNetworkStats(UdpProtocol *protocol);
@@ -215,4 +395,10 @@ typedef struct UdpProtocol UdpProtocol;
 	void UdpProtocol_PumpSendQueue(UdpProtocol *protocol);
 	void UdpProtocol_DispatchMsg(UdpProtocol *protocol, uint8* buffer, int len);
 	void UdpProtocol_SendPendingOutput(UdpProtocol *protocol);
+	void UdpProtocol_EncodeConnectStatus(UdpProtocol *protocol, UdpMsg *msg);
+	void UdpProtocol_SendStateChunks(UdpProtocol *protocol);
+	void UdpProtocol_GetPendingOutput(UdpProtocol *protocol, int i, GameInput *input);
+	int UdpProtocol_EncodePendingOutput(UdpProtocol *protocol, int first, GameInput *last, int max_bits, UdpMsg *msg);
+	void UdpProtocol_DiscardAckedOutput(UdpProtocol *protocol, int ack_frame);
+	int UdpProtocol_TrimInputLog(InputLog *log, UdpProtocol *endpoints, int count);
 #endif
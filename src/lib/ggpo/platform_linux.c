@@ -8,22 +8,101 @@
 #if !defined(_WINDOWS)
 #include "types.h"
 #include "platform_linux.h"
-
-struct timespec start = { 0 };
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <strings.h>
 
 uint32 Platform_GetCurrentTimeMS()
 {
-    if (start.tv_sec == 0 && start.tv_nsec == 0) {
-        clock_gettime(CLOCK_MONOTONIC, &start);
-        return 0;
-    }
+    /*
+     * Like timeGetTime on Windows, count from an arbitrary point in the
+     * past rather than from the first call.  The protocol treats a time
+     * of 0 as "never".
+     */
+    struct timespec current;
+    clock_gettime(CLOCK_MONOTONIC, &current);
+
+    return (uint32)((current.tv_sec * 1000) + (current.tv_nsec / 1000000));
+}
+
+uint64 Platform_GetCurrentTimeUS()
+{
     struct timespec current;
     clock_gettime(CLOCK_MONOTONIC, &current);
 
-    return ((current.tv_sec - start.tv_sec) * 1000) +
-	    ((current.tv_nsec  - start.tv_nsec ) / 1000000);
+    return (uint64)current.tv_sec * 1000000 + (uint64)(current.tv_nsec / 1000);
 }
 
-int Platform_GetConfigInt(const char* name) { return 0; }
-bool Platform_GetConfigBool(const char* name) { return false; }
+int Platform_GetConfigInt(const char* name)
+{
+    const char* value = getenv(name);
+    if (!value) {
+        return 0;
+    }
+    return atoi(value);
+}
+
+bool Platform_GetConfigBool(const char* name)
+{
+    const char* value = getenv(name);
+    if (!value) {
+        return false;
+    }
+    return atoi(value) != 0 || strcasecmp(value, "true") == 0;
+}
+
+void Platform_CreateDirectory(const char* path)
+{
+    mkdir(path, 0755);
+}
+
+struct PlatformThreadStart {
+    void (*proc)(void* arg);
+    void* arg;
+};
+
+static void* Platform_ThreadMain(void* param)
+{
+    struct PlatformThreadStart start = *(struct PlatformThreadStart*)param;
+    free(param);
+    start.proc(start.arg);
+    return NULL;
+}
+
+bool Platform_CreateThread(PlatformThread* thread, void (*proc)(void* arg), void* arg)
+{
+    struct PlatformThreadStart* start = malloc(sizeof(*start));
+    start->proc = proc;
+    start->arg = arg;
+    if (pthread_create(thread, NULL, Platform_ThreadMain, start) != 0) {
+        free(start);
+        return false;
+    }
+    return true;
+}
+
+byte* Platform_MapFile(const char* filename, size_t* size)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    void* data = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    *size = st.st_size;
+    return data;
+}
+
+void Platform_UnmapFile(byte* data, size_t size)
+{
+    munmap(data, size);
+}
 #endif
\ No newline at end of file
@@ -8,7 +8,7 @@
 #ifndef _GGPO_LINUX_H_
 #define _GGPO_LINUX_H_
 
-#define _POSIX_C_SOURCE 199309L // We need this POSIX standard for clock_gettime
+#define _POSIX_C_SOURCE 200112L // We need this POSIX standard for clock_gettime and flockfile
 
 #include <stdio.h>
 #include <stdarg.h>
@@ -20,10 +20,11 @@
 #include <limits.h>
 #include <time.h>
 #include <stdint.h>
+#include <pthread.h>
 
 typedef uint64 ProcessID;
 
-inline int strncat_s(
+static inline int strncat_s(
    char *strDestination,
    size_t numberOfElements,
    const char *strSource,
@@ -35,17 +36,43 @@ inline int strncat_s(
 	return errno;
 }
 
-inline void DebugBreak()
+static inline void DebugBreak()
 {
 	__builtin_trap();
 }
 
 #define MAX_PATH 255
 
-inline ProcessID Platform_GetProcessID() { return (ProcessID)getpid(); }
-inline void Platform_AssertFailed(char *msg) {}
+static inline ProcessID Platform_GetProcessID() { return (ProcessID)getpid(); }
+static inline void Platform_AssertFailed(char *msg) {}
 uint32 Platform_GetCurrentTimeMS();
+uint64 Platform_GetCurrentTimeUS();
 int Platform_GetConfigInt(const char* name);
 bool Platform_GetConfigBool(const char* name);
+void Platform_CreateDirectory(const char* path);
+
+typedef pthread_t PlatformThread;
+typedef pthread_mutex_t PlatformMutex;
+typedef pthread_cond_t PlatformCondition;
+typedef pthread_once_t PlatformOnce;
+
+#define PLATFORM_ONCE_INIT PTHREAD_ONCE_INIT
+
+bool Platform_CreateThread(PlatformThread* thread, void (*proc)(void* arg), void* arg);
+static inline void Platform_JoinThread(PlatformThread* thread) { pthread_join(*thread, NULL); }
+static inline void Platform_InitMutex(PlatformMutex* mutex) { pthread_mutex_init(mutex, NULL); }
+static inline void Platform_DestroyMutex(PlatformMutex* mutex) { pthread_mutex_destroy(mutex); }
+static inline void Platform_LockMutex(PlatformMutex* mutex) { pthread_mutex_lock(mutex); }
+static inline void Platform_UnlockMutex(PlatformMutex* mutex) { pthread_mutex_unlock(mutex); }
+static inline void Platform_InitCondition(PlatformCondition* cond) { pthread_cond_init(cond, NULL); }
+static inline void Platform_DestroyCondition(PlatformCondition* cond) { pthread_cond_destroy(cond); }
+static inline void Platform_WaitCondition(PlatformCondition* cond, PlatformMutex* mutex) { pthread_cond_wait(cond, mutex); }
+static inline void Platform_SignalCondition(PlatformCondition* cond) { pthread_cond_signal(cond); }
+static inline void Platform_CallOnce(PlatformOnce* once, void (*proc)(void)) { pthread_once(once, proc); }
+static inline void Platform_LockFile(FILE* fp) { flockfile(fp); }
+static inline void Platform_UnlockFile(FILE* fp) { funlockfile(fp); }
+
+byte* Platform_MapFile(const char* filename, size_t* size);
+void Platform_UnmapFile(byte* data, size_t size);
 
 #endif
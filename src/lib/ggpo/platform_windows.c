@@ -22,6 +22,22 @@ Platform_GetConfigInt(const char* name)
    return atoi(buf);
 }
 
+uint64
+Platform_GetCurrentTimeUS()
+{
+   LARGE_INTEGER frequency;
+   LARGE_INTEGER counter;
+
+   /*
+    * Fixed at boot and cheap to read, so not worth caching in a global
+    * every session thread would race on.
+    */
+   QueryPerformanceFrequency(&frequency);
+   QueryPerformanceCounter(&counter);
+   return (uint64)(counter.QuadPart / frequency.QuadPart) * 1000000 +
+          (uint64)(counter.QuadPart % frequency.QuadPart) * 1000000 / frequency.QuadPart;
+}
+
 bool Platform_GetConfigBool(const char* name)
 {
    char buf[1024];
@@ -31,4 +47,71 @@ bool Platform_GetConfigBool(const char* name)
    return atoi(buf) != 0 || _stricmp(buf, "true") == 0;
 }
 
+struct PlatformThreadStart {
+   void (*proc)(void* arg);
+   void* arg;
+};
+
+static DWORD WINAPI
+Platform_ThreadMain(LPVOID param)
+{
+   struct PlatformThreadStart start = *(struct PlatformThreadStart*)param;
+   free(param);
+   start.proc(start.arg);
+   return 0;
+}
+
+bool
+Platform_CreateThread(PlatformThread* thread, void (*proc)(void* arg), void* arg)
+{
+   struct PlatformThreadStart* start = malloc(sizeof(*start));
+   start->proc = proc;
+   start->arg = arg;
+   *thread = CreateThread(NULL, 0, Platform_ThreadMain, start, 0, NULL);
+   if (*thread == NULL) {
+      free(start);
+      return false;
+   }
+   return true;
+}
+
+static BOOL CALLBACK
+Platform_OnceMain(PINIT_ONCE once, PVOID param, PVOID* context)
+{
+   ((void (*)(void))param)();
+   return TRUE;
+}
+
+void
+Platform_CallOnce(PlatformOnce* once, void (*proc)(void))
+{
+   InitOnceExecuteOnce(once, Platform_OnceMain, (PVOID)proc, NULL);
+}
+
+byte*
+Platform_MapFile(const char* filename, size_t* size)
+{
+   HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+   if (file == INVALID_HANDLE_VALUE) {
+      return NULL;
+   }
+   LARGE_INTEGER file_size;
+   byte* data = NULL;
+   if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0) {
+      HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+      if (mapping) {
+         /*
+          * The view keeps the mapping alive once both handles are closed.
+          */
+         data = (byte*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+         CloseHandle(mapping);
+      }
+   }
+   CloseHandle(file);
+   if (data) {
+      *size = (size_t)file_size.QuadPart;
+   }
+   return data;
+}
+
 #endif
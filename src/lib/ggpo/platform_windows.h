@@ -17,10 +17,36 @@
 
 typedef uint64 ProcessID;
 
-inline ProcessID Platform_GetProcessID() { return (ProcessID)GetCurrentProcessId(); }
-   inline void Platform_AssertFailed(char *msg) { MessageBoxA(NULL, msg, "GGPO Assertion Failed", MB_OK | MB_ICONEXCLAMATION); }
-   inline uint32 Platform_GetCurrentTimeMS() { return timeGetTime(); }
+static inline ProcessID Platform_GetProcessID() { return (ProcessID)GetCurrentProcessId(); }
+   static inline void Platform_AssertFailed(char *msg) { MessageBoxA(NULL, msg, "GGPO Assertion Failed", MB_OK | MB_ICONEXCLAMATION); }
+   static inline uint32 Platform_GetCurrentTimeMS() { return timeGetTime(); }
+   uint64 Platform_GetCurrentTimeUS();
    int Platform_GetConfigInt(const char* name);
    bool Platform_GetConfigBool(const char* name);
+   static inline void Platform_CreateDirectory(const char* path) { CreateDirectoryA(path, NULL); }
+
+   typedef HANDLE PlatformThread;
+   typedef CRITICAL_SECTION PlatformMutex;
+   typedef CONDITION_VARIABLE PlatformCondition;
+   typedef INIT_ONCE PlatformOnce;
+
+#  define PLATFORM_ONCE_INIT INIT_ONCE_STATIC_INIT
+
+   bool Platform_CreateThread(PlatformThread* thread, void (*proc)(void* arg), void* arg);
+   static inline void Platform_JoinThread(PlatformThread* thread) { WaitForSingleObject(*thread, INFINITE); CloseHandle(*thread); }
+   static inline void Platform_InitMutex(PlatformMutex* mutex) { InitializeCriticalSection(mutex); }
+   static inline void Platform_DestroyMutex(PlatformMutex* mutex) { DeleteCriticalSection(mutex); }
+   static inline void Platform_LockMutex(PlatformMutex* mutex) { EnterCriticalSection(mutex); }
+   static inline void Platform_UnlockMutex(PlatformMutex* mutex) { LeaveCriticalSection(mutex); }
+   static inline void Platform_InitCondition(PlatformCondition* cond) { InitializeConditionVariable(cond); }
+   static inline void Platform_DestroyCondition(PlatformCondition* cond) { }
+   static inline void Platform_WaitCondition(PlatformCondition* cond, PlatformMutex* mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+   static inline void Platform_SignalCondition(PlatformCondition* cond) { WakeConditionVariable(cond); }
+   void Platform_CallOnce(PlatformOnce* once, void (*proc)(void));
+   static inline void Platform_LockFile(FILE* fp) { _lock_file(fp); }
+   static inline void Platform_UnlockFile(FILE* fp) { _unlock_file(fp); }
+
+   byte* Platform_MapFile(const char* filename, size_t* size);
+   static inline void Platform_UnmapFile(byte* data, size_t size) { UnmapViewOfFile(data); }
 
 #endif
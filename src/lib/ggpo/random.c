@@ -0,0 +1,45 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+#include "random.h"
+
+void
+random_init(Random* random, uint64 seed)
+{
+	random->_state = seed;
+}
+
+/*
+ * random_init_unique --
+ *
+ * Seed from the time, the process and the address of the owner, so that
+ * two sessions started together, in the same process or not, still draw
+ * different numbers.
+ */
+void
+random_init_unique(Random* random, void const* owner)
+{
+	random_init(random, Platform_GetCurrentTimeUS() ^ ((uint64)Platform_GetProcessID() << 32) ^ (uint64)(uptr)owner);
+}
+
+uint32
+random_next(Random* random)
+{
+	uint64 z = (random->_state += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return (uint32)((z ^ (z >> 31)) >> 32);
+}
@@ -0,0 +1,39 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#ifndef _RANDOM_H
+#define _RANDOM_H
+
+#include "types.h"
+
+/*
+ * A small pseudo-random generator (splitmix64) for the code which used
+ * rand().  Each owner keeps its own state, so that sessions on different
+ * threads neither race on nor depend on the shared state of the C library.
+ * Not suitable for anything needing real unpredictability.
+ */
+struct Random
+{
+	uint64      _state;
+};
+typedef struct Random Random;
+
+void random_init(Random* random, uint64 seed);
+void random_init_unique(Random* random, void const* owner);
+uint32 random_next(Random* random);
+
+#endif
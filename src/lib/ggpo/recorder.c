@@ -0,0 +1,243 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#include "recorder.h"
+#include "compress.h"
+
+static void
+recorder_WriterMain(void* arg)
+{
+   Recorder* rec = (Recorder*)arg;
+
+   Platform_LockMutex(&rec->_mutex);
+   for (;;) {
+      while (rec->_pending_size == 0 && !rec->_closing) {
+         Platform_WaitCondition(&rec->_cond, &rec->_mutex);
+      }
+      if (rec->_pending_size == 0) {
+         break;
+      }
+
+      /*
+       * Swap the buffers so the game thread can keep appending while we
+       * write this one out.
+       */
+      byte* buf = rec->_pending;
+      int capacity = rec->_pending_capacity;
+      int size = rec->_pending_size;
+      rec->_pending = rec->_writing;
+      rec->_pending_capacity = rec->_writing_capacity;
+      rec->_pending_size = 0;
+      rec->_writing = buf;
+      rec->_writing_capacity = capacity;
+      Platform_UnlockMutex(&rec->_mutex);
+
+      bool ok = fwrite(buf, 1, size, rec->_file) == (size_t)size;
+
+      Platform_LockMutex(&rec->_mutex);
+      rec->_failed = rec->_failed || !ok;
+   }
+   Platform_UnlockMutex(&rec->_mutex);
+}
+
+static void
+recorder_Write(Recorder* rec, const void* data, int size)
+{
+   Platform_LockMutex(&rec->_mutex);
+   if (rec->_pending_size + size > rec->_pending_capacity) {
+      rec->_pending_capacity = MAX(rec->_pending_capacity * 2, rec->_pending_size + size);
+      rec->_pending = realloc(rec->_pending, rec->_pending_capacity);
+   }
+   memcpy(rec->_pending + rec->_pending_size, data, size);
+   rec->_pending_size += size;
+   if (rec->_pending_size >= RECORDER_FLUSH_SIZE) {
+      Platform_SignalCondition(&rec->_cond);
+   }
+   Platform_UnlockMutex(&rec->_mutex);
+
+   rec->_offset += size;
+}
+
+static void
+recorder_WriteChunk(Recorder* rec, ReplayChunkType type, int frame, uint32 count, const void* payload, uint32 size)
+{
+   static const byte padding[REPLAY_FILE_ALIGNMENT] = { 0 };
+   ReplayChunkHeader hdr = { type, size, frame, count };
+
+   recorder_Write(rec, &hdr, sizeof(hdr));
+   recorder_Write(rec, payload, size);
+   if (replay_file_Align(size) != size) {
+      recorder_Write(rec, padding, replay_file_Align(size) - size);
+   }
+}
+
+/*
+ * recorder_FlushInputs --
+ *
+ * Write the inputs encoded so far and start a new chunk, delta encoded from
+ * an empty input so it can be decoded on its own.
+ */
+static void
+recorder_FlushInputs(Recorder* rec)
+{
+   if (rec->_chunk_count) {
+      recorder_WriteChunk(rec, ReplayChunk_Inputs, rec->_chunk_frame, rec->_chunk_count, rec->_bits, (rec->_num_bits + 7) / 8);
+   }
+   memset(rec->_bits, 0, rec->_bits_capacity);
+   rec->_num_bits = 0;
+   rec->_chunk_frame = rec->_next_frame;
+   rec->_chunk_count = 0;
+   gameinput_init(&rec->_last_input, rec->_next_frame - 1, NULL, rec->_num_players * rec->_input_size);
+}
+
+GGPOErrorCode
+recorder_Open(Recorder* rec, const char* filename, int num_players, int input_size, int keyframe_interval, int first_frame)
+{
+   memset(rec, 0, sizeof(*rec));
+
+   rec->_file = fopen(filename, "wb");
+   if (!rec->_file) {
+      Log("failed to open replay file %s.\n", filename);
+      return GGPO_ERRORCODE_GENERAL_FAILURE;
+   }
+   rec->_num_players = num_players;
+   rec->_input_size = input_size;
+   rec->_keyframe_interval = keyframe_interval;
+   rec->_first_frame = first_frame;
+   rec->_next_frame = first_frame;
+   rec->_last_keyframe = -1;
+
+   rec->_bits_capacity = (REPLAY_INPUT_CHUNK_FRAMES * replay_file_MaxInputBits(num_players * input_size) + 7) / 8;
+   rec->_bits = calloc(rec->_bits_capacity, 1);
+
+   Platform_InitMutex(&rec->_mutex);
+   Platform_InitCondition(&rec->_cond);
+   if (!Platform_CreateThread(&rec->_thread, recorder_WriterMain, rec)) {
+      Platform_DestroyCondition(&rec->_cond);
+      Platform_DestroyMutex(&rec->_mutex);
+      fclose(rec->_file);
+      free(rec->_bits);
+      memset(rec, 0, sizeof(*rec));
+      return GGPO_ERRORCODE_GENERAL_FAILURE;
+   }
+
+   ReplayFileHeader hdr = {
+      .magic = REPLAY_FILE_MAGIC,
+      .version = REPLAY_FILE_VERSION,
+      .num_players = num_players,
+      .input_size = input_size,
+      .keyframe_interval = keyframe_interval,
+   };
+   recorder_Write(rec, &hdr, sizeof(hdr));
+   recorder_FlushInputs(rec);
+   return GGPO_OK;
+}
+
+/*
+ * recorder_Close --
+ *
+ * Write the index and the trailer, wait for the writer thread to flush
+ * everything and close the file.
+ */
+GGPOErrorCode
+recorder_Close(Recorder* rec)
+{
+   recorder_FlushInputs(rec);
+
+   ReplayFileTrailer trailer = { rec->_offset, rec->_index_size ? rec->_index[0].frame : rec->_next_frame, rec->_next_frame, REPLAY_FILE_TRAILER_MAGIC };
+   recorder_WriteChunk(rec, ReplayChunk_Index, rec->_first_frame, rec->_index_size, rec->_index, rec->_index_size * sizeof(ReplayIndexEntry));
+   recorder_Write(rec, &trailer, sizeof(trailer));
+
+   Platform_LockMutex(&rec->_mutex);
+   rec->_closing = true;
+   Platform_SignalCondition(&rec->_cond);
+   Platform_UnlockMutex(&rec->_mutex);
+   Platform_JoinThread(&rec->_thread);
+
+   bool ok = !rec->_failed && fclose(rec->_file) == 0;
+   Log("closed replay file (frames %d to %d, %d keyframes).\n", trailer.first_frame, trailer.end_frame, rec->_index_size);
+
+   Platform_DestroyCondition(&rec->_cond);
+   Platform_DestroyMutex(&rec->_mutex);
+   free(rec->_bits);
+   free(rec->_index);
+   free(rec->_pending);
+   free(rec->_writing);
+   memset(rec, 0, sizeof(*rec));
+   return ok ? GGPO_OK : GGPO_ERRORCODE_GENERAL_FAILURE;
+}
+
+bool
+recorder_NeedsKeyframe(Recorder* rec, int frame)
+{
+   return rec->_last_keyframe < 0 || frame - rec->_last_keyframe >= rec->_keyframe_interval;
+}
+
+/*
+ * recorder_SkipFrame --
+ *
+ * The file has to start with a keyframe.  Skip the frames we have no state
+ * for until we get one.
+ */
+void
+recorder_SkipFrame(Recorder* rec)
+{
+   ASSERT(!recorder_HasKeyframe(rec));
+   rec->_next_frame++;
+   rec->_chunk_frame = rec->_next_frame;
+}
+
+void
+recorder_AddKeyframe(Recorder* rec, int frame, byte* buf, int len, int checksum)
+{
+   ASSERT(frame == rec->_next_frame);
+
+   recorder_FlushInputs(rec);
+
+   if (rec->_index_size == rec->_index_capacity) {
+      rec->_index_capacity = MAX(rec->_index_capacity * 2, 16);
+      rec->_index = realloc(rec->_index, rec->_index_capacity * sizeof(ReplayIndexEntry));
+   }
+   ReplayIndexEntry* entry = &rec->_index[rec->_index_size++];
+   entry->frame = frame;
+   entry->checksum = checksum;
+   entry->offset = rec->_offset;
+
+   byte* data = malloc(compress_Bound(len));
+   int size = compress_Encode(buf, len, data, compress_Bound(len));
+   recorder_WriteChunk(rec, ReplayChunk_Keyframe, frame, len, data, size);
+   free(data);
+
+   rec->_last_keyframe = frame;
+}
+
+void
+recorder_AddInput(Recorder* rec, GameInput* input)
+{
+   ASSERT(recorder_HasKeyframe(rec));
+   ASSERT(input->frame == rec->_next_frame);
+
+   gameinput_encode_delta(input, &rec->_last_input, rec->_bits, &rec->_num_bits);
+   ASSERT(rec->_num_bits <= rec->_bits_capacity * 8);
+   rec->_last_input = *input;
+   rec->_chunk_count++;
+   rec->_next_frame++;
+
+   if (rec->_chunk_count == REPLAY_INPUT_CHUNK_FRAMES) {
+      recorder_FlushInputs(rec);
+   }
+}
@@ -0,0 +1,84 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#ifndef _RECORDER_H
+#define _RECORDER_H
+
+#include "types.h"
+#include "ggponet.h"
+#include "game_input.h"
+#include "replay_file.h"
+
+#define RECORDER_FLUSH_SIZE     (64 * 1024)
+
+/*
+ * Writes a replay file (see replay_file.h) from the confirmed inputs of a
+ * session.  Chunks are encoded on the game thread into a pending buffer,
+ * which a writer thread flushes to disk so the game never blocks on I/O.
+ */
+struct Recorder
+{
+   /*
+    * Game thread
+    */
+   int                  _num_players;
+   int                  _input_size;
+   int                  _keyframe_interval;
+   int                  _first_frame;
+   int                  _next_frame;
+   int                  _last_keyframe;
+   GameInput            _last_input;
+
+   uint8*               _bits;
+   int                  _bits_capacity;
+   int                  _num_bits;
+   int                  _chunk_frame;
+   int                  _chunk_count;
+
+   uint64               _offset;
+   ReplayIndexEntry*    _index;
+   int                  _index_size;
+   int                  _index_capacity;
+
+   /*
+    * Shared with the writer thread
+    */
+   FILE*                _file;
+   PlatformThread       _thread;
+   PlatformMutex        _mutex;
+   PlatformCondition    _cond;
+   byte*                _pending;
+   int                  _pending_size;
+   int                  _pending_capacity;
+   byte*                _writing;
+   int                  _writing_capacity;
+   bool                 _closing;
+   bool                 _failed;
+};
+typedef struct Recorder Recorder;
+
+GGPOErrorCode recorder_Open(Recorder* rec, const char* filename, int num_players, int input_size, int keyframe_interval, int first_frame);
+GGPOErrorCode recorder_Close(Recorder* rec);
+static inline bool recorder_IsOpen(Recorder* rec) { return rec->_file != NULL; }
+static inline bool recorder_HasKeyframe(Recorder* rec) { return rec->_last_keyframe >= 0; }
+static inline int recorder_GetNextFrame(Recorder* rec) { return rec->_next_frame; }
+bool recorder_NeedsKeyframe(Recorder* rec, int frame);
+void recorder_SkipFrame(Recorder* rec);
+void recorder_AddKeyframe(Recorder* rec, int frame, byte* buf, int len, int checksum);
+void recorder_AddInput(Recorder* rec, GameInput* input);
+
+#endif
@@ -0,0 +1,93 @@
+/**
+ * Copyright (C) 2025 Vincent Parizet
+ * This program is free software: you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public License
+ * as published by the Free Software Foundation, either version 3 of
+ * the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program. If not, see
+ * <https://www.gnu.org/licenses/>.
+**/
+
+#ifndef _REPLAY_FILE_H
+#define _REPLAY_FILE_H
+
+#include "types.h"
+#include "game_input.h"
+
+/*
+ * Replay files hold the confirmed inputs of a session, delta encoded the same
+ * way they are sent over the network, and periodic keyframes of the game
+ * state.  The layout is meant to be read through a memory mapping:
+ *
+ *    ReplayFileHeader
+ *    ReplayChunkHeader + payload, padded to REPLAY_FILE_ALIGNMENT   (repeated)
+ *    ReplayChunkHeader + ReplayIndexEntry[]                          (index)
+ *    ReplayFileTrailer
+ *
+ * A reader looks up the trailer at the end of the file, finds the closest
+ * keyframe before the frame it wants in the index, and walks the chunks from
+ * there.  Every keyframe is followed by input chunks starting at its frame,
+ * and every input chunk is delta encoded from an empty input, so a chunk can
+ * be decoded without reading anything before it.
+ */
+#define REPLAY_FILE_MAGIC          "GGPOREPL"
+#define REPLAY_FILE_TRAILER_MAGIC  "GGPOINDX"
+#define REPLAY_FILE_VERSION        1
+#define REPLAY_FILE_ALIGNMENT      8
+#define REPLAY_INPUT_CHUNK_FRAMES  256
+
+#pragma pack(push, 1)
+
+enum ReplayChunkType {
+   ReplayChunk_Inputs      = 1,
+   ReplayChunk_Keyframe    = 2,
+   ReplayChunk_Index       = 3,
+};
+typedef enum ReplayChunkType ReplayChunkType;
+
+struct ReplayFileHeader {
+   char           magic[8];
+   uint32         version;
+   uint32         num_players;
+   uint32         input_size;          /* per player */
+   uint32         keyframe_interval;
+   uint32         reserved[2];
+};
+typedef struct ReplayFileHeader ReplayFileHeader;
+
+struct ReplayChunkHeader {
+   uint32         type;
+   uint32         size;                /* payload size, without the padding */
+   int            frame;               /* first frame of the chunk */
+   uint32         count;               /* inputs: frames, keyframe: decompressed size, index: entries */
+};
+typedef struct ReplayChunkHeader ReplayChunkHeader;
+
+struct ReplayIndexEntry {
+   int            frame;
+   int            checksum;            /* checksum returned by save_game_state */
+   uint64         offset;              /* offset of the keyframe chunk */
+};
+typedef struct ReplayIndexEntry ReplayIndexEntry;
+
+struct ReplayFileTrailer {
+   uint64         index_offset;
+   int            first_frame;
+   int            end_frame;           /* one past the last recorded frame */
+   char           magic[8];
+};
+typedef struct ReplayFileTrailer ReplayFileTrailer;
+
+#pragma pack(pop)
+
+static inline uint32 replay_file_Align(uint32 size) { return (size + REPLAY_FILE_ALIGNMENT - 1) & ~(REPLAY_FILE_ALIGNMENT - 1); }
+static inline int replay_file_MaxInputBits(int input_size) { return 1 + input_size * 8 * (2 + gameinput_index_bits(input_size)); }
+
+#endif
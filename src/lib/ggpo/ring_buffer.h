@@ -19,7 +19,7 @@ struct RingBuffer
 };
 typedef struct RingBuffer RingBuffer;
 
-inline void ring_ctor(RingBuffer* ring, int N)
+static inline void ring_ctor(RingBuffer* ring, int N)
 {
     ring->_head = 0;
     ring->_tail = 0;
@@ -27,23 +27,23 @@ inline void ring_ctor(RingBuffer* ring, int N)
     ring->_N = N;
 }
 
-inline int ring_front(RingBuffer* ring) {
+static inline int ring_front(RingBuffer* ring) {
 	ASSERT(ring->_size != ring->_N);
 	return ring->_tail;
 }
 
-inline int  ring_item(RingBuffer* ring, int i) {
+static inline int  ring_item(RingBuffer* ring, int i) {
 	ASSERT(i < ring->_size);
 	return (ring->_tail + i) % ring->_N;
 }
 
-inline void  ring_pop(RingBuffer* ring) {
+static inline void  ring_pop(RingBuffer* ring) {
 	ASSERT(ring->_size != ring->_N);
 	ring->_tail = (ring->_tail + 1) % ring->_N;
 	ring->_size--;
 }
 
-inline int  ring_push(RingBuffer* ring) {
+static inline int  ring_push(RingBuffer* ring) {
 	ASSERT(ring->_size != (ring->_N - 1));
 	int result = ring->_head;
 	ring->_head = (ring->_head + 1) % ring->_N;
@@ -51,11 +51,11 @@ inline int  ring_push(RingBuffer* ring) {
     return result;
 }
 
-inline int  ring_size(RingBuffer* ring) {
+static inline int  ring_size(RingBuffer* ring) {
 	return ring->_size;
 }
 
-inline bool  ring_empty(RingBuffer* ring) {
+static inline bool  ring_empty(RingBuffer* ring) {
 	return ring->_size == 0;
 }
 
@@ -52,6 +52,9 @@ void sync_dtor(Sync* sync)
    for (int i = 0; i < ARRAY_SIZE(sync->_savedstate.frames); i++) {
       sync->_callbacks.free_buffer(sync->_savedstate.frames[i].buf);
    }
+   for (int i = 0; sync->_input_queues && i < sync->_config.num_players; i++) {
+      input_queue_dtor(&sync->_input_queues[i]);
+   }
    free(sync->_input_queues);
    sync->_input_queues = NULL;
 }
@@ -83,6 +86,39 @@ void sync_SetFrameDelay(Sync* sync, int queue, int delay)
         input_queue_SetFrameDelay(&sync->_input_queues[queue], delay);
 }
 
+/*
+ * sync_IsRepeatedInput --
+ *
+ * Whether input holds the same buttons as the last one added to queue, so
+ * that dropping it when the frame delay shrinks loses nothing.
+ */
+bool sync_IsRepeatedInput(Sync* sync, int queue, GameInput* input)
+{
+   GameInput last;
+   return input_queue_GetLastAddedInput(&sync->_input_queues[queue], &last) && gameinput_equal(&last, input, true);
+}
+
+void sync_SetInputPredictor(Sync* sync, int queue, GGPOInputPredictor predictor, const void* release_mask, int size, GGPOPlayerHandle player)
+{
+   input_predictor_SetStrategy(input_queue_GetPredictor(&sync->_input_queues[queue]), predictor, release_mask, size,
+                               sync->_callbacks.predict_input, player);
+}
+
+void sync_SetInputRelevance(Sync* sync, int queue, const void* mask, int size)
+{
+   input_queue_SetRelevanceMask(&sync->_input_queues[queue], mask, size);
+}
+
+void sync_GetPredictionStats(Sync* sync, int queue, GGPONetworkStats* stats)
+{
+   InputPredictor* predictor = input_queue_GetPredictor(&sync->_input_queues[queue]);
+   stats->prediction.predicted_frames = predictor->_predicted_frames;
+   stats->prediction.mispredicted_frames = predictor->_mispredicted_frames;
+   stats->prediction.mispredictions = predictor->_mispredictions;
+   stats->prediction.rollback_frames = predictor->_rollback_frames;
+   stats->prediction.rollbacks_avoided = predictor->_rollbacks_avoided;
+}
+
 bool sync_AddLocalInput(Sync* sync, int queue, GameInput* input)
 {
    int frames_behind = sync->_framecount - sync->_last_confirmed_frame;
@@ -211,6 +247,25 @@ sync_SavedFrame* sync_GetLastSavedFrame(Sync *sync)
         return &sync->_savedstate.frames[i];
 }
 
+/*
+ * sync_FindSavedFrame --
+ *
+ * Return the most recent state saved between min_frame and max_frame, or
+ * NULL if none of them is still around.
+ */
+sync_SavedFrame* sync_FindSavedFrame(Sync* sync, int min_frame, int max_frame)
+{
+   sync_SavedFrame* found = NULL;
+
+   for (int i = 0; i < ARRAY_SIZE(sync->_savedstate.frames); i++) {
+      sync_SavedFrame* state = &sync->_savedstate.frames[i];
+      if (state->buf && state->frame >= min_frame && state->frame <= max_frame && (!found || state->frame > found->frame)) {
+         found = state;
+      }
+   }
+   return found;
+}
+
 void sync_SaveCurrentFrame(Sync* sync)
 {
         /*
@@ -287,6 +342,16 @@ static bool _sync_CheckSimulationConsistency(Sync* sync, int *seekTo)
       if (incorrect != GAMEINPUT_NULL_FRAME && (first_incorrect == GAMEINPUT_NULL_FRAME || incorrect < first_incorrect)) {
          first_incorrect = incorrect;
       }
+
+      /*
+       * Charge each misprediction with the frames it alone would have
+       * made us run again.
+       */
+      if (incorrect != GAMEINPUT_NULL_FRAME) {
+         InputPredictor* predictor = input_queue_GetPredictor(&sync->_input_queues[i]);
+         predictor->_mispredictions++;
+         predictor->_rollback_frames += sync->_framecount - incorrect;
+      }
    }
 
    if (first_incorrect == GAMEINPUT_NULL_FRAME) {
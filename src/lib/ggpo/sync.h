@@ -99,6 +99,12 @@ void sync_Init(Sync *sync, sync_Config* config);
 
 void sync_SetLastConfirmedFrame(Sync* sync, int frame);
 void sync_SetFrameDelay(Sync* sync, int queue, int delay);
+static inline int sync_GetFrameDelay(Sync* sync, int queue) { return input_queue_GetFrameDelay(&sync->_input_queues[queue]); }
+bool sync_IsRepeatedInput(Sync* sync, int queue, GameInput* input);
+void sync_SetInputPredictor(Sync* sync, int queue, GGPOInputPredictor predictor, const void* release_mask, int size, GGPOPlayerHandle player);
+void sync_SetInputRelevance(Sync* sync, int queue, const void* mask, int size);
+void sync_GetPredictionStats(Sync* sync, int queue, GGPONetworkStats* stats);
+static inline bool sync_GetQueuedInput(Sync* sync, int queue, int frame, GameInput* input) { return input_queue_GetConfirmedInput(&sync->_input_queues[queue], frame, input); }
 bool sync_AddLocalInput(Sync* sync, int queue, GameInput* input);
 void sync_AddRemoteInput(Sync* sync, int queue, GameInput* input);
 int sync_GetConfirmedInputs(Sync* sync, void* values, int size, int frame);
@@ -106,10 +112,11 @@ int sync_SynchronizeInputs(Sync* sync, void* values, int size);
 void sync_CheckSimulation(Sync* sync, int timeout);
 void sync_AdjustSimulation(Sync* sync, int seek_to);
 void sync_IncrementFrame(Sync* sync);
-inline int sync_GetFrameCount(Sync* sync) { return sync->_framecount; }
-inline bool sync_InRollback(Sync* sync) { return sync->_rollingback; }
+static inline int sync_GetFrameCount(Sync* sync) { return sync->_framecount; }
+static inline bool sync_InRollback(Sync* sync) { return sync->_rollingback; }
 bool sync_GetEvent(Sync* sync, sync_Event* e);
 sync_SavedFrame* sync_GetLastSavedFrame(Sync* sync);
+sync_SavedFrame* sync_FindSavedFrame(Sync* sync, int min_frame, int max_frame);
 void sync_SaveCurrentFrame(Sync* sync);
 void sync_LoadFrame(Sync* sync, int frame);
 #endif
@@ -25,40 +25,67 @@
 
 void timesync_init(TimeSync* timesync)
 {
+	timesync_set_frame_duration(timesync, TIMESYNC_DEFAULT_FRAME_USEC);
+	timesync->_next_prediction = FRAME_WINDOW_SIZE * 3;
+	timesync->_recommend_count = 0;
+}
+
+/*
+ * timesync_scale_frames --
+ *
+ * Converts a number of frames of TIMESYNC_DEFAULT_FRAME_USEC into the
+ * number of frames of usec covering the same time, rounded.
+ */
+static int timesync_scale_frames(int frames, int usec)
+{
+	return (int)(((int64)frames * TIMESYNC_DEFAULT_FRAME_USEC + usec / 2) / usec);
+}
+
+/*
+ * timesync_set_frame_duration --
+ *
+ * Sizes the window and the thresholds for frames lasting usec
+ * microseconds.  The frame advantages gathered so far are dropped, since
+ * they were laid out for the previous window.
+ */
+void timesync_set_frame_duration(TimeSync* timesync, int usec)
+{
+	ASSERT(usec > 0);
+	timesync->_frame_usec = usec;
+	timesync->_window_size = MAX(MIN_UNIQUE_FRAMES, MIN(timesync_scale_frames(FRAME_WINDOW_SIZE, usec), MAX_FRAME_WINDOW_SIZE));
+	timesync->_min_frame_advantage = MAX(1, timesync_scale_frames(MIN_FRAME_ADVANTAGE, usec));
+	timesync->_max_frame_advantage = MAX(timesync->_min_frame_advantage, timesync_scale_frames(MAX_FRAME_ADVANTAGE, usec));
+
 	memset(timesync->_local, 0, sizeof(timesync->_local));
 	memset(timesync->_remote, 0, sizeof(timesync->_remote));
-	timesync->_next_prediction = FRAME_WINDOW_SIZE * 3;
+	timesync->_local_sum = 0;
+	timesync->_remote_sum = 0;
 }
 
 
 void timesync_advance_frame(TimeSync* timesync, GameInput* input, int advantage, int radvantage)
 {
 
-	// Remember the last frame and frame advantage
+	int slot = input->frame % timesync->_window_size;
+
+	// Remember the last frame and frame advantage, keeping the window sums
+	// up to date as the oldest entries are replaced.
 	timesync->_last_inputs[input->frame % ARRAY_SIZE(timesync->_last_inputs)] = *input;
-	timesync->_local[input->frame % ARRAY_SIZE(timesync->_local)] = advantage;
-	timesync->_remote[input->frame % ARRAY_SIZE(timesync->_remote)] = radvantage;
+	timesync->_local_sum += advantage - timesync->_local[slot];
+	timesync->_remote_sum += radvantage - timesync->_remote[slot];
+	timesync->_local[slot] = advantage;
+	timesync->_remote[slot] = radvantage;
 
 }
 
-int timesync_recommend_frame_wait_duration(TimeSync const* timesync, bool require_idle_input)
+int timesync_recommend_frame_wait_duration(TimeSync* timesync, bool require_idle_input)
 {
 	// Average our local and remote frame advantages
-	int i, sum = 0;
-	float advantage, radvantage;
-	for (i = 0; i < ARRAY_SIZE(timesync->_local); i++) {
-		sum += timesync->_local[i];
-	}
-	advantage = sum / (float)ARRAY_SIZE(timesync->_local);
-
-	sum = 0;
-	for (i = 0; i < ARRAY_SIZE(timesync->_remote); i++) {
-		sum += timesync->_remote[i];
-	}
-	radvantage = sum / (float)ARRAY_SIZE(timesync->_remote);
+	int i;
+	float advantage = timesync->_local_sum / (float)timesync->_window_size;
+	float radvantage = timesync->_remote_sum / (float)timesync->_window_size;
 
-	static int count = 0;
-	count++;
+	int count = ++timesync->_recommend_count;
 
 	// See if someone should take action.  The person furthest ahead
 	// needs to slow down so the other user can catch up.
@@ -76,7 +103,7 @@ int timesync_recommend_frame_wait_duration(TimeSync const* timesync, bool requir
 
 	// Some things just aren't worth correcting for.  Make sure
 	// the difference is relevant before proceeding.
-	if (sleep_frames < MIN_FRAME_ADVANTAGE) {
+	if (sleep_frames < timesync->_min_frame_advantage) {
 		return 0;
 	}
 
@@ -94,6 +121,31 @@ int timesync_recommend_frame_wait_duration(TimeSync const* timesync, bool requir
 	}
 
 	// Success!!! Recommend the number of frames to sleep and adjust
-	return MIN(sleep_frames, MAX_FRAME_ADVANTAGE);
+	return MIN(sleep_frames, timesync->_max_frame_advantage);
+
+}
 
+/*
+ * timesync_recommend_drift --
+ *
+ * The number of microseconds to add to each frame so that our lead over
+ * the remote is gone after DRIFT_SLEW_USEC.  Unlike the frame
+ * wait above, this is small enough to apply on every frame without the
+ * player noticing, so it doesn't wait for idle input.  Returns 0 when we
+ * aren't ahead.
+ */
+int timesync_recommend_drift(TimeSync const* timesync)
+{
+	float advantage = timesync->_local_sum / (float)timesync->_window_size;
+	float radvantage = timesync->_remote_sum / (float)timesync->_window_size;
+
+	// Same rule as timesync_recommend_frame_wait_duration: only the side
+	// both clients agree is ahead slows down, by half the difference.
+	float lead = (radvantage - advantage) / 2;
+	if (lead < MIN_DRIFT_ADVANTAGE) {
+		return 0;
+	}
+	float slew_frames = DRIFT_SLEW_USEC / (float)timesync->_frame_usec;
+	int usec = (int)(lead * timesync->_frame_usec / slew_frames + 0.5f);
+	return MIN(usec, timesync->_frame_usec / DRIFT_MAX_FRAME_FRACTION);
 }
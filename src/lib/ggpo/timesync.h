@@ -27,23 +27,49 @@
 #include "types.h"
 #include "game_input.h"
 
+/*
+ * The window and the frame advantage thresholds are given in frames of
+ * TIMESYNC_DEFAULT_FRAME_USEC, and scaled by timesync_set_frame_duration
+ * so that they cover the same amount of time at any tick rate.
+ */
+#define TIMESYNC_DEFAULT_FRAME_USEC  (1000000 / 60)
 #define FRAME_WINDOW_SIZE           40
+#define MAX_FRAME_WINDOW_SIZE      (FRAME_WINDOW_SIZE * 4)
 #define MIN_UNIQUE_FRAMES           10
 #define MIN_FRAME_ADVANTAGE          3
 #define MAX_FRAME_ADVANTAGE          9
 
+/*
+ * Drift correction.  A lead is shed by stretching each frame of the next
+ * DRIFT_SLEW_USEC, never by more than 1 / DRIFT_MAX_FRAME_FRACTION of a
+ * frame, and leads under MIN_DRIFT_ADVANTAGE frames are left alone.
+ */
+#define DRIFT_SLEW_USEC              1000000
+#define DRIFT_MAX_FRAME_FRACTION     10
+#define MIN_DRIFT_ADVANTAGE          0.5f
+
 
 struct TimeSync
 {
-	int         _local[FRAME_WINDOW_SIZE];
-	int         _remote[FRAME_WINDOW_SIZE];
+	int         _local[MAX_FRAME_WINDOW_SIZE];
+	int         _remote[MAX_FRAME_WINDOW_SIZE];
+	int         _local_sum;
+	int         _remote_sum;
+	int         _frame_usec;
+	int         _window_size;
+	int         _min_frame_advantage;
+	int         _max_frame_advantage;
 	GameInput   _last_inputs[MIN_UNIQUE_FRAMES];
 	int         _next_prediction;
+	int         _recommend_count;
 };
 typedef struct TimeSync TimeSync;
 
 void timesync_init(TimeSync* timesync);
+void timesync_set_frame_duration(TimeSync* timesync, int usec);
+static inline int timesync_get_frame_duration(TimeSync const* timesync) { return timesync->_frame_usec; }
 void timesync_advance_frame(TimeSync* timesync, GameInput* input, int advantage, int radvantage);
-int timesync_recommend_frame_wait_duration(TimeSync const* timesync, bool require_idle_input);
+int timesync_recommend_frame_wait_duration(TimeSync* timesync, bool require_idle_input);
+int timesync_recommend_drift(TimeSync const* timesync);
 
 #endif